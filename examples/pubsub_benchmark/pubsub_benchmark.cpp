@@ -0,0 +1,136 @@
+#include <websocketpp/config/core.hpp>
+
+#include <websocketpp/server.hpp>
+#include <websocketpp/pubsub.hpp>
+
+#include <websocketpp/common/chrono.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Measures the cost of fanning a message out to many subscribers. The
+// subscribers are iostream connections that write to a stream that discards
+// its input, so no sockets are involved and the results are the per
+// subscriber cost of the library alone. Each message is published once with
+// the pubsub broker, which frames it once for all subscribers, and once with
+// a loop that sends the payload to each connection handle, which frames it
+// once per subscriber.
+
+namespace chrono = websocketpp::lib::chrono;
+
+struct config : public websocketpp::config::core {
+    // Keep the per connection footprint small enough for a large number of
+    // subscribers
+    static const size_t connection_read_buffer_size = 512;
+};
+
+typedef websocketpp::server<config> server;
+typedef websocketpp::pubsub::broker<server> broker;
+
+/// Stream buffer that discards everything written to it
+class null_buffer : public std::streambuf {
+protected:
+    std::streamsize xsputn(char const *, std::streamsize n) {
+        return n;
+    }
+    int_type overflow(int_type c) {
+        return traits_type::not_eof(c);
+    }
+};
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::duration<double> >(
+        chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char * argv[]) {
+    size_t subscribers = 100000;
+    size_t messages = 100;
+    size_t size = 64;
+
+    if (argc > 1) {
+        subscribers = std::strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        messages = std::strtoul(argv[2], NULL, 10);
+    }
+    if (argc > 3) {
+        size = std::strtoul(argv[3], NULL, 10);
+    }
+    if (subscribers == 0 || messages == 0) {
+        std::cout << "Usage: pubsub_benchmark [subscribers] [messages] [size]"
+                  << std::endl;
+        return 1;
+    }
+
+    null_buffer buffer;
+    std::ostream output(&buffer);
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    broker::ptr b = websocketpp::lib::make_shared<broker>(&s);
+    b->set_backpressure(websocketpp::pubsub::backpressure::unbounded, 0);
+
+    std::string handshake = "GET / HTTP/1.1\r\nHost: localhost\r\n"
+        "Connection: upgrade\r\nUpgrade: websocket\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+
+    std::cout << "Opening " << subscribers << " subscribers" << std::endl;
+
+    std::vector<server::connection_ptr> cons;
+    std::vector<websocketpp::connection_hdl> hdls;
+    cons.reserve(subscribers);
+    hdls.reserve(subscribers);
+    for (size_t i = 0; i < subscribers; ++i) {
+        server::connection_ptr con = s.get_connection();
+        con->start();
+        con->read_some(handshake.data(), handshake.length());
+
+        b->subscribe(con->get_handle(), "ticker");
+        cons.push_back(con);
+        hdls.push_back(con->get_handle());
+    }
+
+    std::string payload(size, '*');
+    std::cout << "Publishing " << messages << " messages of " << size
+              << " bytes" << std::endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < messages; ++i) {
+        b->publish("ticker", payload);
+    }
+    double shared = seconds_since(start);
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < messages; ++i) {
+        for (size_t j = 0; j < hdls.size(); ++j) {
+            s.send(hdls[j], payload, websocketpp::frame::opcode::text);
+        }
+    }
+    double looped = seconds_since(start);
+
+    double deliveries = double(messages) * double(subscribers);
+    std::cout << "broker: " << (1e9 * shared / deliveries)
+              << " ns per delivery, " << (messages / shared)
+              << " messages per second" << std::endl;
+    std::cout << "loop:   " << (1e9 * looped / deliveries)
+              << " ns per delivery, " << (messages / looped)
+              << " messages per second" << std::endl;
+
+    std::cout << "10000 messages per second to " << subscribers
+              << " subscribers leaves " << (1e9 / (1e4 * subscribers))
+              << " ns per delivery" << std::endl;
+
+    websocketpp::pubsub::stats stats = b->get_stats();
+    std::cout << "frames prepared by the broker: " << stats.frames
+              << std::endl;
+
+    return 0;
+}
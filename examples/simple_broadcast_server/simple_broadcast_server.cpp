@@ -1,4 +1,3 @@
-#include <set>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 
@@ -14,23 +13,16 @@ public:
     broadcast_server() {
         m_server.init_asio();
 
-        m_server.set_open_handler(bind(&broadcast_server::on_open,this,::_1));
-        m_server.set_close_handler(bind(&broadcast_server::on_close,this,::_1));
-        m_server.set_message_handler(bind(&broadcast_server::on_message,this,::_1,::_2));
-    }
-
-    void on_open(connection_hdl hdl) {
-        m_connections.insert(hdl);
-    }
+        // Let the endpoint keep track of the open connections
+        m_server.set_connection_registry(true);
 
-    void on_close(connection_hdl hdl) {
-        m_connections.erase(hdl);
+        m_server.set_message_handler(bind(&broadcast_server::on_message,this,::_1,::_2));
     }
 
     void on_message(connection_hdl hdl, server::message_ptr msg) {
-        for (auto it : m_connections) {
-            m_server.send(it,msg);
-        }
+        m_server.for_each_open([msg](server::connection_ptr const & con) {
+            con->send(msg);
+        });
     }
 
     void run(uint16_t port) {
@@ -39,10 +31,7 @@ public:
         m_server.run();
     }
 private:
-    typedef std::set<connection_hdl,std::owner_less<connection_hdl>> con_list;
-
     server m_server;
-    con_list m_connections;
 };
 
 int main() {
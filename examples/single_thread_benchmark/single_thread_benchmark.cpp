@@ -0,0 +1,162 @@
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/config/asio_single_thread.hpp>
+
+#include <websocketpp/server.hpp>
+#include <websocketpp/client.hpp>
+
+#include <websocketpp/common/chrono.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Measures the per-message cost of the library by echoing messages between a
+// client and a server that share one io_service and one thread. Everything
+// except the configs is identical between runs, so the difference between
+// the results is the cost of the strands and locks that the multithreaded
+// configs pay for.
+
+using websocketpp::lib::placeholders::_1;
+using websocketpp::lib::placeholders::_2;
+using websocketpp::lib::bind;
+
+namespace chrono = websocketpp::lib::chrono;
+
+template <typename server_config, typename client_config>
+class echo_benchmark {
+public:
+    typedef websocketpp::server<server_config> server;
+    typedef websocketpp::client<client_config> client;
+    typedef typename server::message_ptr server_message_ptr;
+    typedef typename client::message_ptr client_message_ptr;
+
+    echo_benchmark(size_t messages, size_t size)
+      : m_messages(messages)
+      , m_received(0)
+      , m_payload(size, '*')
+    {
+        m_server.clear_access_channels(websocketpp::log::alevel::all);
+        m_server.clear_error_channels(websocketpp::log::elevel::all);
+        m_client.clear_access_channels(websocketpp::log::alevel::all);
+        m_client.clear_error_channels(websocketpp::log::elevel::all);
+
+        m_server.init_asio(&m_io_service);
+        m_client.init_asio(&m_io_service);
+
+        m_server.set_message_handler(bind(&echo_benchmark::on_server_message,
+            this,_1,_2));
+        m_client.set_open_handler(bind(&echo_benchmark::on_client_open,
+            this,_1));
+        m_client.set_message_handler(bind(&echo_benchmark::on_client_message,
+            this,_1,_2));
+    }
+
+    /// Run the benchmark and return the mean round trip time in nanoseconds
+    double run() {
+        websocketpp::lib::asio::ip::tcp::endpoint ep(
+            websocketpp::lib::asio::ip::address_v4::loopback(), 0);
+        m_server.listen(ep);
+        m_server.start_accept();
+
+        websocketpp::lib::asio::error_code aec;
+        std::stringstream uri;
+        uri << "ws://127.0.0.1:" << m_server.get_local_endpoint(aec).port();
+
+        websocketpp::lib::error_code ec;
+        typename client::connection_ptr con = m_client.get_connection(
+            uri.str(), ec);
+        if (ec) {
+            std::cout << "could not create connection: " << ec.message()
+                      << std::endl;
+            return 0;
+        }
+        m_client.connect(con);
+
+        m_io_service.run();
+
+        chrono::nanoseconds elapsed = chrono::duration_cast<chrono::nanoseconds>(
+            m_end - m_start);
+        return double(elapsed.count()) / double(m_messages);
+    }
+private:
+    void on_server_message(websocketpp::connection_hdl hdl,
+        server_message_ptr msg)
+    {
+        m_server.send(hdl, msg->get_payload(), msg->get_opcode());
+    }
+
+    void on_client_open(websocketpp::connection_hdl hdl) {
+        m_start = chrono::steady_clock::now();
+        m_client.send(hdl, m_payload, websocketpp::frame::opcode::binary);
+    }
+
+    void on_client_message(websocketpp::connection_hdl hdl,
+        client_message_ptr)
+    {
+        if (++m_received < m_messages) {
+            m_client.send(hdl, m_payload, websocketpp::frame::opcode::binary);
+            return;
+        }
+
+        m_end = chrono::steady_clock::now();
+        m_server.stop_listening();
+        m_client.close(hdl, websocketpp::close::status::normal, "");
+    }
+
+    websocketpp::lib::asio::io_service m_io_service;
+    server m_server;
+    client m_client;
+
+    size_t m_messages;
+    size_t m_received;
+    std::string m_payload;
+    chrono::steady_clock::time_point m_start;
+    chrono::steady_clock::time_point m_end;
+};
+
+int main(int argc, char * argv[]) {
+    size_t messages = 100000;
+    size_t size = 64;
+
+    if (argc > 1) {
+        messages = std::strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        size = std::strtoul(argv[2], NULL, 10);
+    }
+    if (messages == 0) {
+        std::cout << "Usage: single_thread_benchmark [messages] [size]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << "Echoing " << messages << " messages of " << size
+              << " bytes" << std::endl;
+
+    double multi;
+    double single;
+
+    {
+        echo_benchmark<websocketpp::config::asio,
+            websocketpp::config::asio_client> b(messages, size);
+        multi = b.run();
+    }
+    {
+        echo_benchmark<websocketpp::config::asio_single_thread,
+            websocketpp::config::asio_single_thread_client> b(messages, size);
+        single = b.run();
+    }
+
+    std::cout << "multithreaded:   " << multi << " ns per round trip"
+              << std::endl;
+    std::cout << "single threaded: " << single << " ns per round trip"
+              << std::endl;
+    if (multi > 0) {
+        std::cout << "difference:      " << (multi - single) << " ns ("
+                  << (100.0 * (multi - single) / multi) << "%)" << std::endl;
+    }
+
+    return 0;
+}
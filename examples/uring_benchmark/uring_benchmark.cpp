@@ -0,0 +1,217 @@
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/config/uring.hpp>
+
+#include <websocketpp/server.hpp>
+#include <websocketpp/client.hpp>
+
+#include <websocketpp/common/chrono.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Compares the asio and io_uring transports by echoing messages between a
+// client and a server that share one event loop and one thread. The configs
+// differ only in their transport, so the difference between the results is
+// the per message cost of the transports.
+
+using websocketpp::lib::placeholders::_1;
+using websocketpp::lib::placeholders::_2;
+using websocketpp::lib::bind;
+
+namespace chrono = websocketpp::lib::chrono;
+
+/// Sets up and runs endpoints on a shared asio io_service
+struct asio_loop {
+    typedef websocketpp::config::asio server_config;
+    typedef websocketpp::config::asio_client client_config;
+
+    template <typename endpoint>
+    void init(endpoint & e) {
+        e.init_asio(&m_io_service);
+    }
+
+    template <typename server>
+    uint16_t listen(server & s) {
+        websocketpp::lib::asio::ip::tcp::endpoint ep(
+            websocketpp::lib::asio::ip::address_v4::loopback(), 0);
+        s.listen(ep);
+
+        websocketpp::lib::asio::error_code ec;
+        return s.get_local_endpoint(ec).port();
+    }
+
+    void run() {
+        m_io_service.run();
+    }
+
+    websocketpp::lib::asio::io_service m_io_service;
+};
+
+/// Sets up and runs endpoints on a shared io_uring ring
+struct uring_loop {
+    typedef websocketpp::config::uring server_config;
+    typedef websocketpp::config::uring_client client_config;
+    typedef websocketpp::transport::uring::ring<
+        server_config::concurrency_type> ring_type;
+
+    uring_loop() {
+        websocketpp::lib::error_code ec = m_ring.init(256, 256, 16384);
+        if (ec) {
+            std::cout << "could not create ring: " << ec.message()
+                      << std::endl;
+            std::exit(1);
+        }
+    }
+
+    template <typename endpoint>
+    void init(endpoint & e) {
+        e.init_uring(&m_ring);
+    }
+
+    template <typename server>
+    uint16_t listen(server & s) {
+        s.listen(0);
+
+        websocketpp::lib::error_code ec;
+        return s.get_local_port(ec);
+    }
+
+    void run() {
+        m_ring.run();
+    }
+
+    ring_type m_ring;
+};
+
+template <typename loop>
+class echo_benchmark {
+public:
+    typedef websocketpp::server<typename loop::server_config> server;
+    typedef websocketpp::client<typename loop::client_config> client;
+    typedef typename server::message_ptr server_message_ptr;
+    typedef typename client::message_ptr client_message_ptr;
+
+    echo_benchmark(size_t messages, size_t size)
+      : m_messages(messages)
+      , m_received(0)
+      , m_payload(size, '*')
+    {
+        m_server.clear_access_channels(websocketpp::log::alevel::all);
+        m_server.clear_error_channels(websocketpp::log::elevel::all);
+        m_client.clear_access_channels(websocketpp::log::alevel::all);
+        m_client.clear_error_channels(websocketpp::log::elevel::all);
+
+        m_loop.init(m_server);
+        m_loop.init(m_client);
+
+        m_server.set_message_handler(bind(&echo_benchmark::on_server_message,
+            this,_1,_2));
+        m_client.set_open_handler(bind(&echo_benchmark::on_client_open,
+            this,_1));
+        m_client.set_message_handler(bind(&echo_benchmark::on_client_message,
+            this,_1,_2));
+    }
+
+    /// Run the benchmark and return the mean round trip time in nanoseconds
+    double run() {
+        uint16_t port = m_loop.listen(m_server);
+        m_server.start_accept();
+
+        std::stringstream uri;
+        uri << "ws://127.0.0.1:" << port;
+
+        websocketpp::lib::error_code ec;
+        typename client::connection_ptr con = m_client.get_connection(
+            uri.str(), ec);
+        if (ec) {
+            std::cout << "could not create connection: " << ec.message()
+                      << std::endl;
+            return 0;
+        }
+        m_client.connect(con);
+
+        m_loop.run();
+
+        chrono::nanoseconds elapsed = chrono::duration_cast<chrono::nanoseconds>(
+            m_end - m_start);
+        return double(elapsed.count()) / double(m_messages);
+    }
+private:
+    void on_server_message(websocketpp::connection_hdl hdl,
+        server_message_ptr msg)
+    {
+        m_server.send(hdl, msg->get_payload(), msg->get_opcode());
+    }
+
+    void on_client_open(websocketpp::connection_hdl hdl) {
+        m_start = chrono::steady_clock::now();
+        m_client.send(hdl, m_payload, websocketpp::frame::opcode::binary);
+    }
+
+    void on_client_message(websocketpp::connection_hdl hdl,
+        client_message_ptr)
+    {
+        if (++m_received < m_messages) {
+            m_client.send(hdl, m_payload, websocketpp::frame::opcode::binary);
+            return;
+        }
+
+        m_end = chrono::steady_clock::now();
+        m_server.stop_listening();
+        m_client.close(hdl, websocketpp::close::status::normal, "");
+    }
+
+    // The loop is declared first so that it outlives the endpoints
+    loop m_loop;
+    server m_server;
+    client m_client;
+
+    size_t m_messages;
+    size_t m_received;
+    std::string m_payload;
+    chrono::steady_clock::time_point m_start;
+    chrono::steady_clock::time_point m_end;
+};
+
+int main(int argc, char * argv[]) {
+    size_t messages = 100000;
+    size_t size = 64;
+
+    if (argc > 1) {
+        messages = std::strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        size = std::strtoul(argv[2], NULL, 10);
+    }
+    if (messages == 0) {
+        std::cout << "Usage: uring_benchmark [messages] [size]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Echoing " << messages << " messages of " << size
+              << " bytes" << std::endl;
+
+    double asio;
+    double uring;
+
+    {
+        echo_benchmark<asio_loop> b(messages, size);
+        asio = b.run();
+    }
+    {
+        echo_benchmark<uring_loop> b(messages, size);
+        uring = b.run();
+    }
+
+    std::cout << "asio:     " << asio << " ns per round trip" << std::endl;
+    std::cout << "io_uring: " << uring << " ns per round trip" << std::endl;
+    if (asio > 0) {
+        std::cout << "difference: " << (asio - uring) << " ns ("
+                  << (100.0 * (asio - uring) / asio) << "%)" << std::endl;
+    }
+
+    return 0;
+}
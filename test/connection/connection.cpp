@@ -528,3 +528,261 @@ BOOST_AUTO_TEST_CASE( server_handshake_timeout_race2 ) {
 }
 
 
+
+struct hybi13_only_config : public websocketpp::config::core {
+    static const unsigned int processor_versions =
+        websocketpp::processor::versions::hybi13;
+};
+
+typedef websocketpp::server<hybi13_only_config> hybi13_only_server;
+
+std::string run_hybi13_only_test(hybi13_only_server & s, std::string input) {
+    std::stringstream output;
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    hybi13_only_server::connection_ptr con = s.get_connection();
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+
+    return output.str();
+}
+
+BOOST_AUTO_TEST_CASE( processor_version_list ) {
+    using websocketpp::processor::versions::list;
+
+    std::vector<int> v = list(websocketpp::processor::versions::all);
+    BOOST_CHECK_EQUAL( v.size(), 4 );
+    BOOST_CHECK( v == websocketpp::versions_supported );
+
+    v = list(websocketpp::processor::versions::hybi13);
+    BOOST_REQUIRE_EQUAL( v.size(), 1 );
+    BOOST_CHECK_EQUAL( v[0], 13 );
+}
+
+BOOST_AUTO_TEST_CASE( hybi13_only_holds_processor_by_value ) {
+    typedef hybi13_only_server::connection_type::processor_holder holder;
+    typedef server::connection_type::processor_holder general_holder;
+
+    bool direct = websocketpp::lib::is_same<holder::processor_type,
+        websocketpp::processor::hybi13_direct<hybi13_only_config> >::value;
+    bool general = websocketpp::lib::is_same<general_holder::processor_type,
+        websocketpp::processor::processor<websocketpp::config::core> >::value;
+    BOOST_CHECK( direct );
+    BOOST_CHECK( general );
+}
+
+BOOST_AUTO_TEST_CASE( hybi13_only_accepts_rfc6455 ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+
+    // After the handshake, a masked text frame "foo" followed by a close
+    char frame[15] = {char(0x81), char(0x83), 0x00, 0x00, 0x00, 0x00, 'f',
+        'o', 'o', char(0x88), char(0x82), 0x00, 0x00, 0x00, 0x00};
+    input.append(frame, 15);
+    input.append("\x03\xe8", 2);
+
+    hybi13_only_server s;
+    s.set_user_agent("");
+
+    std::string output = run_hybi13_only_test(s, input);
+    BOOST_CHECK_EQUAL( output.substr(0, 34), "HTTP/1.1 101 Switching Protocols\r\n" );
+
+    // The close acknowledgement follows the handshake response
+    std::string ack("\x88\x02\x03\xe8", 4);
+    BOOST_CHECK_EQUAL( output.substr(output.size() - 4), ack );
+}
+
+BOOST_AUTO_TEST_CASE( hybi13_only_rejects_legacy_versions ) {
+    std::string hybi08 = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 8\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string hybi00 = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\nOrigin: http://www.example.com\r\n\r\nWjN}|M(6";
+
+    hybi13_only_server s;
+    s.set_user_agent("");
+
+    std::string output = run_hybi13_only_test(s, hybi08);
+    BOOST_CHECK_EQUAL( output.substr(0, 26), "HTTP/1.1 400 Bad Request\r\n" );
+    BOOST_CHECK( output.find("Sec-WebSocket-Version: 13\r\n") != std::string::npos );
+
+    output = run_hybi13_only_test(s, hybi00);
+    BOOST_CHECK_EQUAL( output.substr(0, 26), "HTTP/1.1 400 Bad Request\r\n" );
+    BOOST_CHECK( output.find("Sec-WebSocket-Version: 13\r\n") != std::string::npos );
+}
+
+template <size_t coalesce_size>
+struct coalesce_config : public websocketpp::config::core {
+    static const size_t write_coalesce_size = coalesce_size;
+};
+
+/// Records the transport buffers of each frame write and sends a burst of
+/// messages from within the first one, so that they queue up behind it.
+template <typename endpoint_type>
+struct write_recorder {
+    typedef typename endpoint_type::connection_ptr connection_ptr;
+
+    websocketpp::lib::error_code on_write(websocketpp::connection_hdl,
+        char const *, size_t)
+    {
+        return websocketpp::lib::error_code();
+    }
+
+    websocketpp::lib::error_code on_vector_write(websocketpp::connection_hdl,
+        std::vector<websocketpp::transport::buffer> const & bufs)
+    {
+        writes.push_back(bufs.size());
+        first_buffers.push_back(bufs.empty() ? NULL : bufs[0].buf);
+        for (size_t i = 0; i < bufs.size(); i++) {
+            bytes.append(bufs[i].buf, bufs[i].len);
+        }
+
+        if (writes.size() == 1) {
+            frames.resize(burst.size());
+            for (size_t i = 0; i < burst.size(); i++) {
+                if (!shared) {
+                    con->send(burst[i], websocketpp::frame::opcode::binary);
+                    continue;
+                }
+                // Frames kept in a cache are shared as if by several
+                // connections
+                typename endpoint_type::message_ptr msg = con->get_message(
+                    websocketpp::frame::opcode::binary, burst[i].size());
+                msg->append_payload(burst[i]);
+                con->send(msg, frames[i]);
+            }
+        }
+        return websocketpp::lib::error_code();
+    }
+
+    void on_open(websocketpp::connection_hdl) {
+        con->send(std::string("first"), websocketpp::frame::opcode::binary);
+    }
+
+    void run(endpoint_type & e) {
+        using websocketpp::lib::bind;
+        using websocketpp::lib::placeholders::_1;
+        using websocketpp::lib::placeholders::_2;
+        using websocketpp::lib::placeholders::_3;
+
+        e.clear_access_channels(websocketpp::log::alevel::all);
+        e.clear_error_channels(websocketpp::log::elevel::all);
+        e.set_open_handler(bind(&write_recorder::on_open, this, _1));
+
+        con = e.get_connection();
+        con->set_write_handler(bind(&write_recorder::on_write, this, _1, _2,
+            _3));
+        con->set_vector_write_handler(bind(&write_recorder::on_vector_write,
+            this, _1, _2));
+        con->start();
+
+        std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+        con->read_some(handshake.data(), handshake.size());
+    }
+
+    write_recorder() : shared(false) {}
+
+    connection_ptr con;
+    std::vector<std::string> burst;
+    bool shared;
+    std::vector<typename endpoint_type::connection_type::frame_cache> frames;
+    std::vector<size_t> writes;
+    std::vector<char const *> first_buffers;
+    std::string bytes;
+};
+
+std::string binary_frame(std::string const & payload) {
+    std::string frame(1, char(0x82));
+    frame.push_back(char(payload.size()));
+    return frame + payload;
+}
+
+BOOST_AUTO_TEST_CASE( coalesce_small_frames ) {
+    typedef websocketpp::server<coalesce_config<16384> > endpoint_type;
+    endpoint_type s;
+    write_recorder<endpoint_type> r;
+    r.burst.push_back("a");
+    r.burst.push_back("bc");
+    r.burst.push_back("def");
+    r.run(s);
+
+    BOOST_REQUIRE_EQUAL( r.writes.size(), 2 );
+    BOOST_CHECK_EQUAL( r.writes[0], 1 );
+    BOOST_CHECK_EQUAL( r.writes[1], 1 );
+    BOOST_CHECK_EQUAL( r.bytes, binary_frame("first") + binary_frame("a") +
+        binary_frame("bc") + binary_frame("def") );
+}
+
+BOOST_AUTO_TEST_CASE( coalesce_sends_large_frames_in_place ) {
+    typedef websocketpp::server<coalesce_config<8> > endpoint_type;
+    endpoint_type s;
+    write_recorder<endpoint_type> r;
+    r.burst.push_back("abc");
+    r.burst.push_back("defgh");
+    r.burst.push_back("ijklmnopqrstuvwxyz");
+    r.run(s);
+
+    // "abc" and the header of "defgh" share a buffer, the payload of "defgh"
+    // is sent in place and the last frame no longer fits at all.
+    BOOST_REQUIRE_EQUAL( r.writes.size(), 2 );
+    BOOST_CHECK_EQUAL( r.writes[0], 1 );
+    BOOST_CHECK_EQUAL( r.writes[1], 4 );
+    BOOST_CHECK_EQUAL( r.bytes, binary_frame("first") + binary_frame("abc") +
+        binary_frame("defgh") + binary_frame("ijklmnopqrstuvwxyz") );
+}
+
+BOOST_AUTO_TEST_CASE( coalesce_sends_shared_frames_in_place ) {
+    typedef websocketpp::server<coalesce_config<16384> > endpoint_type;
+    endpoint_type s;
+    write_recorder<endpoint_type> r;
+    r.burst.push_back("a");
+    r.burst.push_back("bc");
+    r.shared = true;
+    r.run(s);
+
+    // Only the headers of the shared frames are copied
+    BOOST_REQUIRE_EQUAL( r.writes.size(), 2 );
+    BOOST_CHECK_EQUAL( r.writes[1], 4 );
+    BOOST_CHECK_EQUAL( r.bytes, binary_frame("first") + binary_frame("a") +
+        binary_frame("bc") );
+}
+
+BOOST_AUTO_TEST_CASE( coalesce_reuses_buffer_after_drain ) {
+    typedef websocketpp::server<coalesce_config<16384> > endpoint_type;
+    endpoint_type s;
+    write_recorder<endpoint_type> r;
+    r.burst.push_back(std::string(100, 'a'));
+    r.burst.push_back(std::string(100, 'b'));
+    r.run(s);
+
+    BOOST_REQUIRE_EQUAL( r.writes.size(), 2 );
+    BOOST_CHECK_EQUAL( r.writes[1], 1 );
+    size_t held = r.con->get_memory_usage().send_queue;
+    BOOST_CHECK( held >= 2 * (100 + 2) );
+
+    // The queue drained after the burst. The next burst is copied into the
+    // same buffer rather than a new allocation.
+    r.con->send(std::string(100, 'c'), websocketpp::frame::opcode::binary);
+
+    BOOST_REQUIRE_EQUAL( r.writes.size(), 3 );
+    BOOST_CHECK_EQUAL( r.writes[2], 1 );
+    BOOST_CHECK( r.first_buffers[2] == r.first_buffers[1] );
+    BOOST_CHECK_EQUAL( r.con->get_memory_usage().send_queue, held );
+}
+
+BOOST_AUTO_TEST_CASE( coalesce_disabled ) {
+    typedef websocketpp::server<coalesce_config<0> > endpoint_type;
+    endpoint_type s;
+    write_recorder<endpoint_type> r;
+    r.burst.push_back("a");
+    r.burst.push_back("bc");
+    r.run(s);
+
+    BOOST_REQUIRE_EQUAL( r.writes.size(), 2 );
+    BOOST_CHECK_EQUAL( r.writes[0], 2 );
+    BOOST_CHECK_EQUAL( r.writes[1], 4 );
+    BOOST_CHECK_EQUAL( r.bytes, binary_frame("first") + binary_frame("a") +
+        binary_frame("bc") );
+}
@@ -43,6 +43,12 @@ class config {};
 
 typedef websocketpp::extensions::permessage_deflate::enabled<config> enabled_type;
 typedef websocketpp::extensions::permessage_deflate::disabled<config> disabled_type;
+typedef websocketpp::extensions::permessage_deflate::window_policy::memory_budget
+    budget_policy;
+typedef websocketpp::extensions::permessage_deflate::enabled<config,
+    budget_policy> budget_type;
+typedef websocketpp::extensions::permessage_deflate::window_policy::window_budget
+    window_budget_type;
 
 struct ext_vars {
     enabled_type exts;
@@ -647,3 +653,206 @@ BOOST_AUTO_TEST_CASE( decompress_data ) {
     BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
     BOOST_CHECK_EQUAL( out, reference );
 }
+
+BOOST_AUTO_TEST_CASE( decompress_data_max_size ) {
+    ext_vars v;
+
+    uint8_t in[11] = {0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00, 0x00, 0x00, 0xff, 0xff};
+    std::string out;
+
+    v.exts.init(true);
+
+    v.ec = v.exts.decompress(in,11,out,5);
+
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( out, "Hello" );
+}
+
+BOOST_AUTO_TEST_CASE( decompress_data_too_big ) {
+    ext_vars v;
+
+    uint8_t in[11] = {0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00, 0x00, 0x00, 0xff, 0xff};
+    std::string out;
+
+    v.exts.init(true);
+
+    v.ec = v.exts.decompress(in,11,out,4);
+
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::extensions::error::make_error_code(
+        websocketpp::extensions::error::message_too_big) );
+    BOOST_CHECK( out.size() <= 4 );
+}
+
+BOOST_AUTO_TEST_CASE( decompress_reserve_within_max_size ) {
+    ext_vars v;
+
+    uint8_t in[11] = {0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00, 0x00, 0x00, 0xff, 0xff};
+    std::string out(500,'x');
+
+    v.exts.init(true);
+
+    v.ec = v.exts.decompress(in,11,out,600);
+
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( out, std::string(500,'x') + "Hello" );
+    BOOST_CHECK( out.capacity() <= 600 );
+}
+
+BOOST_AUTO_TEST_CASE( decompress_bomb_stops_early ) {
+    ext_vars v;
+
+    std::string compress_in(4000000,'a');
+    std::string compress_out;
+    std::string decompress_out;
+
+    v.exts.init(true);
+    v.extc.init(false);
+
+    v.ec = v.exts.compress(compress_in,compress_out);
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+    BOOST_CHECK( compress_out.size() < 10000 );
+
+    v.ec = v.extc.decompress(
+        reinterpret_cast<const uint8_t *>(compress_out.data()),
+        compress_out.size(),
+        decompress_out,
+        100000
+    );
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::extensions::error::make_error_code(
+        websocketpp::extensions::error::message_too_big) );
+    BOOST_CHECK( decompress_out.size() <= 100000 );
+    BOOST_CHECK( decompress_out.capacity() < 1000000 );
+}
+
+// Memory budget window policy
+
+BOOST_AUTO_TEST_CASE( budget_unlimited ) {
+    websocketpp::http::attribute_list attr;
+    attr["client_max_window_bits"].clear();
+
+    websocketpp::lib::shared_ptr<window_budget_type> budget =
+        websocketpp::lib::make_shared<window_budget_type>();
+
+    {
+        budget_type exts;
+        exts.set_window_budget(budget);
+        websocketpp::err_str_pair esp = exts.negotiate(attr);
+        BOOST_CHECK_EQUAL( esp.first, websocketpp::lib::error_code() );
+        BOOST_CHECK_EQUAL( esp.second, "permessage-deflate" );
+
+        BOOST_CHECK_EQUAL( budget->get_usage().connections, 1 );
+        BOOST_CHECK( budget->get_usage().bytes_in_use > 0 );
+    }
+
+    BOOST_CHECK_EQUAL( budget->get_usage().connections, 0 );
+    BOOST_CHECK_EQUAL( budget->get_usage().bytes_in_use, 0 );
+}
+
+BOOST_AUTO_TEST_CASE( budget_near_limit_shrinks_windows ) {
+    websocketpp::http::attribute_list attr;
+    attr["client_max_window_bits"].clear();
+
+    websocketpp::lib::shared_ptr<window_budget_type> budget =
+        websocketpp::lib::make_shared<window_budget_type>();
+    budget->set_budget(400000);
+
+    budget_type exts1;
+    exts1.set_window_budget(budget);
+    websocketpp::err_str_pair esp = exts1.negotiate(attr);
+    BOOST_CHECK_EQUAL( esp.second, "permessage-deflate" );
+
+    budget_type exts2;
+    exts2.set_window_budget(budget);
+    esp = exts2.negotiate(attr);
+    BOOST_CHECK_EQUAL( esp.first, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( esp.second, "permessage-deflate; server_max_window_bits=13; client_max_window_bits=13" );
+
+    BOOST_CHECK_EQUAL( exts2.init(true), websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( budget->get_usage().connections, 2 );
+}
+
+BOOST_AUTO_TEST_CASE( budget_shared_between_connections ) {
+    websocketpp::http::attribute_list attr;
+    attr["client_max_window_bits"].clear();
+
+    websocketpp::lib::shared_ptr<window_budget_type> budget =
+        websocketpp::lib::make_shared<window_budget_type>();
+    budget->set_budget(400000);
+
+    budget_type exts1;
+    exts1.set_window_budget(budget);
+    exts1.negotiate(attr);
+    budget_type exts2;
+    exts2.set_window_budget(budget);
+    exts2.negotiate(attr);
+
+    // Past the soft limit the third connection gets half of what is left
+    // rather than the smallest windows
+    budget_type exts3;
+    exts3.set_window_budget(budget);
+    websocketpp::err_str_pair esp = exts3.negotiate(attr);
+    BOOST_CHECK_EQUAL( esp.second, "permessage-deflate; server_max_window_bits=11; client_max_window_bits=11" );
+    BOOST_CHECK( budget->get_usage().bytes_in_use <= 400000 );
+}
+
+BOOST_AUTO_TEST_CASE( budget_exhausted_disables_context_takeover ) {
+    websocketpp::http::attribute_list attr;
+    attr["client_max_window_bits"].clear();
+
+    websocketpp::lib::shared_ptr<window_budget_type> budget =
+        websocketpp::lib::make_shared<window_budget_type>();
+    budget->set_budget(1);
+
+    budget_type exts;
+    exts.set_window_budget(budget);
+    websocketpp::err_str_pair esp = exts.negotiate(attr);
+    BOOST_CHECK( exts.is_enabled() );
+    BOOST_CHECK_EQUAL( esp.first, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( esp.second, "permessage-deflate; server_no_context_takeover; client_no_context_takeover; server_max_window_bits=9; client_max_window_bits=9" );
+}
+
+BOOST_AUTO_TEST_CASE( budget_without_client_bits_offer ) {
+    websocketpp::lib::shared_ptr<window_budget_type> budget =
+        websocketpp::lib::make_shared<window_budget_type>();
+    budget->set_budget(1);
+
+    budget_type exts;
+    exts.set_window_budget(budget);
+    websocketpp::err_str_pair esp = exts.negotiate(websocketpp::http::attribute_list());
+    BOOST_CHECK_EQUAL( esp.second, "permessage-deflate; server_no_context_takeover; client_no_context_takeover; server_max_window_bits=9" );
+}
+
+BOOST_AUTO_TEST_CASE( budget_not_attached_keeps_settings ) {
+    websocketpp::http::attribute_list attr;
+    attr["client_max_window_bits"].clear();
+
+    budget_type exts;
+    websocketpp::err_str_pair esp = exts.negotiate(attr);
+    BOOST_CHECK_EQUAL( esp.first, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( esp.second, "permessage-deflate" );
+}
+
+BOOST_AUTO_TEST_CASE( budget_attached_is_separate ) {
+    websocketpp::http::attribute_list attr;
+    attr["client_max_window_bits"].clear();
+
+    websocketpp::lib::shared_ptr<window_budget_type> full =
+        websocketpp::lib::make_shared<window_budget_type>();
+    websocketpp::lib::shared_ptr<window_budget_type> open =
+        websocketpp::lib::make_shared<window_budget_type>();
+    full->set_budget(1);
+
+    budget_type exts1;
+    exts1.set_window_budget(full);
+    websocketpp::err_str_pair esp = exts1.negotiate(attr);
+    BOOST_CHECK_EQUAL( esp.second, "permessage-deflate; server_no_context_takeover; client_no_context_takeover; server_max_window_bits=9; client_max_window_bits=9" );
+
+    // The other budget does not see the usage
+    budget_type exts2;
+    exts2.set_window_budget(open);
+    esp = exts2.negotiate(attr);
+    BOOST_CHECK_EQUAL( esp.second, "permessage-deflate" );
+
+    BOOST_CHECK_EQUAL( full->get_usage().connections, 1 );
+    BOOST_CHECK_EQUAL( open->get_usage().connections, 1 );
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE async_log
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+
+#include <websocketpp/logger/async.hpp>
+#include <websocketpp/concurrency/basic.hpp>
+#include <websocketpp/common/thread.hpp>
+
+typedef websocketpp::log::async<websocketpp::concurrency::basic,
+    websocketpp::log::alevel> async_access_log_type;
+
+static size_t count_lines(std::string const & s) {
+    size_t lines = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '\n') {
+            ++lines;
+        }
+    }
+    return lines;
+}
+
+BOOST_AUTO_TEST_CASE( writes_after_flush ) {
+    std::stringstream out;
+    async_access_log_type logger(0xffffffff,&out);
+
+    logger.set_channels(websocketpp::log::alevel::devel);
+    logger.write(websocketpp::log::alevel::devel,"first");
+    logger.write(websocketpp::log::alevel::devel,std::string("second"));
+    logger.write(websocketpp::log::alevel::frame_header,"filtered");
+    logger.flush();
+
+    std::string s = out.str();
+    BOOST_CHECK_EQUAL( count_lines(s), 2 );
+    BOOST_CHECK( s.find("] [devel] first\n") != std::string::npos );
+    BOOST_CHECK( s.find("] [devel] second\n") != std::string::npos );
+    BOOST_CHECK( s.find("first") < s.find("second") );
+    BOOST_CHECK( s.find("filtered") == std::string::npos );
+    BOOST_CHECK_EQUAL( logger.get_dropped(), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( access_clear ) {
+    std::stringstream out;
+    async_access_log_type logger(0xffffffff,&out);
+
+    logger.set_channels(0xffffffff);
+    logger.clear_channels(0xffffffff);
+
+    logger.write(websocketpp::log::alevel::devel,"devel");
+    logger.flush();
+    BOOST_CHECK( out.str().size() == 0 );
+}
+
+BOOST_AUTO_TEST_CASE( destructor_drains ) {
+    std::stringstream out;
+    {
+        async_access_log_type logger(0xffffffff,&out);
+        logger.set_flush_interval(60000);
+        logger.set_channels(0xffffffff);
+        for (int i = 0; i < 100; ++i) {
+            logger.write(websocketpp::log::alevel::devel,"devel");
+        }
+    }
+    BOOST_CHECK_EQUAL( count_lines(out.str()), 100 );
+}
+
+BOOST_AUTO_TEST_CASE( overflow_drops ) {
+    std::stringstream out;
+    async_access_log_type logger(0xffffffff,&out);
+    logger.set_flush_interval(60000);
+    logger.set_channels(0xffffffff);
+
+    // Only the drain thread's first pass can run while these are written
+    size_t const total = 3 * websocketpp::log::detail::async_ring::capacity;
+    for (size_t i = 0; i < total; ++i) {
+        logger.write(websocketpp::log::alevel::devel,"devel");
+    }
+    logger.flush();
+
+    BOOST_CHECK( logger.get_dropped() > 0 );
+    BOOST_CHECK_EQUAL( count_lines(out.str()) + logger.get_dropped(), total );
+}
+
+BOOST_AUTO_TEST_CASE( copies_share_output ) {
+    std::stringstream out;
+    async_access_log_type logger1(0xffffffff,&out);
+    async_access_log_type logger2(logger1);
+
+    logger2.set_channels(0xffffffff);
+    logger2.write(websocketpp::log::alevel::devel,"devel");
+    logger1.flush();
+    BOOST_CHECK_EQUAL( count_lines(out.str()), 1 );
+}
+
+static void write_records(async_access_log_type * logger, int count) {
+    for (int i = 0; i < count; ++i) {
+        logger->write(websocketpp::log::alevel::devel,"devel");
+        if (i % 100 == 0) {
+            logger->flush();
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( many_threads ) {
+    std::stringstream out;
+    async_access_log_type logger(0xffffffff,&out);
+    logger.set_channels(0xffffffff);
+
+    websocketpp::lib::thread t1(websocketpp::lib::bind(&write_records,
+        &logger,500));
+    websocketpp::lib::thread t2(websocketpp::lib::bind(&write_records,
+        &logger,500));
+    write_records(&logger,500);
+    t1.join();
+    t2.join();
+    logger.flush();
+
+    BOOST_CHECK_EQUAL( logger.get_dropped(), 0u );
+    BOOST_CHECK_EQUAL( count_lines(out.str()), 1500 );
+}
+
+BOOST_AUTO_TEST_CASE( exited_threads_rings_freed ) {
+    std::stringstream out;
+    websocketpp::log::detail::async_sink sink(&out);
+
+    for (int i = 0; i < 4; ++i) {
+        websocketpp::lib::thread t(websocketpp::lib::bind(
+            &websocketpp::log::detail::async_sink::push, &sink, "devel",
+            "devel", size_t(5)));
+        t.join();
+    }
+    sink.flush();
+
+    BOOST_CHECK_EQUAL( count_lines(out.str()), 4 );
+#ifdef _WEBSOCKETPP_ASYNC_RING_OWNER_
+    BOOST_CHECK_EQUAL( sink.get_ring_count(), 0u );
+#else
+    BOOST_CHECK_EQUAL( sink.get_ring_count(), 4u );
+#endif
+}
@@ -31,6 +31,7 @@
 #include <string>
 
 #include <websocketpp/logger/basic.hpp>
+#include <websocketpp/logger/format.hpp>
 #include <websocketpp/concurrency/none.hpp>
 #include <websocketpp/concurrency/basic.hpp>
 
@@ -94,6 +95,65 @@ BOOST_AUTO_TEST_CASE( copy_constructor ) {
     BOOST_CHECK( out.str().size() > 0 );
 }
 
+static int evaluations = 0;
+
+static int evaluate() {
+    return ++evaluations;
+}
+
+BOOST_AUTO_TEST_CASE( lazy_format ) {
+    std::stringstream out;
+    basic_access_log_type logger(websocketpp::log::alevel::devel,&out);
+
+    evaluations = 0;
+
+    // statically disabled
+    _WEBSOCKETPP_LOG(logger, websocketpp::log::alevel::frame_header,
+        "value " << evaluate());
+    // dynamically disabled
+    _WEBSOCKETPP_LOG(logger, websocketpp::log::alevel::devel,
+        "value " << evaluate());
+    BOOST_CHECK_EQUAL( evaluations, 0 );
+    BOOST_CHECK( out.str().empty() );
+
+    logger.set_channels(websocketpp::log::alevel::devel);
+    _WEBSOCKETPP_LOG(logger, websocketpp::log::alevel::devel,
+        "value " << evaluate() << " " << std::hex << 255);
+    _WEBSOCKETPP_LOG(logger, websocketpp::log::alevel::devel,
+        "value " << evaluate() << " " << 255);
+    BOOST_CHECK_EQUAL( evaluations, 2 );
+    BOOST_CHECK( out.str().find("] [devel] value 1 ff\n") != std::string::npos );
+    BOOST_CHECK( out.str().find("] [devel] value 2 255\n") != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( lazy_format_embedded_nul ) {
+    std::stringstream out;
+    basic_access_log_type logger(websocketpp::log::alevel::devel,&out);
+    logger.set_channels(websocketpp::log::alevel::devel);
+
+    std::string reason("a\0b", 3);
+    _WEBSOCKETPP_LOG(logger, websocketpp::log::alevel::devel,
+        "reason " << reason << " end");
+    std::string expected("] [devel] reason a\0b end\n", 25);
+    BOOST_CHECK( out.str().find(expected) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( nested_formatters ) {
+    websocketpp::log::formatter outer;
+    outer.stream() << "outer " << 1;
+    {
+        websocketpp::log::formatter inner;
+        inner.stream() << "inner " << 2;
+        BOOST_CHECK_EQUAL( inner.str(), "inner 2" );
+    }
+    outer.stream() << " done";
+    BOOST_CHECK_EQUAL( outer.str(), "outer 1 done" );
+
+    websocketpp::log::formatter next;
+    next.stream() << "next";
+    BOOST_CHECK_EQUAL( std::string(next.c_str()), "next" );
+}
+
 #ifdef _WEBSOCKETPP_MOVE_SEMANTICS_
 BOOST_AUTO_TEST_CASE( move_constructor ) {
     std::stringstream out;
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE metrics
+#include <boost/test/unit_test.hpp>
+
+#include <websocketpp/config/core.hpp>
+#include <websocketpp/server.hpp>
+
+#include <websocketpp/metrics/basic.hpp>
+#include <websocketpp/metrics/histogram.hpp>
+#include <websocketpp/metrics/prometheus.hpp>
+
+#include <sstream>
+#include <string>
+
+struct metrics_config : public websocketpp::config::core {
+    typedef websocketpp::metrics::basic metrics_type;
+};
+
+typedef websocketpp::server<metrics_config> server;
+typedef websocketpp::metrics::histogram histogram;
+
+using websocketpp::lib::placeholders::_1;
+using websocketpp::lib::placeholders::_2;
+using websocketpp::lib::bind;
+
+BOOST_AUTO_TEST_CASE( histogram_buckets ) {
+    for (uint64_t v = 0; v < 100000; v += 7) {
+        unsigned i = histogram::index_of(v);
+        BOOST_CHECK( histogram::upper_bound(i) >= v );
+        if (i > 0) {
+            BOOST_CHECK( histogram::upper_bound(i - 1) < v );
+        }
+    }
+
+    // Relative error is bounded by the number of sub buckets
+    uint64_t v = 123456789;
+    uint64_t upper = histogram::upper_bound(histogram::index_of(v));
+    BOOST_CHECK( upper - v <= v / histogram::sub_buckets );
+
+    BOOST_CHECK_EQUAL( histogram::index_of(~uint64_t(0)),
+        histogram::bucket_count - 1 );
+}
+
+BOOST_AUTO_TEST_CASE( histogram_percentiles ) {
+    histogram h;
+    BOOST_CHECK_EQUAL( h.get_percentile(50), 0 );
+
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        h.record(v);
+    }
+
+    BOOST_CHECK_EQUAL( h.get_count(), 1000 );
+    BOOST_CHECK_EQUAL( h.get_sum(), 500500 );
+    BOOST_CHECK_EQUAL( h.get_max(), 1000 );
+
+    uint64_t p50 = h.get_percentile(50);
+    BOOST_CHECK( p50 >= 500 && p50 <= 500 + 500 / histogram::sub_buckets );
+    BOOST_CHECK_EQUAL( h.get_percentile(100), 1000 );
+}
+
+BOOST_AUTO_TEST_CASE( basic_samples_latency_in_fixed_slots ) {
+    typedef websocketpp::metrics::basic::connection_metrics con_metrics;
+    websocketpp::lib::shared_ptr<websocketpp::metrics::basic> endpoint(
+        new websocketpp::metrics::basic());
+    con_metrics m;
+    m.attach(endpoint);
+
+    // Messages deeper in the queue than the rings hold are not sampled
+    uint64_t const slots = con_metrics::latency_slots;
+    size_t const deep = slots + 8;
+    for (size_t i = 0; i < deep; ++i) {
+        m.queued(i + 1, i + 1);
+    }
+    for (size_t i = 0; i < deep; ++i) {
+        m.dequeued();
+    }
+    for (size_t i = 0; i < deep; ++i) {
+        m.written(false, 1);
+    }
+    BOOST_CHECK_EQUAL( endpoint->get_send_latency().get_count(),
+        slots );
+    BOOST_CHECK_EQUAL( m.get_counters().messages_out, deep );
+    BOOST_CHECK_EQUAL( m.get_counters().queue_messages_peak, deep );
+
+    // The rings are reused once the queue drains
+    m.queued(1, 1);
+    m.dequeued();
+    m.written(false, 1);
+    m.written(false, 1);
+    BOOST_CHECK_EQUAL( endpoint->get_send_latency().get_count(),
+        slots + 1 );
+}
+
+std::string const handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+
+void echo(server * s, websocketpp::connection_hdl hdl, server::message_ptr msg)
+{
+    s->send(hdl, msg->get_payload(), msg->get_opcode());
+}
+
+server::connection_ptr open_connection(server & s, std::stringstream & out) {
+    server::connection_ptr con = s.get_connection();
+    con->register_ostream(&out);
+    con->start();
+    con->read_some(handshake.data(), handshake.size());
+    return con;
+}
+
+BOOST_AUTO_TEST_CASE( basic_counts_traffic ) {
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.set_message_handler(bind(&echo,&s,::_1,::_2));
+
+    std::stringstream out;
+    server::connection_ptr con = open_connection(s, out);
+    BOOST_CHECK_EQUAL( s.get_metrics().get_open_connections(), 1 );
+    BOOST_CHECK_EQUAL( s.get_metrics().get_handshake_duration().get_count(),
+        1 );
+
+    // A masked text frame with a zero masking key, then a ping
+    std::string frames("\x81\x85\x00\x00\x00\x00hello\x89\x80\x00\x00\x00\x00",
+        17);
+    con->read_some(frames.data(), frames.size());
+
+    websocketpp::metrics::counters c = con->get_metrics().get_counters();
+    BOOST_CHECK_EQUAL( c.messages_in, 1 );
+    BOOST_CHECK_EQUAL( c.control_frames_in, 1 );
+    BOOST_CHECK_EQUAL( c.frames_in, 2 );
+    BOOST_CHECK_EQUAL( c.bytes_in, 17 );
+    BOOST_CHECK_EQUAL( c.messages_out, 1 );
+    BOOST_CHECK_EQUAL( c.control_frames_out, 1 );
+    BOOST_CHECK_EQUAL( c.frames_out, 2 );
+    BOOST_CHECK_EQUAL( c.bytes_out, 9 );
+    BOOST_CHECK_EQUAL( c.queue_messages_peak, 1 );
+    BOOST_CHECK_EQUAL( c.queue_bytes_peak, 5 );
+
+    websocketpp::metrics::counters e = s.get_metrics().get_counters();
+    BOOST_CHECK_EQUAL( e.messages_in, 1 );
+    BOOST_CHECK_EQUAL( e.bytes_out, 9 );
+    BOOST_CHECK_EQUAL( s.get_metrics().get_send_latency().get_count(), 2 );
+
+    con.reset();
+    BOOST_CHECK_EQUAL( s.get_metrics().get_open_connections(), 0 );
+    BOOST_CHECK_EQUAL( s.get_metrics().get_connections_opened(), 1 );
+}
+
+BOOST_AUTO_TEST_CASE( prometheus_histogram_boundaries ) {
+    websocketpp::metrics::histogram h;
+    h.record(15);
+    h.record(16);
+
+    std::stringstream out;
+    websocketpp::metrics::write_prometheus_histogram(out, "h", "Test.", h);
+    std::string text = out.str();
+
+    // Boundaries sit one microsecond below each power of two, so 16 is
+    // counted at the next one and not below it
+    BOOST_CHECK( text.find("\nh_bucket{le=\"1.5e-05\"} 1\n")
+        != std::string::npos );
+    BOOST_CHECK( text.find("\nh_bucket{le=\"3.1e-05\"} 2\n")
+        != std::string::npos );
+    BOOST_CHECK( text.find("le=\"1.6e-05\"") == std::string::npos );
+    BOOST_CHECK( text.find("\nh_bucket{le=\"+Inf\"} 2\n")
+        != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( prometheus_export ) {
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.set_message_handler(bind(&echo,&s,::_1,::_2));
+
+    websocketpp::metrics::prometheus_exporter<server> exporter(&s);
+    s.set_http_handler(exporter);
+
+    std::stringstream ws_out;
+    server::connection_ptr con = open_connection(s, ws_out);
+    std::string frame("\x81\x82\x00\x00\x00\x00hi", 8);
+    con->read_some(frame.data(), frame.size());
+
+    std::string request = "GET /metrics HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
+    std::stringstream out;
+    server::connection_ptr http = s.get_connection();
+    http->register_ostream(&out);
+    http->start();
+    http->read_some(request.data(), request.size());
+
+    std::string response = out.str();
+    BOOST_CHECK( response.find("HTTP/1.1 200") == 0 );
+    BOOST_CHECK( response.find("text/plain; version=0.0.4")
+        != std::string::npos );
+    BOOST_CHECK( response.find("\nwebsocketpp_messages_sent_total 1\n")
+        != std::string::npos );
+    BOOST_CHECK( response.find("\nwebsocketpp_connections_open 1\n")
+        != std::string::npos );
+    BOOST_CHECK( response.find("\nwebsocketpp_send_latency_seconds_count 1\n")
+        != std::string::npos );
+    BOOST_CHECK( response.find(
+        "\nwebsocketpp_handshake_duration_seconds_bucket{le=\"+Inf\"} 1\n")
+        != std::string::npos );
+
+    request = "GET /other HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
+    std::stringstream other_out;
+    http = s.get_connection();
+    http->register_ostream(&other_out);
+    http->start();
+    http->read_some(request.data(), request.size());
+    BOOST_CHECK( other_out.str().find("HTTP/1.1 404") == 0 );
+}
@@ -691,3 +691,20 @@ BOOST_AUTO_TEST_CASE( extension_negotiation_permessage_deflate ) {
     BOOST_CHECK_EQUAL( neg_results.second, "permessage-deflate" );
 }
 
+
+BOOST_AUTO_TEST_CASE( compressed_message_too_large ) {
+    processor_setup_ext env(true);
+
+    env.req.replace_header("Sec-WebSocket-Extensions",
+        "permessage-deflate; client_max_window_bits");
+    env.p.negotiate_extensions(env.req);
+
+    env.p.set_max_message_size(4);
+
+    // 7 compressed bytes that inflate to "Hello"
+    uint8_t frame0[13] = {0xc2, 0x87, 0x00, 0x00, 0x00, 0x00, 0xf2, 0x48,
+                          0xcd, 0xc9, 0xc9, 0x07, 0x00};
+
+    env.p.consume(frame0,13,env.ec);
+    BOOST_CHECK_EQUAL( env.ec, websocketpp::processor::error::message_too_big );
+}
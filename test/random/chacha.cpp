@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE chacha
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+#include <vector>
+
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/random/chacha.hpp>
+#include <websocketpp/concurrency/basic.hpp>
+#include <websocketpp/concurrency/none.hpp>
+
+// RFC 7539 section 2.3.2
+BOOST_AUTO_TEST_CASE( block_function ) {
+    uint32_t const input[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        0x03020100, 0x07060504, 0x0b0a0908, 0x0f0e0d0c,
+        0x13121110, 0x17161514, 0x1b1a1918, 0x1f1e1d1c,
+        0x00000001, 0x09000000, 0x4a000000, 0x00000000
+    };
+    uint32_t const expected[16] = {
+        0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3,
+        0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+        0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+        0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2
+    };
+
+    uint32_t output[16];
+    websocketpp::random::chacha::detail::block(input, output);
+
+    for (int i = 0; i < 16; i++) {
+        BOOST_CHECK_EQUAL( output[i], expected[i] );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( distinct_values ) {
+    websocketpp::random::chacha::int_generator<uint32_t,
+        websocketpp::concurrency::none> rng;
+
+    // Spans several refills of the batch buffer
+    std::set<uint32_t> values;
+    for (int i = 0; i < 1000; i++) {
+        values.insert(rng());
+    }
+
+    // The chance of a collision among 1000 random 32 bit values is ~0.01%
+    BOOST_CHECK( values.size() >= 999 );
+}
+
+BOOST_AUTO_TEST_CASE( wide_types ) {
+    websocketpp::random::chacha::int_generator<uint64_t,
+        websocketpp::concurrency::none> rng64;
+    websocketpp::random::chacha::int_generator<uint8_t,
+        websocketpp::concurrency::none> rng8;
+
+    uint64_t a = rng64();
+    uint64_t b = rng64();
+    BOOST_CHECK( a != b );
+    BOOST_CHECK( (a >> 32) != 0 || (b >> 32) != 0 );
+
+    std::set<uint8_t> bytes;
+    for (int i = 0; i < 1000; i++) {
+        bytes.insert(rng8());
+    }
+    BOOST_CHECK( bytes.size() > 200 );
+}
+
+template <typename rng_type>
+void generate(rng_type * rng, std::vector<uint32_t> * out) {
+    for (size_t i = 0; i < out->size(); i++) {
+        (*out)[i] = (*rng)();
+    }
+}
+
+BOOST_AUTO_TEST_CASE( threads_have_independent_streams ) {
+    typedef websocketpp::random::chacha::int_generator<uint32_t,
+        websocketpp::concurrency::basic> rng_type;
+    rng_type rng;
+
+    std::vector<uint32_t> a(500);
+    std::vector<uint32_t> b(500);
+
+    websocketpp::lib::thread t1(websocketpp::lib::bind(&generate<rng_type>,
+        &rng, &a));
+    websocketpp::lib::thread t2(websocketpp::lib::bind(&generate<rng_type>,
+        &rng, &b));
+    t1.join();
+    t2.join();
+
+    std::set<uint32_t> values(a.begin(), a.end());
+    values.insert(b.begin(), b.end());
+    BOOST_CHECK( values.size() >= 999 );
+}
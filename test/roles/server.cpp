@@ -236,6 +236,33 @@ BOOST_AUTO_TEST_CASE( accept_subprotocol_two ) {
     BOOST_CHECK_EQUAL(open, "bar");
 }
 
+void terminate_func(server::connection_ptr const & con) {
+    con->terminate(websocketpp::lib::error_code());
+}
+
+void count_func(size_t * count, websocketpp::connection_hdl) {
+    ++(*count);
+}
+
+BOOST_AUTO_TEST_CASE( registry_visitor_terminates_connection ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    size_t closed = 0;
+
+    server s;
+    s.set_user_agent("test");
+    s.set_connection_registry(true);
+    s.set_close_handler(bind(&count_func,&closed,::_1));
+
+    run_server_test(s,input);
+    BOOST_CHECK_EQUAL(s.get_connection_registry()->size(), 1);
+
+    // Terminating removes the connection from the shard being visited
+    s.for_each_open(&terminate_func);
+    BOOST_CHECK_EQUAL(closed, 1);
+    BOOST_CHECK_EQUAL(s.get_connection_registry()->size(), 0);
+}
+
 /*BOOST_AUTO_TEST_CASE( user_reject_origin ) {
     std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example2.com\r\n\r\n";
     std::string output = "HTTP/1.1 403 Forbidden\r\nServer: test\r\n\r\n";
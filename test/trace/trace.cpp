@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE trace
+#include <boost/test/unit_test.hpp>
+
+#include <websocketpp/config/core.hpp>
+#include <websocketpp/server.hpp>
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/trace/ring.hpp>
+
+#include <set>
+#include <sstream>
+#include <string>
+
+struct trace_config : public websocketpp::config::core {
+    typedef websocketpp::trace::ring trace_type;
+};
+
+typedef websocketpp::server<trace_config> server;
+typedef websocketpp::trace::ring ring;
+
+std::string dump() {
+    std::stringstream s;
+    ring::dump(s);
+    return s.str();
+}
+
+size_t count(std::string const & haystack, std::string const & needle) {
+    size_t n = 0;
+    for (size_t p = haystack.find(needle); p != std::string::npos;
+        p = haystack.find(needle, p + 1))
+    {
+        ++n;
+    }
+    return n;
+}
+
+BOOST_AUTO_TEST_CASE( records_spans ) {
+    ring::clear();
+    {
+        ring::scope s("test::scope");
+    }
+    int object;
+    ring::begin("test::async", &object);
+    ring::end("test::async", &object);
+
+    std::string out = dump();
+    BOOST_CHECK( out.find("{\"traceEvents\":[") == 0 );
+    BOOST_CHECK_EQUAL( count(out, "\"name\":\"test::scope\""), 1 );
+    BOOST_CHECK_EQUAL( count(out, "\"ph\":\"X\""), 1 );
+    BOOST_CHECK_EQUAL( count(out, "\"dur\":"), 1 );
+    BOOST_CHECK_EQUAL( count(out, "\"ph\":\"b\""), 1 );
+    BOOST_CHECK_EQUAL( count(out, "\"ph\":\"e\""), 1 );
+
+    std::stringstream id;
+    id << "\"id\":\"0x" << std::hex
+       << reinterpret_cast<size_t>(static_cast<void *>(&object)) << "\"";
+    BOOST_CHECK_EQUAL( count(out, id.str()), 2 );
+
+    ring::clear();
+    BOOST_CHECK_EQUAL( count(dump(), "\"name\""), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( keeps_most_recent_events ) {
+    ring::clear();
+    size_t const capacity = websocketpp::trace::detail::thread_ring::capacity;
+    for (size_t i = 0; i < capacity + 10; ++i) {
+        ring::scope s("test::wrap");
+    }
+    BOOST_CHECK_EQUAL( count(dump(), "\"name\":\"test::wrap\""), capacity );
+}
+
+// Lets the main thread dump while the recording threads are alive
+struct gate {
+    gate() : recorded(0), released(false) {}
+
+    websocketpp::lib::mutex                 lock;
+    websocketpp::lib::condition_variable    cond;
+    size_t                                  recorded;
+    bool                                    released;
+};
+
+void record_spans(gate * g) {
+    for (int i = 0; i < 100; ++i) {
+        ring::scope s("test::thread");
+    }
+
+    websocketpp::lib::unique_lock<websocketpp::lib::mutex> lock(g->lock);
+    ++g->recorded;
+    g->cond.notify_all();
+    while (!g->released) {
+        g->cond.wait(lock);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( one_ring_per_thread ) {
+    ring::clear();
+    gate g;
+    websocketpp::lib::thread a(&record_spans, &g);
+    websocketpp::lib::thread b(&record_spans, &g);
+
+    std::string out;
+    {
+        websocketpp::lib::unique_lock<websocketpp::lib::mutex> lock(g.lock);
+        while (g.recorded != 2) {
+            g.cond.wait(lock);
+        }
+        out = dump();
+        g.released = true;
+        g.cond.notify_all();
+    }
+    a.join();
+    b.join();
+
+    BOOST_CHECK_EQUAL( count(out, "\"name\":\"test::thread\""), 200 );
+
+    std::set<std::string> tids;
+    for (size_t p = out.find("\"tid\":"); p != std::string::npos;
+        p = out.find("\"tid\":", p + 1))
+    {
+        tids.insert(out.substr(p, out.find(',', p) - p));
+    }
+    BOOST_CHECK_EQUAL( tids.size(), 2 );
+}
+
+void record_and_exit() {
+    for (int i = 0; i < 100; ++i) {
+        ring::scope s("test::joined");
+    }
+}
+
+BOOST_AUTO_TEST_CASE( dumps_joined_threads ) {
+    ring::clear();
+    websocketpp::lib::thread a(&record_and_exit);
+    websocketpp::lib::thread b(&record_and_exit);
+    a.join();
+    b.join();
+
+    BOOST_CHECK_EQUAL( count(dump(), "\"name\":\"test::joined\""), 200 );
+#ifdef _WEBSOCKETPP_TRACE_RING_OWNER_
+    // The rings of exited threads are freed once they have been dumped
+    BOOST_CHECK_EQUAL( count(dump(), "\"name\":\"test::joined\""), 0 );
+#endif
+}
+
+void record_until_stopped(websocketpp::lib::atomic<bool> * stop) {
+    while (!stop->load()) {
+        ring::scope s("test::busy");
+    }
+}
+
+BOOST_AUTO_TEST_CASE( dump_while_recording ) {
+    ring::clear();
+    websocketpp::lib::atomic<bool> stop(false);
+    websocketpp::lib::thread t(&record_until_stopped, &stop);
+
+    // Events overwritten while they are copied are left out, never garbled
+    for (int i = 0; i < 20; ++i) {
+        std::string out = dump();
+        BOOST_CHECK_EQUAL( count(out, "\"name\":\"test::busy\""),
+            count(out, "\"name\"") );
+        BOOST_CHECK_EQUAL( count(out, "\"ph\":\"X\""),
+            count(out, "\"name\"") );
+    }
+
+    stop.store(true);
+    t.join();
+}
+
+BOOST_AUTO_TEST_CASE( connection_hooks ) {
+    ring::clear();
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+
+    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+    std::string ping("\x89\x80\x00\x00\x00\x00", 6);
+
+    std::stringstream output;
+    server::connection_ptr con = s.get_connection();
+    con->register_ostream(&output);
+    con->start();
+    con->read_some(handshake.data(), handshake.size());
+    con->read_some(ping.data(), ping.size());
+    con->send(std::string("hello"));
+
+    std::string out = dump();
+    BOOST_CHECK_EQUAL( count(out, "\"name\":\"connection::handshake\""), 2 );
+    BOOST_CHECK_EQUAL( count(out,
+        "\"name\":\"connection::handle_read_handshake\""), 1 );
+    BOOST_CHECK_EQUAL( count(out,
+        "\"name\":\"connection::process_handshake_request\""), 1 );
+    BOOST_CHECK_EQUAL( count(out, "\"name\":\"processor::consume\""), 1 );
+    BOOST_CHECK_EQUAL( count(out,
+        "\"name\":\"processor::prepare_data_frame\""), 1 );
+    // One write for the pong and one for the message
+    BOOST_CHECK_EQUAL( count(out, "\"name\":\"connection::write\""), 4 );
+}
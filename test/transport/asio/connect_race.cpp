@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE transport_asio_connect_race
+#include <boost/test/unit_test.hpp>
+
+#include <websocketpp/transport/asio/connect_race.hpp>
+
+#include <websocketpp/common/chrono.hpp>
+
+#include <vector>
+
+using websocketpp::transport::asio::connect_race;
+using websocketpp::lib::asio::ip::tcp;
+using websocketpp::lib::asio::ip::address;
+
+namespace chrono = websocketpp::lib::chrono;
+
+struct race_result {
+    race_result() : called(0) {}
+
+    int called;
+    websocketpp::lib::asio::error_code ec;
+    connect_race::socket_ptr socket;
+    chrono::steady_clock::time_point time;
+};
+
+void record(race_result * r, websocketpp::lib::asio::error_code const & ec,
+    connect_race::socket_ptr socket)
+{
+    r->called++;
+    r->ec = ec;
+    r->socket = socket;
+    r->time = chrono::steady_clock::now();
+}
+
+long elapsed(chrono::steady_clock::time_point start, race_result const & r) {
+    return static_cast<long>(chrono::duration_cast<chrono::milliseconds>(
+        r.time - start).count());
+}
+
+// An endpoint nothing listens on. Binding and closing a socket yields a port
+// that refuses connections.
+tcp::endpoint refused_endpoint(websocketpp::lib::asio::io_service & service) {
+    tcp::acceptor a(service, tcp::endpoint(address::from_string("127.0.0.1"),
+        0));
+    tcp::endpoint ep = a.local_endpoint();
+    a.close();
+    return ep;
+}
+
+// An endpoint whose connection attempts hang, like an unreachable replica.
+// The listener's accept queue is kept full so further SYNs are dropped.
+struct blackhole {
+    blackhole(websocketpp::lib::asio::io_service & service)
+      : acceptor(service)
+      , filler(service)
+    {
+        acceptor.open(tcp::v4());
+        acceptor.bind(tcp::endpoint(address::from_string("127.0.0.1"), 0));
+        acceptor.listen(0);
+        filler.connect(acceptor.local_endpoint());
+    }
+
+    tcp::acceptor acceptor;
+    tcp::socket filler;
+};
+
+BOOST_AUTO_TEST_CASE( interleave_address_families ) {
+    std::vector<tcp::endpoint> in;
+    in.push_back(tcp::endpoint(address::from_string("::1"), 1));
+    in.push_back(tcp::endpoint(address::from_string("::2"), 2));
+    in.push_back(tcp::endpoint(address::from_string("::3"), 3));
+    in.push_back(tcp::endpoint(address::from_string("127.0.0.1"), 4));
+    in.push_back(tcp::endpoint(address::from_string("127.0.0.2"), 5));
+
+    std::vector<tcp::endpoint> out = connect_race::interleave(in);
+
+    BOOST_REQUIRE_EQUAL( out.size(), 5 );
+    BOOST_CHECK_EQUAL( out[0].port(), 1 );
+    BOOST_CHECK_EQUAL( out[1].port(), 4 );
+    BOOST_CHECK_EQUAL( out[2].port(), 2 );
+    BOOST_CHECK_EQUAL( out[3].port(), 5 );
+    BOOST_CHECK_EQUAL( out[4].port(), 3 );
+}
+
+BOOST_AUTO_TEST_CASE( dead_address_costs_one_delay ) {
+    websocketpp::lib::asio::io_service service;
+    blackhole dead(service);
+    tcp::acceptor live(service, tcp::endpoint(
+        address::from_string("127.0.0.1"), 0));
+
+    std::vector<tcp::endpoint> endpoints;
+    endpoints.push_back(dead.acceptor.local_endpoint());
+    endpoints.push_back(live.local_endpoint());
+
+    race_result r;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    connect_race::ptr race = websocketpp::lib::make_shared<connect_race>(
+        websocketpp::lib::ref(service), connect_race::strand_ptr(), endpoints,
+        50);
+    race->start(websocketpp::lib::bind(&record, &r,
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2));
+    service.run();
+
+    BOOST_CHECK_EQUAL( r.called, 1 );
+    BOOST_CHECK( !r.ec );
+    BOOST_REQUIRE( r.socket );
+    BOOST_CHECK_EQUAL( r.socket->remote_endpoint(), live.local_endpoint() );
+    BOOST_CHECK( elapsed(start, r) >= 50 );
+    BOOST_CHECK( elapsed(start, r) < 1000 );
+}
+
+BOOST_AUTO_TEST_CASE( failure_starts_next_attempt ) {
+    websocketpp::lib::asio::io_service service;
+    tcp::acceptor live(service, tcp::endpoint(
+        address::from_string("127.0.0.1"), 0));
+
+    std::vector<tcp::endpoint> endpoints;
+    endpoints.push_back(refused_endpoint(service));
+    endpoints.push_back(live.local_endpoint());
+
+    race_result r;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    connect_race::ptr race = websocketpp::lib::make_shared<connect_race>(
+        websocketpp::lib::ref(service), connect_race::strand_ptr(), endpoints,
+        5000);
+    race->start(websocketpp::lib::bind(&record, &r,
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2));
+    service.run();
+
+    BOOST_CHECK_EQUAL( r.called, 1 );
+    BOOST_CHECK( !r.ec );
+    BOOST_REQUIRE( r.socket );
+    BOOST_CHECK_EQUAL( r.socket->remote_endpoint(), live.local_endpoint() );
+    BOOST_CHECK( elapsed(start, r) < 1000 );
+}
+
+BOOST_AUTO_TEST_CASE( all_attempts_fail ) {
+    websocketpp::lib::asio::io_service service;
+
+    std::vector<tcp::endpoint> endpoints;
+    endpoints.push_back(refused_endpoint(service));
+    endpoints.push_back(refused_endpoint(service));
+
+    race_result r;
+    connect_race::ptr race = websocketpp::lib::make_shared<connect_race>(
+        websocketpp::lib::ref(service), connect_race::strand_ptr(), endpoints,
+        50);
+    race->start(websocketpp::lib::bind(&record, &r,
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2));
+    service.run();
+
+    BOOST_CHECK_EQUAL( r.called, 1 );
+    BOOST_CHECK_EQUAL( r.ec, websocketpp::lib::asio::error::connection_refused );
+    BOOST_CHECK( !r.socket );
+}
+
+void cancel_race(connect_race::ptr race) {
+    race->cancel();
+}
+
+BOOST_AUTO_TEST_CASE( cancel_closes_attempts ) {
+    websocketpp::lib::asio::io_service service;
+    blackhole dead(service);
+
+    std::vector<tcp::endpoint> endpoints;
+    endpoints.push_back(dead.acceptor.local_endpoint());
+    endpoints.push_back(dead.acceptor.local_endpoint());
+
+    race_result r;
+    connect_race::ptr race = websocketpp::lib::make_shared<connect_race>(
+        websocketpp::lib::ref(service), connect_race::strand_ptr(), endpoints,
+        10);
+    race->start(websocketpp::lib::bind(&record, &r,
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2));
+
+    websocketpp::lib::asio::steady_timer timer(service,
+        websocketpp::lib::asio::milliseconds(50));
+    timer.async_wait(websocketpp::lib::bind(&cancel_race, race));
+    service.run();
+
+    BOOST_CHECK_EQUAL( r.called, 1 );
+    BOOST_CHECK_EQUAL( r.ec, websocketpp::lib::asio::error::operation_aborted );
+    BOOST_CHECK( !r.socket );
+}
@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE transport_asio_handler_arena
+#include <boost/test/unit_test.hpp>
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+
+#include <websocketpp/server.hpp>
+#include <websocketpp/client.hpp>
+
+#include <websocketpp/transport/asio/base.hpp>
+#include <websocketpp/concurrency/none.hpp>
+#include <websocketpp/message_buffer/alloc.hpp>
+#include <websocketpp/message_buffer/message.hpp>
+
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+
+// Count every allocation made through the global heap so that the tests can
+// check that warmed up operations no longer allocate.
+static size_t g_allocations = 0;
+
+#if __cplusplus >= 201103L
+void * operator new(std::size_t size) {
+#else
+void * operator new(std::size_t size) throw(std::bad_alloc) {
+#endif
+    ++g_allocations;
+    void * p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void * p) _WEBSOCKETPP_NOEXCEPT_TOKEN_ {
+    std::free(p);
+}
+
+using websocketpp::transport::asio::handler_arena;
+using websocketpp::transport::asio::make_custom_alloc_handler;
+using websocketpp::lib::asio::ip::tcp;
+
+typedef handler_arena<websocketpp::concurrency::none> arena_type;
+
+BOOST_AUTO_TEST_CASE( arena_recycles_blocks ) {
+    arena_type arena;
+
+    void * a = arena.allocate(100);
+    arena.deallocate(a, 100);
+    void * b = arena.allocate(120);
+    BOOST_CHECK( a == b );
+    BOOST_CHECK_EQUAL( arena.get_heap_allocations(), 1u );
+
+    // a block of a different size class comes from the heap once
+    void * c = arena.allocate(300);
+    BOOST_CHECK_EQUAL( arena.get_heap_allocations(), 2u );
+    arena.deallocate(c, 300);
+    arena.deallocate(b, 120);
+
+    // requests larger than every size class are passed through
+    void * d = arena.allocate(1 << 16);
+    arena.deallocate(d, 1 << 16);
+    void * e = arena.allocate(1 << 16);
+    arena.deallocate(e, 1 << 16);
+    BOOST_CHECK_EQUAL( arena.get_heap_allocations(), 4u );
+}
+
+struct timer_loop {
+    timer_loop(websocketpp::lib::asio::io_service & s, size_t n)
+      : timer(s), remaining(n), allocations(0) {}
+
+    void arm() {
+        timer.expires_from_now(websocketpp::lib::asio::milliseconds(0));
+        timer.async_wait(make_custom_alloc_handler(arena, websocketpp::lib::bind(
+            &timer_loop::on_timer, this, websocketpp::lib::placeholders::_1)));
+    }
+
+    void on_timer(websocketpp::lib::asio::error_code const &) {
+        if (--remaining == 0) {
+            return;
+        }
+        if (remaining == 100) {
+            allocations = g_allocations;
+        }
+        arm();
+    }
+
+    arena_type arena;
+    websocketpp::lib::asio::steady_timer timer;
+    size_t remaining;
+    size_t allocations;
+};
+
+BOOST_AUTO_TEST_CASE( timer_rearm_does_not_allocate ) {
+    websocketpp::lib::asio::io_service service;
+    timer_loop loop(service, 1000);
+
+    loop.arm();
+    service.run();
+
+    BOOST_CHECK_EQUAL( loop.remaining, 0u );
+    BOOST_CHECK( loop.arena.get_heap_allocations() > 0 );
+    BOOST_CHECK_EQUAL( g_allocations, loop.allocations );
+}
+
+struct socket_echo {
+    socket_echo(websocketpp::lib::asio::io_service & s, size_t n)
+      : client(s), server(s), remaining(n), allocations(0) {}
+
+    void write() {
+        websocketpp::lib::asio::async_write(client,
+            websocketpp::lib::asio::buffer(out, sizeof(out)),
+            make_custom_alloc_handler(arena, websocketpp::lib::bind(
+                &socket_echo::on_write, this,
+                websocketpp::lib::placeholders::_1)));
+        websocketpp::lib::asio::async_read(server,
+            websocketpp::lib::asio::buffer(in, sizeof(in)),
+            make_custom_alloc_handler(arena, websocketpp::lib::bind(
+                &socket_echo::on_read, this,
+                websocketpp::lib::placeholders::_1)));
+    }
+
+    void on_write(websocketpp::lib::asio::error_code const & ec) {
+        BOOST_CHECK( !ec );
+    }
+
+    void on_read(websocketpp::lib::asio::error_code const & ec) {
+        BOOST_REQUIRE( !ec );
+        if (--remaining == 0) {
+            return;
+        }
+        if (remaining == 100) {
+            allocations = g_allocations;
+        }
+        write();
+    }
+
+    arena_type arena;
+    tcp::socket client;
+    tcp::socket server;
+    char out[64];
+    char in[64];
+    size_t remaining;
+    size_t allocations;
+};
+
+BOOST_AUTO_TEST_CASE( socket_exchange_does_not_allocate ) {
+    websocketpp::lib::asio::io_service service;
+    tcp::acceptor acceptor(service, tcp::endpoint(
+        websocketpp::lib::asio::ip::address_v4::loopback(), 0));
+
+    socket_echo echo(service, 1000);
+    echo.client.connect(acceptor.local_endpoint());
+    acceptor.accept(echo.server);
+
+    echo.write();
+    service.run();
+
+    BOOST_CHECK_EQUAL( echo.remaining, 0u );
+    BOOST_CHECK( echo.arena.get_heap_allocations() > 0 );
+    BOOST_CHECK_EQUAL( g_allocations, echo.allocations );
+}
+
+// Global heap allocations made by the message managers of all connections
+static size_t g_message_allocations = 0;
+// Messages handed out without a payload size. The processor frames outgoing
+// messages into these, which allocates their payload once more.
+static size_t g_frame_messages = 0;
+
+// Connection message manager that allocates a new message for each request
+// and counts the heap allocations this takes.
+template <typename message>
+class counting_msg_manager
+  : public websocketpp::lib::enable_shared_from_this<
+        counting_msg_manager<message> >
+{
+public:
+    typedef counting_msg_manager<message> type;
+    typedef websocketpp::lib::shared_ptr<counting_msg_manager> ptr;
+    typedef websocketpp::lib::weak_ptr<counting_msg_manager> weak_ptr;
+
+    typedef typename message::ptr message_ptr;
+
+    message_ptr get_message() {
+        size_t before = g_allocations;
+        message_ptr msg = websocketpp::lib::make_shared<message>(
+            type::shared_from_this());
+        g_message_allocations += g_allocations - before;
+        ++g_frame_messages;
+        return msg;
+    }
+
+    message_ptr get_message(websocketpp::frame::opcode::value op, size_t size)
+    {
+        size_t before = g_allocations;
+        message_ptr msg = websocketpp::lib::make_shared<message>(
+            type::shared_from_this(), op, size);
+        g_message_allocations += g_allocations - before;
+        return msg;
+    }
+
+    bool recycle(message *) {
+        return false;
+    }
+};
+
+struct counting_config : public websocketpp::config::asio {
+    typedef websocketpp::message_buffer::message<counting_msg_manager>
+        message_type;
+    typedef counting_msg_manager<message_type> con_msg_manager_type;
+    typedef websocketpp::message_buffer::alloc::endpoint_msg_manager<
+        con_msg_manager_type> endpoint_msg_manager_type;
+};
+
+struct counting_client_config : public websocketpp::config::asio_client {
+    typedef counting_config::message_type message_type;
+    typedef counting_config::con_msg_manager_type con_msg_manager_type;
+    typedef counting_config::endpoint_msg_manager_type
+        endpoint_msg_manager_type;
+};
+
+typedef websocketpp::server<counting_config> server;
+typedef websocketpp::client<counting_client_config> client;
+
+// Echoes messages between a client and a server and then rearms a client
+// timer, recording the heap allocations of both connections' arenas and the
+// global and message manager heap allocations once they have warmed up, and
+// the global heap allocations of the timer rearms.
+struct endpoint_echo {
+    endpoint_echo(size_t n)
+      : messages(n), received(0), timers(n)
+      , server_arena(0), client_arena(0), echo_heap(0), echo_messages(0)
+      , timer_arena(0), timer_heap(0)
+    {
+        s.clear_access_channels(websocketpp::log::alevel::all);
+        s.clear_error_channels(websocketpp::log::elevel::all);
+        c.clear_access_channels(websocketpp::log::alevel::all);
+        c.clear_error_channels(websocketpp::log::elevel::all);
+
+        s.init_asio(&service);
+        c.init_asio(&service);
+
+        s.set_message_handler(websocketpp::lib::bind(
+            &endpoint_echo::on_server_message, this,
+            websocketpp::lib::placeholders::_1,
+            websocketpp::lib::placeholders::_2));
+        s.set_open_handler(websocketpp::lib::bind(
+            &endpoint_echo::on_server_open, this,
+            websocketpp::lib::placeholders::_1));
+        c.set_open_handler(websocketpp::lib::bind(
+            &endpoint_echo::on_client_open, this,
+            websocketpp::lib::placeholders::_1));
+        c.set_message_handler(websocketpp::lib::bind(
+            &endpoint_echo::on_client_message, this,
+            websocketpp::lib::placeholders::_1,
+            websocketpp::lib::placeholders::_2));
+    }
+
+    void run() {
+        s.listen(tcp::endpoint(
+            websocketpp::lib::asio::ip::address_v4::loopback(), 0));
+        s.start_accept();
+
+        websocketpp::lib::asio::error_code aec;
+        std::stringstream uri;
+        uri << "ws://127.0.0.1:" << s.get_local_endpoint(aec).port();
+
+        websocketpp::lib::error_code ec;
+        client::connection_ptr con = c.get_connection(uri.str(), ec);
+        BOOST_REQUIRE( !ec );
+        c.connect(con);
+
+        service.run();
+    }
+
+    size_t server_allocations() {
+        return s.get_con_from_hdl(server_hdl)->get_handler_arena()
+            ->get_heap_allocations();
+    }
+
+    size_t client_allocations() {
+        return c.get_con_from_hdl(client_hdl)->get_handler_arena()
+            ->get_heap_allocations();
+    }
+
+    void on_server_open(websocketpp::connection_hdl hdl) {
+        server_hdl = hdl;
+    }
+
+    void on_server_message(websocketpp::connection_hdl hdl,
+        server::message_ptr msg)
+    {
+        s.send(hdl, msg->get_payload(), msg->get_opcode());
+    }
+
+    void on_client_open(websocketpp::connection_hdl hdl) {
+        client_hdl = hdl;
+        c.send(hdl, std::string(64, '*'), websocketpp::frame::opcode::binary);
+    }
+
+    void on_client_message(websocketpp::connection_hdl hdl,
+        client::message_ptr msg)
+    {
+        if (++received == 10) {
+            server_arena = server_allocations();
+            client_arena = client_allocations();
+            echo_heap = g_allocations;
+            echo_messages = g_message_allocations + g_frame_messages;
+        }
+        if (received < messages) {
+            c.send(hdl, msg->get_payload(), msg->get_opcode());
+            return;
+        }
+
+        BOOST_CHECK( server_arena > 0 );
+        BOOST_CHECK( client_arena > 0 );
+        BOOST_CHECK_EQUAL( server_allocations(), server_arena );
+        BOOST_CHECK_EQUAL( client_allocations(), client_arena );
+
+        // Apart from the messages and the frames prepared into them, nothing
+        // is allocated per message. The send queues still allocate a block
+        // now and then.
+        size_t round_trips = messages - 10;
+        size_t message_heap = g_message_allocations + g_frame_messages -
+            echo_messages;
+        BOOST_CHECK( message_heap > 0 );
+        BOOST_CHECK_LT( g_allocations - echo_heap - message_heap,
+            round_trips );
+
+        arm_timer();
+    }
+
+    void arm_timer() {
+        c.get_con_from_hdl(client_hdl)->set_timer(0, websocketpp::lib::bind(
+            &endpoint_echo::on_timer, this,
+            websocketpp::lib::placeholders::_1));
+    }
+
+    void on_timer(websocketpp::lib::error_code const & ec) {
+        BOOST_CHECK( !ec );
+        if (--timers == 10) {
+            timer_arena = client_allocations();
+            timer_heap = g_allocations;
+        }
+        if (timers > 0) {
+            arm_timer();
+            return;
+        }
+
+        BOOST_CHECK_EQUAL( client_allocations(), timer_arena );
+        BOOST_CHECK_EQUAL( g_allocations, timer_heap );
+
+        s.stop_listening();
+        c.close(client_hdl, websocketpp::close::status::normal, "");
+    }
+
+    websocketpp::lib::asio::io_service service;
+    server s;
+    client c;
+
+    websocketpp::connection_hdl server_hdl;
+    websocketpp::connection_hdl client_hdl;
+
+    size_t messages;
+    size_t received;
+    size_t timers;
+
+    size_t server_arena;
+    size_t client_arena;
+    size_t echo_heap;
+    size_t echo_messages;
+    size_t timer_arena;
+    size_t timer_heap;
+};
+
+BOOST_AUTO_TEST_CASE( connection_operations_use_arena ) {
+    endpoint_echo echo(200);
+    echo.run();
+
+    BOOST_CHECK_EQUAL( echo.received, 200u );
+    BOOST_CHECK_EQUAL( echo.timers, 0u );
+}
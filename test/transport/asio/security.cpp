@@ -67,3 +67,30 @@ BOOST_AUTO_TEST_CASE( translated_ec_tls ) {
     	BOOST_CHECK_EQUAL( tscon.test(), websocketpp::transport::error::make_error_code(websocketpp::transport::error::pass_through) );
     }
 }
+
+BOOST_AUTO_TEST_CASE( session_cache_lives_with_context ) {
+    using websocketpp::transport::asio::tls_socket::session_cache;
+
+    SSL_CTX * ctx = SSL_CTX_new(SSLv23_method());
+    BOOST_REQUIRE( ctx );
+
+    session_cache::ptr cache = websocketpp::lib::make_shared<session_cache>();
+    websocketpp::lib::weak_ptr<session_cache> weak = cache;
+
+    cache->attach(ctx,true);
+    cache->attach(ctx,true);
+    BOOST_CHECK_EQUAL( cache.use_count(), 2 );
+
+    // The context keeps the cache its callbacks use alive
+    cache.reset();
+    BOOST_CHECK( !weak.expired() );
+
+    // and a cache attached in its place takes over that reference
+    session_cache::ptr other = websocketpp::lib::make_shared<session_cache>();
+    other->attach(ctx,false);
+    BOOST_CHECK( weak.expired() );
+    BOOST_CHECK_EQUAL( other.use_count(), 2 );
+
+    SSL_CTX_free(ctx);
+    BOOST_CHECK_EQUAL( other.use_count(), 1 );
+}
@@ -30,6 +30,7 @@
 
 #include <exception>
 #include <iostream>
+#include <vector>
 
 #include <websocketpp/common/thread.hpp>
 
@@ -169,6 +170,12 @@ struct mock_endpoint : public websocketpp::transport::asio::endpoint<config> {
         con->start();
     }
 
+    connection_ptr make_connection() {
+        connection_ptr con(new mock_con(false,alog,elog));
+        BOOST_CHECK_EQUAL( base::init(con), websocketpp::lib::error_code() );
+        return con;
+    }
+
     connection_ptr m_con;
     config::alog_type alog;
     config::elog_type elog;
@@ -185,3 +192,220 @@ BOOST_AUTO_TEST_CASE( tls_handshake_timeout ) {
     endpoint.connect("wss://localhost:9005");
     endpoint.run();
 }
+
+BOOST_AUTO_TEST_CASE( tls_handshake_timeout_timer_wheel ) {
+    websocketpp::lib::thread dummy_server(websocketpp::lib::bind(&run_dummy_server,9006));
+    websocketpp::lib::thread timer(websocketpp::lib::bind(&run_test_timer,5000));
+    dummy_server.detach();
+    timer.detach();
+
+    mock_endpoint endpoint;
+    endpoint.set_timer_wheel_resolution(100);
+    endpoint.set_tls_init_handler(&on_tls_init);
+    endpoint.connect("wss://localhost:9006");
+
+    BOOST_CHECK( endpoint.get_timer_wheel() );
+    endpoint.run();
+    BOOST_CHECK_EQUAL( endpoint.get_timer_wheel()->size(), 0 );
+}
+
+typedef websocketpp::transport::asio::timer_wheel<
+    websocketpp::concurrency::none> timer_wheel;
+typedef websocketpp::lib::chrono::steady_clock steady_clock;
+
+struct wheel_result {
+    wheel_result(std::vector<long> & o, long d)
+      : order(o), duration(d), start(steady_clock::now()) {}
+
+    void operator()(websocketpp::lib::error_code const & ec) {
+        BOOST_CHECK( !ec );
+        long elapsed = static_cast<long>(websocketpp::lib::chrono::duration_cast<
+            websocketpp::lib::chrono::milliseconds>(steady_clock::now() - start)
+            .count());
+        BOOST_CHECK_GE( elapsed, duration );
+        order.push_back(duration);
+    }
+
+    std::vector<long> & order;
+    long duration;
+    steady_clock::time_point start;
+};
+
+void record_ec(websocketpp::lib::error_code * out,
+    websocketpp::lib::error_code const & ec)
+{
+    *out = ec;
+}
+
+BOOST_AUTO_TEST_CASE( timer_wheel_fires_in_order ) {
+    boost::asio::io_service service;
+    timer_wheel::ptr wheel = websocketpp::lib::make_shared<timer_wheel>(
+        &service, 1);
+    std::vector<long> order;
+
+    // 300 ticks lands on the second level and must cascade down
+    timer_wheel::timer_ptr t1 = wheel->schedule(300, wheel_result(order, 300));
+    timer_wheel::timer_ptr t2 = wheel->schedule(10, wheel_result(order, 10));
+    timer_wheel::timer_ptr t3 = wheel->schedule(50, wheel_result(order, 50));
+
+    BOOST_CHECK_EQUAL( wheel->size(), 3 );
+    BOOST_CHECK( !t2->expired() );
+
+    service.run();
+
+    BOOST_CHECK_EQUAL( wheel->size(), 0 );
+    BOOST_REQUIRE_EQUAL( order.size(), 3 );
+    BOOST_CHECK_EQUAL( order[0], 10 );
+    BOOST_CHECK_EQUAL( order[1], 50 );
+    BOOST_CHECK_EQUAL( order[2], 300 );
+    BOOST_CHECK( t1->expired() );
+}
+
+BOOST_AUTO_TEST_CASE( timer_wheel_cancel ) {
+    boost::asio::io_service service;
+    timer_wheel::ptr wheel = websocketpp::lib::make_shared<timer_wheel>(
+        &service, 10);
+    websocketpp::lib::error_code ec;
+
+    timer_wheel::timer_ptr t = wheel->schedule(60000,
+        websocketpp::lib::bind(&record_ec, &ec,
+        websocketpp::lib::placeholders::_1));
+    t->cancel();
+
+    // The handler is never called from within cancel
+    BOOST_CHECK( !ec );
+    BOOST_CHECK_EQUAL( wheel->size(), 0 );
+
+    steady_clock::time_point start = steady_clock::now();
+    service.run();
+
+    BOOST_CHECK_EQUAL( ec, websocketpp::transport::error::make_error_code(
+        websocketpp::transport::error::operation_aborted) );
+    BOOST_CHECK( steady_clock::now() - start <
+        websocketpp::lib::chrono::seconds(1) );
+
+    // Cancelling again has no effect
+    t->cancel();
+    BOOST_CHECK_EQUAL( service.poll(), 0 );
+}
+
+int plain_timer_calls = 0;
+
+void count_plain_timer(websocketpp::lib::error_code const & ec) {
+    BOOST_CHECK( !ec );
+    ++plain_timer_calls;
+}
+
+BOOST_AUTO_TEST_CASE( connection_timer_takes_plain_functions ) {
+    mock_endpoint endpoint;
+    endpoint.set_tls_init_handler(&on_tls_init);
+
+    connection_ptr con = endpoint.make_connection();
+    con->set_timer(0, count_plain_timer);
+    con->set_timer(0, &count_plain_timer);
+    endpoint.run();
+
+    BOOST_CHECK_EQUAL( plain_timer_calls, 2 );
+}
+
+void hold_connection(connection_ptr, websocketpp::lib::error_code const &) {}
+
+BOOST_AUTO_TEST_CASE( timer_wheel_releases_connections ) {
+    websocketpp::lib::weak_ptr<mock_con> weak;
+    {
+        mock_endpoint endpoint;
+        endpoint.set_timer_wheel_resolution(100);
+        endpoint.set_tls_init_handler(&on_tls_init);
+
+        connection_ptr con = endpoint.make_connection();
+        weak = con;
+
+        // A pending timeout whose handler refers to its own connection
+        con->set_timer(60000, websocketpp::lib::bind(&hold_connection, con,
+            websocketpp::lib::placeholders::_1));
+        BOOST_CHECK_EQUAL( endpoint.get_timer_wheel()->size(), 1 );
+    }
+
+    BOOST_CHECK( weak.expired() );
+}
+
+BOOST_AUTO_TEST_CASE( timer_wheel_cancels_timers_of_destroyed_connection ) {
+    mock_endpoint endpoint;
+    endpoint.set_timer_wheel_resolution(100);
+    endpoint.set_tls_init_handler(&on_tls_init);
+
+    websocketpp::lib::error_code ec;
+    {
+        connection_ptr con = endpoint.make_connection();
+        con->set_timer(60000, websocketpp::lib::bind(&record_ec, &ec,
+            websocketpp::lib::placeholders::_1));
+        BOOST_CHECK_EQUAL( endpoint.get_timer_wheel()->size(), 1 );
+    }
+
+    // The timeout is gone and its handler is not called for a connection
+    // that no longer exists
+    BOOST_CHECK_EQUAL( endpoint.get_timer_wheel()->size(), 0 );
+    endpoint.run();
+    BOOST_CHECK( !ec );
+}
+
+BOOST_AUTO_TEST_CASE( timer_wheel_rearm_reuses_entries ) {
+    mock_endpoint endpoint;
+    endpoint.set_timer_wheel_resolution(100);
+    endpoint.set_tls_init_handler(&on_tls_init);
+
+    websocketpp::lib::error_code ec;
+    connection_ptr con = endpoint.make_connection();
+
+    // Cancel and set again, as the ping timeout is rearmed
+    con_type::timer_ptr t;
+    size_t heap = 0;
+    for (int i = 0; i < 100; ++i) {
+        if (t) {
+            t->cancel();
+            endpoint.poll();
+        }
+        t = con->set_timer(60000, websocketpp::lib::bind(&record_ec, &ec,
+            websocketpp::lib::placeholders::_1));
+        if (i == 1) {
+            heap = con->get_handler_arena()->get_heap_allocations();
+        }
+    }
+
+    BOOST_CHECK_EQUAL( con->get_handler_arena()->get_heap_allocations(),
+        heap );
+    BOOST_CHECK_EQUAL( endpoint.get_timer_wheel()->size(), 1 );
+
+    // A handle of a timeout that was cancelled does not cancel the timeout
+    // set after it on the same entry
+    con_type::timer_ptr stale = t;
+    stale->cancel();
+    t = con->set_timer(60000, websocketpp::lib::bind(&record_ec, &ec,
+        websocketpp::lib::placeholders::_1));
+    stale->cancel();
+    BOOST_CHECK_EQUAL( endpoint.get_timer_wheel()->size(), 1 );
+    BOOST_CHECK( !t->expired() );
+}
+
+BOOST_AUTO_TEST_CASE( timer_wheel_release_drops_pending ) {
+    boost::asio::io_service service;
+    timer_wheel::ptr wheel = websocketpp::lib::make_shared<timer_wheel>(
+        &service, 10);
+    websocketpp::lib::error_code ec;
+
+    timer_wheel::timer_ptr t = wheel->schedule(60000,
+        websocketpp::lib::bind(&record_ec, &ec,
+        websocketpp::lib::placeholders::_1));
+
+    // The pending tick does not keep the wheel alive
+    websocketpp::lib::weak_ptr<timer_wheel> weak = wheel;
+    wheel.reset();
+    BOOST_CHECK( weak.expired() );
+
+    steady_clock::time_point start = steady_clock::now();
+    service.run();
+
+    BOOST_CHECK( !ec );
+    BOOST_CHECK( steady_clock::now() - start <
+        websocketpp::lib::chrono::seconds(1) );
+}
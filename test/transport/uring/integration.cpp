@@ -0,0 +1,597 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE transport_uring_integration
+#include <boost/test/unit_test.hpp>
+
+#include <websocketpp/common/thread.hpp>
+
+#include <websocketpp/config/uring.hpp>
+#include <websocketpp/server.hpp>
+#include <websocketpp/client.hpp>
+
+#include <boost/asio.hpp>
+
+// The transport integration tests from test/transport/integration.cpp run
+// against the uring transport, plus tests for the parts of the transport
+// that have no asio counterpart: provided buffer handling and rings shared
+// between endpoints.
+
+struct config : public websocketpp::config::uring_client {
+    typedef config type;
+    typedef websocketpp::config::uring_client base;
+
+    typedef base::concurrency_type concurrency_type;
+
+    typedef base::request_type request_type;
+    typedef base::response_type response_type;
+
+    typedef base::message_type message_type;
+    typedef base::con_msg_manager_type con_msg_manager_type;
+    typedef base::endpoint_msg_manager_type endpoint_msg_manager_type;
+
+    typedef base::alog_type alog_type;
+    typedef base::elog_type elog_type;
+
+    typedef base::rng_type rng_type;
+
+    struct transport_config : public base::transport_config {
+        typedef type::concurrency_type concurrency_type;
+        typedef type::alog_type alog_type;
+        typedef type::elog_type elog_type;
+        typedef type::request_type request_type;
+        typedef type::response_type response_type;
+    };
+
+    typedef websocketpp::transport::uring::endpoint<transport_config>
+        transport_type;
+
+    /// Length of time before an opening handshake is aborted
+    static const long timeout_open_handshake = 500;
+    /// Length of time before a closing handshake is aborted
+    static const long timeout_close_handshake = 500;
+    /// Length of time to wait for a pong after a ping
+    static const long timeout_pong = 500;
+};
+
+typedef websocketpp::server<config> server;
+typedef websocketpp::client<config> client;
+
+using websocketpp::lib::placeholders::_1;
+using websocketpp::lib::placeholders::_2;
+using websocketpp::lib::bind;
+
+int const port = 9105;
+std::string const uri = "http://localhost:9105";
+
+template <typename T>
+void quiet(T & e) {
+    e.clear_access_channels(websocketpp::log::alevel::all);
+    e.clear_error_channels(websocketpp::log::elevel::all);
+}
+
+// Listen on the calling thread so that clients started afterwards can
+// connect, then run the server on a new thread.
+websocketpp::lib::thread * start_server(server & s) {
+    quiet(s);
+    s.init_uring();
+    s.set_reuse_addr(true);
+    s.listen(port);
+    s.start_accept();
+    return new websocketpp::lib::thread(bind(&server::run,&s));
+}
+
+void run_client(client & c, std::string u) {
+    quiet(c);
+    websocketpp::lib::error_code ec;
+    c.init_uring(ec);
+    BOOST_CHECK(!ec);
+
+    client::connection_ptr con = c.get_connection(u,ec);
+    BOOST_CHECK( !ec );
+    c.connect(con);
+
+    c.run();
+}
+
+template <typename T>
+void close_after_timeout(T & e, websocketpp::connection_hdl hdl, long timeout) {
+    sleep(timeout);
+
+    websocketpp::lib::error_code ec;
+    e.close(hdl,websocketpp::close::status::normal,"",ec);
+    BOOST_CHECK(!ec);
+}
+
+void run_time_limited_client(client & c, std::string u, long timeout) {
+    quiet(c);
+    c.init_uring();
+
+    websocketpp::lib::error_code ec;
+    client::connection_ptr con = c.get_connection(u,ec);
+    BOOST_CHECK( !ec );
+    c.connect(con);
+
+    websocketpp::lib::thread tthread(websocketpp::lib::bind(
+        &close_after_timeout<client>,
+        websocketpp::lib::ref(c),
+        con->get_handle(),
+        timeout
+    ));
+    tthread.detach();
+
+    c.run();
+}
+
+void run_dummy_server(int p) {
+    using boost::asio::ip::tcp;
+
+    try {
+        boost::asio::io_service io_service;
+        tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v6(), p));
+        tcp::socket socket(io_service);
+
+        acceptor.accept(socket);
+        for (;;) {
+            char data[512];
+            boost::system::error_code ec;
+            socket.read_some(boost::asio::buffer(data), ec);
+            if (ec) {
+                break;
+            }
+        }
+    } catch (std::exception & e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
+void run_dummy_client(std::string p) {
+    using boost::asio::ip::tcp;
+
+    try {
+        boost::asio::io_service io_service;
+        tcp::resolver resolver(io_service);
+        tcp::resolver::query query("localhost", p);
+        tcp::resolver::iterator iterator = resolver.resolve(query);
+        tcp::socket socket(io_service);
+
+        boost::asio::connect(socket, iterator);
+        for (;;) {
+            char data[512];
+            boost::system::error_code ec;
+            socket.read_some(boost::asio::buffer(data), ec);
+            if (ec) {
+                break;
+            }
+        }
+    } catch (std::exception & e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
+bool on_ping(websocketpp::connection_hdl, std::string) {
+    return false;
+}
+
+void cancel_on_open(server * s, websocketpp::connection_hdl) {
+    s->stop_listening();
+}
+
+void stop_on_close(server * s, websocketpp::connection_hdl) {
+    s->stop();
+}
+
+template <typename T>
+void ping_on_open(T * c, std::string payload, websocketpp::connection_hdl hdl) {
+    typename T::connection_ptr con = c->get_con_from_hdl(hdl);
+    websocketpp::lib::error_code ec;
+    con->ping(payload,ec);
+    BOOST_CHECK_EQUAL(ec, websocketpp::lib::error_code());
+}
+
+void fail_on_pong(websocketpp::connection_hdl, std::string) {
+    BOOST_FAIL( "expected no pong handler" );
+}
+
+void fail_on_pong_timeout(websocketpp::connection_hdl, std::string) {
+    BOOST_FAIL( "expected no pong timeout" );
+}
+
+void req_pong(std::string expected_payload, websocketpp::connection_hdl,
+    std::string payload)
+{
+    BOOST_CHECK_EQUAL( expected_payload, payload );
+}
+
+void fail_on_open(websocketpp::connection_hdl) {
+    BOOST_FAIL( "expected no open handler" );
+}
+
+void delay(websocketpp::connection_hdl, long duration) {
+    sleep(duration);
+}
+
+template <typename T>
+void check_ec(T * c, websocketpp::lib::error_code ec,
+    websocketpp::connection_hdl hdl)
+{
+    typename T::connection_ptr con = c->get_con_from_hdl(hdl);
+    BOOST_CHECK_EQUAL( con->get_ec(), ec );
+}
+
+template <typename T>
+void check_ec_and_stop(T * e, websocketpp::lib::error_code ec,
+    websocketpp::connection_hdl hdl)
+{
+    typename T::connection_ptr con = e->get_con_from_hdl(hdl);
+    BOOST_CHECK_EQUAL( con->get_ec(), ec );
+    e->stop();
+}
+
+template <typename T>
+void req_pong_timeout(T * c, std::string expected_payload,
+    websocketpp::connection_hdl hdl, std::string payload)
+{
+    typename T::connection_ptr con = c->get_con_from_hdl(hdl);
+    BOOST_CHECK_EQUAL( payload, expected_payload );
+    con->close(websocketpp::close::status::normal,"");
+}
+
+template <typename T>
+void close(T * e, websocketpp::connection_hdl hdl) {
+    e->get_con_from_hdl(hdl)->close(websocketpp::close::status::normal,"");
+}
+
+void echo(server * s, websocketpp::connection_hdl hdl,
+    server::message_ptr msg)
+{
+    s->send(hdl, msg->get_payload(), msg->get_opcode());
+}
+
+void send_on_open(client * c, std::string const * payload,
+    websocketpp::connection_hdl hdl)
+{
+    c->send(hdl, *payload, websocketpp::frame::opcode::binary);
+}
+
+void close_on_echo(client * c, std::string const * payload, bool * received,
+    websocketpp::connection_hdl hdl, client::message_ptr msg)
+{
+    BOOST_CHECK( msg->get_payload() == *payload );
+    *received = true;
+    c->close(hdl,websocketpp::close::status::normal,"");
+}
+
+// Wait for the specified time period then fail the test
+void run_test_timer(long value) {
+    sleep(value);
+    BOOST_FAIL( "Test timed out" );
+}
+
+BOOST_AUTO_TEST_CASE( pong_no_timeout ) {
+    server s;
+    client c;
+
+    s.set_close_handler(bind(&stop_on_close,&s,::_1));
+
+    // send a ping when the connection is open
+    c.set_open_handler(bind(&ping_on_open<client>,&c,"foo",::_1));
+    // require that a pong with matching payload is received
+    c.set_pong_handler(bind(&req_pong,"foo",::_1,::_2));
+    // require that a pong timeout is NOT received
+    c.set_pong_timeout_handler(bind(&fail_on_pong_timeout,::_1,::_2));
+
+    websocketpp::lib::thread * sthread = start_server(s);
+
+    // Run a client that closes the connection after 1 seconds
+    run_time_limited_client(c, uri, 1);
+
+    sthread->join();
+    delete sthread;
+}
+
+BOOST_AUTO_TEST_CASE( pong_timeout ) {
+    server s;
+    client c;
+
+    s.set_ping_handler(bind(&on_ping,::_1,::_2));
+    s.set_close_handler(bind(&stop_on_close,&s,::_1));
+
+    c.set_fail_handler(bind(&check_ec<client>,&c,
+        websocketpp::lib::error_code(),::_1));
+
+    c.set_pong_handler(bind(&fail_on_pong,::_1,::_2));
+    c.set_open_handler(bind(&ping_on_open<client>,&c,"foo",::_1));
+    c.set_pong_timeout_handler(bind(&req_pong_timeout<client>,&c,"foo",::_1,::_2));
+    c.set_close_handler(bind(&check_ec<client>,&c,
+        websocketpp::lib::error_code(),::_1));
+
+    websocketpp::lib::thread * sthread = start_server(s);
+
+    run_client(c, uri);
+
+    sthread->join();
+    delete sthread;
+}
+
+BOOST_AUTO_TEST_CASE( client_open_handshake_timeout ) {
+    client c;
+
+    // set open handler to fail test
+    c.set_open_handler(bind(&fail_on_open,::_1));
+    // set fail hander to test for the right fail error code
+    c.set_fail_handler(bind(&check_ec<client>,&c,
+        websocketpp::error::open_handshake_timeout,::_1));
+
+    websocketpp::lib::thread sthread(websocketpp::lib::bind(&run_dummy_server,port));
+    sleep(1);
+
+    run_client(c, uri);
+
+    sthread.join();
+}
+
+BOOST_AUTO_TEST_CASE( server_open_handshake_timeout ) {
+    server s;
+
+    // set open handler to fail test
+    s.set_open_handler(bind(&fail_on_open,::_1));
+    // set fail hander to test for the right fail error code
+    s.set_fail_handler(bind(&check_ec_and_stop<server>,&s,
+        websocketpp::error::open_handshake_timeout,::_1));
+
+    websocketpp::lib::thread * sthread = start_server(s);
+
+    run_dummy_client("9105");
+
+    sthread->join();
+    delete sthread;
+}
+
+BOOST_AUTO_TEST_CASE( client_self_initiated_close_handshake_timeout ) {
+    server s;
+    client c;
+
+    // on open server sleeps for longer than the timeout
+    // on open client sends close handshake
+    // client handshake timer should be triggered
+    s.set_open_handler(bind(&delay,::_1,1));
+    s.set_close_handler(bind(&stop_on_close,&s,::_1));
+
+    c.set_open_handler(bind(&close<client>,&c,::_1));
+    c.set_close_handler(bind(&check_ec<client>,&c,
+        websocketpp::error::close_handshake_timeout,::_1));
+
+    websocketpp::lib::thread * sthread = start_server(s);
+
+    run_client(c, uri);
+
+    sthread->join();
+    delete sthread;
+}
+
+BOOST_AUTO_TEST_CASE( server_self_initiated_close_handshake_timeout ) {
+    server s;
+    client c;
+
+    // on open server sends close
+    // on open client sleeps for longer than the timeout
+    // server handshake timer should be triggered
+
+    s.set_open_handler(bind(&close<server>,&s,::_1));
+    s.set_close_handler(bind(&check_ec_and_stop<server>,&s,
+        websocketpp::error::close_handshake_timeout,::_1));
+
+    c.set_open_handler(bind(&delay,::_1,1));
+
+    websocketpp::lib::thread * sthread = start_server(s);
+
+    run_client(c, uri);
+
+    sthread->join();
+    delete sthread;
+}
+
+BOOST_AUTO_TEST_CASE( client_runs_out_of_work ) {
+    client c;
+
+    websocketpp::lib::error_code ec;
+    c.init_uring(ec);
+    BOOST_CHECK(!ec);
+
+    c.run();
+
+    // This test checks that a ring with no work ends immediately.
+    BOOST_CHECK(true);
+}
+
+void run_client_and_mark(client * c, bool * flag, websocketpp::lib::mutex * mutex) {
+    c->run();
+    websocketpp::lib::lock_guard<websocketpp::lib::mutex> lock(*mutex);
+    *flag = true;
+}
+
+BOOST_AUTO_TEST_CASE( client_is_perpetual ) {
+    client c;
+    bool flag = false;
+    websocketpp::lib::mutex mutex;
+
+    websocketpp::lib::error_code ec;
+    c.init_uring(ec);
+    BOOST_CHECK(!ec);
+
+    c.start_perpetual();
+
+    websocketpp::lib::thread cthread(websocketpp::lib::bind(&run_client_and_mark,&c,&flag,&mutex));
+
+    sleep(1);
+
+    {
+        // Checks that the thread hasn't exited yet
+        websocketpp::lib::lock_guard<websocketpp::lib::mutex> lock(mutex);
+        BOOST_CHECK( !flag );
+    }
+
+    c.stop_perpetual();
+
+    sleep(1);
+
+    {
+        // Checks that the thread has exited
+        websocketpp::lib::lock_guard<websocketpp::lib::mutex> lock(mutex);
+        BOOST_CHECK( flag );
+    }
+
+    cthread.join();
+}
+
+BOOST_AUTO_TEST_CASE( client_failed_connection ) {
+    client c;
+
+    c.set_fail_handler(bind(&check_ec<client>,&c,
+        websocketpp::transport::uring::error::make_error_code(
+            websocketpp::transport::uring::error::pass_through),::_1));
+
+    run_client(c, uri);
+}
+
+BOOST_AUTO_TEST_CASE( stop_listening ) {
+    server s;
+    client c;
+
+    // the first connection stops the server from listening
+    s.set_open_handler(bind(&cancel_on_open,&s,::_1));
+
+    // client immediately closes after opening a connection
+    c.set_open_handler(bind(&close<client>,&c,::_1));
+
+    websocketpp::lib::thread * sthread = start_server(s);
+
+    run_client(c, uri);
+
+    sthread->join();
+    delete sthread;
+}
+
+BOOST_AUTO_TEST_CASE( echo_large_message ) {
+    server s;
+    client c;
+    bool received = false;
+
+    // Larger than a provided buffer and the library's read buffer, so the
+    // message arrives in many recvs and leaves bytes held between reads.
+    std::string payload(1000000, '*');
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>(i % 251);
+    }
+
+    s.set_message_handler(bind(&echo,&s,::_1,::_2));
+    s.set_close_handler(bind(&stop_on_close,&s,::_1));
+
+    c.set_read_buffers(4, 1000);
+    c.set_open_handler(bind(&send_on_open,&c,&payload,::_1));
+    c.set_message_handler(bind(&close_on_echo,&c,&payload,&received,::_1,::_2));
+
+    websocketpp::lib::thread * sthread = start_server(s);
+
+    run_client(c, uri);
+
+    sthread->join();
+    delete sthread;
+
+    BOOST_CHECK( received );
+}
+
+BOOST_AUTO_TEST_CASE( echo_empty_message ) {
+    server s;
+    client c;
+    bool received = false;
+
+    // The frame's payload buffer is empty and must not stall the write
+    std::string payload;
+
+    s.set_message_handler(bind(&echo,&s,::_1,::_2));
+    s.set_close_handler(bind(&stop_on_close,&s,::_1));
+
+    c.set_open_handler(bind(&send_on_open,&c,&payload,::_1));
+    c.set_message_handler(bind(&close_on_echo,&c,&payload,&received,::_1,::_2));
+
+    websocketpp::lib::thread * sthread = start_server(s);
+
+    run_client(c, uri);
+
+    sthread->join();
+    delete sthread;
+
+    BOOST_CHECK( received );
+}
+
+BOOST_AUTO_TEST_CASE( shared_ring ) {
+    typedef websocketpp::transport::uring::ring<config::concurrency_type> ring;
+
+    ring r;
+    BOOST_CHECK( !r.init(64, 1, 64) );
+
+    server s;
+    client c;
+    bool received = false;
+    std::string payload(256, 'x');
+
+    quiet(s);
+    quiet(c);
+
+    // Both endpoints on one ring, sharing a single provided buffer. Readers
+    // that find it in use wait for it to be released.
+    s.init_uring(&r);
+    c.init_uring(&r);
+    BOOST_CHECK( s.get_ring() == &r );
+
+    s.set_message_handler(bind(&echo,&s,::_1,::_2));
+    s.set_close_handler(bind(&stop_on_close,&s,::_1));
+    c.set_open_handler(bind(&send_on_open,&c,&payload,::_1));
+    c.set_message_handler(bind(&close_on_echo,&c,&payload,&received,::_1,::_2));
+
+    s.set_reuse_addr(true);
+    s.listen(0);
+    s.start_accept();
+
+    websocketpp::lib::error_code ec;
+    std::stringstream u;
+    u << "ws://localhost:" << s.get_local_port(ec);
+    BOOST_CHECK( !ec );
+
+    client::connection_ptr con = c.get_connection(u.str(), ec);
+    BOOST_CHECK( !ec );
+    c.connect(con);
+
+    websocketpp::lib::thread tthread(websocketpp::lib::bind(&run_test_timer,5));
+    tthread.detach();
+
+    r.run();
+
+    BOOST_CHECK( received );
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2014, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE inline_function
+#include <boost/test/unit_test.hpp>
+
+#include <websocketpp/common/inline_function.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/system_error.hpp>
+
+#include <string>
+
+using websocketpp::inline_function;
+
+struct counter {
+    counter() : calls(0), last(0) {}
+
+    void hit() {
+        ++calls;
+    }
+
+    void add(int a, int b) {
+        ++calls;
+        last = a + b;
+    }
+
+    int calls;
+    int last;
+};
+
+int twice(int x) {
+    return 2 * x;
+}
+
+BOOST_AUTO_TEST_CASE( empty_by_default ) {
+    inline_function<void()> f;
+
+    BOOST_CHECK( f.empty() );
+    BOOST_CHECK( !f );
+}
+
+BOOST_AUTO_TEST_CASE( calls_target ) {
+    inline_function<int(int)> f(&twice);
+
+    BOOST_CHECK( f );
+    BOOST_CHECK_EQUAL( f(21), 42 );
+}
+
+BOOST_AUTO_TEST_CASE( calls_bound_member ) {
+    websocketpp::lib::shared_ptr<counter> c =
+        websocketpp::lib::make_shared<counter>();
+
+    inline_function<void(int, int)> f = websocketpp::lib::bind(
+        &counter::add, c,
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2
+    );
+
+    f(1, 2);
+    BOOST_CHECK_EQUAL( c->calls, 1 );
+    BOOST_CHECK_EQUAL( c->last, 3 );
+}
+
+BOOST_AUTO_TEST_CASE( copies_hold_their_own_target ) {
+    websocketpp::lib::shared_ptr<counter> c =
+        websocketpp::lib::make_shared<counter>();
+
+    {
+        inline_function<void()> f = websocketpp::lib::bind(&counter::hit, c);
+        BOOST_CHECK_EQUAL( c.use_count(), 2 );
+
+        inline_function<void()> g(f);
+        BOOST_CHECK_EQUAL( c.use_count(), 3 );
+
+        inline_function<void()> h;
+        h = g;
+        BOOST_CHECK_EQUAL( c.use_count(), 4 );
+
+        f();
+        g();
+        h();
+        BOOST_CHECK_EQUAL( c->calls, 3 );
+
+        h = inline_function<void()>();
+        BOOST_CHECK( !h );
+        BOOST_CHECK_EQUAL( c.use_count(), 3 );
+    }
+
+    BOOST_CHECK_EQUAL( c.use_count(), 1 );
+}
+
+BOOST_AUTO_TEST_CASE( empty_callables_stay_empty ) {
+    websocketpp::lib::function<void()> none;
+    inline_function<void()> f(none);
+    BOOST_CHECK( f.empty() );
+
+    inline_function<void()> g(f);
+    BOOST_CHECK( !g );
+
+    inline_function<void()> h = websocketpp::lib::function<void()>();
+    BOOST_CHECK( !h );
+
+    int (*null_fn)(int) = NULL;
+    inline_function<int(int)> p(null_fn);
+    BOOST_CHECK( !p );
+}
+
+BOOST_AUTO_TEST_CASE( copies_function_targets ) {
+    websocketpp::lib::shared_ptr<counter> c =
+        websocketpp::lib::make_shared<counter>();
+
+    websocketpp::lib::function<void()> hit =
+        websocketpp::lib::bind(&counter::hit, c);
+
+    inline_function<void()> f(hit);
+    inline_function<void()> g(f);
+    inline_function<void()> h;
+    h = g;
+    BOOST_CHECK( f );
+    BOOST_CHECK( g );
+    BOOST_CHECK( h );
+
+    f();
+    g();
+    h();
+    BOOST_CHECK_EQUAL( c->calls, 3 );
+}
+
+BOOST_AUTO_TEST_CASE( swap_exchanges_targets ) {
+    websocketpp::lib::shared_ptr<counter> c =
+        websocketpp::lib::make_shared<counter>();
+
+    inline_function<void()> f = websocketpp::lib::bind(&counter::hit, c);
+    inline_function<void()> g;
+
+    g.swap(f);
+    BOOST_CHECK( !f );
+    BOOST_CHECK( g );
+    BOOST_CHECK_EQUAL( c.use_count(), 2 );
+
+    g();
+    BOOST_CHECK_EQUAL( c->calls, 1 );
+}
+
+#ifdef _WEBSOCKETPP_MOVE_SEMANTICS_
+BOOST_AUTO_TEST_CASE( move_leaves_source_empty ) {
+    websocketpp::lib::shared_ptr<counter> c =
+        websocketpp::lib::make_shared<counter>();
+
+    inline_function<void()> f = websocketpp::lib::bind(&counter::hit, c);
+    inline_function<void()> g(std::move(f));
+
+    BOOST_CHECK( !f );
+    BOOST_CHECK( g );
+    BOOST_CHECK_EQUAL( c.use_count(), 2 );
+}
+#endif
+
+BOOST_AUTO_TEST_CASE( holds_hot_path_binds ) {
+    // A member function bound to a shared_ptr, as used by the connection
+    // for dispatched writes, and a bound raw pointer with two placeholders,
+    // as used for frame reads, must both be stored inline.
+    websocketpp::lib::shared_ptr<counter> c =
+        websocketpp::lib::make_shared<counter>();
+
+    inline_function<void()> dispatch = websocketpp::lib::bind(
+        &counter::hit, c);
+    inline_function<void(int, int)> read = websocketpp::lib::bind(
+        &counter::add, c.get(),
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2
+    );
+
+    dispatch();
+    read(2, 3);
+    BOOST_CHECK_EQUAL( c->calls, 2 );
+    BOOST_CHECK( sizeof(dispatch) <= websocketpp::inline_function_capacity +
+        2 * sizeof(void *) );
+}
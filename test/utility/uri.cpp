@@ -236,6 +236,39 @@ BOOST_AUTO_TEST_CASE( uri_invalid_no_scheme ) {
     BOOST_CHECK( !uri.get_valid() );
 }
 
+// Valid unix domain socket URI
+BOOST_AUTO_TEST_CASE( uri_valid_unix_socket ) {
+    websocketpp::uri uri("unix:/run/ws.sock");
+
+    BOOST_CHECK( uri.get_valid() );
+    BOOST_CHECK( !uri.get_secure() );
+    BOOST_CHECK_EQUAL( uri.get_scheme(), "unix" );
+    BOOST_CHECK_EQUAL( uri.get_socket_path(), "/run/ws.sock" );
+    BOOST_CHECK_EQUAL( uri.get_host(), "localhost" );
+    BOOST_CHECK_EQUAL( uri.get_port(), 80 );
+    BOOST_CHECK_EQUAL( uri.get_resource(), "/" );
+    BOOST_CHECK_EQUAL( uri.str(), "unix:/run/ws.sock" );
+}
+
+// Valid unix domain socket URI with a resource
+BOOST_AUTO_TEST_CASE( uri_valid_unix_socket_resource ) {
+    websocketpp::uri uri("unix:/run/ws.sock:/chat?room=1");
+
+    BOOST_CHECK( uri.get_valid() );
+    BOOST_CHECK_EQUAL( uri.get_socket_path(), "/run/ws.sock" );
+    BOOST_CHECK_EQUAL( uri.get_resource(), "/chat?room=1" );
+    BOOST_CHECK_EQUAL( uri.get_query(), "room=1" );
+    BOOST_CHECK_EQUAL( uri.str(), "unix:/run/ws.sock:/chat?room=1" );
+}
+
+// Unix domain socket URI without a path
+BOOST_AUTO_TEST_CASE( uri_invalid_unix_socket ) {
+    websocketpp::uri uri("unix::/chat");
+
+    BOOST_CHECK( !uri.get_valid() );
+    BOOST_CHECK( uri.get_socket_path().empty() );
+}
+
 // Invalid IPv6 literal
 /*BOOST_AUTO_TEST_CASE( uri_invalid_v6_nonhex ) {
     websocketpp::uri uri("wss://[g::1]:9000/");
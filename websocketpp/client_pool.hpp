@@ -0,0 +1,608 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_CLIENT_POOL_HPP
+#define WEBSOCKETPP_CLIENT_POOL_HPP
+
+#include <websocketpp/close.hpp>
+#include <websocketpp/error.hpp>
+#include <websocketpp/uri.hpp>
+
+#include <websocketpp/random/chacha.hpp>
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/system_error.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace websocketpp {
+
+/// Client pool health counters
+struct client_pool_stats {
+    client_pool_stats()
+      : active(0)
+      , spares(0)
+      , connecting(0)
+      , attempts(0)
+      , failures(0)
+      , disconnects(0)
+      , promotions(0)
+      , backoff(0) {}
+
+    /// Number of open connections handed out by get_connection
+    size_t active;
+    /// Number of open connections held in reserve
+    size_t spares;
+    /// Number of connections being opened
+    size_t connecting;
+    /// Number of connection attempts
+    uint64_t attempts;
+    /// Number of connection attempts that failed
+    uint64_t failures;
+    /// Number of active connections that closed
+    uint64_t disconnects;
+    /// Number of spares that replaced an active connection
+    uint64_t promotions;
+    /// Current reconnect delay in milliseconds, zero if not backing off
+    long backoff;
+};
+
+/// Pool of client connections kept open to a set of URIs
+/**
+ * A client_pool keeps a fixed number of active connections open to each URI
+ * added to it, plus a number of spares that have completed their opening
+ * handshake but are not handed out. When an active connection closes a spare
+ * takes its place immediately and a replacement spare is opened in the
+ * background, so a failover does not wait for a handshake.
+ *
+ * Connections that fail to open are retried after a delay that doubles with
+ * each consecutive failure, up to a maximum. The delay is jittered between
+ * half and all of its nominal value so that many pools reconnecting to the
+ * same upstream spread out. A successful open resets the delay.
+ *
+ * Pooled connections use the client endpoint's handlers, except that the
+ * pool replaces their open, fail and close handlers. Use the pool's activate
+ * and deactivate handlers to learn when connections enter and leave the
+ * active set.
+ *
+ * The pool must be owned by a shared pointer and requires a transport that
+ * provides endpoint timers, such as the asio transport.
+ *
+ * @since 0.8.0
+ */
+template <typename client>
+class client_pool
+  : public lib::enable_shared_from_this<client_pool<client> >
+{
+public:
+    /// Type of this client pool
+    typedef client_pool<client> type;
+    /// Type of a shared pointer to this client pool
+    typedef lib::shared_ptr<type> ptr;
+    /// Type of a weak pointer to this client pool
+    typedef lib::weak_ptr<type> weak_ptr;
+
+    /// Type of the client endpoint the pool connects with
+    typedef client client_type;
+    /// Type of a shared pointer to a pooled connection
+    typedef typename client_type::connection_ptr connection_ptr;
+    /// Type of the endpoint concurrency policy
+    typedef typename client_type::concurrency_type concurrency_type;
+    /// Type of the mutex protecting the pool
+    typedef typename concurrency_type::mutex_type mutex_type;
+    /// Type of a lock on the pool
+    typedef typename concurrency_type::scoped_lock_type scoped_lock_type;
+    /// Type of a handle to a transport timer
+    typedef typename client_type::transport_type::timer_ptr timer_ptr;
+
+    /// Type of the activate and deactivate handlers
+    /**
+     * Called with the URI the connection belongs to and the connection.
+     */
+    typedef lib::function<void(std::string const &,connection_hdl)>
+        connection_handler;
+
+    /// Construct a pool that connects using the given client endpoint
+    /**
+     * The endpoint must outlive the pool and must be initialized before
+     * URIs are added.
+     *
+     * @param c The client endpoint
+     */
+    explicit client_pool(client_type * c)
+      : m_client(c)
+      , m_backoff_initial(100)
+      , m_backoff_max(30000)
+      , m_stopped(false) {}
+
+    /// Set the reconnect delay bounds
+    /**
+     * The first retry after a failure waits `initial` milliseconds, and each
+     * further consecutive failure doubles the delay up to `max`. The defaults
+     * are 100 and 30000 milliseconds.
+     *
+     * @param initial The delay after the first failure in milliseconds
+     * @param max The maximum delay in milliseconds
+     */
+    void set_backoff(long initial, long max) {
+        scoped_lock_type guard(m_lock);
+        m_backoff_initial = initial > 0 ? initial : 1;
+        m_backoff_max = max > m_backoff_initial ? max : m_backoff_initial;
+    }
+
+    /// Set the handler called when a connection becomes active
+    void set_activate_handler(connection_handler h) {
+        scoped_lock_type guard(m_lock);
+        m_activate_handler = h;
+    }
+
+    /// Set the handler called when an active connection closes
+    void set_deactivate_handler(connection_handler h) {
+        scoped_lock_type guard(m_lock);
+        m_deactivate_handler = h;
+    }
+
+    /// Start keeping connections open to a URI
+    /**
+     * If the URI is already in the pool its sizes are updated. Shrinking a
+     * URI does not close connections that are already open.
+     *
+     * @param [in] u The URI to connect to
+     * @param [in] size The number of active connections
+     * @param [in] spares The number of spare connections
+     * @param [out] ec A status code indicating an error, if any.
+     */
+    void add(std::string const & u, size_t size, size_t spares,
+        lib::error_code & ec)
+    {
+        if (!uri(u).get_valid()) {
+            ec = error::make_error_code(error::invalid_uri);
+            return;
+        }
+
+        size_t n;
+        {
+            scoped_lock_type guard(m_lock);
+            if (m_stopped) {
+                ec = error::make_error_code(error::invalid_state);
+                return;
+            }
+
+            target & t = m_targets[u];
+            t.size = size;
+            t.spares = spares;
+            n = fill_locked(u, t);
+        }
+
+        ec = lib::error_code();
+        connect(u, n);
+    }
+
+    /// Start keeping connections open to a URI (exception version)
+    void add(std::string const & u, size_t size, size_t spares) {
+        lib::error_code ec;
+        add(u, size, spares, ec);
+        if (ec) {
+            throw exception(ec);
+        }
+    }
+
+    /// Get an active connection to a URI
+    /**
+     * Successive calls cycle through the URI's active connections.
+     *
+     * @param [in] u The URI
+     * @param [out] ec Set to error::no_pooled_connection if no connection to
+     * the URI is active.
+     * @return The connection, or an empty pointer on error
+     */
+    connection_ptr get_connection(std::string const & u,
+        lib::error_code & ec)
+    {
+        scoped_lock_type guard(m_lock);
+
+        typename target_map::iterator it = m_targets.find(u);
+        if (it == m_targets.end() || it->second.active.empty()) {
+            ec = error::make_error_code(error::no_pooled_connection);
+            return connection_ptr();
+        }
+
+        target & t = it->second;
+        ec = lib::error_code();
+        return t.active[t.next++ % t.active.size()];
+    }
+
+    /// Get an active connection to a URI (exception version)
+    connection_ptr get_connection(std::string const & u) {
+        lib::error_code ec;
+        connection_ptr con = get_connection(u, ec);
+        if (ec) {
+            throw exception(ec);
+        }
+        return con;
+    }
+
+    /// Get the health counters of one URI
+    client_pool_stats get_stats(std::string const & u) const {
+        scoped_lock_type guard(m_lock);
+
+        typename target_map::const_iterator it = m_targets.find(u);
+        if (it == m_targets.end()) {
+            return client_pool_stats();
+        }
+        return stats_locked(it->second);
+    }
+
+    /// Get the health counters summed over all URIs
+    /**
+     * The backoff field holds the longest current delay.
+     */
+    client_pool_stats get_stats() const {
+        scoped_lock_type guard(m_lock);
+
+        client_pool_stats total;
+        typename target_map::const_iterator it;
+        for (it = m_targets.begin(); it != m_targets.end(); ++it) {
+            client_pool_stats s = stats_locked(it->second);
+            total.active += s.active;
+            total.spares += s.spares;
+            total.connecting += s.connecting;
+            total.attempts += s.attempts;
+            total.failures += s.failures;
+            total.disconnects += s.disconnects;
+            total.promotions += s.promotions;
+            if (s.backoff > total.backoff) {
+                total.backoff = s.backoff;
+            }
+        }
+        return total;
+    }
+
+    /// Close all pooled connections and stop reconnecting
+    /**
+     * The pool can not be used after it is stopped.
+     */
+    void stop() {
+        std::vector<connection_ptr> cons;
+        std::vector<timer_ptr> timers;
+        {
+            scoped_lock_type guard(m_lock);
+            m_stopped = true;
+
+            typename target_map::iterator it;
+            for (it = m_targets.begin(); it != m_targets.end(); ++it) {
+                target & t = it->second;
+                cons.insert(cons.end(), t.active.begin(), t.active.end());
+                cons.insert(cons.end(), t.idle.begin(), t.idle.end());
+                if (t.timer) {
+                    timers.push_back(t.timer);
+                }
+            }
+            m_targets.clear();
+        }
+
+        for (size_t i = 0; i < timers.size(); ++i) {
+            timers[i]->cancel();
+        }
+        for (size_t i = 0; i < cons.size(); ++i) {
+            lib::error_code ec;
+            cons[i]->close(close::status::going_away, "", ec);
+        }
+    }
+private:
+    struct target {
+        target()
+          : size(0)
+          , spares(0)
+          , connecting(0)
+          , next(0)
+          , failures(0)
+          , backoff(0) {}
+
+        size_t size;
+        size_t spares;
+        std::vector<connection_ptr> active;
+        std::vector<connection_ptr> idle;
+        size_t connecting;
+        size_t next;
+        // Consecutive failed attempts
+        unsigned int failures;
+        // Delay of the pending reconnect timer, zero if there is none
+        long backoff;
+        timer_ptr timer;
+        client_pool_stats stats;
+    };
+
+    typedef std::map<std::string,target> target_map;
+
+    client_pool_stats stats_locked(target const & t) const {
+        client_pool_stats s = t.stats;
+        s.active = t.active.size();
+        s.spares = t.idle.size();
+        s.connecting = t.connecting;
+        s.backoff = t.backoff;
+        return s;
+    }
+
+    /// Count and reserve the connections to open now for a target
+    /**
+     * Schedules a delayed reconnect instead if the target is backing off.
+     * Must be called with m_lock held.
+     */
+    size_t fill_locked(std::string const & u, target & t) {
+        size_t have = t.active.size() + t.idle.size() + t.connecting;
+        size_t want = t.size + t.spares;
+
+        if (m_stopped || have >= want || t.timer) {
+            return 0;
+        }
+
+        if (t.failures > 0) {
+            schedule_locked(u, t);
+            return 0;
+        }
+
+        t.connecting += want - have;
+        return want - have;
+    }
+
+    /// Arm the reconnect timer of a target. Must be called with m_lock held.
+    void schedule_locked(std::string const & u, target & t) {
+        unsigned int shift = t.failures - 1 < 20 ? t.failures - 1 : 20;
+
+        // Compare before shifting so that large delays saturate at the
+        // maximum instead of overflowing
+        long delay = m_backoff_max;
+        if (m_backoff_initial <= (m_backoff_max >> shift)) {
+            delay = m_backoff_initial << shift;
+        }
+
+        // Equal jitter: wait between half and all of the nominal delay
+        long half = delay / 2;
+        unsigned long span = static_cast<unsigned long>(delay - half) + 1;
+        delay = half + static_cast<long>(m_rng() % span);
+
+        t.backoff = delay;
+        t.timer = m_client->set_timer(delay, lib::bind(
+            &type::handle_timer,
+            weak_ptr(this->shared_from_this()),
+            u,
+            lib::placeholders::_1
+        ));
+    }
+
+    /// Open n connections to a URI. Must be called without m_lock held.
+    void connect(std::string const & u, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            lib::error_code ec;
+            connection_ptr con = m_client->get_connection(u, ec);
+            if (ec) {
+                on_fail(u);
+                continue;
+            }
+
+            weak_ptr w(this->shared_from_this());
+            con->set_open_handler(lib::bind(&type::handle_open, w, u,
+                lib::placeholders::_1));
+            con->set_fail_handler(lib::bind(&type::handle_fail, w, u,
+                lib::placeholders::_1));
+            con->set_close_handler(lib::bind(&type::handle_close, w, u,
+                lib::placeholders::_1));
+
+            {
+                scoped_lock_type guard(m_lock);
+                typename target_map::iterator it = m_targets.find(u);
+                if (it != m_targets.end()) {
+                    it->second.stats.attempts++;
+                }
+            }
+
+            m_client->connect(con);
+        }
+    }
+
+    static void handle_open(weak_ptr w, std::string u, connection_hdl hdl) {
+        ptr pool = w.lock();
+        if (pool) {
+            pool->on_open(u, hdl);
+        }
+    }
+
+    static void handle_fail(weak_ptr w, std::string u, connection_hdl) {
+        ptr pool = w.lock();
+        if (pool) {
+            pool->on_fail(u);
+        }
+    }
+
+    static void handle_close(weak_ptr w, std::string u, connection_hdl hdl) {
+        ptr pool = w.lock();
+        if (pool) {
+            pool->on_close(u, hdl);
+        }
+    }
+
+    static void handle_timer(weak_ptr w, std::string u,
+        lib::error_code const & ec)
+    {
+        ptr pool = w.lock();
+        if (pool && !ec) {
+            pool->on_timer(u);
+        }
+    }
+
+    void on_open(std::string const & u, connection_hdl hdl) {
+        connection_handler handler;
+        connection_ptr con = m_client->get_con_from_hdl(hdl);
+        bool orphan = false;
+        {
+            scoped_lock_type guard(m_lock);
+
+            typename target_map::iterator it = m_targets.find(u);
+            if (it == m_targets.end()) {
+                orphan = true;
+            } else {
+                target & t = it->second;
+                t.connecting--;
+                t.failures = 0;
+
+                if (t.active.size() < t.size) {
+                    t.active.push_back(con);
+                    handler = m_activate_handler;
+                } else {
+                    t.idle.push_back(con);
+                }
+            }
+        }
+
+        if (orphan) {
+            // The pool was stopped while this connection was opening
+            lib::error_code ec;
+            con->close(close::status::going_away, "", ec);
+        } else if (handler) {
+            handler(u, hdl);
+        }
+    }
+
+    void on_fail(std::string const & u) {
+        size_t n = 0;
+        {
+            scoped_lock_type guard(m_lock);
+
+            typename target_map::iterator it = m_targets.find(u);
+            if (it == m_targets.end()) {
+                return;
+            }
+
+            target & t = it->second;
+            t.connecting--;
+            t.failures++;
+            t.stats.failures++;
+            n = fill_locked(u, t);
+        }
+        connect(u, n);
+    }
+
+    void on_close(std::string const & u, connection_hdl hdl) {
+        connection_handler deactivate;
+        connection_handler activate;
+        connection_hdl promoted;
+        size_t n = 0;
+        {
+            scoped_lock_type guard(m_lock);
+
+            typename target_map::iterator it = m_targets.find(u);
+            if (it == m_targets.end()) {
+                return;
+            }
+
+            target & t = it->second;
+            connection_ptr con = m_client->get_con_from_hdl(hdl);
+
+            if (erase(t.active, con)) {
+                t.stats.disconnects++;
+                deactivate = m_deactivate_handler;
+
+                if (!t.idle.empty()) {
+                    t.active.push_back(t.idle.back());
+                    t.idle.pop_back();
+                    t.stats.promotions++;
+                    promoted = t.active.back();
+                    activate = m_activate_handler;
+                }
+            } else {
+                erase(t.idle, con);
+            }
+
+            n = fill_locked(u, t);
+        }
+
+        if (deactivate) {
+            deactivate(u, hdl);
+        }
+        if (activate) {
+            activate(u, promoted);
+        }
+        connect(u, n);
+    }
+
+    void on_timer(std::string const & u) {
+        size_t n = 0;
+        {
+            scoped_lock_type guard(m_lock);
+
+            typename target_map::iterator it = m_targets.find(u);
+            if (it == m_targets.end()) {
+                return;
+            }
+
+            target & t = it->second;
+            t.timer.reset();
+            t.backoff = 0;
+
+            size_t have = t.active.size() + t.idle.size() + t.connecting;
+            size_t want = t.size + t.spares;
+            if (have < want) {
+                t.connecting += want - have;
+                n = want - have;
+            }
+        }
+        connect(u, n);
+    }
+
+    static bool erase(std::vector<connection_ptr> & v, connection_ptr con) {
+        typename std::vector<connection_ptr>::iterator it;
+        for (it = v.begin(); it != v.end(); ++it) {
+            if (*it == con) {
+                v.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    client_type *       m_client;
+    mutable mutex_type  m_lock;
+    target_map          m_targets;
+    long                m_backoff_initial;
+    long                m_backoff_max;
+    bool                m_stopped;
+    connection_handler  m_activate_handler;
+    connection_handler  m_deactivate_handler;
+    random::chacha::int_generator<uint32_t,concurrency_type> m_rng;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CLIENT_POOL_HPP
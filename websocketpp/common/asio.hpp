@@ -66,6 +66,32 @@
     #include <boost/system/error_code.hpp>
 #endif
 
+// Unix domain socket support in the asio transport (the local_socket socket
+// policy) requires a platform with local::stream_protocol.
+#ifndef _WEBSOCKETPP_NO_LOCAL_SOCKETS_
+    #ifdef ASIO_STANDALONE
+        #ifdef ASIO_HAS_LOCAL_SOCKETS
+            #define _WEBSOCKETPP_LOCAL_SOCKETS_
+        #endif
+    #else
+        #ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+            #define _WEBSOCKETPP_LOCAL_SOCKETS_
+        #endif
+    #endif
+#endif
+
+// basic_socket::release, which hands a connected socket's descriptor over to
+// another socket object, requires Asio 1.12 or Boost 1.66.
+#ifdef ASIO_STANDALONE
+    #if ASIO_VERSION >= 101200
+        #define _WEBSOCKETPP_ASIO_SOCKET_RELEASE_
+    #endif
+#else
+    #if BOOST_VERSION >= 106600
+        #define _WEBSOCKETPP_ASIO_SOCKET_RELEASE_
+    #endif
+#endif
+
 namespace websocketpp {
 namespace lib {
 
@@ -86,6 +86,9 @@
     #ifndef _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
         #define _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
     #endif
+    #ifndef _WEBSOCKETPP_FINAL_TOKEN_
+        #define _WEBSOCKETPP_FINAL_TOKEN_ final
+    #endif
     
     #ifndef __GNUC__
         // GCC as of version 4.9 (latest) does not support std::put_time yet.
@@ -139,6 +142,25 @@
         #define _WEBSOCKETPP_INITIALIZER_LISTS_
     #endif
     
+    // Test for final
+    #ifndef _WEBSOCKETPP_FINAL_TOKEN_
+        #ifdef _WEBSOCKETPP_FINAL_
+            // build system says we have final
+            #define _WEBSOCKETPP_FINAL_TOKEN_ final
+        #else
+            #if __has_feature(cxx_override_control)
+                // clang feature detect says we have final
+                #define _WEBSOCKETPP_FINAL_TOKEN_ final
+            #elif defined(_MSC_VER) && _MSC_VER >= 1700
+                // Visual Studio 2012+ has final
+                #define _WEBSOCKETPP_FINAL_TOKEN_ final
+            #else
+                // assume we don't have final
+                #define _WEBSOCKETPP_FINAL_TOKEN_
+            #endif
+        #endif
+    #endif
+
     // Test for nullptr
     #ifndef _WEBSOCKETPP_NULLPTR_TOKEN_
         #ifdef _WEBSOCKETPP_NULLPTR_
@@ -159,4 +181,17 @@
     #endif
 #endif
 
+// Thread local storage for POD objects. C++11 `thread_local` is preferred,
+// then the equivalent compiler extensions. Left undefined if none are
+// available or _WEBSOCKETPP_NO_THREAD_LOCAL_ is defined.
+#ifndef _WEBSOCKETPP_NO_THREAD_LOCAL_
+    #if defined _WEBSOCKETPP_CPP11_INTERNAL_ && !defined(__APPLE__)
+        #define _WEBSOCKETPP_THREAD_LOCAL_ thread_local
+    #elif defined(__GNUC__) || defined(__clang__)
+        #define _WEBSOCKETPP_THREAD_LOCAL_ __thread
+    #elif defined(_MSC_VER)
+        #define _WEBSOCKETPP_THREAD_LOCAL_ __declspec(thread)
+    #endif
+#endif
+
 #endif // WEBSOCKETPP_COMMON_CPP11_HPP
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_COMMON_INLINE_FUNCTION_HPP
+#define WEBSOCKETPP_COMMON_INLINE_FUNCTION_HPP
+
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/type_traits.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace websocketpp {
+
+/// Default number of bytes an inline_function can hold
+/**
+ * Large enough for a member function pointer bound to a shared_ptr and one
+ * further pointer sized argument.
+ */
+static std::size_t const inline_function_capacity = 48;
+
+namespace detail {
+
+/// Test whether a callable has no target
+template <typename F>
+bool is_empty_target(F const &) {
+    return false;
+}
+
+/// A null function pointer has no target
+template <typename T>
+bool is_empty_target(T * f) {
+    return f == NULL;
+}
+
+/// An empty lib::function has no target
+template <typename Signature>
+bool is_empty_target(lib::function<Signature> const & f) {
+    return !f;
+}
+
+/// Storage and lifetime management shared by all inline_function signatures
+template <std::size_t Capacity>
+class inline_function_base {
+public:
+    /// Test whether the function holds a target
+    bool empty() const {
+        return m_manager == NULL;
+    }
+protected:
+    enum operation {
+        copy_op,
+        move_op,
+        destroy_op
+    };
+
+    typedef void (*manager_type)(operation, void *, void *);
+    typedef typename lib::aligned_storage<Capacity>::type storage_type;
+
+    inline_function_base() : m_manager(NULL) {}
+
+    inline_function_base(inline_function_base const & other)
+      : m_manager(other.m_manager)
+    {
+        if (m_manager) {
+            m_manager(copy_op, &m_storage, other.target());
+        }
+    }
+
+    ~inline_function_base() {
+        reset();
+    }
+
+    /// Construct a copy of f in the inline storage
+    /**
+     * Fails to compile if f does not fit. inline_function never falls back
+     * to the heap.
+     */
+    template <typename F>
+    void store(F const & f) {
+#ifdef _WEBSOCKETPP_CPP11_INTERNAL_
+        static_assert(sizeof(F) <= Capacity,
+            "handler is too large for inline_function, it would spill");
+        static_assert(alignof(F) <= alignof(storage_type),
+            "handler is over-aligned for inline_function");
+#else
+        typedef char handler_too_large_for_inline_function
+            [sizeof(F) <= Capacity ? 1 : -1];
+        static_cast<void>(sizeof(handler_too_large_for_inline_function));
+#endif
+        new (&m_storage) F(f);
+        m_manager = &manage<F>;
+    }
+
+    void reset() {
+        if (m_manager) {
+            m_manager(destroy_op, &m_storage, NULL);
+            m_manager = NULL;
+        }
+    }
+
+    /// Replace the target with the target of other
+    /**
+     * If move is set the target of other is moved from rather than copied
+     * and other is left empty.
+     */
+    void assign(inline_function_base & other, bool move) {
+        if (this == &other) {
+            return;
+        }
+        reset();
+        if (other.m_manager) {
+            other.m_manager(move ? move_op : copy_op, &m_storage,
+                &other.m_storage);
+            m_manager = other.m_manager;
+            if (move) {
+                other.reset();
+            }
+        }
+    }
+
+    void swap_base(inline_function_base & other) {
+        inline_function_base tmp;
+        tmp.assign(other, true);
+        other.assign(*this, true);
+        assign(tmp, true);
+    }
+
+    void * target() const {
+        return const_cast<void *>(static_cast<void const *>(&m_storage));
+    }
+private:
+    template <typename F>
+    static void manage(operation op, void * dst, void * src) {
+        switch (op) {
+            case copy_op:
+                new (dst) F(*static_cast<F const *>(src));
+                break;
+            case move_op:
+#ifdef _WEBSOCKETPP_MOVE_SEMANTICS_
+                new (dst) F(std::move(*static_cast<F *>(src)));
+#else
+                new (dst) F(*static_cast<F const *>(src));
+#endif
+                break;
+            case destroy_op:
+                static_cast<F *>(dst)->~F();
+                break;
+        }
+    }
+
+    storage_type m_storage;
+    manager_type m_manager;
+};
+
+} // namespace detail
+
+/// Function wrapper that stores its target inline
+/**
+ * inline_function is a replacement for lib::function for callbacks on the
+ * hot path, such as transport read, write and dispatch handlers. The target
+ * is always stored in a fixed size buffer inside the object, so constructing,
+ * copying or moving an inline_function never allocates. Constructing one from
+ * a callable larger than the capacity is a compile time error rather than a
+ * silent heap allocation.
+ *
+ * Signatures with up to two arguments are supported. Constructing one from
+ * a null function pointer or an empty lib::function leaves it empty. Calling
+ * an empty inline_function is undefined.
+ *
+ * @since 0.8.0
+ */
+template <typename Signature, std::size_t Capacity = inline_function_capacity>
+class inline_function;
+
+template <typename R, std::size_t Capacity>
+class inline_function<R (), Capacity>
+  : public detail::inline_function_base<Capacity>
+{
+    typedef detail::inline_function_base<Capacity> base;
+    typedef R (*invoker_type)(void *);
+    typedef void (inline_function::*bool_type)() const;
+public:
+    typedef R result_type;
+
+    inline_function() : m_invoke(NULL) {}
+
+    template <typename F>
+    inline_function(F f) : m_invoke(NULL) {
+        if (!detail::is_empty_target(f)) {
+            base::store(f);
+            m_invoke = &invoke<F>;
+        }
+    }
+
+    inline_function(inline_function const & other)
+      : base(other), m_invoke(other.m_invoke) {}
+
+#ifdef _WEBSOCKETPP_MOVE_SEMANTICS_
+    inline_function(inline_function && other) : m_invoke(other.m_invoke) {
+        base::assign(other, true);
+    }
+
+    inline_function & operator=(inline_function && other) {
+        base::assign(other, true);
+        m_invoke = other.m_invoke;
+        return *this;
+    }
+#endif
+
+    inline_function & operator=(inline_function const & other) {
+        base::assign(const_cast<inline_function &>(other), false);
+        m_invoke = other.m_invoke;
+        return *this;
+    }
+
+    void swap(inline_function & other) {
+        base::swap_base(other);
+        std::swap(m_invoke, other.m_invoke);
+    }
+
+    operator bool_type() const {
+        return base::empty() ? 0 : &inline_function::bool_true;
+    }
+
+    R operator()() const {
+        return m_invoke(base::target());
+    }
+private:
+    void bool_true() const {}
+
+    template <typename F>
+    static R invoke(void * f) {
+        return (*static_cast<F *>(f))();
+    }
+
+    invoker_type m_invoke;
+};
+
+template <typename R, typename A1, std::size_t Capacity>
+class inline_function<R (A1), Capacity>
+  : public detail::inline_function_base<Capacity>
+{
+    typedef detail::inline_function_base<Capacity> base;
+    typedef R (*invoker_type)(void *, A1);
+    typedef void (inline_function::*bool_type)() const;
+public:
+    typedef R result_type;
+
+    inline_function() : m_invoke(NULL) {}
+
+    template <typename F>
+    inline_function(F f) : m_invoke(NULL) {
+        if (!detail::is_empty_target(f)) {
+            base::store(f);
+            m_invoke = &invoke<F>;
+        }
+    }
+
+    inline_function(inline_function const & other)
+      : base(other), m_invoke(other.m_invoke) {}
+
+#ifdef _WEBSOCKETPP_MOVE_SEMANTICS_
+    inline_function(inline_function && other) : m_invoke(other.m_invoke) {
+        base::assign(other, true);
+    }
+
+    inline_function & operator=(inline_function && other) {
+        base::assign(other, true);
+        m_invoke = other.m_invoke;
+        return *this;
+    }
+#endif
+
+    inline_function & operator=(inline_function const & other) {
+        base::assign(const_cast<inline_function &>(other), false);
+        m_invoke = other.m_invoke;
+        return *this;
+    }
+
+    void swap(inline_function & other) {
+        base::swap_base(other);
+        std::swap(m_invoke, other.m_invoke);
+    }
+
+    operator bool_type() const {
+        return base::empty() ? 0 : &inline_function::bool_true;
+    }
+
+    R operator()(A1 a1) const {
+        return m_invoke(base::target(), a1);
+    }
+private:
+    void bool_true() const {}
+
+    template <typename F>
+    static R invoke(void * f, A1 a1) {
+        return (*static_cast<F *>(f))(a1);
+    }
+
+    invoker_type m_invoke;
+};
+
+template <typename R, typename A1, typename A2, std::size_t Capacity>
+class inline_function<R (A1, A2), Capacity>
+  : public detail::inline_function_base<Capacity>
+{
+    typedef detail::inline_function_base<Capacity> base;
+    typedef R (*invoker_type)(void *, A1, A2);
+    typedef void (inline_function::*bool_type)() const;
+public:
+    typedef R result_type;
+
+    inline_function() : m_invoke(NULL) {}
+
+    template <typename F>
+    inline_function(F f) : m_invoke(NULL) {
+        if (!detail::is_empty_target(f)) {
+            base::store(f);
+            m_invoke = &invoke<F>;
+        }
+    }
+
+    inline_function(inline_function const & other)
+      : base(other), m_invoke(other.m_invoke) {}
+
+#ifdef _WEBSOCKETPP_MOVE_SEMANTICS_
+    inline_function(inline_function && other) : m_invoke(other.m_invoke) {
+        base::assign(other, true);
+    }
+
+    inline_function & operator=(inline_function && other) {
+        base::assign(other, true);
+        m_invoke = other.m_invoke;
+        return *this;
+    }
+#endif
+
+    inline_function & operator=(inline_function const & other) {
+        base::assign(const_cast<inline_function &>(other), false);
+        m_invoke = other.m_invoke;
+        return *this;
+    }
+
+    void swap(inline_function & other) {
+        base::swap_base(other);
+        std::swap(m_invoke, other.m_invoke);
+    }
+
+    operator bool_type() const {
+        return base::empty() ? 0 : &inline_function::bool_true;
+    }
+
+    R operator()(A1 a1, A2 a2) const {
+        return m_invoke(base::target(), a1, a2);
+    }
+private:
+    void bool_true() const {}
+
+    template <typename F>
+    static R invoke(void * f, A1 a1, A2 a2) {
+        return (*static_cast<F *>(f))(a1, a2);
+    }
+
+    invoker_type m_invoke;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_COMMON_INLINE_FUNCTION_HPP
@@ -66,6 +66,7 @@ namespace lib {
     using std::error_category;
     using std::error_condition;
     using std::system_error;
+    using std::system_category;
     #define _WEBSOCKETPP_ERROR_CODE_ENUM_NS_START_ namespace std {
     #define _WEBSOCKETPP_ERROR_CODE_ENUM_NS_END_ }
 #else
@@ -74,6 +75,7 @@ namespace lib {
     using boost::system::error_category;
     using boost::system::error_condition;
     using boost::system::system_error;
+    using boost::system::system_category;
     #define _WEBSOCKETPP_ERROR_CODE_ENUM_NS_START_ namespace boost { namespace system {
     #define _WEBSOCKETPP_ERROR_CODE_ENUM_NS_END_ }}
 #endif
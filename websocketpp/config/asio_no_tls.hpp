@@ -52,6 +52,8 @@ struct asio : public core {
     typedef base::elog_type elog_type;
 
     typedef base::rng_type rng_type;
+    typedef base::metrics_type metrics_type;
+    typedef base::trace_type trace_type;
 
     struct transport_config : public base::transport_config {
         typedef type::concurrency_type concurrency_type;
@@ -43,6 +43,9 @@
 #include <websocketpp/http/request.hpp>
 #include <websocketpp/http/response.hpp>
 
+// Processors
+#include <websocketpp/processors/base.hpp>
+
 // Messages
 #include <websocketpp/message_buffer/message.hpp>
 #include <websocketpp/message_buffer/alloc.hpp>
@@ -50,6 +53,12 @@
 // Loggers
 #include <websocketpp/logger/stub.hpp>
 
+// Metrics
+#include <websocketpp/metrics/none.hpp>
+
+// Tracing
+#include <websocketpp/trace/none.hpp>
+
 // RNG
 #include <websocketpp/random/none.hpp>
 
@@ -118,6 +127,12 @@ struct minimal_server {
     /// RNG policies
     typedef websocketpp::random::none::int_generator<uint32_t> rng_type;
 
+    /// Metrics policy
+    typedef websocketpp::metrics::none metrics_type;
+
+    /// Tracing policy
+    typedef websocketpp::trace::none trace_type;
+
     /// Controls compile time enabling/disabling of thread syncronization
     /// code Disabling can provide a minor performance improvement to single
     /// threaded applications
@@ -189,6 +204,19 @@ struct minimal_server {
      */
     static const int client_version = 13; // RFC6455
 
+    /// WebSocket Protocol versions to support
+    /**
+     * A mask of `websocketpp::processor::versions` values. Handshakes for
+     * other versions are rejected, and the processors for them are not
+     * compiled in. Setting this to `processor::versions::hybi13` alone also
+     * lets connections hold their processor by value and call it without
+     * virtual dispatch.
+     *
+     * @since 0.8.0
+     */
+    static const unsigned int processor_versions =
+        websocketpp::processor::versions::all;
+
     /// Default static error logging channels
     /**
      * Which error logging channels to enable at compile time. Channels not
@@ -218,6 +246,21 @@ struct minimal_server {
     ///
     static const size_t connection_read_buffer_size = 16384;
 
+    /// Size of the buffer small outgoing frames are coalesced into
+    /**
+     * Frames that fit are copied into a per-connection buffer of up to this
+     * size so that a burst of small messages is written as one contiguous
+     * buffer rather than a header and a payload buffer each. This cuts the
+     * number of system calls and, with TLS, the number of records. Larger
+     * frames and frames shared with other connections are written in place.
+     * The buffer is reused across writes and released when the keepalive
+     * scheduler finds it unused for an interval. Set to zero to disable
+     * coalescing.
+     *
+     * @since 0.8.0
+     */
+    static const size_t write_coalesce_size = 2048;
+
     /// Drop connections immediately on protocol error.
     /**
      * Drop connections on protocol error rather than sending a close frame.
@@ -29,10 +29,14 @@
 #define WEBSOCKETPP_CONNECTION_HPP
 
 #include <websocketpp/close.hpp>
+#include <websocketpp/connection_registry.hpp>
 #include <websocketpp/error.hpp>
 #include <websocketpp/frame.hpp>
 
+#include <websocketpp/logger/format.hpp>
 #include <websocketpp/logger/levels.hpp>
+#include <websocketpp/memory_budget.hpp>
+#include <websocketpp/processors/holder.hpp>
 #include <websocketpp/processors/processor.hpp>
 #include <websocketpp/transport/base/connection.hpp>
 #include <websocketpp/http/constants.hpp>
@@ -40,10 +44,12 @@
 #include <websocketpp/common/connection_hdl.hpp>
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/inline_function.hpp>
 
 #include <queue>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace websocketpp {
@@ -151,15 +157,15 @@ typedef lib::function<bool(connection_hdl)> validate_handler;
 typedef lib::function<void(connection_hdl)> http_handler;
 
 //
-typedef lib::function<void(lib::error_code const & ec, size_t bytes_transferred)> read_handler;
-typedef lib::function<void(lib::error_code const & ec)> write_frame_handler;
+typedef inline_function<void(lib::error_code const & ec, size_t bytes_transferred)> read_handler;
+typedef inline_function<void(lib::error_code const & ec)> write_frame_handler;
 
 // constants related to the default WebSocket protocol versions available
 #ifdef _WEBSOCKETPP_INITIALIZER_LISTS_ // simplified C++11 version
     /// Container that stores the list of protocol versions supported
     /**
-     * @todo Move this to configs to allow compile/runtime disabling or enabling
-     * of protocol versions
+     * Connections support the subset of these enabled by the
+     * `processor_versions` config setting.
      */
     static std::vector<int> const versions_supported = {0,7,8,13};
 #else
@@ -167,8 +173,8 @@ typedef lib::function<void(lib::error_code const & ec)> write_frame_handler;
     static int const helper[] = {0,7,8,13};
     /// Container that stores the list of protocol versions supported
     /**
-     * @todo Move this to configs to allow compile/runtime disabling or enabling
-     * of protocol versions
+     * Connections support the subset of these enabled by the
+     * `processor_versions` config setting.
      */
     static std::vector<int> const versions_supported(helper,helper+4);
 #endif
@@ -271,11 +277,19 @@ public:
     typedef typename config::con_msg_manager_type con_msg_manager_type;
     typedef typename con_msg_manager_type::ptr con_msg_manager_ptr;
 
+    /// Type of a cache of data frames shared between connections
+    /**
+     * Maps a protocol version to the frame prepared for it.
+     */
+    typedef std::vector<std::pair<int,message_ptr> > frame_cache;
+
     /// Type of RNG
     typedef typename config::rng_type rng_type;
 
     typedef processor::processor<config> processor_type;
     typedef lib::shared_ptr<processor_type> processor_ptr;
+    /// Type of the owner of the connection's processor
+    typedef processor::holder<config> processor_holder;
 
     // Message handler (needs to know message type)
     typedef lib::function<void(connection_hdl,message_ptr)> message_handler;
@@ -283,6 +297,27 @@ public:
     /// Type of a pointer to a transport timer handle
     typedef typename transport_con_type::timer_ptr timer_ptr;
 
+    /// Type of the endpoint's registry of open connections
+    typedef connection_registry<type,concurrency_type> registry_type;
+
+    /// Type of the endpoint's memory budget
+    typedef websocketpp::memory_budget<type,concurrency_type>
+        memory_budget_type;
+
+    /// Type of the compression window budget shared with the endpoint
+    typedef extensions::permessage_deflate::window_policy::window_budget
+        window_budget_type;
+
+    /// Type of the metrics policy
+    typedef typename config::metrics_type metrics_type;
+    /// Type of the connection's metrics
+    typedef typename metrics_type::connection_metrics connection_metrics_type;
+
+    /// Type of the tracing policy
+    typedef typename config::trace_type trace_type;
+    /// Type of a span covering a scope
+    typedef typename trace_type::scope trace_scope;
+
     // Misc Convenience Types
     typedef session::internal_state::value istate_type;
 
@@ -317,6 +352,8 @@ public:
       , m_internal_state(session::internal_state::USER_INIT)
       , m_msg_manager(new con_msg_manager_type())
       , m_send_buffer_size(0)
+      , m_write_buffer_capacity(0)
+      , m_write_buffer_used(false)
       , m_write_flag(false)
       , m_read_flag(true)
       , m_is_server(p_is_server)
@@ -328,6 +365,12 @@ public:
       , m_is_http(false)
       , m_http_state(session::http_state::init)
       , m_was_clean(false)
+      , m_inbound_memory(0)
+      , m_compression_memory(0)
+      , m_handshake_memory(0)
+      , m_memory_reported(0)
+      , m_keepalive_activity(false)
+      , m_keepalive_pending(false)
     {
         m_alog.write(log::alevel::devel,"connection constructor");
     }
@@ -574,7 +617,7 @@ public:
      */
     void set_max_message_size(size_t new_value) {
         m_max_message_size = new_value;
-        if (m_processor) {
+        if (m_processor.get()) {
             m_processor->set_max_message_size(new_value);
         }
     }
@@ -636,6 +679,30 @@ public:
         return get_buffered_amount();
     }
 
+    /// Get the memory held by this connection
+    /**
+     * The compression and handshake figures are taken when the connection
+     * opens. The others are current as of the last read or write.
+     *
+     * @since 0.8.0
+     *
+     * @return The connection's memory usage by category
+     */
+    memory_usage get_memory_usage() const;
+
+    /// Get the traffic metrics of this connection
+    /**
+     * What is recorded depends on the config's metrics policy. With the
+     * default policy, metrics::none, nothing is.
+     *
+     * @since 0.8.0
+     *
+     * @return The connection's metrics
+     */
+    connection_metrics_type const & get_metrics() const {
+        return m_metrics;
+    }
+
     ////////////////////
     // Action Methods //
     ////////////////////
@@ -687,6 +754,27 @@ public:
      */
     lib::error_code send(message_ptr msg);
 
+    /// Add a message to the outgoing send queue, sharing its frame
+    /**
+     * Server connections that speak the same protocol version frame an
+     * uncompressed data message identically. The first such connection to
+     * send `msg` frames it and stores the frame in `frames`, and connections
+     * of the same version that send `msg` with the same cache reuse it.
+     * Client connections, which mask every frame, and compressed messages are
+     * framed per connection as with `send(message_ptr)`.
+     *
+     * The cache is not synchronized and must only be used for one message.
+     *
+     * This method invokes the m_write_lock mutex
+     *
+     * @since 0.8.0
+     *
+     * @param msg An unprepared message to send
+     * @param frames The frames of `msg` prepared so far
+     * @return A status code, zero on success
+     */
+    lib::error_code send(message_ptr msg, frame_cache & frames);
+
     /// Asyncronously invoke handler::on_inturrupt
     /**
      * Signals to the connection to asyncronously invoke the on_inturrupt
@@ -1306,6 +1394,9 @@ public:
     void read_frame();
 
     /// Get array of WebSocket protocol versions that this connection supports.
+    /**
+     * The versions enabled by config::processor_versions
+     */
     std::vector<int> const & get_supported_versions() const;
 
     /// Sets the handler for a terminating connection. Should only be used
@@ -1315,6 +1406,9 @@ public:
     void terminate(lib::error_code const & ec);
     void handle_terminate(terminate_status tstat, lib::error_code const & ec);
 
+    /// Terminate a connection whose keepalive ping was not answered
+    void handle_keepalive_timeout();
+
     /// Checks if there are frames in the send queue and if there are sends one
     /**
      * \todo unit tests
@@ -1323,6 +1417,43 @@ public:
      */
     void write_frame();
 
+    /// Append the pending run of the coalescing buffer to the send buffer
+    /**
+     * Adds the bytes of `m_write_buffer` from `run_start` to its end as a
+     * single transport buffer, if there are any, and moves `run_start` to the
+     * end.
+     *
+     * @since 0.8.0
+     *
+     * @param run_start Offset of the first byte not yet in the send buffer
+     */
+    void push_write_run(size_t & run_start);
+
+    /// Get the number of bytes of a frame to copy into the coalescing buffer
+    /**
+     * A frame that is not cached for other connections and fits in the
+     * space left is copied whole. Otherwise its header is copied if it fits
+     * and its payload is sent in place.
+     *
+     * @since 0.8.0
+     *
+     * @param msg The frame to write
+     * @param used The number of bytes already in the coalescing buffer
+     * @return The size of the frame, the size of its header or zero
+     */
+    size_t coalesced_bytes(message_ptr const & msg, size_t used) const;
+
+    /// Release the coalescing buffer if nothing was written since last time
+    /**
+     * Called on each keepalive visit so that connections that stopped
+     * writing do not hold on to the buffer.
+     *
+     * This method locks the m_write_lock mutex
+     *
+     * @since 0.8.0
+     */
+    void release_idle_write_buffer();
+
     /// Process the results of a frame write operation and start the next write
     /**
      * \todo unit tests
@@ -1357,6 +1488,84 @@ public:
         m_connection_hdl = hdl;
         transport_con_type::set_handle(hdl);
     }
+
+    /// Set the keepalive registration of this connection
+    /**
+     * Should only be used internally by the endpoint class. Must be called
+     * before the connection is started.
+     *
+     * @since 0.8.0
+     *
+     * @param lease The lease returned by the endpoint's keepalive scheduler
+     */
+    void set_keepalive_lease(lib::shared_ptr<void> lease) {
+        m_keepalive_lease = lease;
+    }
+
+    /// Set the registry this connection adds itself to when it opens
+    /**
+     * Should only be used internally by the endpoint class. Must be called
+     * before the connection is started.
+     *
+     * @since 0.8.0
+     *
+     * @param registry The endpoint's registry of open connections
+     */
+    void set_registry(lib::shared_ptr<registry_type> registry) {
+        m_registry = registry;
+    }
+
+    /// Set the memory budget this connection reports its usage to
+    /**
+     * Should only be used internally by the endpoint class. Must be called
+     * before the connection is started.
+     *
+     * @since 0.8.0
+     *
+     * @param budget The endpoint's memory budget
+     */
+    void set_memory_budget(lib::shared_ptr<memory_budget_type> budget) {
+        m_memory_budget = budget;
+    }
+
+    /// Set the compression window budget shared with the endpoint
+    /**
+     * Should only be used internally by the endpoint class. Must be called
+     * before the connection is started.
+     *
+     * @since 0.8.0
+     *
+     * @param budget The endpoint's compression window budget
+     */
+    void set_window_budget(lib::shared_ptr<window_budget_type> budget) {
+        m_window_budget = budget;
+    }
+
+    /// Attach the connection's metrics to those of the endpoint
+    /**
+     * Should only be used internally by the endpoint class.
+     *
+     * @since 0.8.0
+     *
+     * @param metrics The endpoint's metrics
+     */
+    void set_metrics(lib::shared_ptr<metrics_type> const & metrics) {
+        m_metrics.attach(metrics);
+    }
+
+    /// Keepalive scheduler visit
+    /**
+     * Called by the endpoint's keepalive scheduler once per keepalive
+     * interval. Skips the connection if data was read since the last visit,
+     * otherwise sends a ping. If a ping was already sent on the last visit
+     * the connection is terminated with error::keepalive_timeout.
+     *
+     * @since 0.8.0
+     *
+     * @param ping A prepared ping frame shared by server connections. Filled
+     * in by the first server connection that needs it.
+     */
+    void handle_keepalive(message_ptr & ping);
 protected:
     void handle_transport_init(lib::error_code const & ec);
 
@@ -1418,17 +1627,46 @@ private:
         close::status::blank, std::string const & reason = std::string(), bool ack = false,
         bool terminal = false);
 
-    /// Get a pointer to a new WebSocket protocol processor for a given version
+    /// Create the WebSocket protocol processor for a given version
     /**
-     * @param version Version number of the WebSocket protocol to get a
+     * @param version Version number of the WebSocket protocol to create a
      * processor for. Negative values indicate invalid/unknown versions and will
-     * always return a null ptr
+     * always fail.
+     *
+     * @return Whether a processor was created. Fails if the version is
+     * unknown or not enabled by config::processor_versions, in which case
+     * m_processor holds no processor.
+     */
+    bool set_processor(int version);
+
+    /// Queue a message and start writing if the connection is idle
+    /**
+     * Shared by both send(message_ptr) overloads.
+     *
+     * This method invokes the m_write_lock mutex
      *
-     * @return A shared_ptr to a new instance of the appropriate processor or a
-     * null ptr if there is no installed processor that matches the version
-     * number.
+     * @param msg The message to send
+     * @param frames The frame cache of `msg`, or NULL to frame it for this
+     * connection only
+     * @return A status code, zero on success
      */
-    processor_ptr get_processor(int version) const;
+    lib::error_code send_message(message_ptr msg, frame_cache * frames);
+
+    /// Get the frame to queue for a message
+    /**
+     * A prepared message is queued as is. Otherwise the frame for this
+     * connection's protocol version is taken from `frames`, or prepared and
+     * added to it.
+     *
+     * Must be called while holding m_write_lock
+     *
+     * @param msg The message to send
+     * @param frames The frame cache of `msg`, or NULL
+     * @param out Set to the frame to queue
+     * @return A status code, zero on success
+     */
+    lib::error_code get_outgoing_message(message_ptr msg, frame_cache * frames,
+        message_ptr & out);
 
     /// Add a message to the write queue
     /**
@@ -1455,6 +1693,23 @@ private:
      */
     message_ptr write_pop();
 
+    /// Start reporting memory usage to the endpoint's memory budget
+    /**
+     * Called when the connection opens. Takes the compression and handshake
+     * figures, which do not change afterwards.
+     */
+    void open_memory_lease();
+
+    /// Report memory usage to the endpoint's memory budget
+    /**
+     * Reports only if usage changed by at least the budget's report
+     * granularity since the last report. If usage went over the budget this
+     * arranges for the budget to be enforced.
+     *
+     * Must be called without holding m_write_lock
+     */
+    void update_memory();
+
     /// Prints information about the incoming connection to the access log
     /**
      * Prints information about the incoming connection to the access log.
@@ -1536,7 +1791,7 @@ private:
      * Serializes access to the write queue as well as shared state within the
      * processor.
      */
-    mutex_type              m_write_lock;
+    mutable mutex_type      m_write_lock;
 
     // connection resources
     char                    m_buf[config::connection_read_buffer_size];
@@ -1559,7 +1814,7 @@ private:
      *
      * Use of the prepare_data_frame method requires lock: m_write_lock
      */
-    processor_ptr           m_processor;
+    processor_holder        m_processor;
 
     /// Queue of unsent outgoing messages
     /**
@@ -1579,6 +1834,28 @@ private:
      */
     std::vector<transport::buffer> m_send_buffer;
 
+    /// Contiguous copy of the small frames in the current write
+    /**
+     * Grown to the bytes coalesced by a write, at most
+     * `config::write_coalesce_size`, and reused by later writes. Released by
+     * a keepalive visit that finds it unused since the previous one.
+     *
+     * Lock m_write_lock
+     */
+    std::string m_write_buffer;
+
+    /// Capacity of m_write_buffer once reserved, for memory accounting
+    /**
+     * Lock: m_write_lock
+     */
+    size_t m_write_buffer_capacity;
+
+    /// Whether m_write_buffer was written since the last keepalive visit
+    /**
+     * Lock: m_write_lock
+     */
+    bool m_write_buffer_used;
+
     /// a list of pointers to hold on to the messages being written to keep them
     /// from going out of scope before the write is complete.
     std::vector<message_ptr> m_current_msgs;
@@ -1642,6 +1919,66 @@ private:
 
     /// Whether or not this endpoint initiated the drop of the TCP connection
     bool                    m_dropped_by_me;
+
+    /// Registration with the endpoint's keepalive scheduler, if any.
+    /// Released when the connection is terminated.
+    lib::shared_ptr<void>   m_keepalive_lease;
+
+    /// Registry of open connections to join when the connection opens, if any
+    lib::shared_ptr<registry_type> m_registry;
+
+    /// Registration with m_registry. Released when the connection is
+    /// terminated.
+    lib::shared_ptr<void>   m_registry_lease;
+
+    /// Memory budget to report to once the connection opens, if any
+    lib::shared_ptr<memory_budget_type> m_memory_budget;
+
+    /// Compression window budget handed to the processor, if any
+    lib::shared_ptr<window_budget_type> m_window_budget;
+
+    /// Registration with m_memory_budget. Released when the connection is
+    /// terminated.
+    /**
+     * Lock: m_memory_lock
+     */
+    lib::shared_ptr<typename memory_budget_type::lease> m_memory_lease;
+
+    /// Payload capacity of partially received messages as of the last read
+    /**
+     * Written by the read path only. Lock: m_write_lock for writes and for
+     * reads outside the read path.
+     */
+    size_t                  m_inbound_memory;
+
+    /// Compression state size, taken when the connection opens
+    size_t                  m_compression_memory;
+
+    /// Handshake request and response size, taken when the connection opens
+    size_t                  m_handshake_memory;
+
+    /// Usage last reported to m_memory_budget
+    /**
+     * Lock: m_memory_lock
+     */
+    size_t                  m_memory_reported;
+    mutex_type              m_memory_lock;
+
+    /// Traffic metrics. The send queue hooks are called with m_write_lock
+    /// held or from the write path.
+    connection_metrics_type m_metrics;
+
+    /// Whether data was read since the last keepalive visit
+    /**
+     * Lock: m_connection_state_lock
+     */
+    bool                    m_keepalive_activity;
+
+    /// Whether a keepalive ping is awaiting a response
+    /**
+     * Lock: m_connection_state_lock
+     */
+    bool                    m_keepalive_pending;
 };
 
 } // namespace websocketpp
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_CONNECTION_REGISTRY_HPP
+#define WEBSOCKETPP_CONNECTION_REGISTRY_HPP
+
+#include <websocketpp/slot_list.hpp>
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+
+#include <vector>
+
+namespace websocketpp {
+
+/// Registry of the open connections of an endpoint
+/**
+ * Keeps a strong reference to every open connection of an endpoint so that
+ * they can be visited without going through connection handles. Connections
+ * are added when they open and removed when they are terminated, both in
+ * constant time.
+ *
+ * Connections are kept in shards, one per transport shard. For the asio
+ * transport a shard is an io_service of the endpoint's pool, or the single
+ * io_service of an endpoint without a pool. Each shard has its own lock and
+ * is normally only touched by the thread that runs its io_service, so adding,
+ * removing and visiting connections does not contend across threads.
+ *
+ * The endpoint clears the registry when it is destroyed to release the
+ * connections that are still open.
+ *
+ * @since 0.8.0
+ */
+template <typename connection, typename concurrency>
+class connection_registry {
+public:
+    /// Type of this registry
+    typedef connection_registry<connection,concurrency> type;
+    /// Type of a shared pointer to this registry
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of the connections being registered
+    typedef connection connection_type;
+    /// Type of a shared pointer to a connection
+    typedef typename connection_type::ptr connection_ptr;
+
+    /// Type of the mutex used to protect a shard
+    typedef typename concurrency::mutex_type mutex_type;
+    /// Type of the lock used to protect a shard
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+
+    /// Type of a function that visits open connections
+    typedef lib::function<void(connection_ptr const &)> visitor;
+
+    /// Construct a registry
+    /**
+     * @param shards The number of shards, at least one
+     */
+    explicit connection_registry(size_t shards) {
+        for (size_t i = 0; i < (shards > 0 ? shards : 1); ++i) {
+            m_shards.push_back(lib::make_shared<shard_type>());
+        }
+    }
+
+    ~connection_registry() {
+        clear();
+    }
+
+    /// Get the number of shards
+    size_t get_shard_count() const {
+        return m_shards.size();
+    }
+
+    /// Get the number of registered connections in a shard
+    size_t size(size_t shard) const {
+        shard_type const & s = *m_shards[shard % m_shards.size()];
+        scoped_lock_type guard(s.lock);
+        return s.entries.size();
+    }
+
+    /// Get the number of registered connections
+    size_t size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            total += size(i);
+        }
+        return total;
+    }
+
+    /// Register a connection
+    /**
+     * @param con The connection to register
+     * @param shard The shard the connection belongs to. Wrapped to the
+     * number of shards.
+     * @return A lease that keeps the connection registered until it is
+     * released
+     */
+    lib::shared_ptr<void> add(connection_ptr con, size_t shard) {
+        shard_ptr const & s = m_shards[shard % m_shards.size()];
+        lib::shared_ptr<lease> l = lib::make_shared<lease>(s);
+
+        scoped_lock_type guard(s->lock);
+        s->entries.push_back(con, l.get());
+        return l;
+    }
+
+    /// Visit every connection of a shard
+    /**
+     * The connections of the shard are copied under the shard lock and the
+     * visitor is called after the lock is released, so it may open, close or
+     * terminate connections of any shard. Connections opened during the
+     * visit are not visited, connections terminated during the visit may
+     * still be.
+     *
+     * @param shard The shard to visit
+     * @param v The function to call with each connection
+     */
+    void visit(size_t shard, visitor const & v) {
+        std::vector<connection_ptr> cons;
+        {
+            shard_type & s = *m_shards[shard % m_shards.size()];
+            scoped_lock_type guard(s.lock);
+            cons.reserve(s.entries.size());
+            for (size_t i = 0; i < s.entries.size(); ++i) {
+                cons.push_back(s.entries[i]);
+            }
+        }
+        for (size_t i = 0; i < cons.size(); ++i) {
+            v(cons[i]);
+        }
+    }
+
+    /// Release every registered connection
+    void clear() {
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            std::vector<connection_ptr> cons;
+            {
+                scoped_lock_type guard(m_shards[i]->lock);
+                m_shards[i]->entries.take(cons);
+            }
+            // Connections are released after the lock is dropped
+        }
+    }
+
+    /// Task that visits one shard of a registry
+    /**
+     * Small enough to be posted as a transport dispatch handler.
+     */
+    class shard_visit {
+    public:
+        shard_visit(ptr registry, size_t shard,
+            lib::shared_ptr<visitor> v)
+          : m_registry(registry)
+          , m_shard(shard)
+          , m_visitor(v) {}
+
+        void operator()() {
+            m_registry->visit(m_shard, *m_visitor);
+        }
+    private:
+        ptr                         m_registry;
+        size_t                      m_shard;
+        lib::shared_ptr<visitor>    m_visitor;
+    };
+private:
+    struct shard_type {
+        /// Unregister the connection of a released lease
+        void release(slot_lease<shard_type> * l) {
+            connection_ptr con;
+            {
+                scoped_lock_type guard(lock);
+                if (!l->is_listed()) {
+                    return;
+                }
+                con = entries[l->get_slot()];
+                entries.erase(*l);
+            }
+            // The connection is released after the lock is dropped
+        }
+
+        mutable mutex_type          lock;
+        slot_list<connection_ptr>   entries;
+    };
+
+    /// Keeps a connection registered in its shard until it is released
+    typedef slot_lease<shard_type> lease;
+    /// Each shard is allocated separately as its mutex cannot be copied and
+    /// leases keep their shard alive
+    typedef lib::shared_ptr<shard_type> shard_ptr;
+
+    std::vector<shard_ptr> m_shards;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CONNECTION_REGISTRY_HPP
@@ -29,6 +29,7 @@
 #define WEBSOCKETPP_ENDPOINT_HPP
 
 #include <websocketpp/connection.hpp>
+#include <websocketpp/keepalive.hpp>
 
 #include <websocketpp/logger/levels.hpp>
 #include <websocketpp/version.hpp>
@@ -79,6 +80,33 @@ public:
     /// Type of our concurrency policy's mutex object
     typedef typename concurrency_type::mutex_type mutex_type;
 
+    /// Type of the keepalive ping scheduler
+    typedef websocketpp::keepalive<connection_type,concurrency_type>
+        keepalive_type;
+
+    /// Type of the registry of open connections
+    typedef typename connection_type::registry_type registry_type;
+    /// Type of a shared pointer to the registry of open connections
+    typedef typename registry_type::ptr registry_ptr;
+    /// Type of a function that visits open connections
+    typedef typename registry_type::visitor open_visitor;
+
+    /// Type of the endpoint's memory budget
+    typedef typename connection_type::memory_budget_type memory_budget_type;
+    /// Type of a shared pointer to the endpoint's memory budget
+    typedef typename memory_budget_type::ptr memory_budget_ptr;
+    /// Type of the handler called when the memory budget is exceeded
+    typedef typename memory_budget_type::pressure_handler
+        memory_pressure_handler;
+
+    /// Type of the compression window budget shared by the connections
+    typedef typename connection_type::window_budget_type window_budget_type;
+    /// Type of a shared pointer to the compression window budget
+    typedef lib::shared_ptr<window_budget_type> window_budget_ptr;
+
+    /// Type of the metrics policy
+    typedef typename connection_type::metrics_type metrics_type;
+
     /// Type of RNG
     typedef typename config::rng_type rng_type;
 
@@ -98,6 +126,8 @@ public:
       , m_max_message_size(config::max_message_size)
       , m_max_http_body_size(config::max_http_body_size)
       , m_is_server(p_is_server)
+      , m_keepalive(lib::make_shared<keepalive_type>())
+      , m_metrics(lib::make_shared<metrics_type>())
     {
         m_alog.set_channels(config::alog_level);
         m_elog.set_channels(config::elog_level);
@@ -109,7 +139,12 @@ public:
 
 
     /// Destructor
-    ~endpoint<connection,config>() {}
+    ~endpoint<connection,config>() {
+        m_keepalive->stop();
+        if (m_registry) {
+            m_registry->clear();
+        }
+    }
 
     #ifdef _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
         // no copy constructor because endpoints are not copyable
@@ -147,6 +182,13 @@ public:
 
          , m_rng(std::move(o.m_rng))
          , m_is_server(o.m_is_server)         
+         // The keepalive scheduler refers to the endpoint it was configured
+         // on so it is not moved.
+         , m_keepalive(lib::make_shared<keepalive_type>())
+         , m_registry(std::move(o.m_registry))
+         , m_memory_budget(std::move(o.m_memory_budget))
+         , m_window_budget(std::move(o.m_window_budget))
+         , m_metrics(std::move(o.m_metrics))
         {}
 
     #ifdef _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
@@ -401,6 +443,235 @@ public:
         m_pong_timeout_dur = dur;
     }
 
+    /// Set keepalive interval
+    /**
+     * Enables automatic keepalive pings for connections created after the
+     * call. The endpoint visits every open connection once per interval using
+     * a single endpoint timer. Connections that received data since the
+     * previous visit are skipped, idle connections are sent a ping and a
+     * connection that is still idle on the visit after its ping is terminated
+     * with error::keepalive_timeout. Visits are spread evenly across the
+     * interval.
+     *
+     * Keepalive pings do not use the pong timeout or call the pong timeout
+     * handler. Pongs are reported to the pong handler as usual.
+     *
+     * The transport in use must support endpoint timers. A value of 0, the
+     * default, disables keepalive pings.
+     *
+     * @since 0.8.0
+     *
+     * @param interval The keepalive interval in ms
+     */
+    void set_keepalive_interval(long interval) {
+        m_keepalive->set_interval(interval, lib::bind(
+            &type::schedule_keepalive,
+            this,
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+    }
+
+    /// Get keepalive interval
+    /**
+     * @since 0.8.0
+     *
+     * @return The keepalive interval in ms, zero if disabled
+     */
+    long get_keepalive_interval() const {
+        return m_keepalive->get_interval();
+    }
+
+    /// Enable or disable the registry of open connections
+    /**
+     * When enabled, connections created after the call are added to a
+     * registry when they open and removed when they are terminated. The
+     * registry is sharded the same way as the transport, for the asio
+     * transport one shard per io_service, so it should be enabled after the
+     * transport has been initialized.
+     *
+     * The registry holds a strong reference to each open connection. This
+     * lets `for_each_open` reach every connection without connection handles
+     * or an application level list and lock.
+     *
+     * Disabling the registry does not unregister connections that are
+     * already open.
+     *
+     * @since 0.8.0
+     *
+     * @param value Whether or not to keep a registry of open connections
+     */
+    void set_connection_registry(bool value) {
+        scoped_lock_type guard(m_mutex);
+        if (!value) {
+            m_registry.reset();
+        } else if (!m_registry) {
+            m_registry = lib::make_shared<registry_type>(
+                transport_type::get_shard_count());
+        }
+    }
+
+    /// Get the registry of open connections
+    /**
+     * @since 0.8.0
+     *
+     * @return A pointer to the registry, empty if the registry is disabled
+     */
+    registry_ptr get_connection_registry() const {
+        scoped_lock_type guard(m_mutex);
+        return m_registry;
+    }
+
+    /// Call a function for every open connection
+    /**
+     * Each shard of the registry of open connections is visited by a task
+     * posted to the transport thread that owns it, so the visitor runs on the
+     * connection's own thread and shards are visited in parallel. The call
+     * returns before the visits take place. Does nothing if the registry is
+     * disabled.
+     *
+     * The visitor is called without any registry lock held, so it may send
+     * messages, close or terminate connections and open new ones.
+     *
+     * @since 0.8.0
+     *
+     * @param visitor The function to call with each open connection
+     */
+    void for_each_open(open_visitor visitor) {
+        registry_ptr registry = get_connection_registry();
+        if (!registry) {
+            return;
+        }
+
+        lib::shared_ptr<open_visitor> v = lib::make_shared<open_visitor>(
+            visitor);
+        for (size_t i = 0; i < registry->get_shard_count(); ++i) {
+            transport_type::post_to_shard(i,
+                typename registry_type::shard_visit(registry, i, v));
+        }
+    }
+
+    /// Enable memory accounting and set the memory budget
+    /**
+     * Connections created after the first call report the memory they hold,
+     * broken down as in connection::get_memory_usage, to an endpoint wide
+     * account while they are open. With a nonzero budget the policy, a
+     * bitmask of memory_policy values, decides what happens once the total
+     * passes it: `refuse` answers new opening handshakes with 503 Service
+     * Unavailable, `shrink` opens new connections without compression once
+     * three quarters of the budget are used and `close` closes the
+     * connections holding the most memory with status try_again_later.
+     *
+     * A budget of zero enables accounting without limiting memory. Without
+     * any call connections do no accounting at all.
+     *
+     * @since 0.8.0
+     *
+     * @param bytes The budget in bytes, zero for unlimited
+     * @param policy The actions to take when the budget is exceeded
+     */
+    void set_memory_budget(size_t bytes, int policy = memory_policy::all) {
+        get_or_create_memory_budget()->set_budget(bytes, policy);
+    }
+
+    /// Set the handler called when the memory budget is exceeded
+    /**
+     * The handler is called with the current usage each time the total goes
+     * over the budget, after the policy has been applied. It may be called
+     * from any transport thread. Enables memory accounting.
+     *
+     * @since 0.8.0
+     *
+     * @param h The handler to call
+     */
+    void set_memory_pressure_handler(memory_pressure_handler h) {
+        get_or_create_memory_budget()->set_pressure_handler(h);
+    }
+
+    /// Get the endpoint's memory budget
+    /**
+     * @since 0.8.0
+     *
+     * @return A pointer to the memory budget, empty if memory accounting is
+     * not enabled
+     */
+    memory_budget_ptr get_memory_budget() const {
+        scoped_lock_type guard(m_mutex);
+        return m_memory_budget;
+    }
+
+    /// Get the memory held by open connections and the budget counters
+    /**
+     * @since 0.8.0
+     *
+     * @return The current usage. All zero if memory accounting is not
+     * enabled.
+     */
+    memory_budget_stats get_memory_stats() const {
+        memory_budget_ptr budget = get_memory_budget();
+        if (!budget) {
+            return memory_budget_stats();
+        }
+        return budget->get_stats();
+    }
+
+    /// Set the compression window budget of this endpoint's connections
+    /**
+     * Connections created after the first call share a budget for the
+     * estimated memory of their compression state, used by the
+     * permessage-deflate `window_policy::memory_budget` policy to shrink the
+     * windows it negotiates as the budget fills up. Without any call those
+     * connections are negotiated with the extension's static settings. Other
+     * window policies ignore the budget.
+     *
+     * This budget only steers negotiation. The endpoint memory budget, see
+     * set_memory_budget, counts the same memory as part of each connection's
+     * total.
+     *
+     * @since 0.8.0
+     *
+     * @param bytes The budget in bytes, zero for unlimited
+     */
+    void set_compression_window_budget(size_t bytes) {
+        scoped_lock_type guard(m_mutex);
+        if (!m_window_budget) {
+            m_window_budget = lib::make_shared<window_budget_type>();
+        }
+        m_window_budget->set_budget(bytes);
+    }
+
+    /// Get the compression memory counted against the window budget
+    /**
+     * @since 0.8.0
+     *
+     * @return The current usage. All zero if set_compression_window_budget
+     * was never called.
+     */
+    extensions::permessage_deflate::window_policy::memory_usage
+        get_compression_window_usage() const
+    {
+        window_budget_ptr budget = get_window_budget();
+        if (!budget) {
+            return extensions::permessage_deflate::window_policy::
+                memory_usage();
+        }
+        return budget->get_usage();
+    }
+
+    /// Get the endpoint wide traffic metrics
+    /**
+     * What is recorded depends on the config's metrics policy. With the
+     * default policy, metrics::none, nothing is. metrics::basic counts the
+     * traffic of all connections and keeps latency histograms.
+     *
+     * @since 0.8.0
+     *
+     * @return The endpoint's metrics
+     */
+    metrics_type const & get_metrics() const {
+        return *m_metrics;
+    }
+
     /// Get default maximum message size
     /**
      * Get the default maximum message size that will be used for new 
@@ -661,6 +932,37 @@ public:
 protected:
     connection_ptr create_connection();
 
+    /// Get the compression window budget, empty if none was set
+    window_budget_ptr get_window_budget() const {
+        scoped_lock_type guard(m_mutex);
+        return m_window_budget;
+    }
+
+    /// Get the memory budget, creating it if accounting is not enabled yet
+    memory_budget_ptr get_or_create_memory_budget() {
+        scoped_lock_type guard(m_mutex);
+        if (!m_memory_budget) {
+            m_memory_budget = lib::make_shared<memory_budget_type>();
+        }
+        return m_memory_budget;
+    }
+
+    /// Schedule a keepalive scheduler tick on the transport's timer
+    typename keepalive_type::cancel_function schedule_keepalive(long duration,
+        typename keepalive_type::tick_handler handler)
+    {
+        typedef typename transport_type::timer_ptr timer_ptr;
+        timer_ptr timer = transport_type::set_timer(duration, handler);
+        return lib::bind(&type::template cancel_keepalive<timer_ptr>, timer);
+    }
+
+    template <typename timer_ptr>
+    static void cancel_keepalive(timer_ptr timer) {
+        if (timer) {
+            timer->cancel();
+        }
+    }
+
     alog_type m_alog;
     elog_type m_elog;
 private:
@@ -689,6 +991,21 @@ private:
     // static settings
     bool const                  m_is_server;
 
+    // keepalive ping scheduler
+    lib::shared_ptr<keepalive_type> m_keepalive;
+
+    // registry of open connections, empty if disabled
+    registry_ptr                m_registry;
+
+    // memory accounting, empty if disabled
+    memory_budget_ptr           m_memory_budget;
+
+    // compression window budget, empty if not set
+    window_budget_ptr           m_window_budget;
+
+    // traffic metrics shared with the connections
+    lib::shared_ptr<metrics_type> m_metrics;
+
     // endpoint state
     mutable mutex_type          m_mutex;
 };
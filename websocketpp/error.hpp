@@ -143,7 +143,16 @@ enum value {
     http_parse_error,
     
     /// Extension negotiation failed
-    extension_neg_failed
+    extension_neg_failed,
+
+    /// A keepalive ping was not answered within the keepalive interval
+    keepalive_timeout,
+
+    /// A client pool has no open connection to the requested URI
+    no_pooled_connection,
+
+    /// The endpoint's memory budget is exhausted
+    memory_budget_exceeded
 }; // enum value
 
 
@@ -221,6 +230,12 @@ public:
                 return "HTTP parse error";
             case error::extension_neg_failed:
                 return "Extension negotiation failed";
+            case error::keepalive_timeout:
+                return "The keepalive ping timed out";
+            case error::no_pooled_connection:
+                return "No pooled connection is open";
+            case error::memory_budget_exceeded:
+                return "The memory budget is exceeded";
             default:
                 return "Unknown";
         }
@@ -55,7 +55,10 @@ enum value {
     general = 1,
 
     /// Extension disabled
-    disabled
+    disabled,
+
+    /// Extension output exceeds the allowed maximum message size
+    message_too_big
 };
 
 class category : public lib::error_category {
@@ -72,6 +75,8 @@ public:
                 return "Generic extension error";
             case disabled:
                 return "Use of methods from disabled extension";
+            case message_too_big:
+                return "Extension output exceeds the maximum message size";
             default:
                 return "Unknown permessage-compress error";
         }
@@ -33,6 +33,7 @@
 
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/extensions/extension.hpp>
+#include <websocketpp/extensions/permessage_deflate/window_policy.hpp>
 
 #include <map>
 #include <string>
@@ -88,6 +89,15 @@ public:
         return false;
     }
 
+    /// Returns the memory held by the compression state, always zero
+    size_t get_memory_usage() const {
+        return 0;
+    }
+
+    /// Share a compression memory budget, a no-op for the disabled extension
+    void set_window_budget(
+        lib::shared_ptr<window_policy::window_budget> const &) {}
+
     /// Generate extension offer
     /**
      * Creates an offer string to include in the Sec-WebSocket-Extensions
@@ -114,9 +124,12 @@ public:
      * @param buf Byte buffer to decompress
      * @param len Length of buf
      * @param out String to append decompressed bytes to
+     * @param max_size The maximum size `out` may reach
      * @return Error or status code
      */
-    lib::error_code decompress(uint8_t const *, size_t, std::string &) {
+    lib::error_code decompress(uint8_t const *, size_t, std::string &,
+        size_t = 0)
+    {
         return make_error_code(error::disabled);
     }
 };
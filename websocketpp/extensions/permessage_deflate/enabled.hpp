@@ -36,10 +36,12 @@
 #include <websocketpp/error.hpp>
 
 #include <websocketpp/extensions/extension.hpp>
+#include <websocketpp/extensions/permessage_deflate/window_policy.hpp>
 
 #include "zlib.h"
 
 #include <algorithm>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -73,7 +75,8 @@ namespace extensions {
  *
  * **negotiate**\n
  * `err_str_pair negotiate(http::attribute_list const & attributes)`\n
- * Negotiate the parameters of extension use
+ * Negotiate the parameters of extension use. Results are passed through the
+ * window policy before the response is generated.
  *
  * **compress**\n
  * `lib::error_code compress(std::string const & in, std::string & out)`\n
@@ -81,8 +84,9 @@ namespace extensions {
  *
  * **decompress**\n
  * `lib::error_code decompress(uint8_t const * buf, size_t len, std::string &
- * out)`\n
- * Decompress `len` bytes from `buf` and append them to string `out`
+ * out, size_t max_size)`\n
+ * Decompress `len` bytes from `buf` and append them to string `out`. Fails
+ * with `message_too_big` as soon as `out` would grow beyond `max_size` bytes.
  */
 namespace permessage_deflate {
 
@@ -188,6 +192,9 @@ static uint8_t const min_client_max_window_bits = 8;
 /// Maximum value for client_max_window_bits as defined by draft 17
 static uint8_t const max_client_max_window_bits = 15;
 
+/// Inflate ratio assumed before any input has been decompressed
+static double const default_inflate_ratio = 3.0;
+
 namespace mode {
 enum value {
     /// Accept any value the remote endpoint offers
@@ -201,7 +208,13 @@ enum value {
 };
 } // namespace mode
 
-template <typename config>
+/// Permessage-deflate extension state for one connection
+/**
+ * The window_policy_type parameter selects a policy that may adjust server
+ * side negotiation results at runtime. See the window_policy namespace for
+ * the interface and the bundled policies.
+ */
+template <typename config, typename window_policy_type = window_policy::fixed>
 class enabled {
 public:
     enabled()
@@ -213,7 +226,9 @@ public:
       , m_server_max_window_bits_mode(mode::accept)
       , m_client_max_window_bits_mode(mode::accept)
       , m_initialized(false)
-      , m_compress_buffer_size(16384)
+      , m_compress_buffer_size(window_policy::compress_buffer_size)
+      , m_memory(0)
+      , m_inflate_ratio(default_inflate_ratio)
     {
         m_dstate.zalloc = Z_NULL;
         m_dstate.zfree = Z_NULL;
@@ -274,7 +289,7 @@ public:
             Z_DEFAULT_COMPRESSION,
             Z_DEFLATED,
             -1*deflate_bits,
-            4, // memory level 1-9
+            window_policy::deflate_mem_level,
             Z_DEFAULT_STRATEGY
         );
 
@@ -299,6 +314,11 @@ public:
         } else {
             m_flush = Z_SYNC_FLUSH;
         }
+
+        m_memory = window_policy::estimate_memory(deflate_bits, inflate_bits,
+            m_compress_buffer_size);
+        m_window_policy.reserve(m_memory);
+
         m_initialized = true;
         return lib::error_code();
     }
@@ -324,6 +344,30 @@ public:
         return m_enabled;
     }
 
+    /// Get the estimated memory held by the compression state
+    /**
+     * @since 0.8.0
+     *
+     * @return The estimated number of bytes, zero before init
+     */
+    size_t get_memory_usage() const {
+        return m_memory;
+    }
+
+    /// Share a compression memory budget with other connections
+    /**
+     * Passed on to the window policy. Must be called before negotiation.
+     *
+     * @since 0.8.0
+     *
+     * @param budget The budget of the connection's endpoint
+     */
+    void set_window_budget(
+        lib::shared_ptr<window_policy::window_budget> const & budget)
+    {
+        m_window_policy.attach(budget);
+    }
+
     /// Reset server's outgoing LZ77 sliding window for each new message
     /**
      * Enabling this setting will cause the server's compressor to reset the
@@ -487,6 +531,8 @@ public:
         }
 
         if (ret.first == lib::error_code()) {
+            apply_window_policy(offer.find("client_max_window_bits") !=
+                offer.end());
             m_enabled = true;
             ret.second = generate_response();
         }
@@ -536,25 +582,54 @@ public:
 
     /// Decompress bytes
     /**
+     * Output size is checked as inflation proceeds. Decompression stops and
+     * `message_too_big` is returned as soon as `out` would grow past
+     * `max_size` bytes, so a small compressed frame cannot expand into an
+     * arbitrarily large allocation. `out` never grows past `max_size`.
+     *
+     * Output space in `out` is reserved up front from a running estimate of
+     * the inflate ratio seen on this connection rather than grown one chunk
+     * at a time.
+     *
      * @param buf Byte buffer to decompress
      * @param len Length of buf
      * @param out String to append decompressed bytes to
+     * @param max_size The maximum size `out` may reach
      * @return Error or status code
      */
     lib::error_code decompress(uint8_t const * buf, size_t len, std::string &
-        out)
+        out, size_t max_size = (std::numeric_limits<size_t>::max)())
     {
         if (!m_initialized) {
             return make_error_code(error::uninitialized);
         }
 
+        size_t const start = out.size();
+        if (start > max_size) {
+            return extensions::error::make_error_code(
+                extensions::error::message_too_big);
+        }
+        size_t const allowance = max_size - start;
+
+        reserve_inflate_output(out, len, allowance);
+
         int ret;
+        size_t written = 0;
+        size_t room;
 
         m_istate.avail_in = len;
         m_istate.next_in = const_cast<unsigned char *>(buf);
 
         do {
-            m_istate.avail_out = m_compress_buffer_size;
+            // Never offer zlib more than one byte past the allowance. If that
+            // byte gets used the limit has been exceeded and we stop without
+            // inflating any further.
+            room = m_compress_buffer_size;
+            if (allowance - written < room) {
+                room = allowance - written + 1;
+            }
+
+            m_istate.avail_out = static_cast<uInt>(room);
             m_istate.next_out = m_compress_buffer.get();
 
             ret = inflate(&m_istate, Z_SYNC_FLUSH);
@@ -563,15 +638,115 @@ public:
                 return make_error_code(error::zlib_error);
             }
 
+            size_t output = room - m_istate.avail_out;
+
+            if (output > allowance - written) {
+                return extensions::error::make_error_code(
+                    extensions::error::message_too_big);
+            }
+
             out.append(
                 reinterpret_cast<char *>(m_compress_buffer.get()),
-                m_compress_buffer_size - m_istate.avail_out
+                output
             );
+            written += output;
         } while (m_istate.avail_out == 0);
 
+        update_inflate_ratio(len, written);
+
         return lib::error_code();
     }
 private:
+    /// Let the window policy adjust the negotiated settings
+    /**
+     * The policy may only reduce window sizes or add no_context_takeover
+     * attributes. Any attempt to relax the negotiated settings is ignored.
+     *
+     * @param client_bits_offered Whether the client offered
+     * client_max_window_bits
+     */
+    void apply_window_policy(bool client_bits_offered) {
+        window_policy::window_settings s;
+        s.server_max_window_bits = m_server_max_window_bits;
+        s.client_max_window_bits = m_client_max_window_bits;
+        s.client_max_window_bits_offered = client_bits_offered;
+        s.server_no_context_takeover = m_server_no_context_takeover;
+        s.client_no_context_takeover = m_client_no_context_takeover;
+
+        m_window_policy.adjust(s);
+
+        if (s.server_max_window_bits >= min_server_max_window_bits) {
+            m_server_max_window_bits = (std::min)(m_server_max_window_bits,
+                s.server_max_window_bits);
+        }
+        if (client_bits_offered &&
+            s.client_max_window_bits >= min_client_max_window_bits)
+        {
+            m_client_max_window_bits = (std::min)(m_client_max_window_bits,
+                s.client_max_window_bits);
+        }
+        m_server_no_context_takeover = m_server_no_context_takeover ||
+            s.server_no_context_takeover;
+        m_client_no_context_takeover = m_client_no_context_takeover ||
+            s.client_no_context_takeover;
+    }
+
+    /// Reserve space in the output string for an inflate operation
+    /**
+     * Estimates the decompressed size of `len` input bytes from the running
+     * inflate ratio and grows the capacity of `out` once to fit it. The
+     * estimate is capped at `allowance`, and so is the doubling used to
+     * amortize growth across frames.
+     *
+     * @param out The string that decompressed bytes will be appended to
+     * @param len The number of compressed input bytes
+     * @param allowance The number of bytes `out` may still grow by
+     */
+    void reserve_inflate_output(std::string & out, size_t len,
+        size_t allowance)
+    {
+        double estimate = m_inflate_ratio * static_cast<double>(len);
+        size_t bytes = allowance;
+
+        if (estimate < static_cast<double>(allowance)) {
+            bytes = static_cast<size_t>(estimate);
+        }
+
+        size_t needed = out.size() + bytes;
+        if (needed > out.capacity()) {
+            size_t const limit = out.size() + allowance;
+            size_t grown = limit;
+            if (out.capacity() < limit / 2) {
+                grown = out.capacity() * 2;
+            }
+
+            // Some standard libraries round a reservation up to twice the
+            // old capacity, so grow into a fresh string reserved to the exact
+            // size to keep the cap.
+            std::string grown_out;
+            grown_out.reserve((std::max)(needed, grown));
+            grown_out.append(out);
+            out.swap(grown_out);
+        }
+    }
+
+    /// Fold an observed inflate ratio into the running estimate
+    /**
+     * Inputs no larger than the deflate trailer are ignored as they say
+     * nothing useful about the ratio of the stream.
+     *
+     * @param in The number of compressed bytes consumed
+     * @param out The number of decompressed bytes produced
+     */
+    void update_inflate_ratio(size_t in, size_t out) {
+        if (in <= 4) {
+            return;
+        }
+
+        double observed = static_cast<double>(out) / static_cast<double>(in);
+        m_inflate_ratio = (m_inflate_ratio * 7 + observed) / 8;
+    }
+
     /// Generate negotiation response
     /**
      * @return Generate extension negotiation reponse string to send to client
@@ -740,9 +915,12 @@ private:
     bool m_initialized;
     int m_flush;
     size_t m_compress_buffer_size;
+    size_t m_memory;
     lib::unique_ptr_uchar_array m_compress_buffer;
+    double m_inflate_ratio;
     z_stream m_dstate;
     z_stream m_istate;
+    window_policy_type m_window_policy;
 };
 
 } // namespace permessage_deflate
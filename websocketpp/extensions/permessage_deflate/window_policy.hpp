@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_WINDOW_POLICY_HPP
+#define WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_WINDOW_POLICY_HPP
+
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+namespace extensions {
+namespace permessage_deflate {
+
+/// Window negotiation policies
+/**
+ * A window policy is consulted by a server's permessage-deflate extension
+ * after the client's offer has been validated against the static settings
+ * and before the negotiation response is generated. It may reduce window
+ * sizes or add no_context_takeover attributes based on live conditions.
+ *
+ * ### window policy interface
+ *
+ * **adjust**\n
+ * `void adjust(window_settings & settings)`\n
+ * Called once per server side negotiation. Changes that would increase a
+ * window size or remove a no_context_takeover attribute are ignored.
+ *
+ * **reserve**\n
+ * `void reserve(size_t bytes)`\n
+ * Called after the compression state has been allocated with the number of
+ * bytes it is estimated to use. Replaces any previous reservation made by
+ * the same policy object.
+ *
+ * **attach**\n
+ * `void attach(lib::shared_ptr<window_budget> const & budget)`\n
+ * Called before negotiation with the budget of the endpoint that owns the
+ * connection, if the endpoint has one. Policies that do not share state
+ * ignore it.
+ *
+ * A policy object is owned by and destroyed with the extension state of its
+ * connection.
+ */
+namespace window_policy {
+
+/// Negotiated values that a window policy may adjust
+struct window_settings {
+    /// LZ77 window bits the server will compress with
+    uint8_t server_max_window_bits;
+    /// LZ77 window bits the client will compress with
+    uint8_t client_max_window_bits;
+    /// Whether the client offered client_max_window_bits
+    /**
+     * If the client did not offer this attribute the server may not limit
+     * the client's window and changes to client_max_window_bits are ignored.
+     */
+    bool client_max_window_bits_offered;
+    /// Whether the server will reset its compression context per message
+    bool server_no_context_takeover;
+    /// Whether the client will reset its compression context per message
+    bool client_no_context_takeover;
+};
+
+/// Snapshot of compression memory use shared by a group of connections
+struct memory_usage {
+    /// Estimated bytes held by compression state
+    size_t bytes_in_use;
+    /// Number of connections holding compression state
+    size_t connections;
+    /// Configured budget in bytes. Zero means unlimited.
+    size_t budget;
+};
+
+/// Compression memory budget shared by a group of connections
+/**
+ * Endpoints own one of these when `set_compression_window_budget` has been
+ * called and attach it to the window policy of each of their connections.
+ * Counts the estimated memory of the compression state of the connections
+ * whose policy reserves against it.
+ *
+ * @since 0.8.0
+ */
+class window_budget {
+public:
+    window_budget() : m_bytes_in_use(0), m_connections(0), m_budget(0) {}
+
+    /// Set the budget in bytes. Zero means unlimited.
+    void set_budget(size_t bytes) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_budget = bytes;
+    }
+
+    /// Retrieve a snapshot of the memory usage
+    memory_usage get_usage() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+
+        memory_usage ret;
+        ret.bytes_in_use = m_bytes_in_use;
+        ret.connections = m_connections;
+        ret.budget = m_budget;
+        return ret;
+    }
+private:
+    friend class memory_budget;
+
+    mutable lib::mutex m_lock;
+    size_t m_bytes_in_use;
+    size_t m_connections;
+    size_t m_budget;
+};
+
+/// zlib memLevel used by the permessage-deflate extension
+static int const deflate_mem_level = 4;
+
+/// Size of the permessage-deflate extension's scratch buffer
+static size_t const compress_buffer_size = 16384;
+
+/// Smallest window that the memory budget policy will negotiate
+/**
+ * Recent versions of zlib do not support raw deflate streams with an 8 bit
+ * window so 9 is used as the floor.
+ */
+static uint8_t const min_policy_window_bits = 9;
+
+/// Estimate the memory used by one connection's compression state
+/**
+ * Based on the zlib memory usage formulas for deflate and inflate plus the
+ * extension's own scratch buffer.
+ *
+ * @param deflate_bits The window bits of the compressor
+ * @param inflate_bits The window bits of the decompressor
+ * @param buffer_size The size of the extension's scratch buffer
+ * @return The estimated number of bytes
+ */
+inline size_t estimate_memory(uint8_t deflate_bits, uint8_t inflate_bits,
+    size_t buffer_size)
+{
+    size_t deflate_bytes = (size_t(1) << (deflate_bits + 2))
+        + (size_t(1) << (deflate_mem_level + 9));
+    size_t inflate_bytes = (size_t(1) << inflate_bits) + 7168;
+
+    return deflate_bytes + inflate_bytes + buffer_size;
+}
+
+/// Window policy that leaves the static settings untouched
+/**
+ * This is the default policy. Every connection is negotiated using only the
+ * values set via `set_server_max_window_bits`,
+ * `enable_server_no_context_takeover` and friends.
+ */
+class fixed {
+public:
+    void adjust(window_settings &) {}
+    void reserve(size_t) {}
+    void attach(lib::shared_ptr<window_budget> const &) {}
+};
+
+/// Window policy that shrinks windows as a shared memory budget fills up
+/**
+ * Connections using this policy share the window_budget attached by their
+ * endpoint, so each endpoint has its own budget. Connections without an
+ * attached budget, such as extensions used on their own, are negotiated
+ * with the static settings unchanged.
+ *
+ * While the estimated compression memory in use stays below three quarters
+ * of the budget new connections are negotiated normally. Above that mark
+ * what is left of the budget is shared between the connections already
+ * holding compression state and the new one, and the policy picks the
+ * largest windows that fit in that share, down to `min_policy_window_bits`.
+ * If even the smallest windows would exceed the full budget it also asks
+ * both sides for no_context_takeover so that peers may release their own
+ * compression context between messages.
+ *
+ * Compression is never refused; connections negotiated while the budget is
+ * exhausted still reserve the smallest window size.
+ *
+ * A budget of zero, the default, disables the policy.
+ *
+ * The budget only counts compression state. An endpoint memory budget, see
+ * `endpoint::set_memory_budget`, accounts for the same memory as part of
+ * each connection's total.
+ */
+class memory_budget {
+public:
+    memory_budget() : m_reserved(0), m_counted(false) {}
+
+    ~memory_budget() {
+        if (!m_counted) {
+            return;
+        }
+
+        lib::lock_guard<lib::mutex> lock(m_budget->m_lock);
+        m_budget->m_bytes_in_use -= m_reserved;
+        --m_budget->m_connections;
+    }
+
+    /// Share the given budget
+    /**
+     * Ignored once this policy has reserved memory.
+     *
+     * @param budget The budget to share, usually the endpoint's
+     */
+    void attach(lib::shared_ptr<window_budget> const & budget) {
+        if (!m_counted) {
+            m_budget = budget;
+        }
+    }
+
+    /// Adjust negotiated settings based on the current memory usage
+    /**
+     * Also reserves the estimated memory for the chosen settings so that a
+     * burst of concurrent handshakes sees each other's usage.
+     *
+     * @param settings The settings to adjust
+     */
+    void adjust(window_settings & settings) {
+        if (!m_budget) {
+            return;
+        }
+
+        lib::lock_guard<lib::mutex> lock(m_budget->m_lock);
+
+        if (m_budget->m_budget != 0) {
+            shrink(settings, m_budget->m_bytes_in_use,
+                m_budget->m_connections, m_budget->m_budget);
+        }
+
+        reserve_locked(cost(settings));
+    }
+
+    /// Record the memory used by this connection's compression state
+    /**
+     * @param bytes The estimated number of bytes in use
+     */
+    void reserve(size_t bytes) {
+        if (!m_budget) {
+            return;
+        }
+
+        lib::lock_guard<lib::mutex> lock(m_budget->m_lock);
+        reserve_locked(bytes);
+    }
+private:
+    static size_t cost(window_settings const & settings) {
+        uint8_t inflate_bits = settings.client_max_window_bits_offered ?
+            settings.client_max_window_bits : 15;
+        return estimate_memory(settings.server_max_window_bits, inflate_bits,
+            compress_buffer_size);
+    }
+
+    /// Reduce window sizes once usage passes the soft limit
+    /**
+     * The soft limit is three quarters of the budget. Past it the windows
+     * are reduced until they fit in an equal share of the remaining budget
+     * between the connections already counted and the new one. If the
+     * smallest windows still do not fit within the full budget
+     * no_context_takeover is requested for both directions as well.
+     */
+    static void shrink(window_settings & settings, size_t in_use,
+        size_t connections, size_t budget)
+    {
+        size_t soft_limit = budget / 4 * 3;
+        if (in_use + cost(settings) <= soft_limit) {
+            return;
+        }
+
+        size_t left = budget > in_use ? budget - in_use : 0;
+        size_t share = left / (connections + 1);
+
+        while (cost(settings) > share) {
+            bool changed = false;
+
+            if (settings.server_max_window_bits > min_policy_window_bits) {
+                --settings.server_max_window_bits;
+                changed = true;
+            }
+            if (settings.client_max_window_bits_offered &&
+                settings.client_max_window_bits > min_policy_window_bits)
+            {
+                --settings.client_max_window_bits;
+                changed = true;
+            }
+
+            if (!changed) {
+                break;
+            }
+        }
+
+        if (in_use + cost(settings) > budget) {
+            settings.server_no_context_takeover = true;
+            settings.client_no_context_takeover = true;
+        }
+    }
+
+    /// Requires the budget's lock
+    void reserve_locked(size_t bytes) {
+        m_budget->m_bytes_in_use -= m_reserved;
+        m_budget->m_bytes_in_use += bytes;
+        m_reserved = bytes;
+
+        if (!m_counted) {
+            ++m_budget->m_connections;
+            m_counted = true;
+        }
+    }
+
+    /// Budget attached by the endpoint, empty if there is none
+    lib::shared_ptr<window_budget> m_budget;
+    size_t m_reserved;
+    bool m_counted;
+};
+
+} // namespace window_policy
+} // namespace permessage_deflate
+} // namespace extensions
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_WINDOW_POLICY_HPP
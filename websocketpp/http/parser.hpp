@@ -496,6 +496,22 @@ public:
         return m_body;
     }
 
+    /// Get the approximate memory held by the version, headers and body
+    /**
+     * @since 0.8.0
+     *
+     * @return The capacity of the strings holding them in bytes
+     */
+    size_t get_memory_usage() const {
+        size_t bytes = m_version.capacity() + m_body.capacity();
+        for (header_list::const_iterator it = m_headers.begin();
+             it != m_headers.end(); ++it)
+        {
+            bytes += it->first.capacity() + it->second.capacity();
+        }
+        return bytes;
+    }
+
     /// Set body content
     /**
      * Set the body content of the HTTP response to the parameter string. Note
@@ -28,10 +28,7 @@
 #ifndef WEBSOCKETPP_CONNECTION_IMPL_HPP
 #define WEBSOCKETPP_CONNECTION_IMPL_HPP
 
-#include <websocketpp/processors/hybi00.hpp>
-#include <websocketpp/processors/hybi07.hpp>
-#include <websocketpp/processors/hybi08.hpp>
-#include <websocketpp/processors/hybi13.hpp>
+#include <websocketpp/processors/holder.hpp>
 
 #include <websocketpp/processors/processor.hpp>
 
@@ -73,6 +70,20 @@ size_t connection<config>::get_buffered_amount() const {
     return m_send_buffer_size;
 }
 
+template <typename config>
+memory_usage connection<config>::get_memory_usage() const {
+    memory_usage usage;
+    usage.read_buffer = config::connection_read_buffer_size;
+    {
+        scoped_lock_type lock(m_write_lock);
+        usage.send_queue = m_send_buffer_size + m_write_buffer_capacity;
+        usage.inbound = m_inbound_memory;
+    }
+    usage.compression = m_compression_memory;
+    usage.handshake = m_handshake_memory;
+    return usage;
+}
+
 template <typename config>
 session::state::value connection<config>::get_state() const {
     //scoped_lock_type lock(m_connection_state_lock);
@@ -103,9 +114,23 @@ lib::error_code connection<config>::send(void const * payload, size_t len,
 template <typename config>
 lib::error_code connection<config>::send(typename config::message_type::ptr msg)
 {
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"connection send");
+    return send_message(msg, NULL);
+}
+
+template <typename config>
+lib::error_code connection<config>::send(message_ptr msg, frame_cache & frames)
+{
+    if (!m_is_server || msg->get_compressed()) {
+        return send_message(msg, NULL);
     }
+    return send_message(msg, &frames);
+}
+
+template <typename config>
+lib::error_code connection<config>::send_message(message_ptr msg,
+    frame_cache * frames)
+{
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "connection send");
 
     {
         scoped_lock_type lock(m_connection_state_lock);
@@ -114,25 +139,13 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
         }
     }
 
-    message_ptr outgoing_msg;
     bool needs_writing = false;
 
-    if (msg->get_prepared()) {
-        outgoing_msg = msg;
-
-        scoped_lock_type lock(m_write_lock);
-        write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
-    } else {
-        outgoing_msg = m_msg_manager->get_message();
-
-        if (!outgoing_msg) {
-            return error::make_error_code(error::no_outgoing_buffers);
-        }
-
+    {
         scoped_lock_type lock(m_write_lock);
-        lib::error_code ec = m_processor->prepare_data_frame(msg,outgoing_msg);
 
+        message_ptr outgoing_msg;
+        lib::error_code ec = get_outgoing_message(msg, frames, outgoing_msg);
         if (ec) {
             return ec;
         }
@@ -141,6 +154,8 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
         needs_writing = !m_write_flag && !m_send_queue.empty();
     }
 
+    update_memory();
+
     if (needs_writing) {
         transport_con_type::dispatch(lib::bind(
             &type::write_frame,
@@ -152,17 +167,54 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
 }
 
 template <typename config>
-void connection<config>::ping(std::string const& payload, lib::error_code& ec) {
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"connection ping");
+lib::error_code connection<config>::get_outgoing_message(message_ptr msg,
+    frame_cache * frames, message_ptr & out)
+{
+    if (msg->get_prepared()) {
+        out = msg;
+        return lib::error_code();
+    }
+
+    int const version = m_processor->get_version();
+    if (frames) {
+        for (size_t i = 0; i < frames->size(); ++i) {
+            if ((*frames)[i].first == version) {
+                out = (*frames)[i].second;
+                return lib::error_code();
+            }
+        }
     }
 
+    out = m_msg_manager->get_message();
+    if (!out) {
+        return error::make_error_code(error::no_outgoing_buffers);
+    }
+
+    lib::error_code ec;
+    {
+        trace_scope trace("processor::prepare_data_frame");
+        ec = m_processor->prepare_data_frame(msg,out);
+    }
+    if (ec) {
+        return ec;
+    }
+
+    if (frames) {
+        out->set_cached(true);
+        frames->push_back(std::make_pair(version,out));
+    }
+    return lib::error_code();
+}
+
+template <typename config>
+void connection<config>::ping(std::string const& payload, lib::error_code& ec) {
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "connection ping");
+
     {
         scoped_lock_type lock(m_connection_state_lock);
         if (m_state != session::state::open) {
-            std::stringstream ss;
-            ss << "connection::ping called from invalid state " << m_state;
-            m_alog.write(log::alevel::devel,ss.str());
+            _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+                "connection::ping called from invalid state " << m_state);
             ec = error::make_error_code(error::invalid_state);
             return;
         }
@@ -233,6 +285,8 @@ template<typename config>
 void connection<config>::handle_pong_timeout(std::string payload,
     lib::error_code const & ec)
 {
+    trace_scope trace("connection::handle_pong_timeout");
+
     if (ec) {
         if (ec == transport::error::operation_aborted) {
             // ignore, this is expected
@@ -249,17 +303,104 @@ void connection<config>::handle_pong_timeout(std::string payload,
 }
 
 template <typename config>
-void connection<config>::pong(std::string const& payload, lib::error_code& ec) {
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"connection pong");
+void connection<config>::handle_keepalive(message_ptr & ping) {
+    release_idle_write_buffer();
+
+    bool timed_out = false;
+    {
+        scoped_lock_type lock(m_connection_state_lock);
+        if (m_state != session::state::open ||
+            m_processor->get_version() < 7)
+        {
+            // Not open yet or the protocol version has no ping frames
+            return;
+        }
+
+        if (m_keepalive_activity) {
+            m_keepalive_activity = false;
+            m_keepalive_pending = false;
+            return;
+        }
+
+        timed_out = m_keepalive_pending;
+        m_keepalive_pending = true;
+    }
+
+    if (timed_out) {
+        transport_con_type::dispatch(lib::bind(
+            &type::handle_keepalive_timeout,
+            type::get_shared()
+        ));
+        return;
     }
 
+    message_ptr msg;
+    lib::error_code ec;
+
+    if (m_is_server) {
+        // Unmasked ping frames are identical for every server connection
+        if (!ping) {
+            ping = m_msg_manager->get_message();
+            if (!ping) {
+                return;
+            }
+            ec = m_processor->prepare_ping("",ping);
+            if (ec) {
+                ping.reset();
+            }
+        }
+        msg = ping;
+    } else {
+        msg = m_msg_manager->get_message();
+        if (msg) {
+            ec = m_processor->prepare_ping("",msg);
+        }
+    }
+
+    if (!msg || ec) {
+        log_err(log::elevel::devel,"handle_keepalive",ec);
+        return;
+    }
+
+    bool needs_writing = false;
+    {
+        scoped_lock_type lock(m_write_lock);
+        write_push(msg);
+        needs_writing = !m_write_flag && !m_send_queue.empty();
+    }
+
+    if (needs_writing) {
+        transport_con_type::dispatch(lib::bind(
+            &type::write_frame,
+            type::get_shared()
+        ));
+    }
+}
+
+template <typename config>
+void connection<config>::handle_keepalive_timeout() {
+    trace_scope trace("connection::handle_keepalive_timeout");
+
+    {
+        scoped_lock_type lock(m_connection_state_lock);
+        if (m_state != session::state::open) {
+            return;
+        }
+    }
+
+    m_alog.write(log::alevel::devel,"keepalive ping timed out");
+    terminate(error::make_error_code(error::keepalive_timeout));
+}
+
+template <typename config>
+void connection<config>::pong(std::string const& payload, lib::error_code& ec) {
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "connection pong");
+
     {
         scoped_lock_type lock(m_connection_state_lock);
         if (m_state != session::state::open) {
-            std::stringstream ss;
-            ss << "connection::pong called from invalid state " << m_state;
-            m_alog.write(log::alevel::devel,ss.str());
+            _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+                "connection::pong called from invalid state " << m_state);
             ec = error::make_error_code(error::invalid_state);
             return;
         }
@@ -304,9 +445,7 @@ template <typename config>
 void connection<config>::close(close::status::value const code,
     std::string const & reason, lib::error_code & ec)
 {
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"connection close");
-    }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "connection close");
 
     // Truncate reason to maximum size allowable in a close frame.
     std::string tr(reason,0,std::min<size_t>(reason.size(),
@@ -723,6 +862,8 @@ void connection<config>::start() {
     }
 
     m_internal_state = istate::TRANSPORT_INIT;
+    m_metrics.started();
+    trace_type::begin("connection::handshake", this);
 
     // Depending on how the transport implements init this function may return
     // immediately and call handle_transport_init later or call
@@ -749,9 +890,8 @@ void connection<config>::handle_transport_init(lib::error_code const & ec) {
     }
 
     if (ecm) {
-        std::stringstream s;
-        s << "handle_transport_init received error: "<< ecm.message();
-        m_elog.write(log::elevel::rerror,s.str());
+        _WEBSOCKETPP_LOG(m_elog, log::elevel::rerror,
+            "handle_transport_init received error: " << ecm.message());
 
         this->terminate(ecm);
         return;
@@ -765,7 +905,7 @@ void connection<config>::handle_transport_init(lib::error_code const & ec) {
         // We are a client. Set the processor to the version specified in the
         // config file and send a handshake request.
         m_internal_state = istate::WRITE_HTTP_REQUEST;
-        m_processor = get_processor(config::client_version);
+        this->set_processor(config::client_version);
         this->send_http_request();
     }
 }
@@ -804,6 +944,8 @@ template <typename config>
 void connection<config>::handle_read_handshake(lib::error_code const & ec,
     size_t bytes_transferred)
 {
+    trace_scope trace("connection::handle_read_handshake");
+
     m_alog.write(log::alevel::devel,"connection handle_read_handshake");
 
     lib::error_code ecm = ec;
@@ -866,12 +1008,9 @@ void connection<config>::handle_read_handshake(lib::error_code const & ec,
         return;
     }
 
-    if (m_alog.static_test(log::alevel::devel)) {
-        std::stringstream s;
-        s << "bytes_transferred: " << bytes_transferred
-          << " bytes, bytes processed: " << bytes_processed << " bytes";
-        m_alog.write(log::alevel::devel,s.str());
-    }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+        "bytes_transferred: " << bytes_transferred
+        << " bytes, bytes processed: " << bytes_processed << " bytes");
 
     if (m_request.ready()) {
         lib::error_code processor_ec = this->initialize_processor();
@@ -880,7 +1019,7 @@ void connection<config>::handle_read_handshake(lib::error_code const & ec,
             return;
         }
 
-        if (m_processor && m_processor->get_version() == 0) {
+        if (m_processor.get() && m_processor->get_version() == 0) {
             // Version 00 has an extra requirement to read some bytes after the
             // handshake
             if (bytes_transferred-bytes_processed >= 8) {
@@ -898,12 +1037,10 @@ void connection<config>::handle_read_handshake(lib::error_code const & ec,
             }
         }
 
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,m_request.raw());
-            if (!m_request.get_header("Sec-WebSocket-Key3").empty()) {
-                m_alog.write(log::alevel::devel,
-                    utility::to_hex(m_request.get_header("Sec-WebSocket-Key3")));
-            }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, m_request.raw());
+        if (!m_request.get_header("Sec-WebSocket-Key3").empty()) {
+            _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+                utility::to_hex(m_request.get_header("Sec-WebSocket-Key3")));
         }
 
         // The remaining bytes in m_buf are frame data. Copy them to the
@@ -1024,40 +1161,39 @@ void connection<config>::handle_read_frame(lib::error_code const & ec,
         return;
     }*/
 
+    if (m_keepalive_lease && bytes_transferred > 0) {
+        scoped_lock_type lock(m_connection_state_lock);
+        m_keepalive_activity = true;
+    }
+
+    m_metrics.read(bytes_transferred);
+
     size_t p = 0;
 
-    if (m_alog.static_test(log::alevel::devel)) {
-        std::stringstream s;
-        s << "p = " << p << " bytes transferred = " << bytes_transferred;
-        m_alog.write(log::alevel::devel,s.str());
-    }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+        "p = " << p << " bytes transferred = " << bytes_transferred);
 
     while (p < bytes_transferred) {
-        if (m_alog.static_test(log::alevel::devel)) {
-            std::stringstream s;
-            s << "calling consume with " << bytes_transferred-p << " bytes";
-            m_alog.write(log::alevel::devel,s.str());
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "calling consume with " << bytes_transferred-p << " bytes");
 
         lib::error_code consume_ec;
 
-        if (m_alog.static_test(log::alevel::devel)) {
-            std::stringstream s;
-            s << "Processing Bytes: " << utility::to_hex(reinterpret_cast<uint8_t*>(m_buf)+p,bytes_transferred-p);
-            m_alog.write(log::alevel::devel,s.str());
-        }
-
-        p += m_processor->consume(
-            reinterpret_cast<uint8_t*>(m_buf)+p,
-            bytes_transferred-p,
-            consume_ec
-        );
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "Processing Bytes: " << utility::to_hex(
+                reinterpret_cast<uint8_t*>(m_buf)+p,bytes_transferred-p));
 
-        if (m_alog.static_test(log::alevel::devel)) {
-            std::stringstream s;
-            s << "bytes left after consume: " << bytes_transferred-p;
-            m_alog.write(log::alevel::devel,s.str());
+        {
+            trace_scope trace("processor::consume");
+            p += m_processor->consume(
+                reinterpret_cast<uint8_t*>(m_buf)+p,
+                bytes_transferred-p,
+                consume_ec
+            );
         }
+
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "bytes left after consume: " << bytes_transferred-p);
         if (consume_ec) {
             log_err(log::elevel::rerror, "consume", consume_ec);
 
@@ -1082,17 +1218,16 @@ void connection<config>::handle_read_frame(lib::error_code const & ec,
         }
 
         if (m_processor->ready()) {
-            if (m_alog.static_test(log::alevel::devel)) {
-                std::stringstream s;
-                s << "Complete message received. Dispatching";
-                m_alog.write(log::alevel::devel,s.str());
-            }
+            _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+                "Complete message received. Dispatching");
 
             message_ptr msg = m_processor->get_message();
 
             if (!msg) {
                 m_alog.write(log::alevel::devel, "null message from m_processor");
             } else if (!is_control(msg->get_opcode())) {
+                m_metrics.message_in(msg->get_payload().size());
+
                 // data message, dispatch to user
                 if (m_state != session::state::open) {
                     m_elog.write(log::elevel::warn, "got non-close frame while closing");
@@ -1100,11 +1235,25 @@ void connection<config>::handle_read_frame(lib::error_code const & ec,
                     m_message_handler(m_connection_hdl, msg);
                 }
             } else {
+                m_metrics.control_in();
                 process_control_frame(msg);
             }
         }
     }
 
+    if (metrics_type::enabled) {
+        m_metrics.set_frames_in(m_processor->get_frame_count());
+    }
+
+    // Only the read path writes the inbound size, so it is compared without
+    // the lock and locked only to publish a change
+    size_t inbound = m_processor->get_inbound_memory();
+    if (inbound != m_inbound_memory) {
+        scoped_lock_type lock(m_write_lock);
+        m_inbound_memory = inbound;
+    }
+    update_memory();
+
     read_frame();
 }
 
@@ -1147,10 +1296,8 @@ lib::error_code connection<config>::initialize_processor() {
         return error::make_error_code(error::invalid_version);
     }
 
-    m_processor = get_processor(version);
-
-    // if the processor is not null we are done
-    if (m_processor) {
+    // if the version has a processor we are done
+    if (this->set_processor(version)) {
         return lib::error_code();
     }
 
@@ -1161,8 +1308,9 @@ lib::error_code connection<config>::initialize_processor() {
 
     std::stringstream ss;
     std::string sep;
+    std::vector<int> const & versions = get_supported_versions();
     std::vector<int>::const_iterator it;
-    for (it = versions_supported.begin(); it != versions_supported.end(); it++)
+    for (it = versions.begin(); it != versions.end(); it++)
     {
         ss << sep << *it;
         sep = ",";
@@ -1174,6 +1322,8 @@ lib::error_code connection<config>::initialize_processor() {
 
 template <typename config>
 lib::error_code connection<config>::process_handshake_request() {
+    trace_scope trace("connection::process_handshake_request");
+
     m_alog.write(log::alevel::devel,"process handshake request");
 
     if (!processor::is_websocket_handshake(m_request)) {
@@ -1217,10 +1367,20 @@ lib::error_code connection<config>::process_handshake_request() {
         return ec;
     }
 
+    // Refuse new connections while the endpoint is over its memory budget
+    if (m_memory_budget && !m_memory_budget->admit()) {
+        m_alog.write(log::alevel::devel, "Memory budget exceeded");
+        m_response.set_status(http::status_code::service_unavailable);
+        return error::make_error_code(error::memory_budget_exceeded);
+    }
+
     // Read extension parameters and set up values necessary for the end user
-    // to complete extension negotiation.
+    // to complete extension negotiation. Close to the memory budget new
+    // connections are opened without extensions.
     std::pair<lib::error_code,std::string> neg_results;
-    neg_results = m_processor->negotiate_extensions(m_request);
+    if (!m_memory_budget || m_memory_budget->allow_compression()) {
+        neg_results = m_processor->negotiate_extensions(m_request);
+    }
 
     if (neg_results.first) {
         // There was a fatal error in extension parsing that should result in
@@ -1265,9 +1425,8 @@ lib::error_code connection<config>::process_handshake_request() {
         ec = m_processor->process_handshake(m_request,m_subprotocol,m_response);
 
         if (ec) {
-            std::stringstream s;
-            s << "Processing error: " << ec << "(" << ec.message() << ")";
-            m_alog.write(log::alevel::devel, s.str());
+            _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+                "Processing error: " << ec << "(" << ec.message() << ")");
 
             m_response.set_status(http::status_code::internal_server_error);
             return ec;
@@ -1317,19 +1476,18 @@ void connection<config>::write_http_response(lib::error_code const & ec) {
     }
 
     // have the processor generate the raw bytes for the wire (if it exists)
-    if (m_processor) {
+    if (m_processor.get()) {
         m_handshake_buffer = m_processor->get_raw(m_response);
     } else {
         // a processor wont exist for raw HTTP responses.
         m_handshake_buffer = m_response.raw();
     }
 
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"Raw Handshake response:\n"+m_handshake_buffer);
-        if (!m_response.get_header("Sec-WebSocket-Key3").empty()) {
-            m_alog.write(log::alevel::devel,
-                utility::to_hex(m_response.get_header("Sec-WebSocket-Key3")));
-        }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+        "Raw Handshake response:\n" << m_handshake_buffer);
+    if (!m_response.get_header("Sec-WebSocket-Key3").empty()) {
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            utility::to_hex(m_response.get_header("Sec-WebSocket-Key3")));
     }
 
     // write raw bytes
@@ -1346,6 +1504,8 @@ void connection<config>::write_http_response(lib::error_code const & ec) {
 
 template <typename config>
 void connection<config>::handle_write_http_response(lib::error_code const & ec) {
+    trace_scope trace("connection::handle_write_http_response");
+
     m_alog.write(log::alevel::devel,"handle_write_http_response");
 
     lib::error_code ecm = ec;
@@ -1394,10 +1554,9 @@ void connection<config>::handle_write_http_response(lib::error_code const & ec)
             || m_ec == error::upgrade_required)
         {*/
         if (!m_is_http) {
-            std::stringstream s;
-            s << "Handshake ended with HTTP error: "
-              << m_response.get_status_code();
-            m_elog.write(log::elevel::rerror,s.str());
+            _WEBSOCKETPP_LOG(m_elog, log::elevel::rerror,
+                "Handshake ended with HTTP error: "
+                << m_response.get_status_code());
         } else {
             // if this was not a websocket connection, we have written
             // the expected response and the connection can be closed.
@@ -1420,6 +1579,14 @@ void connection<config>::handle_write_http_response(lib::error_code const & ec)
     m_internal_state = istate::PROCESS_CONNECTION;
     m_state = session::state::open;
 
+    if (m_registry) {
+        m_registry_lease = m_registry->add(type::get_shared(),
+            transport_con_type::get_shard_index());
+    }
+    open_memory_lease();
+    m_metrics.opened();
+    trace_type::end("connection::handshake", this);
+
     if (m_open_handler) {
         m_open_handler(m_connection_hdl);
     }
@@ -1429,13 +1596,15 @@ void connection<config>::handle_write_http_response(lib::error_code const & ec)
 
 template <typename config>
 void connection<config>::send_http_request() {
+    trace_scope trace("connection::send_http_request");
+
     m_alog.write(log::alevel::devel,"connection send_http_request");
 
     // TODO: origin header?
 
     // Have the protocol processor fill in the appropriate fields based on the
     // selected client version
-    if (m_processor) {
+    if (m_processor.get()) {
         lib::error_code ec;
         ec = m_processor->client_handshake_request(m_request,m_uri,
             m_requested_subprotocols);
@@ -1460,9 +1629,8 @@ void connection<config>::send_http_request() {
 
     m_handshake_buffer = m_request.raw();
 
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"Raw Handshake request:\n"+m_handshake_buffer);
-    }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+        "Raw Handshake request:\n" << m_handshake_buffer);
 
     if (m_open_handshake_timeout_dur > 0) {
         m_handshake_timer = transport_con_type::set_timer(
@@ -1543,6 +1711,8 @@ template <typename config>
 void connection<config>::handle_read_http_response(lib::error_code const & ec,
     size_t bytes_transferred)
 {
+    trace_scope trace("connection::handle_read_http_response");
+
     m_alog.write(log::alevel::devel,"handle_read_http_response");
 
     lib::error_code ecm = ec;
@@ -1633,6 +1803,14 @@ void connection<config>::handle_read_http_response(lib::error_code const & ec,
 
         this->log_open_result();
 
+        if (m_registry) {
+            m_registry_lease = m_registry->add(type::get_shared(),
+                transport_con_type::get_shard_index());
+        }
+        open_memory_lease();
+        m_metrics.opened();
+        trace_type::end("connection::handshake", this);
+
         if (m_open_handler) {
             m_open_handler(m_connection_hdl);
         }
@@ -1663,6 +1841,8 @@ template <typename config>
 void connection<config>::handle_open_handshake_timeout(
     lib::error_code const & ec)
 {
+    trace_scope trace("connection::handle_open_handshake_timeout");
+
     if (ec == transport::error::operation_aborted) {
         m_alog.write(log::alevel::devel,"open handshake timer cancelled");
     } else if (ec) {
@@ -1679,6 +1859,8 @@ template <typename config>
 void connection<config>::handle_close_handshake_timeout(
     lib::error_code const & ec)
 {
+    trace_scope trace("connection::handle_close_handshake_timeout");
+
     if (ec == transport::error::operation_aborted) {
         m_alog.write(log::alevel::devel,"asio close handshake timer cancelled");
     } else if (ec) {
@@ -1693,9 +1875,7 @@ void connection<config>::handle_close_handshake_timeout(
 
 template <typename config>
 void connection<config>::terminate(lib::error_code const & ec) {
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"connection terminate");
-    }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "connection terminate");
 
     // Cancel close handshake timer
     if (m_handshake_timer) {
@@ -1717,6 +1897,7 @@ void connection<config>::terminate(lib::error_code const & ec) {
     if (m_state == session::state::connecting) {
         m_state = session::state::closed;
         tstat = failed;
+        trace_type::end("connection::handshake", this);
         
         // Log fail result here before socket is shut down and we can't get
         // the remote address, etc anymore
@@ -1732,6 +1913,18 @@ void connection<config>::terminate(lib::error_code const & ec) {
         return;
     }
 
+    // Stop being visited by the endpoint's keepalive scheduler, leave the
+    // registry of open connections and stop counting against the memory
+    // budget
+    m_keepalive_lease.reset();
+    m_registry_lease.reset();
+    {
+        // send may be reporting usage through the lease from another thread
+        scoped_lock_type lock(m_memory_lock);
+        m_memory_lease.reset();
+    }
+    m_metrics.closed();
+
     // TODO: choose between shutdown and close based on error code sent
 
     transport_con_type::async_shutdown(
@@ -1748,9 +1941,7 @@ template <typename config>
 void connection<config>::handle_terminate(terminate_status tstat,
     lib::error_code const & ec)
 {
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"connection handle_terminate");
-    }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "connection handle_terminate");
 
     if (ec) {
         // there was an error actually shutting down the connection
@@ -1822,17 +2013,61 @@ void connection<config>::write_frame() {
             // successfully sent or there is some error
             m_write_flag = true;
         }
+
+        // Reserve the coalescing buffer up front. Runs handed to the
+        // transport point into it, so it must not reallocate while they are
+        // built.
+        size_t coalesced = 0;
+        typename std::vector<message_ptr>::iterator it;
+        for (it = m_current_msgs.begin(); it != m_current_msgs.end(); ++it) {
+            coalesced += coalesced_bytes(*it, coalesced);
+        }
+        if (coalesced > m_write_buffer.capacity()) {
+            // Grow geometrically so that bursts of slowly increasing size
+            // settle on one allocation
+            size_t grown = 2 * m_write_buffer.capacity();
+            if (grown > config::write_coalesce_size) {
+                grown = config::write_coalesce_size;
+            }
+            m_write_buffer.reserve(grown > coalesced ? grown : coalesced);
+        }
+        m_write_buffer_capacity = m_write_buffer.capacity();
+        m_write_buffer_used = true;
     }
 
+    update_memory();
+
+    // Frames that fit in the coalescing buffer are copied into it so that a
+    // burst of small messages goes out as one contiguous buffer rather than
+    // two per message. Frames that do not fit or are shared are sent in
+    // place; their header still joins the current run when there is room.
+    size_t run_start = 0;
+
     typename std::vector<message_ptr>::iterator it;
     for (it = m_current_msgs.begin(); it != m_current_msgs.end(); ++it) {
         std::string const & header = (*it)->get_header();
         std::string const & payload = (*it)->get_payload();
 
-        m_send_buffer.push_back(transport::buffer(header.c_str(),header.size()));
-        m_send_buffer.push_back(transport::buffer(payload.c_str(),payload.size()));   
+        size_t bytes = coalesced_bytes(*it, m_write_buffer.size());
+
+        if (bytes == header.size() + payload.size()) {
+            m_write_buffer.append(header);
+            m_write_buffer.append(payload);
+            continue;
+        }
+
+        if (bytes == header.size()) {
+            m_write_buffer.append(header);
+            push_write_run(run_start);
+        } else {
+            push_write_run(run_start);
+            m_send_buffer.push_back(transport::buffer(header.c_str(),header.size()));
+        }
+        m_send_buffer.push_back(transport::buffer(payload.c_str(),payload.size()));
     }
 
+    push_write_run(run_start);
+
     // Print detailed send stats if those log levels are enabled
     if (m_alog.static_test(log::alevel::frame_header)) {
     if (m_alog.dynamic_test(log::alevel::frame_header)) {
@@ -1876,6 +2111,8 @@ void connection<config>::write_frame() {
     }
     }
 
+    trace_type::begin("connection::write", this);
+
     transport_con_type::async_write(
         m_send_buffer,
         m_write_frame_handler
@@ -1883,15 +2120,73 @@ void connection<config>::write_frame() {
 }
 
 template <typename config>
-void connection<config>::handle_write_frame(lib::error_code const & ec)
+void connection<config>::push_write_run(size_t & run_start) {
+    if (m_write_buffer.size() == run_start) {
+        return;
+    }
+
+    m_send_buffer.push_back(transport::buffer(m_write_buffer.data() + run_start,
+        m_write_buffer.size() - run_start));
+    run_start = m_write_buffer.size();
+}
+
+template <typename config>
+size_t connection<config>::coalesced_bytes(message_ptr const & msg,
+    size_t used) const
 {
-    if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"connection handle_write_frame");
+    size_t spare = config::write_coalesce_size - used;
+    size_t header = msg->get_header().size();
+    size_t frame = header + msg->get_payload().size();
+
+    // A frame prepared once for many connections would be copied into the
+    // buffer of each of them
+    if (frame <= spare && !msg->get_cached()) {
+        return frame;
+    }
+    return header <= spare ? header : 0;
+}
+
+template <typename config>
+void connection<config>::release_idle_write_buffer() {
+    {
+        scoped_lock_type lock(m_write_lock);
+
+        // The buffer belongs to the write path while a write is in progress
+        if (m_write_flag || m_write_buffer_capacity == 0) {
+            return;
+        }
+        if (m_write_buffer_used) {
+            m_write_buffer_used = false;
+            return;
+        }
+
+        std::string().swap(m_write_buffer);
+        m_write_buffer_capacity = 0;
     }
 
+    update_memory();
+}
+
+template <typename config>
+void connection<config>::handle_write_frame(lib::error_code const & ec)
+{
+    trace_type::end("connection::write", this);
+
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+        "connection handle_write_frame");
+
     bool terminal = m_current_msgs.back()->get_terminal();
 
+    if (metrics_type::enabled && !ec) {
+        typename std::vector<message_ptr>::iterator it;
+        for (it = m_current_msgs.begin(); it != m_current_msgs.end(); ++it) {
+            m_metrics.written(is_control((*it)->get_opcode()),
+                (*it)->get_header().size() + (*it)->get_payload().size());
+        }
+    }
+
     m_send_buffer.clear();
+    m_write_buffer.clear();
     m_current_msgs.clear();
     // TODO: recycle instead of deleting
 
@@ -1927,7 +2222,9 @@ void connection<config>::handle_write_frame(lib::error_code const & ec)
 template <typename config>
 std::vector<int> const & connection<config>::get_supported_versions() const
 {
-    return versions_supported;
+    static std::vector<int> const versions =
+        processor::versions::list(config::processor_versions);
+    return versions;
 }
 
 template <typename config>
@@ -1938,9 +2235,8 @@ void connection<config>::process_control_frame(typename config::message_type::pt
     frame::opcode::value op = msg->get_opcode();
     lib::error_code ec;
 
-    std::stringstream s;
-    s << "Control frame received with opcode " << op;
-    m_alog.write(log::alevel::control,s.str());
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::control,
+        "Control frame received with opcode " << op);
 
     if (m_state == session::state::closed) {
         m_elog.write(log::elevel::warn,"got frame in state closed");
@@ -1977,16 +2273,15 @@ void connection<config>::process_control_frame(typename config::message_type::pt
 
         m_remote_close_code = close::extract_code(msg->get_payload(),ec);
         if (ec) {
-            s.str("");
             if (config::drop_on_protocol_error) {
-                s << "Received invalid close code " << m_remote_close_code
-                  << " dropping connection per config.";
-                m_elog.write(log::elevel::devel,s.str());
+                _WEBSOCKETPP_LOG(m_elog, log::elevel::devel,
+                    "Received invalid close code " << m_remote_close_code
+                    << " dropping connection per config.");
                 this->terminate(ec);
             } else {
-                s << "Received invalid close code " << m_remote_close_code
-                  << " sending acknowledgement and closing";
-                m_elog.write(log::elevel::devel,s.str());
+                _WEBSOCKETPP_LOG(m_elog, log::elevel::devel,
+                    "Received invalid close code " << m_remote_close_code
+                    << " sending acknowledgement and closing");
                 ec = send_close_ack(close::status::protocol_error,
                     "Invalid close code");
                 if (ec) {
@@ -2015,10 +2310,9 @@ void connection<config>::process_control_frame(typename config::message_type::pt
         }
 
         if (m_state == session::state::open) {
-            s.str("");
-            s << "Received close frame with code " << m_remote_close_code
-              << " and reason " << m_remote_close_reason;
-            m_alog.write(log::alevel::devel,s.str());
+            _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+                "Received close frame with code " << m_remote_close_code
+                << " and reason " << m_remote_close_reason);
 
             ec = send_close_ack();
             if (ec) {
@@ -2095,10 +2389,9 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
         m_local_close_reason = m_remote_close_reason;
     }
 
-    std::stringstream s;
-    s << "Closing with code: " << m_local_close_code << ", and reason: "
-      << m_local_close_reason;
-    m_alog.write(log::alevel::devel,s.str());
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+        "Closing with code: " << m_local_close_code << ", and reason: "
+        << m_local_close_reason);
 
     message_ptr msg = m_msg_manager->get_message();
     if (!msg) {
@@ -2155,52 +2448,77 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
 }
 
 template <typename config>
-typename connection<config>::processor_ptr
-connection<config>::get_processor(int version) const {
-    // TODO: allow disabling certain versions
-    
-    processor_ptr p;
-    
-    switch (version) {
-        case 0:
-            p = lib::make_shared<processor::hybi00<config> >(
-                transport_con_type::is_secure(),
-                m_is_server,
-                m_msg_manager
-            );
-            break;
-        case 7:
-            p = lib::make_shared<processor::hybi07<config> >(
-                transport_con_type::is_secure(),
-                m_is_server,
-                m_msg_manager,
-                lib::ref(m_rng)
-            );
-            break;
-        case 8:
-            p = lib::make_shared<processor::hybi08<config> >(
-                transport_con_type::is_secure(),
-                m_is_server,
-                m_msg_manager,
-                lib::ref(m_rng)
-            );
-            break;
-        case 13:
-            p = lib::make_shared<processor::hybi13<config> >(
-                transport_con_type::is_secure(),
-                m_is_server,
-                m_msg_manager,
-                lib::ref(m_rng)
-            );
-            break;
-        default:
-            return p;
+bool connection<config>::set_processor(int version) {
+    if (!m_processor.init(version, transport_con_type::is_secure(),
+        m_is_server, m_msg_manager, m_rng))
+    {
+        return false;
     }
-    
+
     // Settings not configured by the constructor
-    p->set_max_message_size(m_max_message_size);
-    
-    return p;
+    m_processor->set_max_message_size(m_max_message_size);
+    if (m_window_budget) {
+        m_processor->set_window_budget(m_window_budget);
+    }
+
+    return true;
+}
+
+template <typename config>
+void connection<config>::open_memory_lease() {
+    if (!m_memory_budget) {
+        return;
+    }
+
+    m_compression_memory = m_processor->get_compression_memory();
+    m_handshake_memory = m_request.get_memory_usage() +
+        m_response.get_memory_usage();
+    lib::shared_ptr<typename memory_budget_type::lease> lease =
+        m_memory_budget->add(type::get_shared());
+    {
+        scoped_lock_type lock(m_memory_lock);
+        m_memory_lease = lease;
+    }
+
+    update_memory();
+}
+
+template <typename config>
+void connection<config>::update_memory() {
+    // Set when the connection is created, so without accounting the hot
+    // paths that call this never take the lock
+    if (!m_memory_budget) {
+        return;
+    }
+
+    bool over = false;
+    {
+        // The lease is released by terminate, possibly while send is being
+        // called from another thread, so it is only used under the lock.
+        scoped_lock_type lock(m_memory_lock);
+        if (!m_memory_lease) {
+            return;
+        }
+
+        size_t bytes = get_memory_usage().total();
+        size_t delta = bytes > m_memory_reported ? bytes - m_memory_reported :
+            m_memory_reported - bytes;
+        if (m_memory_reported != 0 &&
+            delta < memory_budget_type::report_granularity)
+        {
+            return;
+        }
+
+        m_memory_reported = bytes;
+        over = m_memory_lease->update(bytes);
+    }
+
+    if (over) {
+        transport_con_type::dispatch(lib::bind(
+            &memory_budget_type::enforce,
+            m_memory_budget
+        ));
+    }
 }
 
 template <typename config>
@@ -2212,13 +2530,11 @@ void connection<config>::write_push(typename config::message_type::ptr msg)
 
     m_send_buffer_size += msg->get_payload().size();
     m_send_queue.push(msg);
+    m_metrics.queued(m_send_queue.size(), m_send_buffer_size);
 
-    if (m_alog.static_test(log::alevel::devel)) {
-        std::stringstream s;
-        s << "write_push: message count: " << m_send_queue.size()
-          << " buffer size: " << m_send_buffer_size;
-        m_alog.write(log::alevel::devel,s.str());
-    }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+        "write_push: message count: " << m_send_queue.size()
+        << " buffer size: " << m_send_buffer_size);
 }
 
 template <typename config>
@@ -2234,20 +2550,25 @@ typename config::message_type::ptr connection<config>::write_pop()
 
     m_send_buffer_size -= msg->get_payload().size();
     m_send_queue.pop();
+    m_metrics.dequeued();
 
-    if (m_alog.static_test(log::alevel::devel)) {
-        std::stringstream s;
-        s << "write_pop: message count: " << m_send_queue.size()
-          << " buffer size: " << m_send_buffer_size;
-        m_alog.write(log::alevel::devel,s.str());
-    }
+    _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+        "write_pop: message count: " << m_send_queue.size()
+        << " buffer size: " << m_send_buffer_size);
     return msg;
 }
 
 template <typename config>
 void connection<config>::log_open_result()
 {
-    std::stringstream s;
+    if (!m_alog.static_test(log::alevel::connect) ||
+        !m_alog.dynamic_test(log::alevel::connect))
+    {
+        return;
+    }
+
+    log::formatter f;
+    std::ostream & s = f.stream();
 
     int version;
     if (!processor::is_websocket_handshake(m_request)) {
@@ -2282,27 +2603,41 @@ void connection<config>::log_open_result()
     // Status code
     s << m_response.get_status_code();
 
-    m_alog.write(log::alevel::connect,s.str());
+    m_alog.write(log::alevel::connect,f.str());
 }
 
 template <typename config>
 void connection<config>::log_close_result()
 {
-    std::stringstream s;
+    if (!m_alog.static_test(log::alevel::disconnect) ||
+        !m_alog.dynamic_test(log::alevel::disconnect))
+    {
+        return;
+    }
+
+    log::formatter f;
+    std::ostream & s = f.stream();
 
     s << "Disconnect "
       << "close local:[" << m_local_close_code
-      << (m_local_close_reason.empty() ? "" : ","+m_local_close_reason)
+      << (m_local_close_reason.empty() ? "" : ",") << m_local_close_reason
       << "] remote:[" << m_remote_close_code
-      << (m_remote_close_reason.empty() ? "" : ","+m_remote_close_reason) << "]";
+      << (m_remote_close_reason.empty() ? "" : ",") << m_remote_close_reason << "]";
 
-    m_alog.write(log::alevel::disconnect,s.str());
+    m_alog.write(log::alevel::disconnect,f.str());
 }
 
 template <typename config>
 void connection<config>::log_fail_result()
 {
-    std::stringstream s;
+    if (!m_alog.static_test(log::alevel::fail) ||
+        !m_alog.dynamic_test(log::alevel::fail))
+    {
+        return;
+    }
+
+    log::formatter f;
+    std::ostream & s = f.stream();
     
     int version = processor::get_websocket_version(m_request);
 
@@ -2335,17 +2670,24 @@ void connection<config>::log_fail_result()
     // WebSocket++ error code & reason
     s << " " << m_ec << " " << m_ec.message();
 
-    m_alog.write(log::alevel::fail,s.str());
+    m_alog.write(log::alevel::fail,f.str());
 }
 
 template <typename config>
 void connection<config>::log_http_result() {
-    std::stringstream s;
-
     if (processor::is_websocket_handshake(m_request)) {
         m_alog.write(log::alevel::devel,"Call to log_http_result for WebSocket");
         return;
-    }  
+    }
+
+    if (!m_alog.static_test(log::alevel::http) ||
+        !m_alog.dynamic_test(log::alevel::http))
+    {
+        return;
+    }
+
+    log::formatter f;
+    std::ostream & s = f.stream();
 
     // Connection Type
     s << (m_request.get_header("host").empty() ? "-" : m_request.get_header("host"))
@@ -2364,7 +2706,7 @@ void connection<config>::log_http_result() {
         s << " \"" << utility::string_replace_all(ua,"\"","\\\"") << "\" ";
     }
 
-    m_alog.write(log::alevel::http,s.str());
+    m_alog.write(log::alevel::http,f.str());
 }
 
 } // namespace websocketpp
@@ -89,6 +89,12 @@ endpoint<connection,config>::create_connection() {
         return connection_ptr();
     }
 
+    con->set_keepalive_lease(m_keepalive->add(con));
+    con->set_registry(get_connection_registry());
+    con->set_memory_budget(get_memory_budget());
+    con->set_window_budget(get_window_budget());
+    con->set_metrics(m_metrics);
+
     return con;
 }
 
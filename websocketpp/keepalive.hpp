@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_KEEPALIVE_HPP
+#define WEBSOCKETPP_KEEPALIVE_HPP
+
+#include <websocketpp/slot_list.hpp>
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/system_error.hpp>
+
+#include <vector>
+
+namespace websocketpp {
+
+/// Endpoint keepalive ping scheduler
+/**
+ * Pings idle connections of an endpoint using a single endpoint timer rather
+ * than a timer per connection.
+ *
+ * Registered connections are spread over a fixed number of slices of the
+ * keepalive interval and one slice is visited per tick. On each visit a
+ * connection that received data since the previous visit is skipped. An idle
+ * connection is sent a ping. A connection that is still idle on the visit
+ * after it was pinged is considered dead and is terminated with
+ * error::keepalive_timeout. A dead peer is therefore detected between one and
+ * two intervals after its last inbound traffic.
+ *
+ * Server connections share one prepared ping frame. Client connections must
+ * mask each frame with a fresh key and prepare their own.
+ *
+ * The scheduler only runs its timer while at least one registered connection
+ * is alive so that it does not keep an endpoint's `run` method from
+ * returning.
+ *
+ * @since 0.8.0
+ */
+template <typename connection, typename concurrency>
+class keepalive
+  : public lib::enable_shared_from_this<keepalive<connection,concurrency> >
+{
+public:
+    /// Type of this keepalive scheduler
+    typedef keepalive<connection,concurrency> type;
+    /// Type of a shared pointer to this keepalive scheduler
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of the connections being kept alive
+    typedef connection connection_type;
+    /// Type of a shared pointer to a connection
+    typedef typename connection_type::ptr connection_ptr;
+    /// Type of a weak pointer to a connection
+    typedef typename connection_type::weak_ptr connection_weak_ptr;
+    /// Type of a pointer to a message
+    typedef typename connection_type::message_ptr message_ptr;
+
+    /// Type of the mutex used to protect the scheduler
+    typedef typename concurrency::mutex_type mutex_type;
+    /// Type of the lock used to protect the scheduler
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+
+    /// Type of a tick handler
+    typedef lib::function<void(lib::error_code const &)> tick_handler;
+    /// Type of a function that cancels a pending tick
+    typedef lib::function<void()> cancel_function;
+    /// Type of a function that schedules a tick
+    /**
+     * Called with a duration in milliseconds and a handler. Returns a function
+     * that cancels the tick.
+     */
+    typedef lib::function<cancel_function(long, tick_handler)> scheduler;
+
+    /// Number of slices each interval is divided into
+    static size_t const slices = 16;
+
+    keepalive()
+      : m_interval(0)
+      , m_live(0)
+      , m_next(0)
+      , m_current(0)
+      , m_generation(0)
+      , m_running(false)
+      , m_buckets(slices) {}
+
+    /// Set the keepalive interval
+    /**
+     * Only affects connections registered after the call. A value of zero
+     * disables the scheduler.
+     *
+     * @param interval The keepalive interval in milliseconds
+     * @param schedule The function used to schedule ticks
+     */
+    void set_interval(long interval, scheduler schedule) {
+        scoped_lock_type guard(m_lock);
+        m_interval = interval > 0 ? interval : 0;
+        m_schedule = schedule;
+    }
+
+    /// Get the keepalive interval
+    long get_interval() const {
+        scoped_lock_type guard(m_lock);
+        return m_interval;
+    }
+
+    /// Stop the scheduler and forget the tick scheduling function
+    /**
+     * Called by the endpoint before it is destroyed.
+     */
+    void stop() {
+        cancel_function cancel;
+        {
+            scoped_lock_type guard(m_lock);
+            m_interval = 0;
+            m_schedule = scheduler();
+            cancel = stop_locked();
+        }
+        if (cancel) {
+            cancel();
+        }
+    }
+
+    /// Register a connection
+    /**
+     * @param con The connection to keep alive
+     * @return A lease that unregisters the connection when released, or an
+     * empty pointer if the scheduler is disabled.
+     */
+    lib::shared_ptr<void> add(connection_ptr con) {
+        scoped_lock_type guard(m_lock);
+
+        if (m_interval == 0 || !m_schedule) {
+            return lib::shared_ptr<void>();
+        }
+
+        m_buckets[m_next].push_back(con);
+        m_next = (m_next + 1) % slices;
+        ++m_live;
+
+        if (!m_running) {
+            m_running = true;
+            ++m_generation;
+            schedule_locked();
+        }
+
+        return lib::make_shared<lease>(this->shared_from_this());
+    }
+
+    /// Get the number of live registered connections
+    size_t size() const {
+        scoped_lock_type guard(m_lock);
+        return m_live;
+    }
+private:
+    friend class slot_lease<type>;
+
+    /// Keeps a connection counted until the connection releases it
+    /**
+     * Never listed, the bucket entries of released connections expire and
+     * are pruned by the tick that visits them.
+     */
+    typedef slot_lease<type> lease;
+
+    void release(lease *) {
+        cancel_function cancel;
+        {
+            scoped_lock_type guard(m_lock);
+            --m_live;
+            if (m_live == 0) {
+                cancel = stop_locked();
+            }
+        }
+        if (cancel) {
+            cancel();
+        }
+    }
+
+    /// Stop ticking. Returns the cancel function to call without the lock.
+    cancel_function stop_locked() {
+        cancel_function cancel;
+        if (m_running) {
+            m_running = false;
+            cancel = m_cancel;
+        }
+        m_cancel = cancel_function();
+
+        for (size_t i = 0; i < m_buckets.size(); ++i) {
+            m_buckets[i].clear();
+        }
+        return cancel;
+    }
+
+    void schedule_locked() {
+        long slice = m_interval / static_cast<long>(slices);
+        m_cancel = m_schedule(slice > 0 ? slice : 1, lib::bind(
+            &type::handle_tick,
+            this->shared_from_this(),
+            m_generation,
+            lib::placeholders::_1
+        ));
+    }
+
+    void handle_tick(uint64_t generation, lib::error_code const & ec) {
+        if (ec) {
+            // cancelled
+            return;
+        }
+
+        std::vector<connection_ptr> cons;
+        {
+            scoped_lock_type guard(m_lock);
+            if (!m_running || generation != m_generation) {
+                return;
+            }
+
+            slot_list<connection_weak_ptr> & bucket = m_buckets[m_current];
+            m_current = (m_current + 1) % slices;
+
+            // Connections are only released after the lock is dropped as
+            // the last reference releases the connection's lease.
+            for (size_t i = 0; i < bucket.size(); ) {
+                cons.push_back(bucket[i].lock());
+                if (cons.back()) {
+                    ++i;
+                } else {
+                    cons.pop_back();
+                    bucket.erase(i);
+                }
+            }
+
+            schedule_locked();
+        }
+
+        // m_ping is only used by the tick handler, which never runs
+        // concurrently with itself.
+        for (size_t i = 0; i < cons.size(); ++i) {
+            cons[i]->handle_keepalive(m_ping);
+        }
+    }
+
+    mutable mutex_type  m_lock;
+    long                m_interval;
+    scheduler           m_schedule;
+    cancel_function     m_cancel;
+    size_t              m_live;
+    size_t              m_next;
+    size_t              m_current;
+    uint64_t            m_generation;
+    bool                m_running;
+    std::vector<slot_list<connection_weak_ptr> > m_buckets;
+    message_ptr         m_ping;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_KEEPALIVE_HPP
@@ -0,0 +1,631 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_LOGGER_ASYNC_HPP
+#define WEBSOCKETPP_LOGGER_ASYNC_HPP
+
+#include <websocketpp/logger/levels.hpp>
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/chrono.hpp>
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/common/time.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Rings are retired by a C++11 thread_local object when their thread exits.
+// The thread local storage of older compilers only holds POD objects, so
+// there rings are kept until the sink is destroyed.
+#if defined(_WEBSOCKETPP_CPP11_INTERNAL_) && !defined(__APPLE__) && \
+    !defined(_WEBSOCKETPP_NO_THREAD_LOCAL_)
+    #define _WEBSOCKETPP_ASYNC_RING_OWNER_
+#endif
+
+namespace websocketpp {
+namespace log {
+
+namespace detail {
+
+/// A log record waiting in a ring to be written
+struct async_record {
+    /// Name of the channel the record was written to
+    char const *    channel_name;
+    /// Time the record was written
+    std::time_t     time;
+    /// Message text. Slots keep their capacity so steady state writes of
+    /// similarly sized messages do not allocate.
+    std::string     text;
+};
+
+/// Bounded single producer single consumer ring of log records
+/**
+ * The owning thread pushes and the drain thread pops. Neither side takes a
+ * lock; the head and tail are published with release semantics and live on
+ * separate cache lines.
+ */
+class async_ring {
+public:
+    /// Number of records a thread may have waiting before writes are dropped
+    static size_t const capacity = 1024;
+
+    async_ring() : m_head(0), m_tail(0), m_retired(false) {
+        m_records.resize(capacity);
+    }
+
+    /// Mark the ring as no longer written to
+    /**
+     * Called by the owning thread as it exits. The drain thread writes out
+     * the records left in a retired ring once more and then frees it.
+     */
+    void retire() {
+        m_retired.store(true, lib::memory_order_release);
+    }
+
+    /// Whether the owning thread has exited
+    bool is_retired() const {
+        return m_retired.load(lib::memory_order_acquire);
+    }
+
+    /// Add a record, returning false if the ring is full
+    bool push(char const * channel_name, std::time_t t, char const * msg,
+        size_t len)
+    {
+        uint64_t head = m_head.load(lib::memory_order_relaxed);
+        if (head - m_tail.load(lib::memory_order_acquire) == capacity) {
+            return false;
+        }
+
+        async_record & r = m_records[head % capacity];
+        r.channel_name = channel_name;
+        r.time = t;
+        r.text.assign(msg, len);
+
+        m_head.store(head + 1, lib::memory_order_release);
+        return true;
+    }
+
+    /// Hand every waiting record to `f` and release their slots
+    template <typename formatter>
+    void drain(formatter & f) {
+        uint64_t tail = m_tail.load(lib::memory_order_relaxed);
+        uint64_t head = m_head.load(lib::memory_order_acquire);
+        for (uint64_t i = tail; i != head; ++i) {
+            f(m_records[i % capacity]);
+        }
+        m_tail.store(head, lib::memory_order_release);
+    }
+private:
+    lib::atomic<uint64_t>       m_head;
+    char                        m_pad[64];
+    lib::atomic<uint64_t>       m_tail;
+    std::vector<async_record>   m_records;
+    lib::atomic<bool>           m_retired;
+};
+
+typedef lib::shared_ptr<async_ring> async_ring_ptr;
+
+#ifdef _WEBSOCKETPP_ASYNC_RING_OWNER_
+/// Holds the rings a thread writes to and retires them when it exits
+/**
+ * A thread has one ring per sink it has written to. Each ring is shared
+ * with its sink, so whichever of the two goes away last frees it.
+ */
+class async_ring_owner {
+public:
+    ~async_ring_owner() {
+        for (size_t i = 0; i < m_rings.size(); ++i) {
+            m_rings[i].ring->retire();
+        }
+    }
+
+    /// Look up the ring for the sink with the given id
+    async_ring * find(uint64_t sink) const {
+        for (size_t i = 0; i < m_rings.size(); ++i) {
+            if (m_rings[i].sink == sink) {
+                return m_rings[i].ring.get();
+            }
+        }
+        return NULL;
+    }
+
+    /// Remember the ring for the sink with the given id
+    /**
+     * Rings whose sink has been destroyed are dropped at the same time, so
+     * a thread that outlives many loggers does not keep their rings.
+     */
+    void add(uint64_t sink, async_ring_ptr const & ring) {
+        size_t i = 0;
+        while (i < m_rings.size()) {
+            if (m_rings[i].ring.use_count() == 1) {
+                m_rings[i] = m_rings.back();
+                m_rings.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        entry e;
+        e.sink = sink;
+        e.ring = ring;
+        m_rings.push_back(e);
+    }
+private:
+    struct entry {
+        uint64_t        sink;
+        async_ring_ptr  ring;
+    };
+
+    std::vector<entry>  m_rings;
+};
+#endif // _WEBSOCKETPP_ASYNC_RING_OWNER_
+
+/// Formats drained records into one batch, caching the timestamp text
+/**
+ * Only used by the drain thread. The timestamp is formatted once per second
+ * rather than once per record.
+ */
+class async_formatter {
+public:
+    explicit async_formatter(std::string & batch)
+      : m_batch(batch), m_time(-1)
+    {
+        m_stamp[0] = '\0';
+    }
+
+    void operator()(async_record const & r) {
+        if (r.time != m_time) {
+            m_time = r.time;
+            std::tm lt = lib::localtime(r.time);
+            if (std::strftime(m_stamp, sizeof(m_stamp), "%Y-%m-%d %H:%M:%S",
+                &lt) == 0)
+            {
+                std::strcpy(m_stamp, "Unknown");
+            }
+        }
+
+        m_batch += '[';
+        m_batch += m_stamp;
+        m_batch += "] [";
+        m_batch += r.channel_name;
+        m_batch += "] ";
+        m_batch += r.text;
+        m_batch += '\n';
+    }
+private:
+    std::string &   m_batch;
+    std::time_t     m_time;
+    char            m_stamp[20];
+};
+
+/// Output shared by an async logger and its copies
+/**
+ * Owns one ring per writing thread and the background thread that drains
+ * them. The drain thread is started by the first write, so loggers that
+ * never log do not cost a thread. When a writing thread exits its ring is
+ * drained one last time and freed.
+ */
+class async_sink {
+public:
+    explicit async_sink(std::ostream * out)
+      : m_id(next_id())
+      , m_out(out)
+      , m_interval(10)
+      , m_passes(0)
+      , m_wake(false)
+      , m_stop(false)
+      , m_dropped(0) {}
+
+    ~async_sink() {
+        {
+            lib::lock_guard<lib::mutex> guard(m_lock);
+            m_stop = true;
+        }
+        m_wake_cond.notify_all();
+        if (m_thread) {
+            m_thread->join();
+        }
+    }
+
+    void set_ostream(std::ostream * out) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        m_out = out;
+    }
+
+    void set_flush_interval(long ms) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        m_interval = ms;
+    }
+
+    /// Queue a record on the calling thread's ring, dropping it if full
+    void push(char const * channel_name, char const * msg, size_t len) {
+        if (!get_ring()->push(channel_name, std::time(NULL), msg, len)) {
+            m_dropped.fetch_add(1, lib::memory_order_relaxed);
+        }
+    }
+
+    /// Block until every record queued before the call has been written
+    void flush() {
+        lib::unique_lock<lib::mutex> lock(m_lock);
+        if (!m_thread) {
+            return;
+        }
+
+        // The pass in progress may have already passed the caller's ring, so
+        // wait for the one after it as well.
+        uint64_t target = m_passes + 2;
+        while (m_passes < target) {
+            m_wake = true;
+            m_wake_cond.notify_all();
+            m_done_cond.wait(lock);
+        }
+    }
+
+    uint64_t get_dropped() const {
+        return m_dropped.load(lib::memory_order_relaxed);
+    }
+
+    /// Get the number of rings not yet freed
+    size_t get_ring_count() {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        return m_rings.size();
+    }
+private:
+    typedef std::vector<std::pair<lib::thread::id, async_ring_ptr> >
+        ring_list;
+
+    struct ring_cache_entry {
+        uint64_t        id;
+        async_ring *    ring;
+    };
+
+    static size_t const ring_cache_size = 4;
+
+    static uint64_t next_id() {
+        static lib::atomic<uint64_t> id(0);
+        return id.fetch_add(1) + 1;
+    }
+
+    /// Look up the calling thread's ring
+    /**
+     * Threads remember the rings of the sinks they wrote to, so the lock is
+     * only taken the first time a thread writes to a sink. Without a
+     * thread_local owner threads cache the rings of the last few sinks and
+     * look the others up by thread id. Sink ids are never reused, so
+     * entries of destroyed sinks never match.
+     */
+    async_ring * get_ring() {
+#if defined(_WEBSOCKETPP_ASYNC_RING_OWNER_)
+        static thread_local async_ring_owner owner;
+
+        async_ring * ring = owner.find(m_id);
+        if (!ring) {
+            async_ring_ptr p = add_ring(lib::this_thread::get_id());
+            owner.add(m_id, p);
+            ring = p.get();
+        }
+        return ring;
+#elif defined(_WEBSOCKETPP_THREAD_LOCAL_)
+        static _WEBSOCKETPP_THREAD_LOCAL_ ring_cache_entry
+            cache[ring_cache_size];
+        static _WEBSOCKETPP_THREAD_LOCAL_ size_t next = 0;
+
+        for (size_t i = 0; i < ring_cache_size; ++i) {
+            if (cache[i].id == m_id) {
+                return cache[i].ring;
+            }
+        }
+
+        async_ring * ring = find_ring();
+        cache[next].id = m_id;
+        cache[next].ring = ring;
+        next = (next + 1) % ring_cache_size;
+        return ring;
+#else
+        return find_ring();
+#endif
+    }
+
+    async_ring * find_ring() {
+        lib::thread::id tid = lib::this_thread::get_id();
+
+        {
+            lib::lock_guard<lib::mutex> guard(m_lock);
+            for (size_t i = 0; i < m_rings.size(); ++i) {
+                if (m_rings[i].first == tid) {
+                    return m_rings[i].second.get();
+                }
+            }
+        }
+
+        return add_ring(tid).get();
+    }
+
+    /// Create a ring for the calling thread, starting the drain thread
+    async_ring_ptr add_ring(lib::thread::id tid) {
+        async_ring_ptr ring = lib::make_shared<async_ring>();
+
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        m_rings.push_back(std::make_pair(tid, ring));
+        if (!m_thread) {
+            m_thread.reset(new lib::thread(lib::bind(&async_sink::run, this)));
+        }
+        return ring;
+    }
+
+    /// Free the rings of exited threads once they have been drained
+    void remove_rings(std::vector<async_ring *> const & retired) {
+        for (size_t i = 0; i < retired.size(); ++i) {
+            for (size_t j = 0; j < m_rings.size(); ++j) {
+                if (m_rings[j].second.get() == retired[i]) {
+                    m_rings.erase(m_rings.begin() + j);
+                    break;
+                }
+            }
+        }
+    }
+
+    /// Drain thread loop
+    void run() {
+        std::string batch;
+        std::vector<async_ring *> rings;
+        std::vector<async_ring *> retired;
+
+        lib::unique_lock<lib::mutex> lock(m_lock);
+        while (true) {
+            bool stop = m_stop;
+            std::ostream * out = m_out;
+            rings.clear();
+            for (size_t i = 0; i < m_rings.size(); ++i) {
+                rings.push_back(m_rings[i].second.get());
+            }
+            lock.unlock();
+
+            // Only this thread removes rings from the list, so the pointers
+            // stay valid while the lock is released. A ring is checked for
+            // retirement before it is drained so that its last records are
+            // written before it is freed.
+            async_formatter format(batch);
+            retired.clear();
+            for (size_t i = 0; i < rings.size(); ++i) {
+                if (rings[i]->is_retired()) {
+                    retired.push_back(rings[i]);
+                }
+                rings[i]->drain(format);
+            }
+            if (!batch.empty() && out) {
+                out->write(batch.data(), static_cast<std::streamsize>(
+                    batch.size()));
+                out->flush();
+            }
+            batch.clear();
+
+            lock.lock();
+            remove_rings(retired);
+            ++m_passes;
+            m_done_cond.notify_all();
+            if (stop) {
+                break;
+            }
+            if (!m_wake && !m_stop) {
+                m_wake_cond.wait_for(lock,
+                    lib::chrono::milliseconds(m_interval));
+            }
+            m_wake = false;
+        }
+    }
+
+    uint64_t const              m_id;
+
+    lib::mutex                  m_lock;
+    lib::condition_variable     m_wake_cond;
+    lib::condition_variable     m_done_cond;
+    lib::shared_ptr<lib::thread> m_thread;
+    ring_list                   m_rings;
+    std::ostream *              m_out;
+    long                        m_interval;
+    uint64_t                    m_passes;
+    bool                        m_wake;
+    bool                        m_stop;
+
+    lib::atomic<uint64_t>       m_dropped;
+};
+
+} // namespace detail
+
+/// Logger that writes to an ostream from a background thread
+/**
+ * A drop in replacement for `log::basic` that keeps formatting and stream
+ * I/O off the calling thread. `write` copies the message into a bounded
+ * ring owned by the calling thread without taking a lock; a background
+ * thread drains the rings, formats each record with a timestamp cached per
+ * second and writes the whole batch to the ostream with a single flush.
+ *
+ * If a thread outpaces the drain thread and its ring fills up, further
+ * records are dropped and counted rather than blocking the caller. The
+ * count is available from `get_dropped`.
+ *
+ * Records from one thread are written in order. Records from different
+ * threads are written in drain order, which may differ slightly from the
+ * order they were written in.
+ *
+ * Copies of a logger share its output, rings and drain thread. The drain
+ * thread is started by the first write and is stopped, after writing every
+ * queued record, when the last copy is destroyed. When a writing thread
+ * exits, the drain thread writes out what is left in its ring and frees it. The concurrency policy is
+ * accepted for compatibility with `log::basic`; the rings and drain thread
+ * always use `lib::thread` primitives.
+ *
+ * To use it, set the log types in the endpoint config:
+ * `typedef websocketpp::log::async<concurrency_type,
+ * websocketpp::log::alevel> alog_type;`
+ *
+ * @since 0.8.0
+ */
+template <typename concurrency, typename names>
+class async {
+public:
+    async<concurrency,names>(channel_type_hint::value h =
+        channel_type_hint::access)
+      : m_static_channels(0xffffffff)
+      , m_dynamic_channels(0)
+      , m_sink(lib::make_shared<detail::async_sink>(
+            h == channel_type_hint::error ? &std::cerr : &std::cout)) {}
+
+    async<concurrency,names>(std::ostream * out)
+      : m_static_channels(0xffffffff)
+      , m_dynamic_channels(0)
+      , m_sink(lib::make_shared<detail::async_sink>(out)) {}
+
+    async<concurrency,names>(level c, channel_type_hint::value h =
+        channel_type_hint::access)
+      : m_static_channels(c)
+      , m_dynamic_channels(0)
+      , m_sink(lib::make_shared<detail::async_sink>(
+            h == channel_type_hint::error ? &std::cerr : &std::cout)) {}
+
+    async<concurrency,names>(level c, std::ostream * out)
+      : m_static_channels(c)
+      , m_dynamic_channels(0)
+      , m_sink(lib::make_shared<detail::async_sink>(out)) {}
+
+    /// Destructor
+    ~async<concurrency,names>() {}
+
+    /// Copy constructor
+    async<concurrency,names>(async<concurrency,names> const & other)
+     : m_static_channels(other.m_static_channels)
+     , m_dynamic_channels(other.m_dynamic_channels.load())
+     , m_sink(other.m_sink)
+    {}
+
+#ifdef _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
+    // no copy assignment operator because of const member variables
+    async<concurrency,names> & operator=(async<concurrency,names> const &) = delete;
+#endif // _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
+
+#ifdef _WEBSOCKETPP_MOVE_SEMANTICS_
+    /// Move constructor
+    async<concurrency,names>(async<concurrency,names> && other)
+     : m_static_channels(other.m_static_channels)
+     , m_dynamic_channels(other.m_dynamic_channels.load())
+     , m_sink(std::move(other.m_sink))
+    {}
+
+#ifdef _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
+    // no move assignment operator because of const member variables
+    async<concurrency,names> & operator=(async<concurrency,names> &&) = delete;
+#endif // _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
+
+#endif // _WEBSOCKETPP_MOVE_SEMANTICS_
+
+    void set_ostream(std::ostream * out = &std::cout) {
+        m_sink->set_ostream(out);
+    }
+
+    void set_channels(level channels) {
+        if (channels == names::none) {
+            clear_channels(names::all);
+            return;
+        }
+
+        m_dynamic_channels.fetch_or(channels & m_static_channels);
+    }
+
+    void clear_channels(level channels) {
+        m_dynamic_channels.fetch_and(~channels);
+    }
+
+    /// Write a string message to the given channel
+    /**
+     * @param channel The channel to write to
+     * @param msg The message to write
+     */
+    void write(level channel, std::string const & msg) {
+        if (!this->dynamic_test(channel)) { return; }
+        m_sink->push(names::channel_name(channel), msg.data(), msg.size());
+    }
+
+    /// Write a cstring message to the given channel
+    /**
+     * @param channel The channel to write to
+     * @param msg The message to write
+     */
+    void write(level channel, char const * msg) {
+        if (!this->dynamic_test(channel)) { return; }
+        m_sink->push(names::channel_name(channel), msg, std::strlen(msg));
+    }
+
+    _WEBSOCKETPP_CONSTEXPR_TOKEN_ bool static_test(level channel) const {
+        return ((channel & m_static_channels) != 0);
+    }
+
+    bool dynamic_test(level channel) {
+        return ((channel & m_dynamic_channels.load(
+            lib::memory_order_relaxed)) != 0);
+    }
+
+    /// Block until every record written before the call is in the ostream
+    void flush() {
+        m_sink->flush();
+    }
+
+    /// Set how often the drain thread wakes up to look for records
+    /**
+     * Records are written at most this long after they are queued. The
+     * default is 10 milliseconds.
+     *
+     * @param ms The interval in milliseconds
+     */
+    void set_flush_interval(long ms) {
+        m_sink->set_flush_interval(ms);
+    }
+
+    /// Get the number of records dropped because a ring was full
+    uint64_t get_dropped() const {
+        return m_sink->get_dropped();
+    }
+private:
+    level const                         m_static_channels;
+    lib::atomic<level>                  m_dynamic_channels;
+    lib::shared_ptr<detail::async_sink> m_sink;
+};
+
+} // log
+} // websocketpp
+
+#endif // WEBSOCKETPP_LOGGER_ASYNC_HPP
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_LOGGER_FORMAT_HPP
+#define WEBSOCKETPP_LOGGER_FORMAT_HPP
+
+#include <websocketpp/common/cpp11.hpp>
+
+#include <ios>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// Thread local objects with constructors and destructors need C++11
+// thread_local; the __thread and __declspec(thread) fallbacks used for
+// _WEBSOCKETPP_THREAD_LOCAL_ only support plain data.
+#if defined _WEBSOCKETPP_THREAD_LOCAL_ && defined _WEBSOCKETPP_CPP11_INTERNAL_ \
+    && !defined(__APPLE__)
+    #define _WEBSOCKETPP_THREAD_LOCAL_OBJECTS_
+#endif
+
+/// Write a message to a logger, formatting it only if it will be written
+/**
+ * `message` is a chain of `<<` operands, for example
+ * `_WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "read " << n << " bytes")`.
+ * It is evaluated only when `channel` passes both the logger's static and
+ * dynamic tests, and is formatted into a buffer reused by the calling thread
+ * rather than a fresh stringstream.
+ *
+ * `logger` is a logger object, not a pointer.
+ *
+ * @since 0.8.0
+ */
+#define _WEBSOCKETPP_LOG(logger, channel, message) \
+    do { \
+        if ((logger).static_test(channel) && (logger).dynamic_test(channel)) { \
+            ::websocketpp::log::formatter _websocketpp_log_formatter; \
+            _websocketpp_log_formatter.stream() << message; \
+            (logger).write((channel), _websocketpp_log_formatter.str()); \
+        } \
+    } while (false)
+
+namespace websocketpp {
+namespace log {
+
+namespace detail {
+
+/// Stream buffer that appends to a string which keeps its capacity
+class string_buffer : public std::streambuf {
+public:
+    std::string const & str() const {
+        return m_str;
+    }
+
+    /// Empty the string without releasing its storage
+    void clear() {
+        m_str.clear();
+    }
+protected:
+    int_type overflow(int_type c) {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            m_str.push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(char const * s, std::streamsize n) {
+        m_str.append(s, static_cast<size_t>(n));
+        return n;
+    }
+private:
+    std::string m_str;
+};
+
+/// Stream and storage a message is formatted into
+struct format_buffer {
+    format_buffer() : stream(&buffer), in_use(false) {}
+
+    /// Get the buffer ready for a new message
+    void reset() {
+        buffer.clear();
+        stream.clear();
+        stream.flags(std::ios_base::skipws | std::ios_base::dec);
+        stream.precision(6);
+        stream.width(0);
+        stream.fill(' ');
+    }
+
+    string_buffer   buffer;
+    std::ostream    stream;
+    bool            in_use;
+};
+
+} // namespace detail
+
+/// Formats one log message into a per thread buffer
+/**
+ * Each thread reuses one buffer for every message it formats, so once the
+ * buffer has grown to fit the thread's messages formatting does not
+ * allocate. If a message is formatted while another is being formatted on
+ * the same thread, for example by an `operator<<` that itself logs, or if
+ * thread local objects are unavailable, the formatter uses a buffer of its
+ * own instead.
+ *
+ * Usually used through `_WEBSOCKETPP_LOG`.
+ *
+ * @since 0.8.0
+ */
+class formatter {
+public:
+    formatter() : m_buffer(acquire()), m_owned(m_buffer == NULL) {
+        if (m_owned) {
+            m_buffer = new detail::format_buffer();
+        }
+        m_buffer->in_use = true;
+        m_buffer->reset();
+    }
+
+    ~formatter() {
+        if (m_owned) {
+            delete m_buffer;
+        } else {
+            m_buffer->in_use = false;
+        }
+    }
+
+    /// Get the stream to format the message into
+    std::ostream & stream() {
+        return m_buffer->stream;
+    }
+
+    /// Get the formatted message
+    /**
+     * The pointer is valid until the formatter is destroyed.
+     */
+    char const * c_str() const {
+        return m_buffer->buffer.str().c_str();
+    }
+
+    /// Get the formatted message
+    std::string const & str() const {
+        return m_buffer->buffer.str();
+    }
+private:
+    // No copying, a formatter owns its buffer until it is destroyed
+    formatter(formatter const &);
+    formatter & operator=(formatter const &);
+
+    /// Get the calling thread's buffer, or NULL if it is unavailable
+    static detail::format_buffer * acquire() {
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_OBJECTS_
+        static thread_local detail::format_buffer buffer;
+        return buffer.in_use ? NULL : &buffer;
+#else
+        return NULL;
+#endif
+    }
+
+    detail::format_buffer * m_buffer;
+    bool                    m_owned;
+};
+
+} // namespace log
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_LOGGER_FORMAT_HPP
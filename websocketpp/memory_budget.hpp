@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_MEMORY_BUDGET_HPP
+#define WEBSOCKETPP_MEMORY_BUDGET_HPP
+
+#include <websocketpp/close.hpp>
+#include <websocketpp/slot_list.hpp>
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/system_error.hpp>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace websocketpp {
+
+/// Breakdown of the memory held by a connection
+/**
+ * @since 0.8.0
+ */
+struct memory_usage {
+    memory_usage()
+      : read_buffer(0)
+      , send_queue(0)
+      , inbound(0)
+      , compression(0)
+      , handshake(0) {}
+
+    /// Size of the connection's read buffer
+    size_t read_buffer;
+    /// Payload bytes of the messages queued for sending plus the capacity of
+    /// the buffer that small outgoing frames are coalesced into
+    size_t send_queue;
+    /// Payload capacity of the messages being received
+    size_t inbound;
+    /// Estimated size of the compression state
+    size_t compression;
+    /// Approximate size of the opening handshake request and response
+    size_t handshake;
+
+    /// Get the sum of all categories
+    size_t total() const {
+        return read_buffer + send_queue + inbound + compression + handshake;
+    }
+};
+
+/// Actions a memory budget takes when it is exceeded
+namespace memory_policy {
+
+enum value {
+    /// Reject opening handshakes with 503 Service Unavailable
+    refuse = 1,
+    /// Open new connections without compression
+    shrink = 2,
+    /// Close the connections holding the most memory
+    close = 4,
+    /// All of the above
+    all = 7
+};
+
+} // namespace memory_policy
+
+/// Memory budget counters
+/**
+ * @since 0.8.0
+ */
+struct memory_budget_stats {
+    memory_budget_stats()
+      : bytes(0)
+      , peak(0)
+      , connections(0)
+      , budget(0)
+      , refused(0)
+      , shrunk(0)
+      , closed(0) {}
+
+    /// Bytes held by open connections
+    size_t bytes;
+    /// Highest value of bytes so far
+    size_t peak;
+    /// Number of open connections
+    size_t connections;
+    /// Configured budget in bytes. Zero means unlimited.
+    size_t budget;
+    /// Number of opening handshakes rejected
+    uint64_t refused;
+    /// Number of connections opened without compression
+    uint64_t shrunk;
+    /// Number of connections closed to get back under the budget
+    uint64_t closed;
+};
+
+/// Endpoint wide memory accounting
+/**
+ * Tracks the memory held by the open connections of an endpoint, as
+ * reported by the connections themselves, and enforces a budget on it.
+ *
+ * Connections report their usage when it has changed by at least
+ * `report_granularity` bytes, so the endpoint total may lag the sum of the
+ * connections' exact usage by that much per connection.
+ *
+ * With a nonzero budget the policy decides what happens once usage passes
+ * it. `refuse` rejects new opening handshakes while usage is over the budget.
+ * `shrink` opens new connections without negotiating compression, the
+ * largest per connection cost, once usage passes three quarters of the
+ * budget. `close` closes the connections holding the most memory, largest
+ * first, until the memory they hold covers the excess. The pressure handler
+ * is called each time usage goes over the budget, after any connections
+ * have been closed, so that an application or autoscaler can react.
+ *
+ * @since 0.8.0
+ */
+template <typename connection, typename concurrency>
+class memory_budget
+  : public lib::enable_shared_from_this<memory_budget<connection,concurrency> >
+{
+public:
+    /// Type of this memory budget
+    typedef memory_budget<connection,concurrency> type;
+    /// Type of a shared pointer to this memory budget
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of the connections being accounted for
+    typedef connection connection_type;
+    /// Type of a shared pointer to a connection
+    typedef typename connection_type::ptr connection_ptr;
+    /// Type of a weak pointer to a connection
+    typedef typename connection_type::weak_ptr connection_weak_ptr;
+
+    /// Type of the mutex used to protect the budget
+    typedef typename concurrency::mutex_type mutex_type;
+    /// Type of the lock used to protect the budget
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+
+    /// Type of the handler called when usage goes over the budget
+    typedef lib::function<void(memory_budget_stats const &)> pressure_handler;
+
+    /// Smallest change in a connection's usage that it reports
+    static size_t const report_granularity = 4096;
+
+    class lease;
+
+    memory_budget()
+      : m_budget(0)
+      , m_policy(memory_policy::all)
+      , m_bytes(0)
+      , m_peak(0)
+      , m_refused(0)
+      , m_shrunk(0)
+      , m_closed(0)
+      , m_over(false) {}
+
+    /// Set the budget and the actions taken when it is exceeded
+    /**
+     * @param bytes The budget in bytes. Zero, the default, means unlimited.
+     * @param policy A bitmask of memory_policy values. Defaults to all.
+     */
+    void set_budget(size_t bytes, int policy) {
+        scoped_lock_type guard(m_lock);
+        m_budget = bytes;
+        m_policy = policy;
+        m_over = false;
+    }
+
+    /// Set the handler called when usage goes over the budget
+    void set_pressure_handler(pressure_handler h) {
+        scoped_lock_type guard(m_lock);
+        m_pressure_handler = h;
+    }
+
+    /// Get the current usage and counters
+    memory_budget_stats get_stats() const {
+        scoped_lock_type guard(m_lock);
+
+        memory_budget_stats s;
+        s.bytes = m_bytes;
+        s.peak = m_peak;
+        s.connections = m_entries.size();
+        s.budget = m_budget;
+        s.refused = m_refused;
+        s.shrunk = m_shrunk;
+        s.closed = m_closed;
+        return s;
+    }
+
+    /// Start accounting for a connection
+    /**
+     * @param con The connection
+     * @return A lease through which the connection reports its usage. The
+     * connection stops being accounted for when the lease is released.
+     */
+    lib::shared_ptr<lease> add(connection_ptr con) {
+        lib::shared_ptr<lease> l = lib::make_shared<lease>(
+            this->shared_from_this());
+
+        scoped_lock_type guard(m_lock);
+        m_entries.push_back(entry(con), l.get());
+        return l;
+    }
+
+    /// Decide whether a new connection may open
+    /**
+     * @return False if the refuse policy applies and usage is over the
+     * budget
+     */
+    bool admit() {
+        scoped_lock_type guard(m_lock);
+        if (over_locked(m_budget) && (m_policy & memory_policy::refuse)) {
+            ++m_refused;
+            return false;
+        }
+        return true;
+    }
+
+    /// Decide whether a new connection may negotiate compression
+    /**
+     * @return False if the shrink policy applies and usage is over three
+     * quarters of the budget
+     */
+    bool allow_compression() {
+        scoped_lock_type guard(m_lock);
+        if (over_locked(m_budget / 4 * 3) &&
+            (m_policy & memory_policy::shrink))
+        {
+            ++m_shrunk;
+            return false;
+        }
+        return true;
+    }
+
+    /// Apply the policy after usage went over the budget
+    /**
+     * Connections call this through their transport after a report returns
+     * true, outside of their own locks.
+     */
+    void enforce() {
+        std::vector<connection_ptr> victims;
+        pressure_handler handler;
+        memory_budget_stats stats;
+        {
+            scoped_lock_type guard(m_lock);
+            if (!over_locked(m_budget)) {
+                return;
+            }
+
+            if (m_policy & memory_policy::close) {
+                select_locked(victims);
+                m_closed += victims.size();
+            }
+
+            handler = m_pressure_handler;
+        }
+
+        for (size_t i = 0; i < victims.size(); ++i) {
+            lib::error_code ec;
+            victims[i]->close(close::status::try_again_later,
+                "memory budget exceeded", ec);
+        }
+
+        if (handler) {
+            handler(get_stats());
+        }
+    }
+
+    /// Usage reported by one connection
+    /**
+     * Tracks the connection's entry, under the budget's lock.
+     */
+    class lease : public slot_lease<type> {
+    public:
+        explicit lease(ptr owner) : slot_lease<type>(owner) {}
+
+        /// Report the connection's current usage
+        /**
+         * @param bytes The number of bytes the connection holds
+         * @return Whether usage just went over the budget, in which case the
+         * caller should arrange for enforce to be called
+         */
+        bool update(size_t bytes) {
+            return this->get_owner()->update(this, bytes);
+        }
+    };
+private:
+    friend class slot_lease<type>;
+
+    struct entry {
+        explicit entry(connection_ptr c) : con(c), bytes(0), closing(false) {}
+
+        connection_weak_ptr con;
+        /// Last reported usage
+        size_t              bytes;
+        /// Whether the connection was already closed by the close policy
+        bool                closing;
+    };
+
+    bool over_locked(size_t limit) const {
+        return m_budget != 0 && m_bytes > limit;
+    }
+
+    bool update(lease * l, size_t bytes) {
+        scoped_lock_type guard(m_lock);
+        if (!l->is_listed()) {
+            return false;
+        }
+
+        entry & e = m_entries[l->get_slot()];
+        m_bytes = m_bytes - e.bytes + bytes;
+        e.bytes = bytes;
+        if (m_bytes > m_peak) {
+            m_peak = m_bytes;
+        }
+
+        // Only the transition over the budget triggers enforcement
+        if (!over_locked(m_budget)) {
+            m_over = false;
+            return false;
+        }
+        if (m_over) {
+            return false;
+        }
+        m_over = true;
+        return true;
+    }
+
+    /// Stop accounting for the connection of a released lease
+    void release(slot_lease<type> * l) {
+        scoped_lock_type guard(m_lock);
+        if (!l->is_listed()) {
+            return;
+        }
+
+        m_bytes -= m_entries[l->get_slot()].bytes;
+        m_entries.erase(*l);
+
+        if (!over_locked(m_budget)) {
+            m_over = false;
+        }
+    }
+
+    /// Pick the largest connections until they cover the excess
+    void select_locked(std::vector<connection_ptr> & victims) {
+        // Memory of connections closed earlier is about to be released
+        size_t pending = 0;
+        std::vector<std::pair<size_t,size_t> > order;
+        order.reserve(m_entries.size());
+        for (size_t i = 0; i < m_entries.size(); ++i) {
+            if (m_entries[i].closing) {
+                pending += m_entries[i].bytes;
+            } else {
+                order.push_back(std::make_pair(m_entries[i].bytes, i));
+            }
+        }
+
+        if (m_bytes - pending <= m_budget) {
+            return;
+        }
+        size_t excess = m_bytes - pending - m_budget;
+
+        std::sort(order.begin(), order.end());
+
+        size_t freed = 0;
+        for (size_t i = order.size(); i > 0 && freed < excess; --i) {
+            entry & e = m_entries[order[i-1].second];
+            connection_ptr con = e.con.lock();
+            if (!con) {
+                continue;
+            }
+            e.closing = true;
+            freed += order[i-1].first;
+            victims.push_back(con);
+        }
+    }
+
+    mutable mutex_type      m_lock;
+    size_t                  m_budget;
+    int                     m_policy;
+    size_t                  m_bytes;
+    size_t                  m_peak;
+    uint64_t                m_refused;
+    uint64_t                m_shrunk;
+    uint64_t                m_closed;
+    // Whether usage was over the budget at the last report
+    bool                    m_over;
+    pressure_handler        m_pressure_handler;
+    slot_list<entry>        m_entries;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_MEMORY_BUDGET_HPP
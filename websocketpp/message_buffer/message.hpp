@@ -98,7 +98,8 @@ public:
       , m_prepared(false)
       , m_fin(true)
       , m_terminal(false)
-      , m_compressed(false) {}
+      , m_compressed(false)
+      , m_cached(false) {}
 
     /// Construct a message and fill in some values
     /**
@@ -111,6 +112,7 @@ public:
       , m_fin(true)
       , m_terminal(false)
       , m_compressed(false)
+      , m_cached(false)
     {
         m_payload.reserve(size);
     }
@@ -136,6 +138,33 @@ public:
         m_prepared = value;
     }
 
+    /// Return whether the prepared message is cached for several connections
+    /**
+     * A cached message is a frame prepared once and queued on every
+     * connection it is sent to, so connections write it in place rather
+     * than copy it.
+     *
+     * @since 0.8.0
+     *
+     * @return Whether the message is shared between connections
+     */
+    bool get_cached() const {
+        return m_cached;
+    }
+
+    /// Set or clear the flag that marks a prepared message as cached
+    /**
+     * Must be set before the message is queued on any connection. This flag
+     * should not be set by end user code without a very good reason.
+     *
+     * @since 0.8.0
+     *
+     * @param value The value to set the cached flag to
+     */
+    void set_cached(bool value) {
+        m_cached = value;
+    }
+
     /// Return whether or not the message is flagged as compressed
     /**
      * @return whether or not the message is/should be compressed
@@ -332,6 +361,7 @@ private:
     bool                        m_fin;
     bool                        m_terminal;
     bool                        m_compressed;
+    bool                        m_cached;
 };
 
 } // namespace message_buffer
@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_METRICS_BASIC_HPP
+#define WEBSOCKETPP_METRICS_BASIC_HPP
+
+#include <websocketpp/metrics/histogram.hpp>
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/chrono.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+namespace metrics {
+
+/// Snapshot of a set of traffic counters
+/**
+ * Byte counts are wire bytes after the opening handshake, including frame
+ * headers. Message counts are data messages, frame counts include control
+ * frames and fragments.
+ *
+ * @since 0.8.0
+ */
+struct counters {
+    counters()
+      : messages_in(0)
+      , messages_out(0)
+      , bytes_in(0)
+      , bytes_out(0)
+      , frames_in(0)
+      , frames_out(0)
+      , control_frames_in(0)
+      , control_frames_out(0)
+      , queue_messages_peak(0)
+      , queue_bytes_peak(0) {}
+
+    uint64_t messages_in;
+    uint64_t messages_out;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t frames_in;
+    uint64_t frames_out;
+    uint64_t control_frames_in;
+    uint64_t control_frames_out;
+    /// Highest number of messages waiting in a send queue
+    uint64_t queue_messages_peak;
+    /// Highest number of payload bytes waiting in a send queue
+    uint64_t queue_bytes_peak;
+};
+
+/// Lock-free counters backing a counters snapshot
+class counter_set {
+public:
+    enum value {
+        messages_in = 0,
+        messages_out,
+        bytes_in,
+        bytes_out,
+        frames_in,
+        frames_out,
+        control_frames_in,
+        control_frames_out,
+        queue_messages_peak,
+        queue_bytes_peak,
+        size
+    };
+
+    counter_set() {
+        for (int i = 0; i < size; ++i) {
+            m_values[i].store(0, lib::memory_order_relaxed);
+        }
+    }
+
+    /// Add to a counter
+    void add(value c, uint64_t n) {
+        m_values[c].fetch_add(n, lib::memory_order_relaxed);
+    }
+
+    /// Raise a high watermark to at least v
+    void raise(value c, uint64_t v) {
+        uint64_t cur = m_values[c].load(lib::memory_order_relaxed);
+        while (v > cur && !m_values[c].compare_exchange_weak(cur, v,
+            lib::memory_order_relaxed))
+        {}
+    }
+
+    /// Get the value of a counter
+    uint64_t get(value c) const {
+        return m_values[c].load(lib::memory_order_relaxed);
+    }
+
+    /// Get a snapshot of all counters
+    counters snapshot() const {
+        counters s;
+        s.messages_in = get(messages_in);
+        s.messages_out = get(messages_out);
+        s.bytes_in = get(bytes_in);
+        s.bytes_out = get(bytes_out);
+        s.frames_in = get(frames_in);
+        s.frames_out = get(frames_out);
+        s.control_frames_in = get(control_frames_in);
+        s.control_frames_out = get(control_frames_out);
+        s.queue_messages_peak = get(queue_messages_peak);
+        s.queue_bytes_peak = get(queue_bytes_peak);
+        return s;
+    }
+private:
+    // Non-copyable
+    counter_set(counter_set const &);
+    counter_set & operator=(counter_set const &);
+
+    lib::atomic<uint64_t> m_values[size];
+};
+
+/// Metrics policy with lock-free counters and latency histograms
+/**
+ * Counts messages, frames and bytes in each direction and the send queue
+ * high watermarks, both per connection and for the endpoint as a whole.
+ * The endpoint additionally keeps histograms of opening handshake durations
+ * and of send latency, the time from a message being queued by `send` to
+ * the transport reporting it written, both in microseconds. Histograms are
+ * kept per endpoint only because each one is several kilobytes.
+ *
+ * All counters are relaxed atomics: recording never takes a lock and the
+ * values may be read from any thread.
+ *
+ * To enable it, set `metrics_type` in the endpoint config:
+ * `typedef websocketpp::metrics::basic metrics_type;`
+ *
+ * @since 0.8.0
+ */
+class basic {
+public:
+    /// Whether this policy records anything
+    static bool const enabled = true;
+
+    /// Type of the clock used for latencies
+    typedef lib::chrono::steady_clock clock_type;
+
+    basic() : m_opened(0), m_open(0) {}
+
+    /// Get the endpoint wide traffic counters
+    counters get_counters() const {
+        return m_counters.snapshot();
+    }
+
+    /// Get the histogram of opening handshake durations in microseconds
+    /**
+     * Measured from the start of the connection until it opens, so for
+     * secure connections it includes the TLS handshake.
+     */
+    histogram const & get_handshake_duration() const {
+        return m_handshake;
+    }
+
+    /// Get the histogram of send latencies in microseconds
+    histogram const & get_send_latency() const {
+        return m_send_latency;
+    }
+
+    /// Get the number of connections that have opened
+    uint64_t get_connections_opened() const {
+        return m_opened.load(lib::memory_order_relaxed);
+    }
+
+    /// Get the number of connections that are open
+    uint64_t get_open_connections() const {
+        return m_open.load(lib::memory_order_relaxed);
+    }
+
+    /// Per connection metrics
+    /**
+     * Owned by the connection, which calls the hooks. Every hook updates the
+     * connection's own counters and those of the endpoint it is attached
+     * to. The send queue hooks are called with the connection's write lock
+     * held or from its write path, which serializes them.
+     *
+     * Queue times are kept in fixed rings of `latency_slots` entries indexed
+     * by the sequence number of the message, so queueing a message never
+     * allocates. The send latency of a message is not recorded if more than
+     * `latency_slots` messages were queued or in flight ahead of it.
+     */
+    class connection_metrics {
+    public:
+        /// Number of messages whose queue times are kept
+        static size_t const latency_slots = 32;
+
+        connection_metrics()
+          : m_queued_total(0)
+          , m_dequeued_total(0)
+          , m_written_total(0)
+          , m_frames_seen(0)
+          , m_open(false) {}
+
+        ~connection_metrics() {
+            closed();
+        }
+
+        /// Get the connection's traffic counters
+        counters get_counters() const {
+            return m_counters.snapshot();
+        }
+
+        /// Attach to the endpoint's metrics
+        void attach(lib::shared_ptr<basic> const & endpoint) {
+            m_endpoint = endpoint;
+        }
+
+        /// The connection has started its opening handshake
+        void started() {
+            m_started = clock_type::now();
+        }
+
+        /// The connection has opened
+        void opened() {
+            if (!m_endpoint || m_open) {
+                return;
+            }
+            m_open = true;
+            m_endpoint->m_opened.fetch_add(1, lib::memory_order_relaxed);
+            m_endpoint->m_open.fetch_add(1, lib::memory_order_relaxed);
+            m_endpoint->m_handshake.record(microseconds(m_started));
+        }
+
+        /// The connection was terminated
+        void closed() {
+            if (!m_endpoint || !m_open) {
+                return;
+            }
+            m_open = false;
+            m_endpoint->m_open.fetch_sub(1, lib::memory_order_relaxed);
+        }
+
+        /// Bytes were read from the transport
+        void read(size_t bytes) {
+            add(counter_set::bytes_in, bytes);
+        }
+
+        /// Update the total number of frames parsed by the processor
+        void set_frames_in(uint64_t total) {
+            if (total > m_frames_seen) {
+                add(counter_set::frames_in, total - m_frames_seen);
+                m_frames_seen = total;
+            }
+        }
+
+        /// A data message was received
+        void message_in(size_t) {
+            add(counter_set::messages_in, 1);
+        }
+
+        /// A control frame was received
+        void control_in() {
+            add(counter_set::control_frames_in, 1);
+        }
+
+        /// A message was added to the send queue
+        /**
+         * @param messages The number of messages now queued
+         * @param bytes The number of payload bytes now queued
+         */
+        void queued(size_t messages, size_t bytes) {
+            m_queued[m_queued_total % latency_slots] = clock_type::now();
+            ++m_queued_total;
+            raise(counter_set::queue_messages_peak, messages);
+            raise(counter_set::queue_bytes_peak, bytes);
+        }
+
+        /// The oldest queued message was handed to the transport
+        void dequeued() {
+            if (m_dequeued_total == m_queued_total) {
+                return;
+            }
+            uint64_t n = m_dequeued_total++;
+            // An empty time point marks a queue time that was overwritten
+            m_inflight[n % latency_slots] =
+                m_queued_total - n <= latency_slots ?
+                m_queued[n % latency_slots] : clock_type::time_point();
+        }
+
+        /// The oldest message handed to the transport was written
+        /**
+         * @param control Whether the message was a control frame
+         * @param bytes The number of wire bytes written
+         */
+        void written(bool control, size_t bytes) {
+            add(control ? counter_set::control_frames_out :
+                counter_set::messages_out, 1);
+            add(counter_set::frames_out, 1);
+            add(counter_set::bytes_out, bytes);
+
+            if (m_written_total == m_dequeued_total) {
+                return;
+            }
+            uint64_t n = m_written_total++;
+            if (!m_endpoint || m_dequeued_total - n > latency_slots) {
+                return;
+            }
+            clock_type::time_point const & t = m_inflight[n % latency_slots];
+            if (t != clock_type::time_point()) {
+                m_endpoint->m_send_latency.record(microseconds(t));
+            }
+        }
+    private:
+        void add(counter_set::value c, uint64_t n) {
+            m_counters.add(c, n);
+            if (m_endpoint) {
+                m_endpoint->m_counters.add(c, n);
+            }
+        }
+
+        void raise(counter_set::value c, uint64_t v) {
+            m_counters.raise(c, v);
+            if (m_endpoint) {
+                m_endpoint->m_counters.raise(c, v);
+            }
+        }
+
+        static uint64_t microseconds(clock_type::time_point since) {
+            return static_cast<uint64_t>(
+                lib::chrono::duration_cast<lib::chrono::microseconds>(
+                    clock_type::now() - since
+                ).count()
+            );
+        }
+
+        lib::shared_ptr<basic>              m_endpoint;
+        counter_set                         m_counters;
+        clock_type::time_point              m_started;
+        clock_type::time_point              m_queued[latency_slots];
+        clock_type::time_point              m_inflight[latency_slots];
+        uint64_t                            m_queued_total;
+        uint64_t                            m_dequeued_total;
+        uint64_t                            m_written_total;
+        uint64_t                            m_frames_seen;
+        bool                                m_open;
+    };
+private:
+    friend class connection_metrics;
+
+    // Non-copyable
+    basic(basic const &);
+    basic & operator=(basic const &);
+
+    counter_set             m_counters;
+    histogram               m_handshake;
+    histogram               m_send_latency;
+    lib::atomic<uint64_t>   m_opened;
+    lib::atomic<uint64_t>   m_open;
+};
+
+} // namespace metrics
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_METRICS_BASIC_HPP
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_METRICS_HISTOGRAM_HPP
+#define WEBSOCKETPP_METRICS_HISTOGRAM_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <vector>
+
+namespace websocketpp {
+namespace metrics {
+
+/// Lock-free histogram with bounded relative error
+/**
+ * Values are sorted into log-linear buckets in the manner of an HDR
+ * histogram: each power of two range is split into `sub_buckets` equal
+ * buckets, so every recorded value is known to within 1/16th (6.25%) of
+ * itself. Values below `sub_buckets` are recorded exactly. Values of
+ * `2^max_exponent` and above are counted in the last bucket.
+ *
+ * Recording is a handful of relaxed atomic operations and never allocates,
+ * so any number of threads may record into the same histogram. Readers see
+ * a consistent enough view for monitoring but not a point in time snapshot.
+ *
+ * @since 0.8.0
+ */
+class histogram {
+public:
+    /// log2 of the number of buckets per power of two
+    static unsigned const sub_bucket_bits = 4;
+    /// Number of buckets per power of two
+    static unsigned const sub_buckets = 1u << sub_bucket_bits;
+    /// log2 of the smallest value that is counted in the last bucket
+    static unsigned const max_exponent = 40;
+    /// Total number of buckets
+    static unsigned const bucket_count =
+        sub_buckets * (max_exponent - sub_bucket_bits + 1);
+
+    histogram() : m_count(0), m_sum(0), m_max(0) {
+        for (unsigned i = 0; i < bucket_count; ++i) {
+            m_buckets[i].store(0, lib::memory_order_relaxed);
+        }
+    }
+
+    /// Record one value
+    void record(uint64_t value) {
+        m_buckets[index_of(value)].fetch_add(1, lib::memory_order_relaxed);
+        m_count.fetch_add(1, lib::memory_order_relaxed);
+        m_sum.fetch_add(value, lib::memory_order_relaxed);
+
+        uint64_t max = m_max.load(lib::memory_order_relaxed);
+        while (value > max &&
+            !m_max.compare_exchange_weak(max, value, lib::memory_order_relaxed))
+        {}
+    }
+
+    /// Get the number of recorded values
+    uint64_t get_count() const {
+        return m_count.load(lib::memory_order_relaxed);
+    }
+
+    /// Get the sum of the recorded values
+    uint64_t get_sum() const {
+        return m_sum.load(lib::memory_order_relaxed);
+    }
+
+    /// Get the largest recorded value
+    uint64_t get_max() const {
+        return m_max.load(lib::memory_order_relaxed);
+    }
+
+    /// Get the number of values recorded in a bucket
+    uint64_t get_bucket(unsigned index) const {
+        return m_buckets[index].load(lib::memory_order_relaxed);
+    }
+
+    /// Get a value at or below which a percentage of the values fall
+    /**
+     * @param percentile The percentile, between 0 and 100
+     * @return The highest value that falls in the same bucket as the value
+     * at the percentile, or zero if nothing was recorded
+     */
+    uint64_t get_percentile(double percentile) const {
+        uint64_t count = get_count();
+        if (count == 0) {
+            return 0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 *
+            static_cast<double>(count) + 0.5);
+        if (rank < 1) {
+            rank = 1;
+        }
+
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < bucket_count; ++i) {
+            seen += get_bucket(i);
+            if (seen >= rank) {
+                uint64_t upper = upper_bound(i);
+                uint64_t max = get_max();
+                return upper < max ? upper : max;
+            }
+        }
+        return get_max();
+    }
+
+    /// Get the bucket a value is counted in
+    static unsigned index_of(uint64_t value) {
+        if (value < sub_buckets) {
+            return static_cast<unsigned>(value);
+        }
+
+        unsigned exponent = sub_bucket_bits;
+        while (exponent < 63 && (value >> (exponent + 1)) != 0) {
+            ++exponent;
+        }
+        if (exponent >= max_exponent) {
+            return bucket_count - 1;
+        }
+
+        unsigned sub = static_cast<unsigned>(
+            value >> (exponent - sub_bucket_bits)) - sub_buckets;
+        return sub_buckets * (exponent - sub_bucket_bits + 1) + sub;
+    }
+
+    /// Get the highest value counted in a bucket
+    static uint64_t upper_bound(unsigned index) {
+        if (index < sub_buckets) {
+            return index;
+        }
+        if (index == bucket_count - 1) {
+            return ~uint64_t(0);
+        }
+
+        unsigned shift = index / sub_buckets - 1;
+        uint64_t lower = uint64_t(sub_buckets + index % sub_buckets) << shift;
+        return lower + (uint64_t(1) << shift) - 1;
+    }
+private:
+    // Non-copyable
+    histogram(histogram const &);
+    histogram & operator=(histogram const &);
+
+    lib::atomic<uint64_t>   m_buckets[bucket_count];
+    lib::atomic<uint64_t>   m_count;
+    lib::atomic<uint64_t>   m_sum;
+    lib::atomic<uint64_t>   m_max;
+};
+
+} // namespace metrics
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_METRICS_HISTOGRAM_HPP
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_METRICS_NONE_HPP
+#define WEBSOCKETPP_METRICS_NONE_HPP
+
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+/// Metrics policies
+namespace metrics {
+
+/// Stub metrics policy that records nothing
+/**
+ * The default metrics policy. Every hook is an empty inline function, so an
+ * endpoint configured with it compiles to the same code as one without
+ * metrics.
+ *
+ * @see basic for the interface a metrics policy implements
+ */
+class none {
+public:
+    /// Whether this policy records anything
+    static bool const enabled = false;
+
+    /// Per connection metrics
+    class connection_metrics {
+    public:
+        void attach(lib::shared_ptr<none> const &) {}
+        void started() {}
+        void opened() {}
+        void closed() {}
+        void read(size_t) {}
+        void set_frames_in(uint64_t) {}
+        void message_in(size_t) {}
+        void control_in() {}
+        void queued(size_t, size_t) {}
+        void dequeued() {}
+        void written(bool, size_t) {}
+    };
+};
+
+} // namespace metrics
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_METRICS_NONE_HPP
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_METRICS_PROMETHEUS_HPP
+#define WEBSOCKETPP_METRICS_PROMETHEUS_HPP
+
+#include <websocketpp/metrics/basic.hpp>
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/http/constants.hpp>
+
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace websocketpp {
+namespace metrics {
+
+/// Write one counter or gauge in the Prometheus text format
+inline void write_prometheus_value(std::ostream & out,
+    std::string const & name, char const * type, char const * help,
+    uint64_t value)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " " << type << "\n"
+        << name << " " << value << "\n";
+}
+
+/// Write a histogram of microseconds in the Prometheus text format
+/**
+ * Buckets are reported in seconds at one microsecond below every power of
+ * two microseconds. The histogram's buckets start at powers of two and never
+ * straddle one, so every value at or below such a boundary is in a bucket
+ * that ends at or below it and the cumulative counts are exact.
+ */
+inline void write_prometheus_histogram(std::ostream & out,
+    std::string const & name, char const * help, histogram const & h)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " histogram\n";
+
+    std::streamsize precision = out.precision(15);
+
+    uint64_t cumulative = 0;
+    unsigned bucket = 0;
+    for (unsigned k = 0; k <= histogram::max_exponent; ++k) {
+        uint64_t le = (uint64_t(1) << k) - 1;
+        while (bucket < histogram::bucket_count - 1 &&
+            histogram::upper_bound(bucket) <= le)
+        {
+            cumulative += h.get_bucket(bucket);
+            ++bucket;
+        }
+        out << name << "_bucket{le=\"" << double(le) / 1e6 << "\"} "
+            << cumulative << "\n";
+    }
+
+    uint64_t count = h.get_count();
+    out << name << "_bucket{le=\"+Inf\"} " << count << "\n"
+        << name << "_sum " << double(h.get_sum()) / 1e6 << "\n"
+        << name << "_count " << count << "\n";
+
+    out.precision(precision);
+}
+
+/// Write the metrics of an endpoint in the Prometheus text format
+/**
+ * @since 0.8.0
+ *
+ * @param out The stream to write to
+ * @param m The endpoint's metrics
+ * @param prefix The prefix of every metric name
+ */
+inline void write_prometheus(std::ostream & out, basic const & m,
+    std::string const & prefix = "websocketpp")
+{
+    counters c = m.get_counters();
+
+    write_prometheus_value(out, prefix + "_messages_received_total",
+        "counter", "Data messages received.", c.messages_in);
+    write_prometheus_value(out, prefix + "_messages_sent_total",
+        "counter", "Data messages sent.", c.messages_out);
+    write_prometheus_value(out, prefix + "_received_bytes_total",
+        "counter", "Bytes read from the transport.", c.bytes_in);
+    write_prometheus_value(out, prefix + "_sent_bytes_total",
+        "counter", "Bytes written to the transport.", c.bytes_out);
+    write_prometheus_value(out, prefix + "_frames_received_total",
+        "counter", "Frames received.", c.frames_in);
+    write_prometheus_value(out, prefix + "_frames_sent_total",
+        "counter", "Frames sent.", c.frames_out);
+    write_prometheus_value(out, prefix + "_control_frames_received_total",
+        "counter", "Control frames received.", c.control_frames_in);
+    write_prometheus_value(out, prefix + "_control_frames_sent_total",
+        "counter", "Control frames sent.", c.control_frames_out);
+    write_prometheus_value(out, prefix + "_send_queue_messages_peak",
+        "gauge", "Most messages waiting in one send queue.",
+        c.queue_messages_peak);
+    write_prometheus_value(out, prefix + "_send_queue_bytes_peak",
+        "gauge", "Most payload bytes waiting in one send queue.",
+        c.queue_bytes_peak);
+    write_prometheus_value(out, prefix + "_connections_opened_total",
+        "counter", "Connections opened.", m.get_connections_opened());
+    write_prometheus_value(out, prefix + "_connections_open",
+        "gauge", "Connections currently open.", m.get_open_connections());
+
+    write_prometheus_histogram(out, prefix + "_handshake_duration_seconds",
+        "Opening handshake duration.", m.get_handshake_duration());
+    write_prometheus_histogram(out, prefix + "_send_latency_seconds",
+        "Time from send to written.", m.get_send_latency());
+}
+
+/// HTTP handler that serves an endpoint's metrics to Prometheus
+/**
+ * Answers plain HTTP requests for the configured path with the endpoint's
+ * metrics in the Prometheus text exposition format. Requests for other
+ * paths are passed to a fallback handler if one is set and answered with
+ * 404 Not Found otherwise. The endpoint's config must use the basic metrics
+ * policy.
+ *
+ * Usage:
+ * ```
+ * metrics::prometheus_exporter<server> exporter(&s);
+ * s.set_http_handler(exporter);
+ * ```
+ *
+ * @since 0.8.0
+ */
+template <typename endpoint>
+class prometheus_exporter {
+public:
+    /// Type of the endpoint whose metrics are exported
+    typedef endpoint endpoint_type;
+    /// Type of a pointer to a connection of the endpoint
+    typedef typename endpoint_type::connection_ptr connection_ptr;
+    /// Type of the fallback handler
+    typedef lib::function<void(connection_hdl)> http_handler;
+
+    /// Construct an exporter
+    /**
+     * @param e The endpoint. Must outlive the exporter.
+     * @param path The resource to serve the metrics at
+     * @param prefix The prefix of every metric name
+     */
+    explicit prometheus_exporter(endpoint_type * e,
+        std::string const & path = "/metrics",
+        std::string const & prefix = "websocketpp")
+      : m_endpoint(e)
+      , m_path(path)
+      , m_prefix(prefix) {}
+
+    /// Set the handler for requests for other paths
+    void set_fallback(http_handler h) {
+        m_fallback = h;
+    }
+
+    /// Get the metrics in the Prometheus text format
+    std::string render() const {
+        std::stringstream s;
+        write_prometheus(s, m_endpoint->get_metrics(), m_prefix);
+        return s.str();
+    }
+
+    /// Handle an HTTP request
+    void operator()(connection_hdl hdl) const {
+        connection_ptr con = m_endpoint->get_con_from_hdl(hdl);
+
+        std::string const & resource = con->get_resource();
+        if (resource.compare(0, resource.find('?'), m_path) != 0) {
+            if (m_fallback) {
+                m_fallback(hdl);
+            } else {
+                con->set_status(http::status_code::not_found);
+            }
+            return;
+        }
+
+        con->set_status(http::status_code::ok);
+        con->replace_header("Content-Type", "text/plain; version=0.0.4");
+        con->set_body(render());
+    }
+private:
+    endpoint_type * m_endpoint;
+    std::string     m_path;
+    std::string     m_prefix;
+    http_handler    m_fallback;
+};
+
+} // namespace metrics
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_METRICS_PROMETHEUS_HPP
@@ -36,6 +36,7 @@
 #include <websocketpp/common/system_error.hpp>
 
 #include <string>
+#include <vector>
 
 namespace websocketpp {
 namespace processor {
@@ -49,6 +50,45 @@ static char const handshake_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 
 } // namespace constants
 
+/// Masks of the WebSocket protocol versions there are processors for
+/**
+ * Combined with `|` for the `processor_versions` config setting, which
+ * limits the versions an endpoint supports at compile time.
+ *
+ * @since 0.8.0
+ */
+namespace versions {
+
+/// Hybi draft 00, also known as Hixie draft 76
+static unsigned int const hybi00 = 0x1;
+/// Hybi draft 07
+static unsigned int const hybi07 = 0x2;
+/// Hybi draft 08
+static unsigned int const hybi08 = 0x4;
+/// Hybi draft 13, RFC 6455
+static unsigned int const hybi13 = 0x8;
+/// All versions
+static unsigned int const all = hybi00 | hybi07 | hybi08 | hybi13;
+
+/// Get the protocol version numbers of a mask in ascending order
+inline std::vector<int> list(unsigned int mask) {
+    std::vector<int> result;
+    if (mask & hybi00) {
+        result.push_back(0);
+    }
+    if (mask & hybi07) {
+        result.push_back(7);
+    }
+    if (mask & hybi08) {
+        result.push_back(8);
+    }
+    if (mask & hybi13) {
+        result.push_back(13);
+    }
+    return result;
+}
+
+} // namespace versions
 
 /// Processor class related error codes
 namespace error_cat {
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_PROCESSOR_HOLDER_HPP
+#define WEBSOCKETPP_PROCESSOR_HOLDER_HPP
+
+#include <websocketpp/processors/base.hpp>
+#include <websocketpp/processors/processor.hpp>
+#include <websocketpp/processors/hybi00.hpp>
+#include <websocketpp/processors/hybi07.hpp>
+#include <websocketpp/processors/hybi08.hpp>
+#include <websocketpp/processors/hybi13.hpp>
+
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/type_traits.hpp>
+
+#include <new>
+
+namespace websocketpp {
+namespace processor {
+
+/// Hybi 13 processor with no subclasses
+/**
+ * Declared final where the compiler supports it, so that calls made through
+ * a pointer to it bypass the virtual table and can be inlined.
+ *
+ * @since 0.8.0
+ */
+template <typename config>
+class hybi13_direct _WEBSOCKETPP_FINAL_TOKEN_ : public hybi13<config> {
+public:
+    typedef typename hybi13<config>::msg_manager_ptr msg_manager_ptr;
+    typedef typename hybi13<config>::rng_type rng_type;
+
+    explicit hybi13_direct(bool secure, bool p_is_server,
+        msg_manager_ptr manager, rng_type & rng)
+      : hybi13<config>(secure, p_is_server, manager, rng) {}
+};
+
+/// Owns the processor of a connection
+/**
+ * Creates the processor for the protocol version of a handshake, if that
+ * version is enabled by `config::processor_versions`. Processors of
+ * disabled versions are never instantiated, so their code, such as the MD5
+ * based handshake of hybi 00, is left out of the program.
+ *
+ * This general form holds the processor by shared pointer and calls it
+ * through the virtual `processor` interface. See the specialization below
+ * for configs that enable only hybi 13.
+ *
+ * @since 0.8.0
+ */
+template <typename config, bool hybi13_only =
+    (config::processor_versions == versions::hybi13)>
+class holder {
+public:
+    typedef processor<config> processor_type;
+    typedef processor_type * pointer;
+    typedef typename config::con_msg_manager_type::ptr msg_manager_ptr;
+    typedef typename config::rng_type rng_type;
+
+    /// Create the processor for a protocol version
+    /**
+     * Replaces any processor held before.
+     *
+     * @param version The protocol version
+     * @param secure Whether the connection is secure
+     * @param p_is_server Whether the connection is the server side
+     * @param manager The connection's message manager
+     * @param rng The connection's random number generator
+     * @return Whether the version is enabled. If it is not, no processor is
+     * held afterwards.
+     */
+    bool init(int version, bool secure, bool p_is_server,
+        msg_manager_ptr manager, rng_type & rng)
+    {
+        switch (version) {
+            case 0:
+                m_processor = make_hybi00(secure, p_is_server, manager,
+                    flag<(config::processor_versions & versions::hybi00) != 0>());
+                break;
+            case 7:
+                m_processor = make<hybi07<config> >(secure, p_is_server,
+                    manager, rng,
+                    flag<(config::processor_versions & versions::hybi07) != 0>());
+                break;
+            case 8:
+                m_processor = make<hybi08<config> >(secure, p_is_server,
+                    manager, rng,
+                    flag<(config::processor_versions & versions::hybi08) != 0>());
+                break;
+            case 13:
+                m_processor = make<hybi13<config> >(secure, p_is_server,
+                    manager, rng,
+                    flag<(config::processor_versions & versions::hybi13) != 0>());
+                break;
+            default:
+                m_processor.reset();
+        }
+        return m_processor.get() != NULL;
+    }
+
+    /// Get the processor, or NULL if none is held
+    pointer get() const {
+        return m_processor.get();
+    }
+
+    pointer operator->() const {
+        return m_processor.get();
+    }
+private:
+    typedef lib::shared_ptr<processor_type> processor_ptr;
+
+    /// Selects between the factories of enabled and disabled versions
+    template <bool enabled>
+    struct flag {};
+
+    template <typename type>
+    static processor_ptr make(bool secure, bool p_is_server,
+        msg_manager_ptr manager, rng_type & rng, flag<true>)
+    {
+        return lib::make_shared<type>(secure, p_is_server, manager,
+            lib::ref(rng));
+    }
+
+    template <typename type>
+    static processor_ptr make(bool, bool, msg_manager_ptr, rng_type &,
+        flag<false>)
+    {
+        return processor_ptr();
+    }
+
+    static processor_ptr make_hybi00(bool secure, bool p_is_server,
+        msg_manager_ptr manager, flag<true>)
+    {
+        return lib::make_shared<hybi00<config> >(secure, p_is_server,
+            manager);
+    }
+
+    static processor_ptr make_hybi00(bool, bool, msg_manager_ptr,
+        flag<false>)
+    {
+        return processor_ptr();
+    }
+
+    processor_ptr m_processor;
+};
+
+/// Owns the processor of a connection that supports only hybi 13
+/**
+ * The processor lives inside the holder rather than in a separate
+ * allocation, and is a `hybi13_direct`, so calls to it are direct.
+ *
+ * @since 0.8.0
+ */
+template <typename config>
+class holder<config, true> {
+public:
+    typedef hybi13_direct<config> processor_type;
+    typedef processor_type * pointer;
+    typedef typename config::con_msg_manager_type::ptr msg_manager_ptr;
+    typedef typename config::rng_type rng_type;
+
+    holder() : m_processor(NULL) {}
+
+    ~holder() {
+        reset();
+    }
+
+    /// Create the processor for a protocol version
+    /**
+     * Replaces any processor held before.
+     *
+     * @param version The protocol version
+     * @param secure Whether the connection is secure
+     * @param p_is_server Whether the connection is the server side
+     * @param manager The connection's message manager
+     * @param rng The connection's random number generator
+     * @return Whether the version is 13. If it is not, no processor is held
+     * afterwards.
+     */
+    bool init(int version, bool secure, bool p_is_server,
+        msg_manager_ptr manager, rng_type & rng)
+    {
+        reset();
+        if (version == 13) {
+            m_processor = new (&m_storage) processor_type(secure, p_is_server,
+                manager, rng);
+        }
+        return m_processor != NULL;
+    }
+
+    /// Get the processor, or NULL if none is held
+    pointer get() const {
+        return m_processor;
+    }
+
+    pointer operator->() const {
+        return m_processor;
+    }
+private:
+    // No copying, the processor lives in m_storage
+    holder(holder const &);
+    holder & operator=(holder const &);
+
+    void reset() {
+        if (m_processor) {
+            m_processor->~processor_type();
+            m_processor = NULL;
+        }
+    }
+
+    typename lib::aligned_storage<sizeof(processor_type)>::type m_storage;
+    pointer m_processor;
+};
+
+} // namespace processor
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_PROCESSOR_HOLDER_HPP
@@ -68,7 +68,8 @@ public:
       , msg_hdr(0x00)
       , msg_ftr(0xff)
       , m_state(HEADER)
-      , m_msg_manager(manager) {}
+      , m_msg_manager(manager)
+      , m_frames(0) {}
 
     int get_version() const {
         return 0;
@@ -289,6 +290,7 @@ public:
                     p++;
                     // TODO: validation
                     m_state = READY;
+                    ++m_frames;
                 }
             } else {
                 // TODO
@@ -314,6 +316,14 @@ public:
         return false;
     }
 
+    uint64_t get_frame_count() const {
+        return m_frames;
+    }
+
+    size_t get_inbound_memory() const {
+        return m_msg_ptr ? m_msg_ptr->get_payload().capacity() : 0;
+    }
+
     message_ptr get_message() {
         message_ptr ret = m_msg_ptr;
         m_msg_ptr = message_ptr();
@@ -454,6 +464,9 @@ private:
     msg_manager_ptr m_msg_manager;
     message_ptr m_msg_ptr;
     utf8_validator::validator m_validator;
+
+    // Number of frames read
+    uint64_t m_frames;
 };
 
 } // namespace processor
@@ -30,6 +30,8 @@
 
 #include <websocketpp/processors/processor.hpp>
 
+#include <websocketpp/extensions/extension.hpp>
+
 #include <websocketpp/frame.hpp>
 #include <websocketpp/http/constants.hpp>
 
@@ -73,6 +75,7 @@ public:
       : processor<config>(secure, p_is_server)
       , m_msg_manager(manager)
       , m_rng(rng)
+      , m_frames(0)
     {
         reset_headers();
     }
@@ -465,6 +468,8 @@ public:
                     continue;
                 }
 
+                ++m_frames;
+
                 // If this was the last frame in the message set the ready flag.
                 // Otherwise, reset processor state to read additional frames.
                 if (frame::get_fin(m_basic_header)) {
@@ -505,9 +510,10 @@ public:
 
             // Decompress current buffer into the message buffer
             lib::error_code ec;
-            ec = m_permessage_deflate.decompress(trailer,4,out);
+            ec = m_permessage_deflate.decompress(trailer,4,out,
+                base::m_max_message_size);
             if (ec) {
-                return ec;
+                return translate_decompress_error(ec);
             }
         }
 
@@ -569,6 +575,35 @@ public:
         return m_bytes_needed;
     }
 
+    uint64_t get_frame_count() const {
+        return m_frames;
+    }
+
+    size_t get_inbound_memory() const {
+        size_t bytes = 0;
+        if (m_data_msg.msg_ptr) {
+            bytes += m_data_msg.msg_ptr->get_payload().capacity();
+        }
+        if (m_control_msg.msg_ptr) {
+            bytes += m_control_msg.msg_ptr->get_payload().capacity();
+        }
+        return bytes;
+    }
+
+    size_t get_compression_memory() const {
+        if (!m_permessage_deflate.is_enabled()) {
+            return 0;
+        }
+        return m_permessage_deflate.get_memory_usage();
+    }
+
+    void set_window_budget(lib::shared_ptr<
+        extensions::permessage_deflate::window_policy::window_budget> const &
+        budget)
+    {
+        m_permessage_deflate.set_window_budget(budget);
+    }
+
     /// Prepare a user data message for writing
     /**
      * Performs validation, masking, compression, etc. will return an error if
@@ -790,9 +825,13 @@ protected:
         if (m_permessage_deflate.is_enabled()
             && m_current_msg->msg_ptr->get_compressed())
         {
-            // Decompress current buffer into the message buffer
-            ec = m_permessage_deflate.decompress(buf,len,out);
+            // Decompress current buffer into the message buffer. Output is
+            // bounded by the maximum message size as it is produced rather
+            // than after the fact.
+            ec = m_permessage_deflate.decompress(buf,len,out,
+                base::m_max_message_size);
             if (ec) {
+                ec = translate_decompress_error(ec);
                 return 0;
             }
         } else {
@@ -813,6 +852,26 @@ protected:
         return len;
     }
 
+    /// Map permessage-deflate size errors into the processor category
+    /**
+     * The extension reports an oversized inflate result in the extension
+     * category.
+     * Translate it so that the connection fails with the message_too_big
+     * close code like any other oversized message.
+     *
+     * @param ec The error returned by the extension
+     * @return The translated error code
+     */
+    lib::error_code translate_decompress_error(lib::error_code const & ec) const
+    {
+        if (ec == extensions::error::make_error_code(
+            extensions::error::message_too_big))
+        {
+            return make_error_code(error::message_too_big);
+        }
+        return ec;
+    }
+
     /// Validate an incoming basic header
     /**
      * Validates an incoming hybi13 basic header.
@@ -1046,6 +1105,9 @@ protected:
     // Overall state of the processor
     state m_state;
 
+    // Number of frames read
+    uint64_t m_frames;
+
     // Extensions
     permessage_deflate_type m_permessage_deflate;
 };
@@ -29,6 +29,7 @@
 #define WEBSOCKETPP_PROCESSOR_HPP
 
 #include <websocketpp/processors/base.hpp>
+#include <websocketpp/extensions/permessage_deflate/window_policy.hpp>
 #include <websocketpp/common/system_error.hpp>
 
 #include <websocketpp/close.hpp>
@@ -350,6 +351,50 @@ public:
         return 1;
     }
 
+    /// Get the number of frames read so far
+    /**
+     * @since 0.8.0
+     *
+     * @return The number of complete frames consumed, including control
+     * frames and fragments
+     */
+    virtual uint64_t get_frame_count() const {
+        return 0;
+    }
+
+    /// Get the memory held for partially received messages
+    /**
+     * @since 0.8.0
+     *
+     * @return The payload capacity of the messages being assembled in bytes
+     */
+    virtual size_t get_inbound_memory() const {
+        return 0;
+    }
+
+    /// Get the estimated memory held by compression state
+    /**
+     * @since 0.8.0
+     *
+     * @return The estimated number of bytes, zero if compression is not in use
+     */
+    virtual size_t get_compression_memory() const {
+        return 0;
+    }
+
+    /// Share a compression memory budget with other connections
+    /**
+     * Passed on to the permessage-deflate extension's window policy. Must be
+     * called before extensions are negotiated.
+     *
+     * @since 0.8.0
+     *
+     * @param budget The budget of the connection's endpoint
+     */
+    virtual void set_window_budget(lib::shared_ptr<
+        extensions::permessage_deflate::window_policy::window_budget> const &)
+    {}
+
     /// Prepare a data message for writing
     /**
      * Performs validation, masking, compression, etc. will return an error if
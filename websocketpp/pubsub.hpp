@@ -0,0 +1,589 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_PUBSUB_HPP
+#define WEBSOCKETPP_PUBSUB_HPP
+
+#include <websocketpp/close.hpp>
+#include <websocketpp/connection.hpp>
+#include <websocketpp/error.hpp>
+#include <websocketpp/frame.hpp>
+#include <websocketpp/slot_list.hpp>
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/system_error.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+/// Topic based publish/subscribe fan-out
+namespace pubsub {
+
+/// What to do with a subscriber whose connection falls behind
+namespace backpressure {
+
+enum value {
+    /// Queue every message no matter how much is buffered
+    unbounded = 0,
+    /// Skip messages while more than the limit is buffered
+    drop = 1,
+    /// Close the connection once more than the limit is buffered
+    disconnect = 2
+};
+
+} // namespace backpressure
+
+/// Broker counters
+struct stats {
+    stats()
+      : subscribers(0)
+      , published(0)
+      , delivered(0)
+      , frames(0)
+      , dropped(0)
+      , disconnected(0) {}
+
+    /// Number of subscriptions
+    size_t subscribers;
+    /// Number of messages published
+    uint64_t published;
+    /// Number of messages queued to subscribers
+    uint64_t delivered;
+    /// Number of frames prepared for sharing between subscribers
+    uint64_t frames;
+    /// Number of messages skipped by the drop policy
+    uint64_t dropped;
+    /// Number of connections closed by the disconnect policy
+    uint64_t disconnected;
+};
+
+/// Publishes messages to the connections subscribed to a topic
+/**
+ * A broker keeps the subscriptions of each transport shard apart, for the
+ * asio transport one shard per io_service of the endpoint's pool. Publishing
+ * posts one task to each shard with subscribers to the topic, and that task
+ * sends to the shard's subscribers on the thread that owns them. Server
+ * connections of the same protocol version share a single frame of each
+ * message, so a message is framed once per shard and wire format rather
+ * than once per subscriber.
+ *
+ * Each subscription has a backpressure policy that applies when the
+ * subscriber's connection has more than a limit of bytes buffered for
+ * sending. The policy and limit default to those set with set_backpressure.
+ *
+ * Subscriptions of closed connections are removed the next time their topic
+ * is published to, so a close handler does not need to unsubscribe.
+ *
+ * The broker must be owned by a shared pointer. The endpoint must outlive
+ * the broker and its transport must be initialized before the broker is
+ * constructed.
+ *
+ * Messages are sent without holding any broker lock, so handlers called
+ * while a message is sent may subscribe and unsubscribe connections, even
+ * with transports that call handlers synchronously, such as iostream.
+ *
+ * @since 0.8.0
+ */
+template <typename endpoint>
+class broker
+  : public lib::enable_shared_from_this<broker<endpoint> >
+{
+public:
+    /// Type of this broker
+    typedef broker<endpoint> type;
+    /// Type of a shared pointer to this broker
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of the endpoint the subscribers belong to
+    typedef endpoint endpoint_type;
+    /// Type of the subscribers' connections
+    typedef typename endpoint_type::connection_type connection_type;
+    /// Type of a shared pointer to a subscriber's connection
+    typedef typename endpoint_type::connection_ptr connection_ptr;
+    /// Type of a weak pointer to a subscriber's connection
+    typedef lib::weak_ptr<connection_type> connection_weak_ptr;
+    /// Type of a message
+    typedef typename connection_type::message_ptr message_ptr;
+    /// Type of a cache of frames shared between connections
+    typedef typename connection_type::frame_cache frame_cache;
+    /// Type of the endpoint concurrency policy
+    typedef typename endpoint_type::concurrency_type concurrency_type;
+    /// Type of the mutex protecting a shard
+    typedef typename concurrency_type::mutex_type mutex_type;
+    /// Type of a lock on a shard
+    typedef typename concurrency_type::scoped_lock_type scoped_lock_type;
+
+    /// Construct a broker for the connections of an endpoint
+    /**
+     * @param e The endpoint, with its transport initialized
+     */
+    explicit broker(endpoint_type * e)
+      : m_endpoint(e)
+      , m_policy(backpressure::drop)
+      , m_limit(1048576)
+      , m_published(0)
+    {
+        size_t shards = e->get_shard_count();
+        for (size_t i = 0; i < (shards > 0 ? shards : 1); ++i) {
+            m_shards.push_back(lib::make_shared<shard_type>());
+        }
+    }
+
+    /// Set the backpressure policy of new subscriptions
+    /**
+     * The default is to drop messages while more than 1 MiB is buffered.
+     *
+     * @param policy The policy
+     * @param limit The number of buffered bytes over which the policy applies
+     */
+    void set_backpressure(backpressure::value policy, size_t limit) {
+        scoped_lock_type guard(m_lock);
+        m_policy = policy;
+        m_limit = limit;
+    }
+
+    /// Subscribe a connection to a topic
+    /**
+     * Subscribing a connection that is already subscribed updates the
+     * policy and limit of its subscription.
+     *
+     * @param [in] hdl The connection
+     * @param [in] topic The topic
+     * @param [in] policy The backpressure policy of the subscription
+     * @param [in] limit The number of buffered bytes over which the policy
+     * applies
+     * @param [out] ec Set to error::bad_connection if the connection no
+     * longer exists.
+     */
+    void subscribe(connection_hdl hdl, std::string const & topic,
+        backpressure::value policy, size_t limit, lib::error_code & ec)
+    {
+        connection_ptr con = lib::static_pointer_cast<connection_type>(
+            hdl.lock());
+        if (!con) {
+            ec = error::make_error_code(error::bad_connection);
+            return;
+        }
+
+        shard_type & s = shard_of(con);
+        scoped_lock_type guard(s.lock);
+
+        subscription & sub = s.topics[topic];
+        typename slot_map::iterator it = sub.slots.find(con.get());
+        if (it != sub.slots.end()) {
+            // The slot may belong to a closed connection at the same address
+            subscriber & entry = sub.subscribers[it->second.get_slot()];
+            entry.con = con;
+            entry.policy = policy;
+            entry.limit = limit;
+        } else {
+            sub.subscribers.push_back(subscriber(con, policy, limit),
+                &sub.slots[con.get()]);
+        }
+        ec = lib::error_code();
+    }
+
+    /// Subscribe a connection to a topic with the default policy
+    void subscribe(connection_hdl hdl, std::string const & topic,
+        lib::error_code & ec)
+    {
+        backpressure::value policy;
+        size_t limit;
+        {
+            scoped_lock_type guard(m_lock);
+            policy = m_policy;
+            limit = m_limit;
+        }
+        subscribe(hdl, topic, policy, limit, ec);
+    }
+
+    /// Subscribe a connection to a topic (exception version)
+    void subscribe(connection_hdl hdl, std::string const & topic,
+        backpressure::value policy, size_t limit)
+    {
+        lib::error_code ec;
+        subscribe(hdl, topic, policy, limit, ec);
+        if (ec) {
+            throw exception(ec);
+        }
+    }
+
+    /// Subscribe a connection to a topic with the default policy (exception
+    /// version)
+    void subscribe(connection_hdl hdl, std::string const & topic) {
+        lib::error_code ec;
+        subscribe(hdl, topic, ec);
+        if (ec) {
+            throw exception(ec);
+        }
+    }
+
+    /// Unsubscribe a connection from a topic
+    /**
+     * Does nothing if the connection is not subscribed or no longer exists.
+     *
+     * @param hdl The connection
+     * @param topic The topic
+     */
+    void unsubscribe(connection_hdl hdl, std::string const & topic) {
+        connection_ptr con = lib::static_pointer_cast<connection_type>(
+            hdl.lock());
+        if (!con) {
+            return;
+        }
+
+        shard_type & s = shard_of(con);
+        scoped_lock_type guard(s.lock);
+
+        typename topic_map::iterator it = s.topics.find(topic);
+        if (it == s.topics.end()) {
+            return;
+        }
+
+        typename slot_map::iterator slot = it->second.slots.find(con.get());
+        if (slot != it->second.slots.end()) {
+            remove(it->second, slot->second.get_slot());
+        }
+        if (it->second.subscribers.empty()) {
+            s.topics.erase(it);
+        }
+    }
+
+    /// Unsubscribe a connection from every topic
+    /**
+     * Visits every topic of the connection's shard.
+     *
+     * @param hdl The connection
+     */
+    void unsubscribe_all(connection_hdl hdl) {
+        connection_ptr con = lib::static_pointer_cast<connection_type>(
+            hdl.lock());
+        if (!con) {
+            return;
+        }
+
+        shard_type & s = shard_of(con);
+        scoped_lock_type guard(s.lock);
+
+        typename topic_map::iterator it = s.topics.begin();
+        while (it != s.topics.end()) {
+            typename slot_map::iterator slot = it->second.slots.find(con.get());
+            if (slot != it->second.slots.end()) {
+                remove(it->second, slot->second.get_slot());
+            }
+            if (it->second.subscribers.empty()) {
+                s.topics.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// Publish a message to the subscribers of a topic
+    /**
+     * Returns once a fan-out task has been posted to each shard with
+     * subscribers to the topic. Messages published from one thread reach
+     * each subscriber in the order they were published.
+     *
+     * Messages are sent uncompressed so that subscribers can share frames.
+     *
+     * @param topic The topic
+     * @param payload The payload of the message
+     * @param op The opcode of the message
+     */
+    void publish(std::string const & topic, std::string const & payload,
+        frame::opcode::value op = frame::opcode::text)
+    {
+        {
+            scoped_lock_type guard(m_lock);
+            ++m_published;
+        }
+
+        lib::shared_ptr<publication> p;
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            {
+                scoped_lock_type guard(m_shards[i]->lock);
+                if (m_shards[i]->topics.find(topic) == m_shards[i]->topics.end()) {
+                    continue;
+                }
+            }
+            if (!p) {
+                p = lib::make_shared<publication>(topic, payload, op);
+            }
+            m_endpoint->post_to_shard(i, fan_out(this->shared_from_this(),
+                i, p));
+        }
+    }
+
+    /// Get the number of subscribers to a topic
+    size_t get_subscriber_count(std::string const & topic) const {
+        size_t count = 0;
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            scoped_lock_type guard(m_shards[i]->lock);
+            typename topic_map::const_iterator it =
+                m_shards[i]->topics.find(topic);
+            if (it != m_shards[i]->topics.end()) {
+                count += it->second.subscribers.size();
+            }
+        }
+        return count;
+    }
+
+    /// Get the broker counters summed over all shards
+    stats get_stats() const {
+        stats total;
+        {
+            scoped_lock_type guard(m_lock);
+            total.published = m_published;
+        }
+
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            shard_type const & s = *m_shards[i];
+            scoped_lock_type guard(s.lock);
+
+            typename topic_map::const_iterator it;
+            for (it = s.topics.begin(); it != s.topics.end(); ++it) {
+                total.subscribers += it->second.subscribers.size();
+            }
+            total.delivered += s.counters.delivered;
+            total.frames += s.counters.frames;
+            total.dropped += s.counters.dropped;
+            total.disconnected += s.counters.disconnected;
+        }
+        return total;
+    }
+private:
+    struct subscriber {
+        subscriber(connection_ptr c, backpressure::value p, size_t l)
+          : con(c), key(c.get()), policy(p), limit(l) {}
+
+        connection_weak_ptr con;
+        /// Address of the connection, its key in the slot map
+        connection_type const * key;
+        backpressure::value policy;
+        size_t              limit;
+    };
+
+    // Subscriber positions are keyed by connection address. The entry of a
+    // closed connection is replaced if a new connection at the same address
+    // subscribes before the entry is pruned.
+    typedef std::map<connection_type const *,slot_holder> slot_map;
+
+    /// The subscribers of a topic in one shard. Each subscriber is tracked
+    /// by the holder in the slot map under its connection's address.
+    struct subscription {
+        slot_list<subscriber>   subscribers;
+        slot_map                slots;
+    };
+
+    typedef std::map<std::string,subscription> topic_map;
+
+    /// A subscriber that a publication is sent to
+    struct target {
+        target(connection_ptr c, backpressure::value p, size_t l)
+          : con(c), policy(p), limit(l) {}
+
+        connection_ptr      con;
+        backpressure::value policy;
+        size_t              limit;
+    };
+
+    struct shard_type {
+        mutable mutex_type  lock;
+        topic_map           topics;
+        stats               counters;
+    };
+
+    struct publication {
+        publication(std::string const & t, std::string const & p,
+            frame::opcode::value o)
+          : topic(t), payload(p), op(o) {}
+
+        std::string             topic;
+        std::string             payload;
+        frame::opcode::value    op;
+    };
+
+    /// Task that sends a publication to the subscribers of one shard
+    /**
+     * Small enough to be posted as a transport dispatch handler.
+     */
+    class fan_out {
+    public:
+        fan_out(ptr b, size_t shard, lib::shared_ptr<publication> p)
+          : m_broker(b), m_shard(shard), m_publication(p) {}
+
+        void operator()() {
+            m_broker->send(m_shard, *m_publication);
+        }
+    private:
+        ptr                             m_broker;
+        size_t                          m_shard;
+        lib::shared_ptr<publication>    m_publication;
+    };
+
+    shard_type & shard_of(connection_ptr const & con) {
+        return *m_shards[con->get_shard_index() % m_shards.size()];
+    }
+
+    /// Remove a subscriber. Must be called with the shard's lock held.
+    void remove(subscription & sub, size_t slot) {
+        connection_type const * key = sub.subscribers[slot].key;
+        sub.subscribers.erase(slot);
+        sub.slots.erase(key);
+    }
+
+    /// Send a publication to the subscribers of a shard
+    /**
+     * The live subscribers are copied under the shard lock and messages are
+     * sent, and slow subscribers closed, after it is released. Subscribers
+     * whose connection has closed are removed when the lock is taken again.
+     */
+    void send(size_t shard, publication const & p) {
+        shard_type & s = *m_shards[shard];
+        std::vector<target> targets;
+
+        {
+            scoped_lock_type guard(s.lock);
+
+            typename topic_map::iterator it = s.topics.find(p.topic);
+            if (it == s.topics.end()) {
+                return;
+            }
+
+            subscription & sub = it->second;
+            targets.reserve(sub.subscribers.size());
+
+            size_t i = 0;
+            while (i < sub.subscribers.size()) {
+                subscriber const & entry = sub.subscribers[i];
+                connection_ptr con = entry.con.lock();
+                if (!con) {
+                    remove(sub, i);
+                    continue;
+                }
+                targets.push_back(target(con, entry.policy, entry.limit));
+                ++i;
+            }
+
+            if (sub.subscribers.empty()) {
+                s.topics.erase(it);
+                return;
+            }
+        }
+
+        message_ptr msg;
+        frame_cache frames;
+        stats counters;
+        std::vector<connection_ptr> closed;
+
+        for (size_t i = 0; i < targets.size(); ++i) {
+            connection_ptr const & con = targets[i].con;
+
+            if (targets[i].policy != backpressure::unbounded &&
+                con->get_buffered_amount() > targets[i].limit)
+            {
+                if (targets[i].policy == backpressure::drop) {
+                    ++counters.dropped;
+                    continue;
+                }
+
+                lib::error_code ec;
+                con->close(close::status::try_again_later,
+                    "subscriber too slow", ec);
+                ++counters.disconnected;
+                closed.push_back(con);
+                continue;
+            }
+
+            if (!msg) {
+                msg = con->get_message(p.op, p.payload.size());
+                msg->append_payload(p.payload);
+            }
+
+            lib::error_code ec = con->send(msg, frames);
+            if (!ec) {
+                ++counters.delivered;
+            } else if (ec == error::invalid_state ||
+                con->get_state() == session::state::closed)
+            {
+                // The connection is closing
+                closed.push_back(con);
+            }
+        }
+
+        scoped_lock_type guard(s.lock);
+
+        s.counters.delivered += counters.delivered;
+        s.counters.dropped += counters.dropped;
+        s.counters.disconnected += counters.disconnected;
+        s.counters.frames += frames.size();
+
+        if (closed.empty()) {
+            return;
+        }
+
+        typename topic_map::iterator it = s.topics.find(p.topic);
+        if (it == s.topics.end()) {
+            return;
+        }
+
+        subscription & sub = it->second;
+        for (size_t i = 0; i < closed.size(); ++i) {
+            typename slot_map::iterator slot = sub.slots.find(closed[i].get());
+            // The subscriber may have unsubscribed or been replaced meanwhile
+            if (slot != sub.slots.end() &&
+                sub.subscribers[slot->second.get_slot()].con.lock() ==
+                    closed[i])
+            {
+                remove(sub, slot->second.get_slot());
+            }
+        }
+
+        if (sub.subscribers.empty()) {
+            s.topics.erase(it);
+        }
+    }
+
+    endpoint_type * const       m_endpoint;
+    /// Each shard is allocated separately as its mutex cannot be copied
+    std::vector<lib::shared_ptr<shard_type> > m_shards;
+
+    mutable mutex_type          m_lock;
+    backpressure::value         m_policy;
+    size_t                      m_limit;
+    uint64_t                    m_published;
+};
+
+} // namespace pubsub
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_PUBSUB_HPP
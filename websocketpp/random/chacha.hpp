@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_RANDOM_CHACHA_HPP
+#define WEBSOCKETPP_RANDOM_CHACHA_HPP
+
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/random.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstring>
+
+// The generator state lives in thread local storage so that threads never
+// contend for it. The state is POD so the compiler extensions behind
+// _WEBSOCKETPP_THREAD_LOCAL_ are sufficient. If none are available each
+// generator keeps its own state behind the lock of its concurrency policy.
+
+namespace websocketpp {
+namespace random {
+/// RNG policy based on a ChaCha20 keystream seeded from random_device
+namespace chacha {
+
+/// Number of 64 byte blocks generated per refill of the buffer
+static unsigned int const batch_blocks = 4;
+
+/// Number of refills after which a thread rekeys from random_device
+static uint32_t const reseed_interval = 16384;
+
+/// ChaCha20 generator state
+/**
+ * Plain old data so that it can be stored in thread local storage on
+ * compilers without C++11 `thread_local`. A zero initialized state is
+ * unseeded.
+ */
+struct state {
+    /// ChaCha20 input block: constants, key, 64 bit counter and nonce
+    uint32_t input[16];
+    /// Buffered keystream not yet handed out
+    uint32_t buffer[16 * batch_blocks];
+    /// Index of the next unused word in buffer
+    uint32_t next;
+    /// Number of refills remaining before the next reseed
+    uint32_t refills;
+};
+
+namespace detail {
+
+inline uint32_t rotl(uint32_t v, int c) {
+    return (v << c) | (v >> (32 - c));
+}
+
+inline void quarter_round(uint32_t * x, int a, int b, int c, int d) {
+    x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+    x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+    x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+    x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+}
+
+/// Compute one ChaCha20 block (RFC 7539 section 2.3)
+/**
+ * @param [in] input The 16 word input block
+ * @param [out] output The 16 word keystream block
+ */
+inline void block(uint32_t const * input, uint32_t * output) {
+    uint32_t x[16];
+    std::memcpy(x, input, sizeof(x));
+
+    for (int i = 0; i < 10; i++) {
+        quarter_round(x, 0, 4,  8, 12);
+        quarter_round(x, 1, 5,  9, 13);
+        quarter_round(x, 2, 6, 10, 14);
+        quarter_round(x, 3, 7, 11, 15);
+        quarter_round(x, 0, 5, 10, 15);
+        quarter_round(x, 1, 6, 11, 12);
+        quarter_round(x, 2, 7,  8, 13);
+        quarter_round(x, 3, 4,  9, 14);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        output[i] = x[i] + input[i];
+    }
+}
+
+/// Load a fresh key and nonce from random_device and reset the counter
+inline void seed(state & s) {
+    lib::random_device rd;
+    lib::uniform_int_distribution<uint32_t> dis;
+
+    // "expand 32-byte k"
+    s.input[0] = 0x61707865;
+    s.input[1] = 0x3320646e;
+    s.input[2] = 0x79622d32;
+    s.input[3] = 0x6b206574;
+    for (int i = 4; i < 12; i++) {
+        s.input[i] = dis(rd);
+    }
+    s.input[12] = 0;
+    s.input[13] = 0;
+    s.input[14] = dis(rd);
+    s.input[15] = dis(rd);
+
+    s.refills = reseed_interval;
+}
+
+/// Fill the buffer with the next batch of keystream
+inline void refill(state & s) {
+    if (s.refills == 0) {
+        seed(s);
+    }
+    s.refills--;
+
+    for (unsigned int i = 0; i < batch_blocks; i++) {
+        block(s.input, s.buffer + 16 * i);
+        if (++s.input[12] == 0) {
+            s.input[13]++;
+        }
+    }
+    s.next = 0;
+}
+
+/// Return the next word of keystream
+inline uint32_t next(state & s) {
+    if (s.next == 16 * batch_blocks) {
+        refill(s);
+    }
+    return s.buffer[s.next++];
+}
+
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_
+/// Return the calling thread's generator state
+inline state & thread_state() {
+    static _WEBSOCKETPP_THREAD_LOCAL_ state s;
+    return s;
+}
+#endif
+
+} // namespace detail
+
+/// Fast cryptographically secure random integer generator.
+/**
+ * This template class produces random integers from a ChaCha20 keystream.
+ * Each thread keys its own stream from random_device on first use and again
+ * after every reseed_interval refills. Keystream is generated batch_blocks
+ * blocks at a time, so generating a number normally costs a copy out of a
+ * thread local buffer, with no locking and no system call.
+ *
+ * This makes it suitable for generating masking keys in clients that send
+ * large numbers of frames. All generators used by a thread share its stream.
+ * It is not the default; a client config uses it by setting `rng_type` to
+ * `random::chacha::int_generator<uint32_t, concurrency_type>`.
+ *
+ * The state is not reseeded across fork(). A child process that continues to
+ * generate numbers inherited from its parent should not rely on them being
+ * distinct from the parent's.
+ *
+ * If the compiler has no thread local storage, or
+ * `_WEBSOCKETPP_NO_THREAD_LOCAL_` is defined, each generator keeps its own
+ * stream and is made thread safe by locking based on the concurrency template
+ * parameter.
+ *
+ * Call operator() to generate the next number
+ *
+ * @since 0.8.0
+ */
+template <typename int_type, typename concurrency>
+class int_generator {
+    public:
+        typedef typename concurrency::scoped_lock_type scoped_lock_type;
+        typedef typename concurrency::mutex_type mutex_type;
+
+        /// constructor
+        int_generator() {
+#ifndef _WEBSOCKETPP_THREAD_LOCAL_
+            std::memset(&m_state, 0, sizeof(m_state));
+#endif
+        }
+
+        /// advances the engine's state and returns the generated value
+        int_type operator()() {
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_
+            return generate(detail::thread_state());
+#else
+            scoped_lock_type guard(m_lock);
+            return generate(m_state);
+#endif
+        }
+    private:
+        static int_type generate(state & s) {
+            // A zero initialized state has next == 0 and an all zero buffer.
+            // Treat it as exhausted so that the first call seeds it.
+            if (s.input[0] == 0) {
+                s.next = 16 * batch_blocks;
+                s.refills = 0;
+            }
+
+            uint32_t words[(sizeof(int_type) + 3) / 4];
+            for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+                words[i] = detail::next(s);
+            }
+
+            int_type value;
+            std::memcpy(&value, words, sizeof(int_type));
+            return value;
+        }
+
+#ifndef _WEBSOCKETPP_THREAD_LOCAL_
+        state m_state;
+        mutex_type m_lock;
+#endif
+};
+
+} // namespace chacha
+} // namespace random
+} // namespace websocketpp
+
+#endif //WEBSOCKETPP_RANDOM_CHACHA_HPP
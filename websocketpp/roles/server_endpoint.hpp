@@ -115,6 +115,9 @@ public:
      *
      * Refer to documentation for the transport policy you are using for
      * instructions on how to stop this acceptance loop.
+     *
+     * If the transport listens with more than one acceptor a separate loop is
+     * started for each of them on the thread that owns it.
      * 
      * @param [out] ec A status code indicating an error, if any.
      */
@@ -123,21 +126,18 @@ public:
             ec = error::make_error_code(error::async_accept_not_listening);
             return;
         }
-        
-        ec = lib::error_code();
-        connection_ptr con = get_connection();
-        
-        transport_type::async_accept(
-            lib::static_pointer_cast<transport_con_type>(con),
-            lib::bind(&type::handle_accept,this,con,lib::placeholders::_1),
-            ec
-        );
-        
-        if (ec && con) {
-            // If the connection was constructed but the accept failed,
-            // terminate the connection to prevent memory leaks
-            con->terminate(lib::error_code());
+
+        size_t acceptors = transport_type::get_acceptor_count();
+        if (acceptors > 1) {
+            ec = lib::error_code();
+            for (size_t i = 0; i < acceptors; ++i) {
+                transport_type::post_to_acceptor(i,
+                    lib::bind(&type::restart_accept,this));
+            }
+            return;
         }
+
+        accept_next(ec);
     }
 
     /// Starts the server's async connection acceptance loop
@@ -173,14 +173,42 @@ public:
             con->start();
         }
 
+        restart_accept();
+    }
+private:
+    /// Accept the next connection on the acceptor owned by this thread
+    void accept_next(lib::error_code & ec) {
+        if (!transport_type::is_listening()) {
+            ec = error::make_error_code(error::async_accept_not_listening);
+            return;
+        }
+
+        ec = lib::error_code();
+        connection_ptr con = get_connection();
+        
+        transport_type::async_accept(
+            lib::static_pointer_cast<transport_con_type>(con),
+            lib::bind(&type::handle_accept,this,con,lib::placeholders::_1),
+            ec
+        );
+        
+        if (ec && con) {
+            // If the connection was constructed but the accept failed,
+            // terminate the connection to prevent memory leaks
+            con->terminate(lib::error_code());
+        }
+    }
+
+    /// Continue an accept loop, logging why it stopped if it can't
+    void restart_accept() {
         lib::error_code start_ec;
-        start_accept(start_ec);
+        accept_next(start_ec);
         if (start_ec == error::async_accept_not_listening) {
             endpoint_type::m_elog.write(log::elevel::info,
                 "Stopping acceptance of new connections because the underlying transport is no longer listening.");
         } else if (start_ec) {
             endpoint_type::m_elog.write(log::elevel::rerror,
-                "Restarting async_accept loop failed: "+ec.message());
+                "Restarting async_accept loop failed: "+start_ec.message());
         }
     }
 };
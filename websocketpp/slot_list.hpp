@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_SLOT_LIST_HPP
+#define WEBSOCKETPP_SLOT_LIST_HPP
+
+#include <websocketpp/common/memory.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace websocketpp {
+
+template <typename T>
+class slot_list;
+
+/// Remembers where an element of a slot_list is
+/**
+ * Typically a base of the lease handed out for an element, so that the
+ * element can be removed in constant time when the lease is released. The
+ * slot is updated by the list whenever the element moves. It is only
+ * accessed under whatever lock protects the list.
+ *
+ * @since 0.8.0
+ */
+class slot_holder {
+public:
+    slot_holder() : m_slot(npos) {}
+
+    /// Whether the element is still in its list
+    bool is_listed() const {
+        return m_slot != npos;
+    }
+
+    /// Get the position of the element in its list
+    size_t get_slot() const {
+        return m_slot;
+    }
+private:
+    template <typename T>
+    friend class slot_list;
+
+    static size_t const npos = static_cast<size_t>(-1);
+
+    size_t m_slot;
+};
+
+/// Unordered list with constant time removal from any position
+/**
+ * An element is removed by moving the last element into its slot, so the
+ * order of the elements is not preserved. An element may be added with a
+ * slot_holder that follows it as it moves, which lets the owner of the
+ * element remove it without searching.
+ *
+ * Copies of a list do not update the holders of its elements.
+ *
+ * @since 0.8.0
+ */
+template <typename T>
+class slot_list {
+public:
+    /// Get the number of elements
+    size_t size() const {
+        return m_values.size();
+    }
+
+    bool empty() const {
+        return m_values.empty();
+    }
+
+    T & operator[](size_t slot) {
+        return m_values[slot];
+    }
+
+    T const & operator[](size_t slot) const {
+        return m_values[slot];
+    }
+
+    /// Add an element
+    /**
+     * @param value The element to add
+     * @param h The holder that will track the element, or NULL. Must not
+     * be tracking another element.
+     */
+    void push_back(T const & value, slot_holder * h = NULL) {
+        if (h) {
+            h->m_slot = m_values.size();
+        }
+        m_values.push_back(value);
+        m_holders.push_back(h);
+    }
+
+    /// Remove the element in a slot
+    void erase(size_t slot) {
+        if (m_holders[slot]) {
+            m_holders[slot]->m_slot = slot_holder::npos;
+        }
+
+        if (slot + 1 != m_values.size()) {
+            m_values[slot] = m_values.back();
+            m_holders[slot] = m_holders.back();
+            if (m_holders[slot]) {
+                m_holders[slot]->m_slot = slot;
+            }
+        }
+        m_values.pop_back();
+        m_holders.pop_back();
+    }
+
+    /// Remove the element tracked by a holder
+    /**
+     * @return False if the element was already removed
+     */
+    bool erase(slot_holder & h) {
+        if (!h.is_listed()) {
+            return false;
+        }
+        erase(h.m_slot);
+        return true;
+    }
+
+    /// Remove every element
+    void clear() {
+        std::vector<T> discard;
+        take(discard);
+    }
+
+    /// Remove every element, moving them into a vector
+    /**
+     * Lets the caller destroy the elements after releasing the lock that
+     * protects the list.
+     *
+     * @param out Receives the elements, replacing its previous contents
+     */
+    void take(std::vector<T> & out) {
+        for (size_t i = 0; i < m_holders.size(); ++i) {
+            if (m_holders[i]) {
+                m_holders[i]->m_slot = slot_holder::npos;
+            }
+        }
+        out.swap(m_values);
+        m_values.clear();
+        m_holders.clear();
+    }
+private:
+    std::vector<T>              m_values;
+    std::vector<slot_holder *>  m_holders;
+};
+
+/// Handle that tells its owner when it is released
+/**
+ * Handed out by a registry for each registration, usually as a
+ * `lib::shared_ptr<void>` that the registered object holds. The lease keeps
+ * its owner alive and calls `owner::release(slot_lease<owner> *)` when it is
+ * destroyed. The holder base may track the entry of the registration in a
+ * slot_list of the owner; a lease that is never listed only tells the owner
+ * that it was released.
+ *
+ * @since 0.8.0
+ */
+template <typename owner>
+class slot_lease : public slot_holder {
+public:
+    /// Type of a pointer to the owner of the lease
+    typedef lib::shared_ptr<owner> owner_ptr;
+
+    explicit slot_lease(owner_ptr const & o) : m_owner(o) {}
+
+    ~slot_lease() {
+        m_owner->release(this);
+    }
+
+    /// Get the owner of the lease
+    owner_ptr const & get_owner() const {
+        return m_owner;
+    }
+private:
+    // Non-copyable
+    slot_lease(slot_lease const &);
+    slot_lease & operator=(slot_lease const &);
+
+    owner_ptr m_owner;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_SLOT_LIST_HPP
@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRACE_RING_HPP
+#define WEBSOCKETPP_TRACE_RING_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/chrono.hpp>
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// Rings are owned by a C++11 thread_local object that frees them when its
+// thread exits. The thread local storage of older compilers only holds POD
+// objects, which cannot free anything, so there rings are never freed.
+#if defined(_WEBSOCKETPP_CPP11_INTERNAL_) && !defined(__APPLE__) && \
+    !defined(_WEBSOCKETPP_NO_THREAD_LOCAL_)
+    #define _WEBSOCKETPP_TRACE_RING_OWNER_
+#endif
+
+namespace websocketpp {
+namespace trace {
+
+namespace detail {
+
+/// A recorded trace event
+struct event {
+    /// Span name. Must be a string literal.
+    char const *    name;
+    /// Identity of an asynchronous span, zero for complete spans
+    uint64_t        id;
+    /// Start time in nanoseconds
+    uint64_t        ts;
+    /// Duration in nanoseconds of a complete span
+    uint64_t        dur;
+    /// Chrome trace event phase: 'X' complete, 'b' begin, 'e' end
+    char            phase;
+};
+
+/// Fixed size ring of the events recorded by one thread
+/**
+ * Only the owning thread writes. Each slot carries a sequence number that
+ * is odd while the slot is being written and otherwise identifies the event
+ * in it, so a reader can tell an event from one that was overwritten or is
+ * being overwritten while it was copied, and skip it.
+ */
+class thread_ring {
+public:
+    /// Number of events kept per thread
+    static size_t const capacity = 8192;
+
+    explicit thread_ring(size_t tid)
+      : m_tid(tid)
+      , m_head(0)
+      , m_slots(new slot[capacity]) {}
+
+    ~thread_ring() {
+        delete[] m_slots;
+    }
+
+    void push(event const & e) {
+        uint64_t head = m_head.load(lib::memory_order_relaxed);
+        slot & s = m_slots[head % capacity];
+        s.seq.store(2 * head + 1, lib::memory_order_relaxed);
+        lib::atomic_thread_fence(lib::memory_order_release);
+        s.e = e;
+        s.seq.store(2 * head + 2, lib::memory_order_release);
+        m_head.store(head + 1, lib::memory_order_release);
+    }
+
+    /// Copy out the events still in the ring, oldest first
+    void copy(std::vector<event> & out) const {
+        uint64_t head = m_head.load(lib::memory_order_acquire);
+        uint64_t first = head > capacity ? head - capacity : 0;
+        for (uint64_t i = first; i < head; ++i) {
+            slot const & s = m_slots[i % capacity];
+            if (s.seq.load(lib::memory_order_acquire) != 2 * i + 2) {
+                continue;
+            }
+            event e = s.e;
+            lib::atomic_thread_fence(lib::memory_order_acquire);
+            if (s.seq.load(lib::memory_order_relaxed) != 2 * i + 2) {
+                continue;
+            }
+            out.push_back(e);
+        }
+    }
+
+    void clear() {
+        m_head.store(0, lib::memory_order_release);
+    }
+
+    size_t get_tid() const {
+        return m_tid;
+    }
+private:
+    struct slot {
+        slot() : seq(0) {}
+
+        lib::atomic<uint64_t>   seq;
+        event                   e;
+    };
+
+    // Non-copyable
+    thread_ring(thread_ring const &);
+    thread_ring & operator=(thread_ring const &);
+
+    size_t                  m_tid;
+    lib::atomic<uint64_t>   m_head;
+    slot *                  m_slots;
+};
+
+/// The rings of the threads that are recording and of the threads that
+/// exited since the last dump. Must be locked to add or remove a ring and
+/// while rings are read.
+struct registry {
+    /// Number of rings of exited threads kept for the next dump
+    static size_t const max_retired = 64;
+
+    registry() : next_tid(0) {}
+
+    ~registry() {
+        for (size_t i = 0; i < retired.size(); ++i) {
+            delete retired[i];
+        }
+    }
+
+    /// Move the ring of an exiting thread to the retired list, freeing the
+    /// oldest retired ring if the list is full
+    void retire(thread_ring * ring) {
+        for (size_t i = 0; i < rings.size(); ++i) {
+            if (rings[i] == ring) {
+                rings.erase(rings.begin() + i);
+                break;
+            }
+        }
+
+        retired.push_back(ring);
+        if (retired.size() > max_retired) {
+            delete retired.front();
+            retired.erase(retired.begin());
+        }
+    }
+
+    /// Free the rings of exited threads
+    void free_retired() {
+        for (size_t i = 0; i < retired.size(); ++i) {
+            delete retired[i];
+        }
+        retired.clear();
+    }
+
+    lib::mutex                  lock;
+    std::vector<thread_ring *>  rings;
+    std::vector<thread_ring *>  retired;
+    size_t                      next_tid;
+};
+
+inline registry & get_registry() {
+    static registry r;
+    return r;
+}
+
+inline thread_ring * new_ring(registry & r) {
+    thread_ring * ring = new thread_ring(r.next_tid++);
+    r.rings.push_back(ring);
+    return ring;
+}
+
+#ifdef _WEBSOCKETPP_TRACE_RING_OWNER_
+/// Owns the ring of one thread and retires it when the thread exits
+class ring_owner {
+public:
+    ring_owner() : m_ring(NULL) {}
+
+    ~ring_owner() {
+        if (!m_ring) {
+            return;
+        }
+
+        registry & r = get_registry();
+        lib::lock_guard<lib::mutex> guard(r.lock);
+        r.retire(m_ring);
+    }
+
+    thread_ring * get() {
+        if (!m_ring) {
+            registry & r = get_registry();
+            lib::lock_guard<lib::mutex> guard(r.lock);
+            m_ring = new_ring(r);
+        }
+        return m_ring;
+    }
+private:
+    thread_ring * m_ring;
+};
+#endif // _WEBSOCKETPP_TRACE_RING_OWNER_
+
+inline uint64_t now() {
+    return static_cast<uint64_t>(
+        lib::chrono::duration_cast<lib::chrono::nanoseconds>(
+            lib::chrono::steady_clock::now().time_since_epoch()
+        ).count()
+    );
+}
+
+/// Record an event in the calling thread's ring
+inline void record(char phase, char const * name, void const * id,
+    uint64_t ts, uint64_t dur)
+{
+    event e;
+    e.name = name;
+    e.id = static_cast<uint64_t>(reinterpret_cast<size_t>(id));
+    e.ts = ts;
+    e.dur = dur;
+    e.phase = phase;
+
+#if defined(_WEBSOCKETPP_TRACE_RING_OWNER_)
+    static thread_local ring_owner owner;
+    owner.get()->push(e);
+#elif defined(_WEBSOCKETPP_THREAD_LOCAL_)
+    static _WEBSOCKETPP_THREAD_LOCAL_ thread_ring * ring = NULL;
+    if (!ring) {
+        registry & r = get_registry();
+        lib::lock_guard<lib::mutex> guard(r.lock);
+        ring = new_ring(r);
+    }
+    ring->push(e);
+#else
+    // Without thread local storage all threads share one ring
+    registry & r = get_registry();
+    lib::lock_guard<lib::mutex> guard(r.lock);
+    if (r.rings.empty()) {
+        new_ring(r);
+    }
+    r.rings[0]->push(e);
+#endif
+}
+
+/// Write a nanosecond count as microseconds with three decimals
+inline void write_us(std::ostream & out, uint64_t ns) {
+    uint64_t frac = ns % 1000;
+    out << ns / 1000 << '.' << char('0' + frac / 100)
+        << char('0' + frac / 10 % 10) << char('0' + frac % 10);
+}
+
+} // namespace detail
+
+/// Tracing policy that records spans into per thread ring buffers
+/**
+ * Each thread that records a span gets its own ring of the most recent
+ * `detail::thread_ring::capacity` events, so recording takes no lock and
+ * touches no shared cache lines; the only synchronization is a mutex taken
+ * when a thread registers its ring and when it exits.
+ *
+ * `dump` writes the recorded events in the Chrome trace event JSON format,
+ * which chrome://tracing and Perfetto load directly. Dumping while other
+ * threads record is safe; events overwritten while they are copied are left
+ * out.
+ *
+ * When a thread exits its ring is kept until the next `dump` or `clear`, so
+ * the events of joined worker threads can still be dumped. At most
+ * `detail::registry::max_retired` rings of exited threads are kept; beyond
+ * that the oldest are freed with their events. Without C++11 `thread_local`
+ * rings are never freed.
+ *
+ * To enable it, set `trace_type` in the endpoint config:
+ * `typedef websocketpp::trace::ring trace_type;`
+ *
+ * @since 0.8.0
+ */
+class ring {
+public:
+    /// Whether this policy records anything
+    static bool const enabled = true;
+
+    /// Span covering the lifetime of the object
+    class scope {
+    public:
+        /**
+         * @param name The name of the span. Must be a string literal.
+         */
+        explicit scope(char const * name)
+          : m_name(name), m_start(detail::now()) {}
+
+        ~scope() {
+            detail::record('X', m_name, NULL, m_start,
+                detail::now() - m_start);
+        }
+    private:
+        char const *    m_name;
+        uint64_t        m_start;
+    };
+
+    /// Begin an asynchronous span
+    /**
+     * Asynchronous spans may end on a different thread than they began.
+     *
+     * @param name The name of the span. Must be a string literal.
+     * @param id The object the span belongs to
+     */
+    static void begin(char const * name, void const * id) {
+        detail::record('b', name, id, detail::now(), 0);
+    }
+
+    /// End an asynchronous span
+    /**
+     * @param name The name given to begin
+     * @param id The object given to begin
+     */
+    static void end(char const * name, void const * id) {
+        detail::record('e', name, id, detail::now(), 0);
+    }
+
+    /// Write the recorded events as Chrome trace event JSON
+    /**
+     * Writes the events of the running threads and of the threads that
+     * exited since the last dump, then frees the rings of the exited
+     * threads.
+     */
+    static void dump(std::ostream & out) {
+        detail::registry & r = detail::get_registry();
+        lib::lock_guard<lib::mutex> guard(r.lock);
+
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        for (size_t i = 0; i < r.rings.size(); ++i) {
+            write_ring(out, *r.rings[i], first);
+        }
+        for (size_t i = 0; i < r.retired.size(); ++i) {
+            write_ring(out, *r.retired[i], first);
+        }
+        out << "\n]}\n";
+
+        r.free_retired();
+    }
+
+    /// Discard the recorded events of all threads
+    /**
+     * Must not be called while other threads record.
+     */
+    static void clear() {
+        detail::registry & r = detail::get_registry();
+        lib::lock_guard<lib::mutex> guard(r.lock);
+        for (size_t i = 0; i < r.rings.size(); ++i) {
+            r.rings[i]->clear();
+        }
+        r.free_retired();
+    }
+private:
+    static void write_ring(std::ostream & out, detail::thread_ring const & ring,
+        bool & first)
+    {
+        std::vector<detail::event> events;
+        ring.copy(events);
+
+        for (size_t j = 0; j < events.size(); ++j) {
+            detail::event const & e = events[j];
+            out << (first ? "\n" : ",\n")
+                << "{\"name\":\"" << e.name
+                << "\",\"cat\":\"websocketpp\",\"ph\":\"" << e.phase
+                << "\",\"pid\":1,\"tid\":" << ring.get_tid()
+                << ",\"ts\":";
+            detail::write_us(out, e.ts);
+            if (e.phase == 'X') {
+                out << ",\"dur\":";
+                detail::write_us(out, e.dur);
+            } else {
+                out << ",\"id\":\"0x" << std::hex << e.id << std::dec
+                    << "\"";
+            }
+            out << "}";
+            first = false;
+        }
+    }
+};
+
+} // namespace trace
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRACE_RING_HPP
@@ -31,9 +31,11 @@
 #include <websocketpp/common/asio.hpp>
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
 #include <websocketpp/common/system_error.hpp>
 #include <websocketpp/common/type_traits.hpp>
 
+#include <cstddef>
 #include <string>
 
 namespace websocketpp {
@@ -77,6 +79,10 @@ public:
         }
     }
 
+    void deallocate(void * pointer, std::size_t /*memsize*/) {
+        deallocate(pointer);
+    }
+
 private:
     // Storage space used for handler-based custom memory allocation.
     lib::aligned_storage<size>::type m_storage;
@@ -85,17 +91,213 @@ private:
     bool m_in_use;
 };
 
+/// Recycling memory arena for asio handlers
+/**
+ * A handler_arena hands out memory for the operations a connection starts on
+ * its io_service, such as reads, writes, timer waits, posts and handshakes.
+ * Requests are rounded up to one of a few power of two size classes. Blocks
+ * are taken from the global heap the first time a size class is needed and
+ * are kept on a free list when released, so once a connection has warmed up
+ * its operations are served without touching the heap. Requests larger than
+ * the largest size class are passed through to the global heap.
+ *
+ * Operations of one connection may be started and completed on different
+ * threads, so the free lists are protected by a mutex of the given
+ * concurrency policy.
+ *
+ * @since 0.8.0
+ */
+template <typename concurrency>
+class handler_arena {
+public:
+    /// Size of the smallest size class in bytes
+    static size_t const min_block_size = 64;
+    /// Number of size classes, each twice the size of the one before
+    static size_t const size_classes = 6;
+    /// Number of released blocks kept per size class
+    static size_t const max_free_blocks = 8;
+
+    /// Type of the mutex protecting the free lists
+    typedef typename concurrency::mutex_type mutex_type;
+    /// Type of a lock on the free lists
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+
+    handler_arena() : m_heap_allocations(0) {
+        for (size_t i = 0; i < size_classes; ++i) {
+            m_free[i] = NULL;
+            m_free_count[i] = 0;
+        }
+    }
+
+    ~handler_arena() {
+        for (size_t i = 0; i < size_classes; ++i) {
+            while (m_free[i]) {
+                block * next = m_free[i]->next;
+                ::operator delete(static_cast<void *>(m_free[i]));
+                m_free[i] = next;
+            }
+        }
+    }
+
+#ifdef _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
+    handler_arena(handler_arena const &) = delete;
+    handler_arena & operator=(handler_arena const &) = delete;
+#endif
+
+    /// Allocate memory for an operation
+    /**
+     * @param memsize The number of bytes requested
+     * @return A pointer to at least memsize bytes
+     */
+    void * allocate(std::size_t memsize) {
+        size_t c = size_class(memsize);
+
+        {
+            scoped_lock_type lock(m_lock);
+            if (c < size_classes && m_free[c]) {
+                block * b = m_free[c];
+                m_free[c] = b->next;
+                --m_free_count[c];
+                return static_cast<void *>(b);
+            }
+            ++m_heap_allocations;
+        }
+
+        if (c < size_classes) {
+            return ::operator new(min_block_size << c);
+        } else {
+            return ::operator new(memsize);
+        }
+    }
+
+    /// Release memory obtained from allocate
+    /**
+     * @param pointer The pointer returned by allocate
+     * @param memsize The number of bytes that were requested
+     */
+    void deallocate(void * pointer, std::size_t memsize) {
+        size_t c = size_class(memsize);
+
+        if (c < size_classes) {
+            scoped_lock_type lock(m_lock);
+            if (m_free_count[c] < max_free_blocks) {
+                block * b = static_cast<block *>(pointer);
+                b->next = m_free[c];
+                m_free[c] = b;
+                ++m_free_count[c];
+                return;
+            }
+        }
+
+        ::operator delete(pointer);
+    }
+
+    /// Get the number of allocations that were passed to the global heap
+    /**
+     * Counts new blocks as well as requests too large for any size class.
+     * This stops growing once the connection's operations have warmed up.
+     */
+    size_t get_heap_allocations() const {
+        scoped_lock_type lock(m_lock);
+        return m_heap_allocations;
+    }
+private:
+    struct block {
+        block * next;
+    };
+
+    static size_t size_class(std::size_t memsize) {
+        size_t c = 0;
+        for (size_t b = min_block_size; b < memsize && c < size_classes; b <<= 1) {
+            ++c;
+        }
+        return c;
+    }
+
+    block *             m_free[size_classes];
+    size_t              m_free_count[size_classes];
+    size_t              m_heap_allocations;
+    mutable mutex_type  m_lock;
+};
+
+/// Standard allocator that draws from a shared handler_arena
+/**
+ * Used for objects that are created alongside asio operations, such as the
+ * timers returned by `connection::set_timer`. The allocator shares ownership
+ * of the arena so that objects may outlive the connection that created them.
+ *
+ * @since 0.8.0
+ */
+template <typename T, typename Arena>
+class arena_allocator {
+public:
+    typedef T value_type;
+    typedef T * pointer;
+    typedef T const * const_pointer;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef arena_allocator<U, Arena> other;
+    };
+
+    explicit arena_allocator(lib::shared_ptr<Arena> const & arena)
+      : m_arena(arena) {}
+
+    template <typename U>
+    arena_allocator(arena_allocator<U, Arena> const & other)
+      : m_arena(other.get_arena()) {}
+
+    pointer allocate(size_type n, void const * = 0) {
+        return static_cast<pointer>(m_arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type n) {
+        m_arena->deallocate(p, n * sizeof(T));
+    }
+
+    size_type max_size() const {
+        return size_type(-1) / sizeof(T);
+    }
+
+    lib::shared_ptr<Arena> const & get_arena() const {
+        return m_arena;
+    }
+private:
+    lib::shared_ptr<Arena> m_arena;
+};
+
+template <typename T, typename U, typename Arena>
+bool operator==(arena_allocator<T, Arena> const & a,
+    arena_allocator<U, Arena> const & b)
+{
+    return a.get_arena() == b.get_arena();
+}
+
+template <typename T, typename U, typename Arena>
+bool operator!=(arena_allocator<T, Arena> const & a,
+    arena_allocator<U, Arena> const & b)
+{
+    return a.get_arena() != b.get_arena();
+}
+
 // Wrapper class template for handler objects to allow handler memory
 // allocation to be customised. Calls to operator() are forwarded to the
-// encapsulated handler.
-template <typename Handler>
+// encapsulated handler. The allocator may be a handler_allocator or a
+// handler_arena.
+template <typename Handler, typename Allocator = handler_allocator>
 class custom_alloc_handler {
 public:
-    custom_alloc_handler(handler_allocator& a, Handler h)
+    custom_alloc_handler(Allocator& a, Handler h)
       : allocator_(a),
         handler_(h)
     {}
 
+    void operator()() {
+        handler_();
+    }
+
     template <typename Arg1>
     void operator()(Arg1 arg1) {
         handler_(arg1);
@@ -107,36 +309,30 @@ public:
     }
 
     friend void* asio_handler_allocate(std::size_t size,
-        custom_alloc_handler<Handler> * this_handler)
+        custom_alloc_handler<Handler, Allocator> * this_handler)
     {
         return this_handler->allocator_.allocate(size);
     }
 
-    friend void asio_handler_deallocate(void* pointer, std::size_t /*size*/,
-        custom_alloc_handler<Handler> * this_handler)
+    friend void asio_handler_deallocate(void* pointer, std::size_t size,
+        custom_alloc_handler<Handler, Allocator> * this_handler)
     {
-        this_handler->allocator_.deallocate(pointer);
+        this_handler->allocator_.deallocate(pointer, size);
     }
 
 private:
-    handler_allocator & allocator_;
+    Allocator & allocator_;
     Handler handler_;
 };
 
 // Helper function to wrap a handler object to add custom allocation.
-template <typename Handler>
-inline custom_alloc_handler<Handler> make_custom_alloc_handler(
-    handler_allocator & a, Handler h)
+template <typename Allocator, typename Handler>
+inline custom_alloc_handler<Handler, Allocator> make_custom_alloc_handler(
+    Allocator & a, Handler h)
 {
-    return custom_alloc_handler<Handler>(a, h);
+    return custom_alloc_handler<Handler, Allocator>(a, h);
 }
 
-
-
-
-
-
-
 // Forward declaration of class endpoint so that it can be friended/referenced
 // before being included.
 template <typename config>
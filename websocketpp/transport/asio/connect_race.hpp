@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_TRANSPORT_ASIO_CONNECT_RACE_HPP
+#define WEBSOCKETPP_TRANSPORT_ASIO_CONNECT_RACE_HPP
+
+#include <websocketpp/common/asio.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+/// Races staggered TCP connection attempts (RFC 8305 "Happy Eyeballs")
+/**
+ * Connects to the first of a list of endpoints that accepts. Attempts are
+ * started one at a time in list order. The next attempt starts when the
+ * previous one fails or, if it is still pending, after the connection attempt
+ * delay, so a dead address costs at most one delay instead of a full connect
+ * timeout. The first socket to connect wins and all other attempts are
+ * closed.
+ *
+ * Use interleave to order resolved endpoints by alternating address
+ * families.
+ *
+ * All completion handlers, including the final one, run through the given
+ * strand if there is one. cancel must be called from the same context.
+ *
+ * @since 0.8.0
+ */
+class connect_race : public lib::enable_shared_from_this<connect_race> {
+public:
+    /// Type of a shared pointer to a connect race
+    typedef lib::shared_ptr<connect_race> ptr;
+    /// Type of an endpoint to connect to
+    typedef lib::asio::ip::tcp::endpoint endpoint_type;
+    /// Type of a racing socket
+    typedef lib::asio::ip::tcp::socket socket_type;
+    /// Type of a shared pointer to a racing socket
+    typedef lib::shared_ptr<socket_type> socket_ptr;
+    /// Type of a shared pointer to the strand handlers are run through
+    typedef lib::shared_ptr<lib::asio::io_service::strand> strand_ptr;
+    /// Type of the race completion handler
+    /**
+     * Called once with the connected socket, or with the error of the last
+     * attempt if all attempts failed, or with operation_aborted if the race
+     * was cancelled.
+     */
+    typedef lib::function<void(lib::asio::error_code const &,socket_ptr)>
+        handler;
+
+    /// Construct a race
+    /**
+     * @param service The io_service to create the sockets on
+     * @param strand The strand to run handlers through, may be empty
+     * @param endpoints The endpoints to connect to, in order. Must not be
+     * empty.
+     * @param delay The connection attempt delay in milliseconds
+     */
+    connect_race(lib::asio::io_service & service, strand_ptr strand,
+        std::vector<endpoint_type> const & endpoints, long delay)
+      : m_service(service)
+      , m_strand(strand)
+      , m_endpoints(endpoints)
+      , m_delay(delay)
+      , m_timer(service)
+      , m_next(0)
+      , m_pending(0)
+      , m_generation(0)
+      , m_done(false) {}
+
+    /// Order endpoints by alternating address families
+    /**
+     * The first endpoint keeps its place and the remaining endpoints
+     * alternate between its address family and the other one, preserving the
+     * resolver's order within each family (RFC 8305 section 4).
+     *
+     * @param endpoints The endpoints in the order returned by the resolver
+     * @return The ordered endpoints
+     */
+    static std::vector<endpoint_type> interleave(
+        std::vector<endpoint_type> const & endpoints)
+    {
+        std::vector<endpoint_type> first;
+        std::vector<endpoint_type> other;
+
+        for (size_t i = 0; i < endpoints.size(); ++i) {
+            if (first.empty() ||
+                endpoints[i].protocol() == first[0].protocol())
+            {
+                first.push_back(endpoints[i]);
+            } else {
+                other.push_back(endpoints[i]);
+            }
+        }
+
+        std::vector<endpoint_type> result;
+        for (size_t i = 0; i < first.size() || i < other.size(); ++i) {
+            if (i < first.size()) {
+                result.push_back(first[i]);
+            }
+            if (i < other.size()) {
+                result.push_back(other[i]);
+            }
+        }
+        return result;
+    }
+
+    /// Start the race
+    /**
+     * @param h The handler to call once the race is decided
+     */
+    void start(handler h) {
+        m_handler = h;
+        attempt();
+    }
+
+    /// Abandon the race
+    /**
+     * Closes all sockets and calls the handler with operation_aborted, unless
+     * the race was already decided.
+     */
+    void cancel() {
+        if (!m_done) {
+            finish(lib::asio::error::operation_aborted, socket_ptr());
+        }
+    }
+private:
+    typedef lib::function<void(lib::asio::error_code const &)> io_handler;
+
+    io_handler wrap(io_handler h) {
+        if (m_strand) {
+            return m_strand->wrap(h);
+        }
+        return h;
+    }
+
+    /// Start the next attempt and arm the delay timer for the one after it
+    void attempt() {
+        size_t index = m_next++;
+
+        socket_ptr s(new socket_type(m_service));
+        m_sockets.push_back(s);
+        m_pending++;
+
+        s->async_connect(m_endpoints[index], wrap(lib::bind(
+            &connect_race::handle_connect,
+            shared_from_this(),
+            index,
+            lib::placeholders::_1
+        )));
+
+        m_generation++;
+        if (m_next < m_endpoints.size()) {
+            m_timer.expires_from_now(lib::asio::milliseconds(m_delay));
+            m_timer.async_wait(wrap(lib::bind(
+                &connect_race::handle_timer,
+                shared_from_this(),
+                m_generation,
+                lib::placeholders::_1
+            )));
+        }
+    }
+
+    void handle_timer(size_t generation, lib::asio::error_code const & ec) {
+        // A timer that expired just as it was cancelled still completes
+        // without an error, so stale timers are recognized by generation.
+        if (ec || m_done || generation != m_generation) {
+            return;
+        }
+        attempt();
+    }
+
+    void handle_connect(size_t index, lib::asio::error_code const & ec) {
+        if (m_done) {
+            return;
+        }
+
+        m_pending--;
+
+        if (!ec) {
+            socket_ptr s = m_sockets[index];
+            m_sockets[index].reset();
+            finish(ec, s);
+            return;
+        }
+
+        lib::asio::error_code cec;
+        m_sockets[index]->close(cec);
+        m_sockets[index].reset();
+
+        if (m_next < m_endpoints.size()) {
+            // Don't wait out the delay after a failure
+            m_timer.cancel(cec);
+            attempt();
+        } else if (m_pending == 0) {
+            finish(ec, socket_ptr());
+        }
+    }
+
+    void finish(lib::asio::error_code const & ec, socket_ptr s) {
+        m_done = true;
+
+        lib::asio::error_code cec;
+        m_timer.cancel(cec);
+        for (size_t i = 0; i < m_sockets.size(); ++i) {
+            if (m_sockets[i]) {
+                m_sockets[i]->close(cec);
+            }
+        }
+        m_sockets.clear();
+
+        // The handler usually holds the connection, don't keep it alive
+        handler h;
+        std::swap(h, m_handler);
+        h(ec, s);
+    }
+
+    lib::asio::io_service &     m_service;
+    strand_ptr                  m_strand;
+    std::vector<endpoint_type>  m_endpoints;
+    long                        m_delay;
+    lib::asio::steady_timer     m_timer;
+    std::vector<socket_ptr>     m_sockets;
+    size_t                      m_next;
+    size_t                      m_pending;
+    size_t                      m_generation;
+    bool                        m_done;
+    handler                     m_handler;
+};
+
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_ASIO_CONNECT_RACE_HPP
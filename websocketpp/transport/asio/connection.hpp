@@ -29,9 +29,11 @@
 #define WEBSOCKETPP_TRANSPORT_ASIO_CON_HPP
 
 #include <websocketpp/transport/asio/base.hpp>
+#include <websocketpp/transport/asio/timer.hpp>
 
 #include <websocketpp/transport/base/connection.hpp>
 
+#include <websocketpp/logger/format.hpp>
 #include <websocketpp/logger/levels.hpp>
 #include <websocketpp/http/constants.hpp>
 
@@ -46,6 +48,7 @@
 #include <websocketpp/common/functional.hpp>
 #include <websocketpp/common/connection_hdl.hpp>
 
+#include <algorithm>
 #include <istream>
 #include <sstream>
 #include <string>
@@ -89,8 +92,16 @@ public:
     typedef lib::asio::io_service * io_service_ptr;
     /// Type of a pointer to the Asio io_service::strand being used
     typedef lib::shared_ptr<lib::asio::io_service::strand> strand_ptr;
-    /// Type of a pointer to the Asio timer class
-    typedef lib::shared_ptr<lib::asio::steady_timer> timer_ptr;
+    /// Type of a pointer to a connection timer
+    typedef lib::shared_ptr<timer> timer_ptr;
+    /// Type of the timer wheel shared by connections on an io_service
+    typedef timer_wheel<typename config::concurrency_type> timer_wheel_type;
+    /// Type of a pointer to a timer wheel
+    typedef typename timer_wheel_type::ptr timer_wheel_ptr;
+    /// Type of the arena that holds memory for this connection's operations
+    typedef handler_arena<typename config::concurrency_type> handler_arena_type;
+    /// Type of a pointer to a handler arena
+    typedef lib::shared_ptr<handler_arena_type> handler_arena_ptr;
 
     // connection is friends with its associated endpoint to allow the endpoint
     // to call private/protected utility methods that we don't want to expose
@@ -102,10 +113,23 @@ public:
       : m_is_server(is_server)
       , m_alog(alog)
       , m_elog(elog)
+      , m_shard_index(0)
+      , m_handler_arena(lib::make_shared<handler_arena_type>())
     {
         m_alog.write(log::alevel::devel,"asio con transport constructor");
     }
 
+    ~connection() {
+        // Unlink the wheel entries of timeouts that can no longer call back.
+        // If the wheel is gone it has already unlinked them.
+        timer_wheel_ptr wheel = m_timer_wheel.lock();
+        if (wheel) {
+            for (size_t i = 0; i < wheel_entry_count; ++i) {
+                wheel->release(m_wheel_entries[i]);
+            }
+        }
+    }
+
     /// Get a shared pointer to this component
     ptr get_shared() {
         return lib::static_pointer_cast<type>(socket_con_type::get_shared());
@@ -279,6 +303,10 @@ public:
      * @return A string identifying the address of the remote endpoint
      */
     std::string get_remote_endpoint() const {
+        if (!m_socket_path.empty()) {
+            return "unix:" + m_socket_path;
+        }
+
         lib::error_code ec;
 
         std::string ret = socket_con_type::get_remote_endpoint(ec);
@@ -291,6 +319,19 @@ public:
         }
     }
 
+    /// Get the unix domain socket path of this connection
+    /**
+     * Only endpoints using the `local_socket` or `local_tls_socket` socket
+     * policies have unix domain socket connections.
+     *
+     * @since 0.8.0
+     *
+     * @return The path of the socket, or an empty string for TCP connections
+     */
+    std::string const & get_socket_path() const {
+        return m_socket_path;
+    }
+
     /// Get the connection handle
     connection_hdl get_handle() const {
         return m_connection_hdl;
@@ -303,6 +344,17 @@ public:
      * A cancelled timer will return the error code error::operation_aborted
      * A timer that expired will return no error.
      *
+     * If the endpoint has a timer wheel resolution set the timer is scheduled
+     * on the wheel shared by this connection's io_service and may fire up to
+     * one tick late. It is linked through one of the connection's own wheel
+     * entries, which are enough for the handshake, ping and shutdown
+     * timeouts that can be pending at once, and its handle comes from the
+     * handler arena.
+     *
+     * The callback is stored in the Asio handler as is, which comes from the
+     * connection's handler arena, so rearming a timer with a callback that is
+     * not a `lib::function` does not allocate once the arena has warmed up.
+     *
      * @param duration Length of time to wait in milliseconds
      *
      * @param callback The function to call back when the timer has expired
@@ -310,31 +362,74 @@ public:
      * @return A handle that can be used to cancel the timer if it is no longer
      * needed.
      */
-    timer_ptr set_timer(long duration, timer_handler callback) {
-        timer_ptr new_timer = lib::make_shared<lib::asio::steady_timer>(
-            lib::ref(*m_io_service),
-            lib::asio::milliseconds(duration)
-        );
+    template <typename Handler>
+    timer_ptr set_timer(long duration, Handler const & callback) {
+        timer_wheel_ptr wheel = m_timer_wheel.lock();
+        if (wheel) {
+            arena_allocator<void, handler_arena_type> alloc(m_handler_arena);
+
+            lib::shared_ptr<wheel_timeout<Handler> > t =
+                lib::allocate_shared<wheel_timeout<Handler> >(alloc,
+                    get_shared(), callback);
+            if (wheel->schedule(m_wheel_entries, wheel_entry_count, t,
+                duration))
+            {
+                return t;
+            }
 
-        if (config::enable_multithreading) {
-            new_timer->async_wait(m_strand->wrap(lib::bind(
-                &type::handle_timer, get_shared(),
-                new_timer,
-                callback,
-                lib::placeholders::_1
-            )));
+            // Every entry is pending, so link this one through its own
+            lib::shared_ptr<linked_wheel_timeout<Handler> > linked =
+                lib::allocate_shared<linked_wheel_timeout<Handler> >(alloc,
+                    get_shared(), callback);
+            wheel->schedule(&linked->link, 1, linked, duration);
+            return linked;
+        }
+
+        io_service_ptr service = m_io_service;
+        lib::shared_ptr<basic_timer> new_timer =
+            lib::allocate_shared<basic_timer>(
+                arena_allocator<basic_timer, handler_arena_type>(
+                    m_handler_arena),
+                lib::ref(*service),
+                duration
+            );
+
+        if (config::enable_multithreading && m_strand) {
+            new_timer->get_timer().async_wait(m_strand->wrap(
+                make_custom_alloc_handler(
+                    *m_handler_arena,
+                    timer_callback<Handler>(get_shared(), new_timer, callback)
+                )
+            ));
         } else {
-            new_timer->async_wait(lib::bind(
-                &type::handle_timer, get_shared(),
-                new_timer,
-                callback,
-                lib::placeholders::_1
+            new_timer->get_timer().async_wait(make_custom_alloc_handler(
+                *m_handler_arena,
+                timer_callback<Handler>(get_shared(), new_timer, callback)
             ));
         }
 
         return new_timer;
     }
 
+    /// Call back a function after a period of time.
+    /**
+     * Overload for plain functions, which the handler template cannot store
+     * by value.
+     *
+     * @param duration Length of time to wait in milliseconds
+     *
+     * @param callback The function to call back when the timer has expired
+     *
+     * @return A handle that can be used to cancel the timer if it is no longer
+     * needed.
+     */
+    timer_ptr set_timer(long duration,
+        void (*callback)(lib::error_code const &))
+    {
+        return set_timer<void (*)(lib::error_code const &)>(duration,
+            callback);
+    }
+
     /// Timer callback
     /**
      * The timer pointer is included to ensure the timer isn't destroyed until
@@ -346,7 +441,8 @@ public:
      * @param callback The function to call back
      * @param ec The status code
      */
-    void handle_timer(timer_ptr, timer_handler callback,
+    template <typename Handler>
+    void handle_timer(timer_ptr, Handler const & callback,
         lib::asio::error_code const & ec)
     {
         if (ec) {
@@ -361,11 +457,109 @@ public:
         }
     }
 
+    /// Timer wheel callback
+    /**
+     * Timeouts on the endpoint's timer wheel only hold a weak reference to
+     * the connection, so that the wheel and the connections on it do not
+     * keep each other alive. The callback is dropped if the connection is
+     * gone and otherwise runs in the connection's strand, if it has one.
+     *
+     * @param weak The connection that set the timer
+     * @param callback The function to call back
+     * @param ec The status code
+     */
+    template <typename Handler>
+    static void handle_wheel_timer(lib::weak_ptr<type> weak,
+        Handler const & callback, lib::error_code const & ec)
+    {
+        ptr con = weak.lock();
+        if (!con) {
+            return;
+        }
+
+        if (config::enable_multithreading && con->m_strand) {
+            con->m_strand->dispatch(lib::bind(callback, ec));
+        } else {
+            callback(ec);
+        }
+    }
+
+    /// Asio handler of a connection timer
+    /**
+     * Used instead of lib::bind, which would treat a bound callback passed
+     * as an argument as a nested bind expression.
+     */
+    template <typename Handler>
+    struct timer_callback {
+        timer_callback(ptr c, timer_ptr t, Handler const & h)
+          : con(c), timer(t), handler(h) {}
+
+        void operator()(lib::asio::error_code const & ec) const {
+            con->handle_timer(timer, handler, ec);
+        }
+
+        ptr con;
+        timer_ptr timer;
+        Handler handler;
+    };
+
+    /// Timer wheel timeout of a connection timer
+    template <typename Handler>
+    class wheel_timeout : public timer_wheel_type::timeout {
+    public:
+        wheel_timeout(ptr c, Handler const & h) : con(c), handler(h) {}
+
+        void call(lib::error_code const & ec) {
+            handle_wheel_timer(con, handler, ec);
+        }
+
+        lib::weak_ptr<type> con;
+        Handler handler;
+    };
+
+    /// Timer wheel timeout linked through an entry of its own
+    template <typename Handler>
+    class linked_wheel_timeout : public wheel_timeout<Handler> {
+    public:
+        linked_wheel_timeout(ptr c, Handler const & h)
+          : wheel_timeout<Handler>(c, h) {}
+
+        typename timer_wheel_type::entry link;
+    };
+
     /// Get a pointer to this connection's strand
+    /**
+     * The pointer is empty if multithreading is disabled or the connection
+     * was initialized without a strand.
+     */
     strand_ptr get_strand() {
         return m_strand;
     }
 
+    /// Get a pointer to the arena used for this connection's operations
+    /**
+     * Memory for every Asio operation the transport starts on behalf of this
+     * connection, and for the timers returned by set_timer, is recycled
+     * through this arena. Its heap allocation count can be used to verify
+     * that a warmed up connection no longer allocates for these.
+     *
+     * @since 0.8.0
+     */
+    handler_arena_ptr get_handler_arena() const {
+        return m_handler_arena;
+    }
+
+    /// Get the index of the endpoint shard this connection belongs to
+    /**
+     * This is the index of the connection's io_service in the endpoint's
+     * pool, zero if the endpoint does not use a pool.
+     *
+     * @since 0.8.0
+     */
+    size_t get_shard_index() const {
+        return m_shard_index;
+    }
+
     /// Get the internal transport error code for a closed/failed connection
     /**
      * Retrieves a machine readable detailed error code indicating the reason
@@ -408,9 +602,7 @@ public:
      */
 protected:
     void init(init_handler callback) {
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,"asio connection init");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "asio connection init");
 
         // TODO: pre-init timeout. Right now no implemented socket policies
         // actually have an asyncronous pre-init
@@ -452,15 +644,23 @@ protected:
      * init_asio is called once immediately after construction to initialize
      * Asio components to the io_service.
      *
+     * Connections on an io_service that is only ever run by one thread don't
+     * need a strand to serialize their handlers. Such connections can be
+     * initialized with `use_strand` set to false.
+     *
      * @param io_service A pointer to the io_service to register with this
      * connection
+     * @param use_strand Whether or not to wrap handlers in a strand when
+     * multithreading is enabled
      *
      * @return Status code for the success or failure of the initialization
      */
-    lib::error_code init_asio (io_service_ptr io_service) {
+    lib::error_code init_asio (io_service_ptr io_service,
+        bool use_strand = true)
+    {
         m_io_service = io_service;
 
-        if (config::enable_multithreading) {
+        if (config::enable_multithreading && use_strand) {
             m_strand = lib::make_shared<lib::asio::io_service::strand>(
                 lib::ref(*io_service));
         }
@@ -472,9 +672,8 @@ protected:
     }
 
     void handle_pre_init(init_handler callback, lib::error_code const & ec) {
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,"asio connection handle pre_init");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio connection handle pre_init");
 
         if (m_tcp_pre_init_handler) {
             m_tcp_pre_init_handler(m_connection_hdl);
@@ -494,9 +693,8 @@ protected:
     }
 
     void post_init(init_handler callback) {
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,"asio connection post_init");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio connection post_init");
 
         timer_ptr post_timer;
         
@@ -573,7 +771,7 @@ protected:
         lib::error_code const & ec)
     {
         if (ec == transport::error::operation_aborted ||
-            (post_timer && lib::asio::is_neg(post_timer->expires_from_now())))
+            (post_timer && post_timer->expired()))
         {
             m_alog.write(log::alevel::devel,"post_init cancelled");
             return;
@@ -583,9 +781,8 @@ protected:
             post_timer->cancel();
         }
 
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,"asio connection handle_post_init");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio connection handle_post_init");
 
         if (m_tcp_post_init_handler) {
             m_tcp_post_init_handler(m_connection_hdl);
@@ -595,9 +792,8 @@ protected:
     }
 
     void proxy_write(init_handler callback) {
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,"asio connection proxy_write");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio connection proxy_write");
 
         if (!m_proxy_data) {
             m_elog.write(log::elevel::library,
@@ -625,24 +821,30 @@ protected:
         );
 
         // Send proxy request
-        if (config::enable_multithreading) {
+        if (config::enable_multithreading && m_strand) {
             lib::asio::async_write(
                 socket_con_type::get_next_layer(),
                 m_bufs,
-                m_strand->wrap(lib::bind(
-                    &type::handle_proxy_write, get_shared(),
-                    callback,
-                    lib::placeholders::_1
+                m_strand->wrap(make_custom_alloc_handler(
+                    *m_handler_arena,
+                    lib::bind(
+                        &type::handle_proxy_write, get_shared(),
+                        callback,
+                        lib::placeholders::_1
+                    )
                 ))
             );
         } else {
             lib::asio::async_write(
                 socket_con_type::get_next_layer(),
                 m_bufs,
-                lib::bind(
-                    &type::handle_proxy_write, get_shared(),
-                    callback,
-                    lib::placeholders::_1
+                make_custom_alloc_handler(
+                    *m_handler_arena,
+                    lib::bind(
+                        &type::handle_proxy_write, get_shared(),
+                        callback,
+                        lib::placeholders::_1
+                    )
                 )
             );
         }
@@ -668,10 +870,8 @@ protected:
     void handle_proxy_write(init_handler callback,
         lib::asio::error_code const & ec)
     {
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,
-                "asio connection handle_proxy_write");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio connection handle_proxy_write");
 
         m_bufs.clear();
 
@@ -679,7 +879,7 @@ protected:
         // Whatever aborted it will be issuing the callback so we are safe to
         // return
         if (ec == lib::asio::error::operation_aborted ||
-            lib::asio::is_neg(m_proxy_data->timer->expires_from_now()))
+            m_proxy_data->timer->expired())
         {
             m_elog.write(log::elevel::devel,"write operation aborted");
             return;
@@ -696,9 +896,8 @@ protected:
     }
 
     void proxy_read(init_handler callback) {
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,"asio connection proxy_read");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio connection proxy_read");
 
         if (!m_proxy_data) {
             m_elog.write(log::elevel::library,
@@ -708,15 +907,18 @@ protected:
             return;
         }
 
-        if (config::enable_multithreading) {
+        if (config::enable_multithreading && m_strand) {
             lib::asio::async_read_until(
                 socket_con_type::get_next_layer(),
                 m_proxy_data->read_buf,
                 "\r\n\r\n",
-                m_strand->wrap(lib::bind(
-                    &type::handle_proxy_read, get_shared(),
-                    callback,
-                    lib::placeholders::_1, lib::placeholders::_2
+                m_strand->wrap(make_custom_alloc_handler(
+                    *m_handler_arena,
+                    lib::bind(
+                        &type::handle_proxy_read, get_shared(),
+                        callback,
+                        lib::placeholders::_1, lib::placeholders::_2
+                    )
                 ))
             );
         } else {
@@ -724,10 +926,13 @@ protected:
                 socket_con_type::get_next_layer(),
                 m_proxy_data->read_buf,
                 "\r\n\r\n",
-                lib::bind(
-                    &type::handle_proxy_read, get_shared(),
-                    callback,
-                    lib::placeholders::_1, lib::placeholders::_2
+                make_custom_alloc_handler(
+                    *m_handler_arena,
+                    lib::bind(
+                        &type::handle_proxy_read, get_shared(),
+                        callback,
+                        lib::placeholders::_1, lib::placeholders::_2
+                    )
                 )
             );
         }
@@ -742,16 +947,14 @@ protected:
     void handle_proxy_read(init_handler callback,
         lib::asio::error_code const & ec, size_t)
     {
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,
-                "asio connection handle_proxy_read");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio connection handle_proxy_read");
 
         // Timer expired or the operation was aborted for some reason.
         // Whatever aborted it will be issuing the callback so we are safe to
         // return
         if (ec == lib::asio::error::operation_aborted ||
-            lib::asio::is_neg(m_proxy_data->timer->expires_from_now()))
+            m_proxy_data->timer->expired())
         {
             m_elog.write(log::elevel::devel,"read operation aborted");
             return;
@@ -820,11 +1023,8 @@ protected:
     void async_read_at_least(size_t num_bytes, char *buf, size_t len,
         read_handler handler)
     {
-        if (m_alog.static_test(log::alevel::devel)) {
-            std::stringstream s;
-            s << "asio async_read_at_least: " << num_bytes;
-            m_alog.write(log::alevel::devel,s.str());
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio async_read_at_least: " << num_bytes);
 
         // TODO: safety vs speed ?
         // maybe move into an if devel block
@@ -836,7 +1036,7 @@ protected:
             return;
         }*/
 
-        if (config::enable_multithreading) {
+        if (config::enable_multithreading && m_strand) {
             lib::asio::async_read(
                 socket_con_type::get_socket(),
                 lib::asio::buffer(buf,len),
@@ -868,7 +1068,8 @@ protected:
         
     }
 
-    void handle_async_read(read_handler handler, lib::asio::error_code const & ec,
+    void handle_async_read(read_handler const & handler,
+        lib::asio::error_code const & ec,
         size_t bytes_transferred)
     {
         m_alog.write(log::alevel::devel, "asio con handle_async_read");
@@ -906,33 +1107,7 @@ protected:
     void async_write(const char* buf, size_t len, write_handler handler) {
         m_bufs.push_back(lib::asio::buffer(buf,len));
 
-        if (config::enable_multithreading) {
-            lib::asio::async_write(
-                socket_con_type::get_socket(),
-                m_bufs,
-                m_strand->wrap(make_custom_alloc_handler(
-                    m_write_handler_allocator,
-                    lib::bind(
-                        &type::handle_async_write, get_shared(),
-                        handler,
-                        lib::placeholders::_1, lib::placeholders::_2
-                    )
-                ))
-            );
-        } else {
-            lib::asio::async_write(
-                socket_con_type::get_socket(),
-                m_bufs,
-                make_custom_alloc_handler(
-                    m_write_handler_allocator,
-                    lib::bind(
-                        &type::handle_async_write, get_shared(),
-                        handler,
-                        lib::placeholders::_1, lib::placeholders::_2
-                    )
-                )
-            );
-        }
+        start_write(m_bufs.front(), handler);
     }
 
     /// Initiate a potentially asyncronous write of the given buffers
@@ -943,10 +1118,25 @@ protected:
             m_bufs.push_back(lib::asio::buffer((*it).buf,(*it).len));
         }
 
-        if (config::enable_multithreading) {
+        // Asio copies a buffer sequence held in a vector, which would
+        // allocate for every write. A single buffer, the usual case once
+        // small frames are coalesced, is passed on its own.
+        if (m_bufs.size() == 1) {
+            start_write(m_bufs.front(), handler);
+        } else {
+            start_write(m_bufs, handler);
+        }
+    }
+
+    /// Start an Asio write of m_bufs, or of its only buffer
+    template <typename ConstBufferSequence>
+    void start_write(ConstBufferSequence const & bufs,
+        write_handler const & handler)
+    {
+        if (config::enable_multithreading && m_strand) {
             lib::asio::async_write(
                 socket_con_type::get_socket(),
-                m_bufs,
+                bufs,
                 m_strand->wrap(make_custom_alloc_handler(
                     m_write_handler_allocator,
                     lib::bind(
@@ -959,7 +1149,7 @@ protected:
         } else {
             lib::asio::async_write(
                 socket_con_type::get_socket(),
-                m_bufs,
+                bufs,
                 make_custom_alloc_handler(
                     m_write_handler_allocator,
                     lib::bind(
@@ -977,7 +1167,9 @@ protected:
      * @param ec The status code
      * @param bytes_transferred The number of bytes read
      */
-    void handle_async_write(write_handler handler, lib::asio::error_code const & ec, size_t) {
+    void handle_async_write(write_handler const & handler,
+        lib::asio::error_code const & ec, size_t)
+    {
         m_bufs.clear();
         lib::error_code tec;
         if (ec) {
@@ -1011,19 +1203,23 @@ protected:
      * This needs to be thread safe
      */
     lib::error_code interrupt(interrupt_handler handler) {
-        if (config::enable_multithreading) {
-            m_io_service->post(m_strand->wrap(handler));
+        if (config::enable_multithreading && m_strand) {
+            m_io_service->post(m_strand->wrap(
+                make_custom_alloc_handler(*m_handler_arena, handler)));
         } else {
-            m_io_service->post(handler);
+            m_io_service->post(
+                make_custom_alloc_handler(*m_handler_arena, handler));
         }
         return lib::error_code();
     }
 
     lib::error_code dispatch(dispatch_handler handler) {
-        if (config::enable_multithreading) {
-            m_io_service->post(m_strand->wrap(handler));
+        if (config::enable_multithreading && m_strand) {
+            m_io_service->post(m_strand->wrap(
+                make_custom_alloc_handler(*m_handler_arena, handler)));
         } else {
-            m_io_service->post(handler);
+            m_io_service->post(
+                make_custom_alloc_handler(*m_handler_arena, handler));
         }
         return lib::error_code();
     }
@@ -1034,9 +1230,8 @@ protected:
 
     /// close and clean up the underlying socket
     void async_shutdown(shutdown_handler callback) {
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,"asio connection async_shutdown");
-        }
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "asio connection async_shutdown");
 
         timer_ptr shutdown_timer;
         shutdown_timer = set_timer(
@@ -1095,7 +1290,7 @@ protected:
         callback, lib::asio::error_code const & ec)
     {
         if (ec == lib::asio::error::operation_aborted ||
-            lib::asio::is_neg(shutdown_timer->expires_from_now()))
+            shutdown_timer->expired())
         {
             m_alog.write(log::alevel::devel,"async_shutdown cancelled");
             return;
@@ -1129,10 +1324,8 @@ protected:
                 }
             }
         } else {
-            if (m_alog.static_test(log::alevel::devel)) {
-                m_alog.write(log::alevel::devel,
-                    "asio con handle_async_shutdown");
-            }
+            _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+                "asio con handle_async_shutdown");
         }
         callback(tec);
     }
@@ -1178,11 +1371,33 @@ private:
     std::string m_proxy;
     lib::shared_ptr<proxy_data> m_proxy_data;
 
+    /// Unix domain socket path, empty for TCP connections
+    std::string m_socket_path;
+
     // transport resources
     io_service_ptr  m_io_service;
     strand_ptr      m_strand;
     connection_hdl  m_connection_hdl;
 
+    /// Registration with the endpoint's io_service pool, if any. Released
+    /// when the connection is destroyed.
+    lib::shared_ptr<void> m_pool_lease;
+
+    /// Index of m_io_service in the endpoint's pool
+    size_t          m_shard_index;
+
+    /// Timer wheel shared with other connections on m_io_service. Timers use
+    /// individual Asio timers if this is empty. Owned by the endpoint.
+    lib::weak_ptr<timer_wheel_type> m_timer_wheel;
+
+    /// Number of timeouts the connection can have pending on the timer wheel
+    /// without allocating an entry
+    static size_t const wheel_entry_count = 4;
+
+    /// Entries linking this connection's timeouts into the timer wheel,
+    /// reused by each timeout set. Released when the connection is destroyed.
+    typename timer_wheel_type::entry m_wheel_entries[wheel_entry_count];
+
     std::vector<lib::asio::const_buffer> m_bufs;
 
     /// Detailed internal error code
@@ -1194,6 +1409,10 @@ private:
 
     handler_allocator   m_read_handler_allocator;
     handler_allocator   m_write_handler_allocator;
+
+    /// Memory for all other operations and for timers. Shared with the
+    /// allocators of timers that may outlive the connection.
+    handler_arena_ptr   m_handler_arena;
 };
 
 
@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_TRANSPORT_ASIO_DNS_CACHE_HPP
+#define WEBSOCKETPP_TRANSPORT_ASIO_DNS_CACHE_HPP
+
+#include <websocketpp/common/asio.hpp>
+#include <websocketpp/common/chrono.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+/// DNS cache counters
+struct dns_cache_stats {
+    dns_cache_stats()
+      : hits(0)
+      , stale_hits(0)
+      , coalesced(0)
+      , queries(0)
+      , timeouts(0) {}
+
+    /// Number of lookups answered from a fresh entry
+    uint64_t hits;
+    /// Number of lookups answered from an expired entry while it refreshed
+    uint64_t stale_hits;
+    /// Number of lookups that waited for a query already in flight
+    uint64_t coalesced;
+    /// Number of queries sent to the resolver
+    uint64_t queries;
+    /// Number of queries abandoned because they did not complete in time
+    uint64_t timeouts;
+};
+
+/// Cache of resolved host names shared by the connections of an endpoint
+/**
+ * Keeps the results of resolving a host and port so that connections to the
+ * same place do not each query the resolver.
+ *
+ * - An entry is fresh for a fixed TTL after it was resolved. The system
+ *   resolver does not report record TTLs, so the configured TTL acts as the
+ *   cap on how long an answer is used without asking again.
+ * - Lookups of a name that is already being resolved wait for the query in
+ *   flight instead of starting another.
+ * - For a configurable period after an entry expires it is still returned,
+ *   while a single background query refreshes it (stale-while-revalidate).
+ *   If that query fails the stale results keep being served until the period
+ *   ends.
+ * - Each query has an id. A query that takes too long is abandoned by
+ *   completing it as failed, and the late result of an abandoned query is
+ *   ignored.
+ *
+ * The cache only does the bookkeeping. The transport endpoint runs the
+ * queries and hands the results to the waiting connections.
+ *
+ * @since 0.8.0
+ */
+template <typename concurrency, typename waiter>
+class dns_cache {
+public:
+    /// Type of this cache
+    typedef dns_cache<concurrency,waiter> type;
+    /// Type of a shared pointer to this cache
+    typedef lib::shared_ptr<type> ptr;
+    /// Type of the resolved endpoints
+    typedef lib::asio::ip::tcp::resolver::iterator results_type;
+    /// Type of a function creating the waiter for a lookup that must wait
+    typedef lib::function<waiter()> waiter_factory;
+
+    /// Type of the mutex protecting the cache
+    typedef typename concurrency::mutex_type mutex_type;
+    /// Type of a lock on the cache
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+
+    dns_cache()
+      : m_ttl(30000)
+      , m_stale_ttl(0)
+      , m_max_entries(1024)
+      , m_next_query(0) {}
+
+    /// Set how long resolved names are used before resolving them again
+    /**
+     * The default is 30000 milliseconds.
+     *
+     * @param ttl The TTL in milliseconds
+     */
+    void set_ttl(long ttl) {
+        scoped_lock_type guard(m_lock);
+        m_ttl = ttl > 0 ? ttl : 0;
+    }
+
+    /// Get how long resolved names are used before resolving them again
+    /**
+     * @return The TTL in milliseconds
+     */
+    long get_ttl() const {
+        scoped_lock_type guard(m_lock);
+        return m_ttl;
+    }
+
+    /// Set how long expired names are served while they are refreshed
+    /**
+     * The default is zero, which makes connections wait for the new query.
+     *
+     * @param stale_ttl The period after expiry in milliseconds
+     */
+    void set_stale_ttl(long stale_ttl) {
+        scoped_lock_type guard(m_lock);
+        m_stale_ttl = stale_ttl > 0 ? stale_ttl : 0;
+    }
+
+    /// Get how long expired names are served while they are refreshed
+    /**
+     * @return The period after expiry in milliseconds
+     */
+    long get_stale_ttl() const {
+        scoped_lock_type guard(m_lock);
+        return m_stale_ttl;
+    }
+
+    /// Set the maximum number of names kept
+    /**
+     * When a new name would exceed the limit the entry that expires first is
+     * dropped. Names that are being resolved are never dropped. The default
+     * is 1024.
+     *
+     * @param max The maximum number of names
+     */
+    void set_max_entries(size_t max) {
+        scoped_lock_type guard(m_lock);
+        m_max_entries = max;
+    }
+
+    /// Get the number of names in the cache
+    size_t size() const {
+        scoped_lock_type guard(m_lock);
+        return m_entries.size();
+    }
+
+    /// Get the cache counters
+    dns_cache_stats get_stats() const {
+        scoped_lock_type guard(m_lock);
+        return m_stats;
+    }
+
+    /// Drop all names that are not being resolved
+    void clear() {
+        scoped_lock_type guard(m_lock);
+        typename entry_map::iterator it = m_entries.begin();
+        while (it != m_entries.end()) {
+            if (it->second.resolving) {
+                it->second.valid = false;
+                ++it;
+            } else {
+                m_entries.erase(it++);
+            }
+        }
+    }
+
+    /// Look up a name
+    /**
+     * If the name has usable results they are returned immediately. Otherwise
+     * a waiter is created by calling `make_waiter` and is queued until the
+     * query for the name completes. `make_waiter` is called with the cache
+     * locked and must not call back into the cache.
+     *
+     * @param [in] key The name to look up, typically "host:port"
+     * @param [in] make_waiter Function that creates the waiter
+     * @param [out] results The cached results, if any
+     * @param [out] query The id of a query the caller must start for the
+     * name and report the result of via complete, zero if none
+     * @return Whether results were returned
+     */
+    bool lookup(std::string const & key, waiter_factory const & make_waiter,
+        results_type & results, uint64_t & query)
+    {
+        clock_type::time_point now = clock_type::now();
+        scoped_lock_type guard(m_lock);
+
+        query = 0;
+
+        typename entry_map::iterator it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            evict_locked(now);
+            it = m_entries.insert(std::make_pair(key, entry())).first;
+        }
+
+        entry & e = it->second;
+
+        if (e.valid && now < e.expiry) {
+            m_stats.hits++;
+            results = e.results;
+            return true;
+        }
+
+        if (e.valid && now < e.expiry + lib::chrono::milliseconds(m_stale_ttl))
+        {
+            m_stats.stale_hits++;
+            if (!e.resolving) {
+                query = start_query_locked(e);
+            }
+            results = e.results;
+            return true;
+        }
+
+        e.valid = false;
+        e.results = results_type();
+        e.waiters.push_back(make_waiter());
+
+        if (e.resolving) {
+            m_stats.coalesced++;
+        } else {
+            query = start_query_locked(e);
+        }
+        return false;
+    }
+
+    /// Record the result of a query started by lookup
+    /**
+     * Results of a query that is no longer in flight, because it was
+     * abandoned, are ignored.
+     *
+     * @param [in] key The name that was resolved
+     * @param [in] query The id of the query returned by lookup
+     * @param [in] success Whether the query succeeded
+     * @param [in] results The results of a successful query
+     * @param [out] waiters The waiters queued for the name, which the caller
+     * must notify of the result
+     * @return Whether the result was recorded
+     */
+    bool complete(std::string const & key, uint64_t query, bool success,
+        results_type const & results, std::vector<waiter> & waiters)
+    {
+        clock_type::time_point now = clock_type::now();
+        scoped_lock_type guard(m_lock);
+
+        typename entry_map::iterator it = m_entries.find(key);
+        if (it == m_entries.end() || !it->second.resolving ||
+            it->second.query != query)
+        {
+            return false;
+        }
+
+        entry & e = it->second;
+        waiters.swap(e.waiters);
+        e.resolving = false;
+
+        if (success) {
+            e.valid = true;
+            e.results = results;
+            e.expiry = now + lib::chrono::milliseconds(m_ttl);
+        } else if (!e.valid) {
+            m_entries.erase(it);
+        }
+        return true;
+    }
+
+    /// Abandon a query that did not complete in time
+    /**
+     * Completes the query as failed so that later lookups start a new one.
+     * Stale results of the name are kept.
+     *
+     * @param [in] key The name being resolved
+     * @param [in] query The id of the query returned by lookup
+     * @param [out] waiters The waiters queued for the name, which the caller
+     * must notify of the timeout
+     * @return Whether the query was still in flight
+     */
+    bool abandon(std::string const & key, uint64_t query,
+        std::vector<waiter> & waiters)
+    {
+        if (!complete(key, query, false, results_type(), waiters)) {
+            return false;
+        }
+
+        scoped_lock_type guard(m_lock);
+        m_stats.timeouts++;
+        return true;
+    }
+private:
+    typedef lib::chrono::steady_clock clock_type;
+
+    struct entry {
+        entry() : valid(false), resolving(false), query(0) {}
+
+        results_type results;
+        clock_type::time_point expiry;
+        std::vector<waiter> waiters;
+        // Whether results holds the outcome of a successful query
+        bool valid;
+        // Whether a query for this name is in flight
+        bool resolving;
+        // Id of the query in flight
+        uint64_t query;
+    };
+
+    typedef std::map<std::string,entry> entry_map;
+
+    /// Mark a query of an entry as in flight. Must be called with m_lock
+    /// held.
+    uint64_t start_query_locked(entry & e) {
+        e.resolving = true;
+        e.query = ++m_next_query;
+        m_stats.queries++;
+        return e.query;
+    }
+
+    /// Make room for one more entry. Must be called with m_lock held.
+    void evict_locked(clock_type::time_point now) {
+        if (m_entries.size() < m_max_entries) {
+            return;
+        }
+
+        lib::chrono::milliseconds stale(m_stale_ttl);
+        typename entry_map::iterator it = m_entries.begin();
+        typename entry_map::iterator first = m_entries.end();
+
+        while (it != m_entries.end()) {
+            if (it->second.resolving) {
+                ++it;
+            } else if (it->second.expiry + stale <= now) {
+                m_entries.erase(it++);
+            } else {
+                if (first == m_entries.end() ||
+                    it->second.expiry < first->second.expiry)
+                {
+                    first = it;
+                }
+                ++it;
+            }
+        }
+
+        if (m_entries.size() >= m_max_entries && first != m_entries.end()) {
+            m_entries.erase(first);
+        }
+    }
+
+    entry_map m_entries;
+    dns_cache_stats m_stats;
+    long m_ttl;
+    long m_stale_ttl;
+    size_t m_max_entries;
+    uint64_t m_next_query;
+    mutable mutex_type m_lock;
+};
+
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_ASIO_DNS_CACHE_HPP
@@ -30,20 +30,51 @@
 
 #include <websocketpp/transport/base/endpoint.hpp>
 #include <websocketpp/transport/asio/connection.hpp>
+#include <websocketpp/transport/asio/connect_race.hpp>
+#include <websocketpp/transport/asio/dns_cache.hpp>
 #include <websocketpp/transport/asio/security/none.hpp>
 
 #include <websocketpp/uri.hpp>
+#include <websocketpp/logger/format.hpp>
 #include <websocketpp/logger/levels.hpp>
 
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/functional.hpp>
+#ifndef _WEBSOCKETPP_NO_THREADING_
+#include <websocketpp/common/thread.hpp>
+#endif
 
+#include <cstdio>
 #include <sstream>
 #include <string>
+#include <vector>
+
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace websocketpp {
 namespace transport {
 namespace asio {
 
+/// Strategies for assigning new connections to pooled io_services
+namespace placement {
+
+enum value {
+    /// Assign connections to each io_service in turn
+    round_robin = 0,
+    /// Assign connections to the io_service with the fewest live connections
+    least_connections = 1
+};
+
+} // namespace placement
+
 /// Asio based endpoint transport component
 /**
  * transport::asio::endpoint implements an endpoint transport component using
@@ -57,6 +88,10 @@ public:
 
     /// Type of the concurrency policy
     typedef typename config::concurrency_type concurrency_type;
+    /// Type of a mutex from the concurrency policy
+    typedef typename concurrency_type::mutex_type mutex_type;
+    /// Type of a scoped lock from the concurrency policy
+    typedef typename concurrency_type::scoped_lock_type scoped_lock_type;
     /// Type of the socket policy
     typedef typename config::socket_type socket_type;
     /// Type of the error logging policy
@@ -68,6 +103,9 @@ public:
     typedef typename socket_type::socket_con_type socket_con_type;
     /// Type of a shared pointer to the socket connection component
     typedef typename socket_con_type::ptr socket_con_ptr;
+    /// Type of the protocol of the socket policy's sockets
+    typedef typename socket_con_type::socket_type::lowest_layer_type::
+        protocol_type protocol_type;
 
     /// Type of the connection transport component associated with this
     /// endpoint transport component
@@ -82,10 +120,38 @@ public:
     typedef lib::shared_ptr<lib::asio::ip::tcp::acceptor> acceptor_ptr;
     /// Type of a shared pointer to the resolver being used
     typedef lib::shared_ptr<lib::asio::ip::tcp::resolver> resolver_ptr;
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+    /// Type of a unix domain socket endpoint
+    typedef lib::asio::local::stream_protocol::endpoint local_endpoint_type;
+    /// Type of a shared pointer to the unix domain socket acceptor
+    typedef lib::shared_ptr<lib::asio::local::stream_protocol::acceptor>
+        local_acceptor_ptr;
+#endif
     /// Type of timer handle
     typedef lib::shared_ptr<lib::asio::steady_timer> timer_ptr;
+    /// Type of a connection timer handle
+    typedef typename transport_con_type::timer_ptr con_timer_ptr;
+    /// Type of the timer wheel used for connection timers
+    typedef typename transport_con_type::timer_wheel_type timer_wheel_type;
+    /// Type of a pointer to a timer wheel
+    typedef typename transport_con_type::timer_wheel_ptr timer_wheel_ptr;
     /// Type of a shared pointer to an io_service work object
     typedef lib::shared_ptr<lib::asio::io_service::work> work_ptr;
+#ifndef _WEBSOCKETPP_NO_THREADING_
+    /// Type of a shared pointer to a thread running a pooled io_service
+    typedef lib::shared_ptr<lib::thread> thread_ptr;
+#endif
+
+    /// A connection waiting for a DNS cache query to complete
+    struct dns_waiter {
+        transport_con_ptr tcon;
+        con_timer_ptr timer;
+        connect_handler callback;
+    };
+    /// Type of the DNS cache
+    typedef asio::dns_cache<concurrency_type,dns_waiter> dns_cache_type;
+    /// Type of a shared pointer to the DNS cache
+    typedef typename dns_cache_type::ptr dns_cache_ptr;
 
     // generate and manage our own io_service
     explicit endpoint()
@@ -93,6 +159,12 @@ public:
       , m_external_io_service(false)
       , m_listen_backlog(0)
       , m_reuse_addr(false)
+      , m_reuse_port(false)
+      , m_pool_next(0)
+      , m_pool_placement(placement::round_robin)
+      , m_pool_cpu_affinity(false)
+      , m_timer_wheel_resolution(0)
+      , m_connection_attempt_delay(0)
       , m_state(UNINITIALIZED)
     {
         //std::cout << "transport::asio::endpoint constructor" << std::endl;
@@ -103,8 +175,23 @@ public:
 
         // Explicitly destroy local objects
         m_acceptor.reset();
-        m_resolver.reset();
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+        m_local_acceptor.reset();
+        if (!m_local_path.empty()) {
+            std::remove(m_local_path.c_str());
+        }
+#endif
+        m_pool_acceptors.clear();
         m_work.reset();
+        m_pool_work.clear();
+        m_timer_wheels.clear();
+        m_retired_timer_wheels.clear();
+
+        // The first pooled io_service is m_io_service, deleted below
+        for (size_t i = 1; i < m_pool.size(); ++i) {
+            delete m_pool[i];
+        }
+
         if (m_state != UNINITIALIZED && !m_external_io_service) {
             delete m_io_service;
         }
@@ -131,8 +218,24 @@ public:
       , m_io_service(src.m_io_service)
       , m_external_io_service(src.m_external_io_service)
       , m_acceptor(src.m_acceptor)
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+      , m_local_acceptor(src.m_local_acceptor)
+#endif
+      , m_local_path(src.m_local_path)
+      , m_pool(src.m_pool)
+      , m_pool_acceptors(src.m_pool_acceptors)
       , m_listen_backlog(lib::asio::socket_base::max_connections)
       , m_reuse_addr(src.m_reuse_addr)
+      , m_reuse_port(src.m_reuse_port)
+      , m_pool_next(0)
+      , m_pool_placement(src.m_pool_placement)
+      , m_pool_cpu_affinity(src.m_pool_cpu_affinity)
+      , m_pool_load(src.m_pool_load)
+      , m_timer_wheels(src.m_timer_wheels)
+      , m_retired_timer_wheels(src.m_retired_timer_wheels)
+      , m_timer_wheel_resolution(src.m_timer_wheel_resolution)
+      , m_dns_cache(src.m_dns_cache)
+      , m_connection_attempt_delay(src.m_connection_attempt_delay)
       , m_elog(src.m_elog)
       , m_alog(src.m_alog)
       , m_state(src.m_state)
@@ -140,6 +243,13 @@ public:
         src.m_io_service = NULL;
         src.m_external_io_service = false;
         src.m_acceptor = NULL;
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+        src.m_local_acceptor.reset();
+#endif
+        src.m_local_path.clear();
+        src.m_pool.clear();
+        src.m_pool_acceptors.clear();
+        src.m_reuse_port = false;
         src.m_state = UNINITIALIZED;
     }
 
@@ -259,6 +369,208 @@ public:
         m_external_io_service = false;
     }
 
+    /// Initialize asio transport with a pool of internal io_services
+    /// (exception free)
+    /**
+     * This method of initialization allocates `threads` internally managed
+     * io_services. `run` starts one thread per io_service (the calling thread
+     * runs the first one) and returns once all of them have run out of work.
+     *
+     * Each new connection, accepted or outgoing, is assigned to one io_service
+     * according to the placement strategy set with `set_pool_placement` and
+     * all of its handlers run on that io_service's thread. Because every
+     * io_service is only run by a single thread, pooled connections do not
+     * use strands.
+     *
+     * Connections are accepted by a single acceptor. See
+     * `init_asio_reuse_port` for a mode with one acceptor per io_service.
+     *
+     * `run_one`, `poll` and `poll_one` only service the first io_service.
+     *
+     * Pools require threads. If `enable_multithreading` is false or the
+     * library was built with `_WEBSOCKETPP_NO_THREADING_` the endpoint is left
+     * uninitialized and `transport::error::operation_not_supported` is
+     * returned.
+     *
+     * @since 0.8.0
+     *
+     * @param threads The number of io_services and threads to use. Zero uses
+     * one per hardware thread.
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void init_asio_pool(size_t threads, lib::error_code & ec) {
+#ifndef _WEBSOCKETPP_NO_THREADING_
+        if (!config::enable_multithreading) {
+            m_elog->write(log::elevel::library,
+                "asio::init_asio_pool requires enable_multithreading");
+            ec = make_error_code(transport::error::operation_not_supported);
+            return;
+        }
+
+        if (threads == 0) {
+            threads = lib::thread::hardware_concurrency();
+            if (threads == 0) {
+                threads = 1;
+            }
+        }
+
+        init_asio(ec);
+        if (ec) {
+            return;
+        }
+
+        m_alog->write(log::alevel::devel,"asio::init_asio_pool");
+
+        m_pool.push_back(m_io_service);
+        m_pool_acceptors.push_back(m_acceptor);
+
+        for (size_t i = 1; i < threads; ++i) {
+            m_pool.push_back(NULL);
+            m_pool.back() = new lib::asio::io_service();
+
+            io_service_ptr service = m_pool.back();
+            m_pool_acceptors.push_back(
+                lib::make_shared<lib::asio::ip::tcp::acceptor>(
+                    lib::ref(*service)));
+        }
+
+        m_pool_load = lib::make_shared<pool_load>(threads);
+#else
+        (void)threads;
+        m_elog->write(log::elevel::library,
+            "asio::init_asio_pool is not available without threading support");
+        ec = make_error_code(transport::error::operation_not_supported);
+#endif
+    }
+
+    /// Initialize asio transport with a pool of internal io_services
+    /**
+     * @see init_asio_pool(size_t, lib::error_code &)
+     *
+     * @since 0.8.0
+     *
+     * @param threads The number of io_services and threads to use. Zero uses
+     * one per hardware thread.
+     */
+    void init_asio_pool(size_t threads) {
+        lib::error_code ec;
+        init_asio_pool(threads,ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Initialize asio transport in SO_REUSEPORT mode (exception free)
+    /**
+     * Sets up a pool of io_services like `init_asio_pool`. Each subsequent
+     * call to `listen` opens one acceptor per io_service, all bound to the
+     * same address with the SO_REUSEPORT socket option, and the operating
+     * system load balances incoming connections between them.
+     *
+     * Connections are assigned to io_services as follows:
+     * - Connections accepted by an acceptor belong to that acceptor's thread.
+     * - Connections created from within a handler belong to the thread
+     *   running that handler.
+     * - Connections created from any other thread are placed according to
+     *   the pool placement strategy.
+     *
+     * If the platform does not support SO_REUSEPORT the endpoint is left
+     * uninitialized and `transport::error::operation_not_supported` is
+     * returned.
+     *
+     * @since 0.8.0
+     *
+     * @param threads The number of io_services, acceptors and threads to
+     * use. Zero uses one per hardware thread.
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void init_asio_reuse_port(size_t threads, lib::error_code & ec) {
+#ifdef SO_REUSEPORT
+        init_asio_pool(threads,ec);
+        if (!ec) {
+            m_reuse_port = true;
+        }
+#else
+        (void)threads;
+        m_elog->write(log::elevel::library,
+            "asio::init_asio_reuse_port: SO_REUSEPORT is not supported");
+        ec = make_error_code(transport::error::operation_not_supported);
+#endif
+    }
+
+    /// Initialize asio transport in SO_REUSEPORT mode
+    /**
+     * @see init_asio_reuse_port(size_t, lib::error_code &)
+     *
+     * @since 0.8.0
+     *
+     * @param threads The number of io_services, acceptors and threads to
+     * use. Zero uses one per hardware thread.
+     */
+    void init_asio_reuse_port(size_t threads) {
+        lib::error_code ec;
+        init_asio_reuse_port(threads,ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Sets how new connections are assigned to pooled io_services
+    /**
+     * Only used by endpoints initialized with `init_asio_pool` or
+     * `init_asio_reuse_port`. Live connections are counted from creation until
+     * the connection object is destroyed.
+     *
+     * The default is placement::round_robin.
+     *
+     * @since 0.8.0
+     *
+     * @param value The placement strategy to use
+     */
+    void set_pool_placement(placement::value value) {
+        m_pool_placement = value;
+    }
+
+    /// Sets whether pool threads are pinned to a CPU
+    /**
+     * If enabled, the thread running pooled io_service `i` is pinned to CPU
+     * `i` modulo the number of hardware threads while `run` is executing. The
+     * calling thread's affinity is restored when `run` returns. Only supported
+     * on Linux; elsewhere this setting is ignored.
+     *
+     * New values affect future calls to run only.
+     *
+     * The default is false.
+     *
+     * @since 0.8.0
+     *
+     * @param value Whether or not to pin pool threads
+     */
+    void set_pool_cpu_affinity(bool value) {
+        m_pool_cpu_affinity = value;
+    }
+
+    /// Get the number of io_services in the pool
+    /**
+     * @since 0.8.0
+     *
+     * @return The number of pooled io_services, zero if the endpoint is not
+     * using a pool.
+     */
+    size_t get_pool_size() const {
+        return m_pool.size();
+    }
+
+    /// Get the number of live connections assigned to a pooled io_service
+    /**
+     * @since 0.8.0
+     *
+     * @param index The index of the io_service, less than get_pool_size()
+     * @return The number of live connections assigned to it
+     */
+    size_t get_pool_connection_count(size_t index) const {
+        if (!m_pool_load) {
+            return 0;
+        }
+        return m_pool_load->count(index);
+    }
+
     /// Sets the tcp pre init handler
     /**
      * The tcp pre init handler is called after the raw tcp connection has been
@@ -398,43 +710,143 @@ public:
             return;
         }
 
+        if (is_local_protocol(static_cast<protocol_type *>(NULL))) {
+            m_elog->write(log::elevel::library,
+                "asio::listen on a TCP endpoint needs a TCP socket policy");
+            ec = make_error_code(transport::error::operation_not_supported);
+            return;
+        }
+
         m_alog->write(log::alevel::devel,"asio::listen");
 
         lib::asio::error_code bec;
 
-        m_acceptor->open(ep.protocol(),bec);
-        if (!bec) {
-            m_acceptor->set_option(lib::asio::socket_base::reuse_address(m_reuse_addr),bec);
+        open_acceptor(*m_acceptor,ep,bec);
+
+        if (!bec && m_reuse_port) {
+            // Bind the remaining acceptors to the address the first one ended
+            // up with so that a request for an ephemeral port is shared.
+            lib::asio::ip::tcp::endpoint bound = m_acceptor->local_endpoint(bec);
+
+            for (size_t i = 1; !bec && i < m_pool_acceptors.size(); ++i) {
+                open_acceptor(*m_pool_acceptors[i],bound,bec);
+            }
+        }
+
+        if (bec) {
+            close_acceptors();
+            log_err(log::elevel::info,"asio listen",bec);
+            ec = make_error_code(error::pass_through);
+        } else {
+            m_state = LISTENING;
+            ec = lib::error_code();
+        }
+    }
+
+    /// Set up endpoint for listening manually
+    /**
+     * Bind the internal acceptor using the settings specified by the endpoint e
+     *
+     * @param ep An endpoint to read settings from
+     */
+    void listen(lib::asio::ip::tcp::endpoint const & ep) {
+        lib::error_code ec;
+        listen(ep,ec);
+        if (ec) { throw exception(ec); }
+    }
+
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+    /// Set up endpoint for listening on a unix domain socket (exception free)
+    /**
+     * Bind a unix domain socket acceptor to the given path. The endpoint's
+     * socket policy must be `local_socket`, as in `config::asio_local`, or
+     * `local_tls_socket`, as in `config::asio_tls_local`.
+     * `get_socket_path` on an accepted connection returns the path.
+     *
+     * If `set_reuse_addr` is enabled a socket left at the path by a previous
+     * process is removed before binding. The socket file is removed when the
+     * endpoint stops listening.
+     *
+     * All connections are accepted on the first io_service. An endpoint
+     * initialized with `init_asio_reuse_port` still places accepted
+     * connections according to its pool placement strategy.
+     *
+     * @since 0.8.0
+     *
+     * @param ep The unix domain socket endpoint to listen on, for example
+     * `lib::asio::local::stream_protocol::endpoint("/run/ws.sock")`
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void listen(local_endpoint_type const & ep, lib::error_code & ec) {
+        if (m_state != READY) {
+            m_elog->write(log::elevel::library,
+                "asio::listen called from the wrong state");
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return;
+        }
+
+        if (!is_local_protocol(static_cast<protocol_type *>(NULL))) {
+            m_elog->write(log::elevel::library,
+                "asio::listen on a unix domain socket needs a local_socket "
+                "or local_tls_socket socket policy");
+            ec = make_error_code(transport::error::operation_not_supported);
+            return;
         }
+
+        m_alog->write(log::alevel::devel,"asio::listen unix:"+ep.path());
+
+        if (!m_local_acceptor) {
+            m_local_acceptor = lib::make_shared<
+                lib::asio::local::stream_protocol::acceptor>(
+                    lib::ref(*m_io_service));
+        }
+
+        std::string path = ep.path();
+        struct stat info;
+        if (m_reuse_addr && ::stat(path.c_str(),&info) == 0 &&
+            S_ISSOCK(info.st_mode))
+        {
+            std::remove(path.c_str());
+        }
+
+        lib::asio::error_code bec;
+        m_local_acceptor->open(ep.protocol(),bec);
         if (!bec) {
-            m_acceptor->bind(ep,bec);
+            m_local_acceptor->bind(ep,bec);
         }
         if (!bec) {
-            m_acceptor->listen(m_listen_backlog,bec);
+            m_local_acceptor->listen(m_listen_backlog,bec);
         }
+
         if (bec) {
-            if (m_acceptor->is_open()) {
-                m_acceptor->close();
+            if (m_local_acceptor->is_open()) {
+                lib::asio::error_code cec;
+                m_local_acceptor->close(cec);
             }
             log_err(log::elevel::info,"asio listen",bec);
             ec = make_error_code(error::pass_through);
         } else {
+            m_local_path = path;
             m_state = LISTENING;
             ec = lib::error_code();
         }
     }
 
-    /// Set up endpoint for listening manually
+    /// Set up endpoint for listening on a unix domain socket
     /**
-     * Bind the internal acceptor using the settings specified by the endpoint e
+     * @see listen(local_endpoint_type const &, lib::error_code &)
      *
-     * @param ep An endpoint to read settings from
+     * @since 0.8.0
+     *
+     * @param ep The unix domain socket endpoint to listen on
      */
-    void listen(lib::asio::ip::tcp::endpoint const & ep) {
+    void listen(local_endpoint_type const & ep) {
         lib::error_code ec;
         listen(ep,ec);
         if (ec) { throw exception(ec); }
     }
+#endif // _WEBSOCKETPP_LOCAL_SOCKETS_
 
     /// Set up endpoint for listening with protocol and port (exception free)
     /**
@@ -583,7 +995,7 @@ public:
             return;
         }
 
-        m_acceptor->close();
+        close_acceptors();
         m_state = READY;
         ec = lib::error_code();
     }
@@ -609,8 +1021,81 @@ public:
         return (m_state == LISTENING);
     }
 
+    /// Get the number of acceptors the endpoint listens with
+    /**
+     * This is one unless the endpoint was initialized with
+     * `init_asio_reuse_port`, in which case there is one acceptor per
+     * io_service.
+     *
+     * @since 0.8.0
+     *
+     * @return The number of acceptors
+     */
+    size_t get_acceptor_count() const {
+        return (m_reuse_port && m_local_path.empty()) ?
+            m_pool_acceptors.size() : 1;
+    }
+
+    /// Run a handler on the thread that owns an acceptor
+    /**
+     * Used by the server role to start one accept loop per acceptor. The
+     * handler is posted to the io_service of the given acceptor.
+     *
+     * @since 0.8.0
+     *
+     * @param index The index of the acceptor, less than get_acceptor_count()
+     * @param handler The handler to run
+     */
+    void post_to_acceptor(size_t index, dispatch_handler handler) {
+        if (m_reuse_port && m_local_path.empty()) {
+            m_pool[index]->post(handler);
+        } else {
+            m_io_service->post(handler);
+        }
+    }
+
+    /// Get the number of shards of the endpoint
+    /**
+     * Each io_service of the endpoint's pool is a shard. An endpoint without
+     * a pool has a single shard.
+     *
+     * @since 0.8.0
+     *
+     * @return The number of shards
+     */
+    size_t get_shard_count() const {
+        return m_pool.empty() ? 1 : m_pool.size();
+    }
+
+    /// Run a handler on the thread that owns a shard
+    /**
+     * The handler is posted to the io_service of the given shard.
+     *
+     * @since 0.8.0
+     *
+     * @param index The index of the shard, less than get_shard_count()
+     * @param handler The handler to run
+     */
+    void post_to_shard(size_t index, dispatch_handler handler) {
+        if (m_pool.empty()) {
+            m_io_service->post(handler);
+        } else {
+            m_pool[index]->post(handler);
+        }
+    }
+
     /// wraps the run method of the internal io_service object
+    /**
+     * If the endpoint uses an io_service pool this runs every io_service,
+     * each on its own thread, and returns the total number of handlers
+     * executed.
+     */
     std::size_t run() {
+#ifndef _WEBSOCKETPP_NO_THREADING_
+        if (config::enable_multithreading && !m_pool.empty()) {
+            return run_pool();
+        }
+#endif
         return m_io_service->run();
     }
 
@@ -625,6 +1110,9 @@ public:
     /// wraps the stop method of the internal io_service object
     void stop() {
         m_io_service->stop();
+        for (size_t i = 1; i < m_pool.size(); ++i) {
+            m_pool[i]->stop();
+        }
     }
 
     /// wraps the poll method of the internal io_service object
@@ -640,10 +1128,18 @@ public:
     /// wraps the reset method of the internal io_service object
     void reset() {
         m_io_service->reset();
+        for (size_t i = 1; i < m_pool.size(); ++i) {
+            m_pool[i]->reset();
+        }
     }
 
     /// wraps the stopped method of the internal io_service object
     bool stopped() const {
+        for (size_t i = 1; i < m_pool.size(); ++i) {
+            if (!m_pool[i]->stopped()) {
+                return false;
+            }
+        }
         return m_io_service->stopped();
     }
 
@@ -663,6 +1159,14 @@ public:
         m_work = lib::make_shared<lib::asio::io_service::work>(
             lib::ref(*m_io_service)
         );
+
+        m_pool_work.clear();
+        for (size_t i = 1; i < m_pool.size(); ++i) {
+            io_service_ptr service = m_pool[i];
+            m_pool_work.push_back(
+                lib::make_shared<lib::asio::io_service::work>(
+                    lib::ref(*service)));
+        }
     }
 
     /// Clears the endpoint's perpetual flag, allowing it to exit when empty
@@ -675,57 +1179,211 @@ public:
      */
     void stop_perpetual() {
         m_work.reset();
+        m_pool_work.clear();
     }
 
-    /// Call back a function after a period of time.
+    /// Sets the resolution of the connection timer wheel
     /**
-     * Sets a timer that calls back a function after the specified period of
-     * milliseconds. Returns a handle that can be used to cancel the timer.
-     * A cancelled timer will return the error code error::operation_aborted
-     * A timer that expired will return no error.
+     * By default every connection timer, including the handshake, ping,
+     * close, proxy, DNS, connect and socket shutdown timeouts, is an
+     * individual Asio timer. With a non-zero resolution these are instead
+     * scheduled on a timer_wheel shared by all connections on the same
+     * io_service, which makes arming and cancelling them constant time at the
+     * cost of firing up to one tick late.
      *
-     * @param duration Length of time to wait in milliseconds
-     * @param callback The function to call back when the timer has expired
-     * @return A handle that can be used to cancel the timer if it is no longer
-     * needed.
+     * Only affects connections created after the call. Wheels of the
+     * previous resolution are kept until their pending timeouts have fired.
+     * Timers set via the endpoint's own `set_timer` always use individual
+     * Asio timers.
+     *
+     * The default is zero, which disables the wheel.
+     *
+     * @since 0.8.0
+     *
+     * @param resolution The length of one tick in milliseconds
      */
-    timer_ptr set_timer(long duration, timer_handler callback) {
-        timer_ptr new_timer = lib::make_shared<lib::asio::steady_timer>(
-            *m_io_service,
-             lib::asio::milliseconds(duration)
-        );
-
-        new_timer->async_wait(
-            lib::bind(
-                &type::handle_timer,
-                this,
-                new_timer,
-                callback,
-                lib::placeholders::_1
-            )
-        );
+    void set_timer_wheel_resolution(long resolution) {
+        scoped_lock_type guard(m_pool_lock);
+        if (resolution != m_timer_wheel_resolution) {
+            // Connections only hold weak references to their wheel
+            std::vector<timer_wheel_ptr> retired;
+            for (size_t i = 0; i < m_retired_timer_wheels.size(); ++i) {
+                if (m_retired_timer_wheels[i]->size() > 0) {
+                    retired.push_back(m_retired_timer_wheels[i]);
+                }
+            }
+            for (size_t i = 0; i < m_timer_wheels.size(); ++i) {
+                if (m_timer_wheels[i] && m_timer_wheels[i]->size() > 0) {
+                    retired.push_back(m_timer_wheels[i]);
+                }
+            }
+            m_retired_timer_wheels.swap(retired);
+            m_timer_wheels.clear();
+        }
+        m_timer_wheel_resolution = resolution > 0 ? resolution : 0;
+    }
 
-        return new_timer;
+    /// Get the resolution of the connection timer wheel
+    /**
+     * @since 0.8.0
+     *
+     * @return The length of one tick in milliseconds, zero if connection
+     * timers use individual Asio timers.
+     */
+    long get_timer_wheel_resolution() const {
+        return m_timer_wheel_resolution;
     }
 
-    /// Timer handler
+    /// Get the timer wheel used by connections on an io_service
     /**
-     * The timer pointer is included to ensure the timer isn't destroyed until
-     * after it has expired.
+     * Returns an empty pointer if the timer wheel is disabled. The wheel is
+     * created the first time it is requested.
      *
-     * @param t Pointer to the timer in question
-     * @param callback The function to call back
-     * @param ec A status code indicating an error, if any.
+     * @since 0.8.0
+     *
+     * @param index The index of the pooled io_service, zero if the endpoint
+     * is not using a pool.
+     * @return A pointer to the timer wheel
      */
-    void handle_timer(timer_ptr, timer_handler callback,
-        lib::asio::error_code const & ec)
-    {
-        if (ec) {
-            if (ec == lib::asio::error::operation_aborted) {
-                callback(make_error_code(transport::error::operation_aborted));
-            } else {
-                m_elog->write(log::elevel::info,
-                    "asio handle_timer error: "+ec.message());
+    timer_wheel_ptr get_timer_wheel(size_t index = 0) {
+        scoped_lock_type guard(m_pool_lock);
+
+        if (m_timer_wheel_resolution == 0) {
+            return timer_wheel_ptr();
+        }
+
+        io_service_ptr service = m_pool.empty() ? m_io_service : m_pool[index];
+        if (m_timer_wheels.size() <= index) {
+            m_timer_wheels.resize(index + 1);
+        }
+        if (!m_timer_wheels[index]) {
+            m_timer_wheels[index] = lib::make_shared<timer_wheel_type>(service,
+                m_timer_wheel_resolution);
+        }
+        return m_timer_wheels[index];
+    }
+
+    /// Enable or disable the DNS cache
+    /**
+     * By default every outgoing connection resolves its host with its own
+     * query, bounded by the DNS resolve timeout. When the cache is enabled
+     * connections share the results of previous and concurrent queries for
+     * the same host and port, and a connection whose host is in the cache
+     * starts connecting right away, without a DNS timer. See dns_cache for
+     * details. Disabled by default.
+     *
+     * Disabling the cache drops its entries and counters.
+     *
+     * @since 0.8.0
+     *
+     * @param value Whether or not to cache DNS results
+     */
+    void set_dns_cache(bool value) {
+        if (!value) {
+            m_dns_cache.reset();
+        } else if (!m_dns_cache) {
+            m_dns_cache = lib::make_shared<dns_cache_type>();
+        }
+    }
+
+    /// Get the DNS cache
+    /**
+     * May be used to configure the cache's TTLs and size and to read its
+     * counters.
+     *
+     * @since 0.8.0
+     *
+     * @return The cache, or an empty pointer if DNS caching is disabled
+     */
+    dns_cache_ptr get_dns_cache() const {
+        return m_dns_cache;
+    }
+
+    /// Set the delay between racing connection attempts
+    /**
+     * By default a host that resolves to several addresses is connected to by
+     * trying the addresses one after another, so each unreachable address
+     * costs up to the connect timeout. With a non-zero delay outgoing
+     * connections race the addresses instead, as described in RFC 8305
+     * ("Happy Eyeballs"). Addresses are tried alternating between IPv6 and
+     * IPv4, a new attempt starts whenever the previous one fails or has been
+     * pending for the delay, and the first to connect is kept. The connect
+     * timeout still bounds the whole race. RFC 8305 recommends 250
+     * milliseconds.
+     *
+     * Racing requires Asio 1.12 or Boost 1.66. With older versions the delay
+     * is ignored.
+     *
+     * The default is zero, which disables racing.
+     *
+     * @since 0.8.0
+     *
+     * @param delay The connection attempt delay in milliseconds
+     */
+    void set_connection_attempt_delay(long delay) {
+        m_connection_attempt_delay = delay > 0 ? delay : 0;
+    }
+
+    /// Get the delay between racing connection attempts
+    /**
+     * @since 0.8.0
+     *
+     * @return The connection attempt delay in milliseconds, zero if
+     * connection attempts are not raced
+     */
+    long get_connection_attempt_delay() const {
+        return m_connection_attempt_delay;
+    }
+
+    /// Call back a function after a period of time.
+    /**
+     * Sets a timer that calls back a function after the specified period of
+     * milliseconds. Returns a handle that can be used to cancel the timer.
+     * A cancelled timer will return the error code error::operation_aborted
+     * A timer that expired will return no error.
+     *
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call back when the timer has expired
+     * @return A handle that can be used to cancel the timer if it is no longer
+     * needed.
+     */
+    timer_ptr set_timer(long duration, timer_handler callback) {
+        timer_ptr new_timer = lib::make_shared<lib::asio::steady_timer>(
+            *m_io_service,
+             lib::asio::milliseconds(duration)
+        );
+
+        new_timer->async_wait(
+            lib::bind(
+                &type::handle_timer,
+                this,
+                new_timer,
+                callback,
+                lib::placeholders::_1
+            )
+        );
+
+        return new_timer;
+    }
+
+    /// Timer handler
+    /**
+     * The timer pointer is included to ensure the timer isn't destroyed until
+     * after it has expired.
+     *
+     * @param t Pointer to the timer in question
+     * @param callback The function to call back
+     * @param ec A status code indicating an error, if any.
+     */
+    void handle_timer(timer_ptr, timer_handler callback,
+        lib::asio::error_code const & ec)
+    {
+        if (ec) {
+            if (ec == lib::asio::error::operation_aborted) {
+                callback(make_error_code(transport::error::operation_aborted));
+            } else {
+                m_elog->write(log::elevel::info,
+                    "asio handle_timer error: "+ec.message());
                 log_err(log::elevel::info,"asio handle_timer",ec);
                 callback(make_error_code(error::pass_through));
             }
@@ -751,27 +1409,7 @@ public:
 
         m_alog->write(log::alevel::devel, "asio::async_accept");
 
-        if (config::enable_multithreading) {
-            m_acceptor->async_accept(
-                tcon->get_raw_socket(),
-                tcon->get_strand()->wrap(lib::bind(
-                    &type::handle_accept,
-                    this,
-                    callback,
-                    lib::placeholders::_1
-                ))
-            );
-        } else {
-            m_acceptor->async_accept(
-                tcon->get_raw_socket(),
-                lib::bind(
-                    &type::handle_accept,
-                    this,
-                    callback,
-                    lib::placeholders::_1
-                )
-            );
-        }
+        async_accept_socket(tcon,callback,static_cast<protocol_type *>(NULL));
     }
 
     /// Accept the next connection attempt and assign it to con.
@@ -785,6 +1423,58 @@ public:
         if (ec) { throw exception(ec); }
     }
 protected:
+    /// Accept the next TCP connection into tcon
+    void async_accept_socket(transport_con_ptr tcon, accept_handler callback,
+        lib::asio::ip::tcp *)
+    {
+        acceptor_ptr acceptor = get_acceptor(tcon);
+
+        if (config::enable_multithreading && tcon->get_strand()) {
+            acceptor->async_accept(
+                tcon->get_raw_socket(),
+                tcon->get_strand()->wrap(make_custom_alloc_handler(
+                    *tcon->get_handler_arena(),
+                    lib::bind(
+                        &type::handle_accept,
+                        this,
+                        callback,
+                        lib::placeholders::_1
+                    )
+                ))
+            );
+        } else if (!m_reuse_port && tcon->m_io_service != m_io_service) {
+            // A pooled connection accepted by an acceptor that runs on a
+            // different thread. Complete the accept on the connection's own
+            // thread.
+            acceptor->async_accept(
+                tcon->get_raw_socket(),
+                make_custom_alloc_handler(
+                    *tcon->get_handler_arena(),
+                    lib::bind(
+                        &type::handle_pooled_accept,
+                        this,
+                        tcon,
+                        callback,
+                        lib::placeholders::_1
+                    )
+                )
+            );
+        } else {
+            acceptor->async_accept(
+                tcon->get_raw_socket(),
+                make_custom_alloc_handler(
+                    *tcon->get_handler_arena(),
+                    lib::bind(
+                        &type::handle_accept,
+                        this,
+                        callback,
+                        lib::placeholders::_1
+                    )
+                )
+            );
+        }
+    }
+
     /// Initialize logging
     /**
      * The loggers are located in the main endpoint class. As such, the
@@ -819,18 +1509,39 @@ protected:
         callback(ret_ec);
     }
 
+    /// Forward an accept completion to the io_service of a pooled connection
+    void handle_pooled_accept(transport_con_ptr tcon, accept_handler callback,
+        lib::asio::error_code const & asio_ec)
+    {
+        tcon->m_io_service->post(lib::bind(
+            &type::handle_accept,
+            this,
+            callback,
+            asio_ec
+        ));
+    }
+
     /// Initiate a new connection
     // TODO: there have to be some more failure conditions here
     void async_connect(transport_con_ptr tcon, uri_ptr u, connect_handler cb) {
-        using namespace lib::asio::ip;
+        tcon->set_uri(u);
 
-        // Create a resolver
-        if (!m_resolver) {
-            m_resolver = lib::make_shared<lib::asio::ip::tcp::resolver>(
-                lib::ref(*m_io_service));
+        // unix: URIs need a local_socket or local_tls_socket socket policy
+        // and other URIs a TCP one
+        bool local = !u->get_socket_path().empty();
+        if (local != is_local_protocol(static_cast<protocol_type *>(NULL))) {
+            cb(make_error_code(transport::error::operation_not_supported));
+            return;
         }
 
-        tcon->set_uri(u);
+        async_connect_socket(tcon,u,cb,static_cast<protocol_type *>(NULL));
+    }
+
+    /// Resolve and connect to the host of a ws: or wss: URI
+    void async_connect_socket(transport_con_ptr tcon, uri_ptr u,
+        connect_handler cb, lib::asio::ip::tcp *)
+    {
+        using namespace lib::asio::ip;
 
         std::string proxy = tcon->get_proxy();
         std::string host;
@@ -859,32 +1570,42 @@ protected:
             port = pu->get_port_str();
         }
 
+        if (m_dns_cache) {
+            async_resolve_cached(m_dns_cache,tcon,host,port,cb);
+            return;
+        }
+
+        // Each resolution gets its own resolver on the connection's
+        // io_service, so that its handlers are serialized with the rest of
+        // the connection's and concurrent connects never share a resolver.
+        resolver_ptr resolver(new tcp::resolver(*tcon->m_io_service));
+
         tcp::resolver::query query(host,port);
 
-        if (m_alog->static_test(log::alevel::devel)) {
-            m_alog->write(log::alevel::devel,
-                "starting async DNS resolve for "+host+":"+port);
-        }
+        _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel,
+            "starting async DNS resolve for " << host << ":" << port);
 
-        timer_ptr dns_timer;
+        con_timer_ptr dns_timer;
 
         dns_timer = tcon->set_timer(
             config::timeout_dns_resolve,
             lib::bind(
                 &type::handle_resolve_timeout,
                 this,
+                resolver,
                 dns_timer,
                 cb,
                 lib::placeholders::_1
             )
         );
 
-        if (config::enable_multithreading) {
-            m_resolver->async_resolve(
+        if (config::enable_multithreading && tcon->get_strand()) {
+            resolver->async_resolve(
                 query,
                 tcon->get_strand()->wrap(lib::bind(
                     &type::handle_resolve,
                     this,
+                    resolver,
                     tcon,
                     dns_timer,
                     cb,
@@ -893,11 +1614,12 @@ protected:
                 ))
             );
         } else {
-            m_resolver->async_resolve(
+            resolver->async_resolve(
                 query,
                 lib::bind(
                     &type::handle_resolve,
                     this,
+                    resolver,
                     tcon,
                     dns_timer,
                     cb,
@@ -913,12 +1635,13 @@ protected:
      * The timer pointer is included to ensure the timer isn't destroyed until
      * after it has expired.
      *
+     * @param resolver The resolver running the query
      * @param dns_timer Pointer to the timer in question
      * @param callback The function to call back
      * @param ec A status code indicating an error, if any.
      */
-    void handle_resolve_timeout(timer_ptr, connect_handler callback,
-        lib::error_code const & ec)
+    void handle_resolve_timeout(resolver_ptr resolver, con_timer_ptr,
+        connect_handler callback, lib::error_code const & ec)
     {
         lib::error_code ret_ec;
 
@@ -936,16 +1659,16 @@ protected:
         }
 
         m_alog->write(log::alevel::devel,"DNS resolution timed out");
-        m_resolver->cancel();
+        resolver->cancel();
         callback(ret_ec);
     }
 
-    void handle_resolve(transport_con_ptr tcon, timer_ptr dns_timer,
-        connect_handler callback, lib::asio::error_code const & ec,
+    void handle_resolve(resolver_ptr, transport_con_ptr tcon,
+        con_timer_ptr dns_timer, connect_handler callback, lib::asio::error_code const & ec,
         lib::asio::ip::tcp::resolver::iterator iterator)
     {
         if (ec == lib::asio::error::operation_aborted ||
-            lib::asio::is_neg(dns_timer->expires_from_now()))
+            dns_timer->expired())
         {
             m_alog->write(log::alevel::devel,"async_resolve cancelled");
             return;
@@ -959,21 +1682,252 @@ protected:
             return;
         }
 
-        if (m_alog->static_test(log::alevel::devel)) {
-            std::stringstream s;
-            s << "Async DNS resolve successful. Results: ";
+        if (m_alog->static_test(log::alevel::devel) &&
+            m_alog->dynamic_test(log::alevel::devel))
+        {
+            log::formatter s;
+            s.stream() << "Async DNS resolve successful. Results: ";
 
             lib::asio::ip::tcp::resolver::iterator it, end;
             for (it = iterator; it != end; ++it) {
-                s << (*it).endpoint() << " ";
+                s.stream() << (*it).endpoint() << " ";
             }
 
             m_alog->write(log::alevel::devel,s.str());
         }
 
+        start_connect(tcon,callback,iterator);
+    }
+
+    /// Resolve a host through the DNS cache
+    /**
+     * Cached results are used right away. Otherwise the connection waits,
+     * bounded by its own DNS timer, for the cache's query of the host. The
+     * query itself is abandoned after the DNS timeout, so that a lookup that
+     * never returns does not hold up later connections to the host.
+     */
+    void async_resolve_cached(dns_cache_ptr cache, transport_con_ptr tcon,
+        std::string const & host, std::string const & port,
+        connect_handler cb)
+    {
+        std::string key = host + ":" + port;
+        lib::asio::ip::tcp::resolver::iterator results;
+        uint64_t query;
+
+        bool hit = cache->lookup(key, lib::bind(
+            &type::make_dns_waiter,
+            this,
+            tcon,
+            cb
+        ), results, query);
+
+        if (query) {
+            _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel,
+                "starting cached async DNS resolve for " << key);
+
+            // The query runs on the io_service of the connection that starts
+            // it. Its result is posted to each waiter's own io_service.
+            resolver_ptr resolver(
+                new lib::asio::ip::tcp::resolver(*tcon->m_io_service));
+            timer_ptr query_timer(new lib::asio::steady_timer(
+                *tcon->m_io_service,
+                lib::asio::milliseconds(config::timeout_dns_resolve)
+            ));
+
+            query_timer->async_wait(lib::bind(
+                &type::handle_cached_query_timeout,
+                this,
+                resolver,
+                query_timer,
+                cache,
+                key,
+                query,
+                lib::placeholders::_1
+            ));
+
+            lib::asio::ip::tcp::resolver::query q(host,port);
+            resolver->async_resolve(
+                q,
+                lib::bind(
+                    &type::handle_cached_resolve,
+                    this,
+                    resolver,
+                    query_timer,
+                    cache,
+                    key,
+                    query,
+                    lib::placeholders::_1,
+                    lib::placeholders::_2
+                )
+            );
+        }
+
+        if (hit) {
+            _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel,
+                "DNS cache hit for " << key);
+            start_connect(tcon,cb,results);
+        }
+    }
+
+    /// Create the waiter of a connection that misses the DNS cache
+    /**
+     * Called with the cache locked, so the DNS timer is armed before the
+     * query can complete.
+     */
+    dns_waiter make_dns_waiter(transport_con_ptr tcon, connect_handler cb) {
+        dns_waiter w;
+        w.tcon = tcon;
+        w.callback = cb;
+        w.timer = tcon->set_timer(
+            config::timeout_dns_resolve,
+            lib::bind(
+                &type::handle_cached_resolve_timeout,
+                this,
+                cb,
+                lib::placeholders::_1
+            )
+        );
+        return w;
+    }
+
+    /// DNS timeout handler for connections waiting on the DNS cache
+    /**
+     * Unlike handle_resolve_timeout this leaves the query running, as other
+     * connections may be waiting for it too.
+     */
+    void handle_cached_resolve_timeout(connect_handler callback,
+        lib::error_code const & ec)
+    {
+        if (ec == transport::error::operation_aborted) {
+            m_alog->write(log::alevel::devel,
+                "asio handle_cached_resolve_timeout timer cancelled");
+            return;
+        }
+
+        if (ec) {
+            log_err(log::elevel::devel,"asio handle_cached_resolve_timeout",
+                ec);
+            callback(ec);
+        } else {
+            m_alog->write(log::alevel::devel,"DNS resolution timed out");
+            callback(make_error_code(transport::error::timeout));
+        }
+    }
+
+    /// Abandon a DNS cache query that did not complete in time
+    /**
+     * Clears the query from the cache and fails the connections waiting for
+     * it. The resolver is cancelled, but a lookup that is stuck in the
+     * system resolver may still complete later; its result is ignored.
+     */
+    void handle_cached_query_timeout(resolver_ptr resolver, timer_ptr,
+        dns_cache_ptr cache, std::string key, uint64_t query,
+        lib::asio::error_code const & ec)
+    {
+        if (ec == lib::asio::error::operation_aborted) {
+            return;
+        }
+
+        std::vector<dns_waiter> waiters;
+        if (!cache->abandon(key, query, waiters)) {
+            return;
+        }
+
+        _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel,
+            "cached DNS resolve for " << key << " timed out");
+        resolver->cancel();
+        notify_dns_waiters(waiters,
+            make_error_code(transport::error::timeout),
+            lib::asio::ip::tcp::resolver::iterator());
+    }
+
+    /// Store the result of a DNS cache query and notify its waiters
+    void handle_cached_resolve(resolver_ptr, timer_ptr query_timer,
+        dns_cache_ptr cache, std::string key, uint64_t query,
+        lib::asio::error_code const & ec,
+        lib::asio::ip::tcp::resolver::iterator iterator)
+    {
+        std::vector<dns_waiter> waiters;
+        if (!cache->complete(key, query, !ec, iterator, waiters)) {
+            // The query was abandoned
+            return;
+        }
+        query_timer->cancel();
+
+        lib::error_code ret_ec;
+        if (ec) {
+            log_err(log::elevel::info,"asio cached async_resolve",ec);
+            ret_ec = make_error_code(error::pass_through);
+        }
+        notify_dns_waiters(waiters, ret_ec, iterator);
+    }
+
+    /// Hand the result of a DNS cache query to the connections waiting on it
+    void notify_dns_waiters(std::vector<dns_waiter> & waiters,
+        lib::error_code const & ec,
+        lib::asio::ip::tcp::resolver::iterator iterator)
+    {
+        typename std::vector<dns_waiter>::iterator it;
+        for (it = waiters.begin(); it != waiters.end(); ++it) {
+            // Each waiter continues on its own strand or io_service
+            if (config::enable_multithreading && it->tcon->get_strand()) {
+                it->tcon->get_strand()->post(lib::bind(
+                    &type::handle_cached_resolve_waiter,
+                    this,
+                    *it,
+                    ec,
+                    iterator
+                ));
+            } else {
+                it->tcon->m_io_service->post(lib::bind(
+                    &type::handle_cached_resolve_waiter,
+                    this,
+                    *it,
+                    ec,
+                    iterator
+                ));
+            }
+        }
+    }
+
+    /// Continue connecting a connection that waited on the DNS cache
+    void handle_cached_resolve_waiter(dns_waiter w, lib::error_code const & ec,
+        lib::asio::ip::tcp::resolver::iterator iterator)
+    {
+        if (w.timer->expired()) {
+            m_alog->write(log::alevel::devel,"cached async_resolve cancelled");
+            return;
+        }
+
+        w.timer->cancel();
+
+        if (ec) {
+            w.callback(ec);
+            return;
+        }
+
+        start_connect(w.tcon,w.callback,iterator);
+    }
+
+    /// Start connecting to the resolved endpoints
+    void start_connect(transport_con_ptr tcon, connect_handler callback,
+        lib::asio::ip::tcp::resolver::iterator iterator)
+    {
+#ifdef _WEBSOCKETPP_ASIO_SOCKET_RELEASE_
+        if (m_connection_attempt_delay > 0) {
+            lib::asio::ip::tcp::resolver::iterator second = iterator;
+            if (second != lib::asio::ip::tcp::resolver::iterator() &&
+                ++second != lib::asio::ip::tcp::resolver::iterator())
+            {
+                start_connect_race(tcon,callback,iterator);
+                return;
+            }
+        }
+#endif
+
         m_alog->write(log::alevel::devel,"Starting async connect");
 
-        timer_ptr con_timer;
+        con_timer_ptr con_timer;
 
         con_timer = tcon->set_timer(
             config::timeout_connect,
@@ -987,35 +1941,152 @@ protected:
             )
         );
 
-        if (config::enable_multithreading) {
+        if (config::enable_multithreading && tcon->get_strand()) {
             lib::asio::async_connect(
                 tcon->get_raw_socket(),
                 iterator,
-                tcon->get_strand()->wrap(lib::bind(
-                    &type::handle_connect,
-                    this,
-                    tcon,
-                    con_timer,
-                    callback,
-                    lib::placeholders::_1
+                tcon->get_strand()->wrap(make_custom_alloc_handler(
+                    *tcon->get_handler_arena(),
+                    lib::bind(
+                        &type::handle_connect,
+                        this,
+                        tcon,
+                        con_timer,
+                        callback,
+                        lib::placeholders::_1
+                    )
                 ))
             );
         } else {
             lib::asio::async_connect(
                 tcon->get_raw_socket(),
                 iterator,
-                lib::bind(
-                    &type::handle_connect,
-                    this,
-                    tcon,
-                    con_timer,
-                    callback,
-                    lib::placeholders::_1
+                make_custom_alloc_handler(
+                    *tcon->get_handler_arena(),
+                    lib::bind(
+                        &type::handle_connect,
+                        this,
+                        tcon,
+                        con_timer,
+                        callback,
+                        lib::placeholders::_1
+                    )
                 )
             );
         }
     }
 
+#ifdef _WEBSOCKETPP_ASIO_SOCKET_RELEASE_
+    /// Race connection attempts to several resolved addresses
+    void start_connect_race(transport_con_ptr tcon, connect_handler callback,
+        lib::asio::ip::tcp::resolver::iterator iterator)
+    {
+        m_alog->write(log::alevel::devel,"Starting async connect race");
+
+        connect_race::strand_ptr strand;
+        if (config::enable_multithreading) {
+            strand = tcon->get_strand();
+        }
+
+        std::vector<connect_race::endpoint_type> endpoints;
+        lib::asio::ip::tcp::resolver::iterator end;
+        for (; iterator != end; ++iterator) {
+            endpoints.push_back(iterator->endpoint());
+        }
+
+        io_service_ptr service = tcon->m_io_service;
+        connect_race::ptr race = lib::make_shared<connect_race>(
+            lib::ref(*service),
+            strand,
+            connect_race::interleave(endpoints),
+            m_connection_attempt_delay
+        );
+
+        con_timer_ptr con_timer;
+
+        con_timer = tcon->set_timer(
+            config::timeout_connect,
+            lib::bind(
+                &type::handle_connect_race_timeout,
+                this,
+                race,
+                callback,
+                lib::placeholders::_1
+            )
+        );
+
+        race->start(lib::bind(
+            &type::handle_connect_race,
+            this,
+            tcon,
+            con_timer,
+            callback,
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+    }
+
+    /// Connect timeout handler for a connection racing several addresses
+    void handle_connect_race_timeout(connect_race::ptr race,
+        connect_handler callback, lib::error_code const & ec)
+    {
+        if (ec == transport::error::operation_aborted) {
+            m_alog->write(log::alevel::devel,
+                "asio handle_connect_race_timeout timer cancelled");
+            return;
+        }
+
+        race->cancel();
+
+        if (ec) {
+            log_err(log::elevel::devel,"asio handle_connect_race_timeout",ec);
+            callback(ec);
+        } else {
+            m_alog->write(log::alevel::devel,"TCP connect timed out");
+            callback(make_error_code(transport::error::timeout));
+        }
+    }
+
+    /// Adopt the socket that won a connect race
+    void handle_connect_race(transport_con_ptr tcon, con_timer_ptr con_timer,
+        connect_handler callback, lib::asio::error_code const & ec,
+        connect_race::socket_ptr socket)
+    {
+        if (ec == lib::asio::error::operation_aborted ||
+            con_timer->expired())
+        {
+            m_alog->write(log::alevel::devel,"async_connect race cancelled");
+            return;
+        }
+
+        con_timer->cancel();
+
+        if (ec) {
+            log_err(log::elevel::info,"asio async_connect race",ec);
+            callback(make_error_code(error::pass_through));
+            return;
+        }
+
+        lib::asio::error_code aec;
+        lib::asio::ip::tcp::endpoint ep = socket->remote_endpoint(aec);
+        if (!aec) {
+            tcon->get_raw_socket().assign(ep.protocol(),socket->release(aec),
+                aec);
+        }
+        if (aec) {
+            log_err(log::elevel::info,"asio async_connect race adopt",aec);
+            callback(make_error_code(error::pass_through));
+            return;
+        }
+
+        _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel,
+            "Async connect to " << tcon->get_remote_endpoint()
+            << " successful.");
+
+        callback(lib::error_code());
+    }
+#endif // _WEBSOCKETPP_ASIO_SOCKET_RELEASE_
+
     /// Asio connect timeout handler
     /**
      * The timer pointer is included to ensure the timer isn't destroyed until
@@ -1026,7 +2097,7 @@ protected:
      * @param callback The function to call back
      * @param ec A status code indicating an error, if any.
      */
-    void handle_connect_timeout(transport_con_ptr tcon, timer_ptr,
+    void handle_connect_timeout(transport_con_ptr tcon, con_timer_ptr,
         connect_handler callback, lib::error_code const & ec)
     {
         lib::error_code ret_ec;
@@ -1049,11 +2120,11 @@ protected:
         callback(ret_ec);
     }
 
-    void handle_connect(transport_con_ptr tcon, timer_ptr con_timer,
+    void handle_connect(transport_con_ptr tcon, con_timer_ptr con_timer,
         connect_handler callback, lib::asio::error_code const & ec)
     {
         if (ec == lib::asio::error::operation_aborted ||
-            lib::asio::is_neg(con_timer->expires_from_now()))
+            con_timer->expired())
         {
             m_alog->write(log::alevel::devel,"async_connect cancelled");
             return;
@@ -1067,13 +2138,117 @@ protected:
             return;
         }
 
+        _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel,
+            "Async connect to " << tcon->get_remote_endpoint()
+            << " successful.");
+
+        callback(lib::error_code());
+    }
+
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+    /// Accept the next unix domain socket connection into tcon
+    void async_accept_socket(transport_con_ptr tcon, accept_handler callback,
+        lib::asio::local::stream_protocol *)
+    {
+        tcon->m_socket_path = m_local_path;
+
+        if (config::enable_multithreading && tcon->get_strand()) {
+            m_local_acceptor->async_accept(
+                tcon->get_raw_socket(),
+                tcon->get_strand()->wrap(make_custom_alloc_handler(
+                    *tcon->get_handler_arena(),
+                    lib::bind(
+                        &type::handle_accept,
+                        this,
+                        callback,
+                        lib::placeholders::_1
+                    )
+                ))
+            );
+        } else if (tcon->m_io_service != m_io_service) {
+            m_local_acceptor->async_accept(
+                tcon->get_raw_socket(),
+                make_custom_alloc_handler(
+                    *tcon->get_handler_arena(),
+                    lib::bind(
+                        &type::handle_pooled_accept,
+                        this,
+                        tcon,
+                        callback,
+                        lib::placeholders::_1
+                    )
+                )
+            );
+        } else {
+            m_local_acceptor->async_accept(
+                tcon->get_raw_socket(),
+                make_custom_alloc_handler(
+                    *tcon->get_handler_arena(),
+                    lib::bind(
+                        &type::handle_accept,
+                        this,
+                        callback,
+                        lib::placeholders::_1
+                    )
+                )
+            );
+        }
+    }
+
+    /// Connect tcon to the unix domain socket of a unix: URI
+    void async_connect_socket(transport_con_ptr tcon, uri_ptr u,
+        connect_handler callback, lib::asio::local::stream_protocol *)
+    {
+        tcon->m_socket_path = u->get_socket_path();
+
         if (m_alog->static_test(log::alevel::devel)) {
             m_alog->write(log::alevel::devel,
-                "Async connect to "+tcon->get_remote_endpoint()+" successful.");
+                "Starting async connect to unix:"+tcon->m_socket_path);
         }
 
-        callback(lib::error_code());
+        con_timer_ptr con_timer;
+
+        con_timer = tcon->set_timer(
+            config::timeout_connect,
+            lib::bind(
+                &type::handle_connect_timeout,
+                this,
+                tcon,
+                con_timer,
+                callback,
+                lib::placeholders::_1
+            )
+        );
+
+        local_endpoint_type ep(tcon->m_socket_path);
+
+        if (config::enable_multithreading && tcon->get_strand()) {
+            tcon->get_raw_socket().async_connect(
+                ep,
+                tcon->get_strand()->wrap(lib::bind(
+                    &type::handle_connect,
+                    this,
+                    tcon,
+                    con_timer,
+                    callback,
+                    lib::placeholders::_1
+                ))
+            );
+        } else {
+            tcon->get_raw_socket().async_connect(
+                ep,
+                lib::bind(
+                    &type::handle_connect,
+                    this,
+                    tcon,
+                    con_timer,
+                    callback,
+                    lib::placeholders::_1
+                )
+            );
+        }
     }
+#endif // _WEBSOCKETPP_LOCAL_SOCKETS_
 
     /// Initialize a connection
     /**
@@ -1095,15 +2270,386 @@ protected:
 
         lib::error_code ec;
 
-        ec = tcon->init_asio(m_io_service);
+        size_t index = 0;
+        if (!config::enable_multithreading || m_pool.empty()) {
+            ec = tcon->init_asio(m_io_service);
+        } else {
+            index = select_pool_index();
+            tcon->m_pool_lease = lib::make_shared<pool_lease>(m_pool_load,
+                index);
+            ec = tcon->init_asio(m_pool[index], false);
+        }
         if (ec) {return ec;}
 
+        tcon->m_shard_index = index;
+
+        tcon->m_timer_wheel = get_timer_wheel(index);
+
         tcon->set_tcp_pre_init_handler(m_tcp_pre_init_handler);
         tcon->set_tcp_post_init_handler(m_tcp_post_init_handler);
 
         return lib::error_code();
     }
 private:
+#ifdef SO_REUSEPORT
+    /// Socket option type for SO_REUSEPORT
+    typedef lib::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>
+        reuse_port;
+#endif
+
+    /// Whether the socket policy uses unix domain sockets rather than TCP
+    static bool is_local_protocol(lib::asio::ip::tcp *) {
+        return false;
+    }
+
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+    static bool is_local_protocol(lib::asio::local::stream_protocol *) {
+        return true;
+    }
+#endif
+
+    /// Open, configure, bind and listen on an acceptor
+    void open_acceptor(lib::asio::ip::tcp::acceptor & acceptor,
+        lib::asio::ip::tcp::endpoint const & ep, lib::asio::error_code & bec)
+    {
+        acceptor.open(ep.protocol(),bec);
+        if (!bec) {
+            acceptor.set_option(lib::asio::socket_base::reuse_address(m_reuse_addr),bec);
+        }
+#ifdef SO_REUSEPORT
+        if (!bec && m_reuse_port) {
+            acceptor.set_option(reuse_port(true),bec);
+        }
+#endif
+        if (!bec) {
+            acceptor.bind(ep,bec);
+        }
+        if (!bec) {
+            acceptor.listen(m_listen_backlog,bec);
+        }
+    }
+
+    /// Close every open acceptor
+    void close_acceptors() {
+        lib::asio::error_code bec;
+
+        if (m_acceptor->is_open()) {
+            m_acceptor->close(bec);
+        }
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+        if (m_local_acceptor && m_local_acceptor->is_open()) {
+            m_local_acceptor->close(bec);
+        }
+        if (!m_local_path.empty()) {
+            std::remove(m_local_path.c_str());
+            m_local_path.clear();
+        }
+#endif
+        for (size_t i = 1; i < m_pool_acceptors.size(); ++i) {
+            if (m_pool_acceptors[i]->is_open()) {
+                m_pool_acceptors[i]->close(bec);
+            }
+        }
+    }
+
+    /// Get the acceptor that shares an io_service with a connection
+    acceptor_ptr get_acceptor(transport_con_ptr tcon) {
+        if (!m_reuse_port) {
+            return m_acceptor;
+        }
+
+        for (size_t i = 1; i < m_pool.size(); ++i) {
+            if (m_pool[i] == tcon->m_io_service) {
+                return m_pool_acceptors[i];
+            }
+        }
+        return m_acceptor;
+    }
+
+    /// Live connection counts per pooled io_service
+    /**
+     * Shared with the leases held by connections so that a connection that
+     * outlives its endpoint can still release its count safely. The counts
+     * are updated without a lock.
+     */
+    class pool_load {
+    public:
+        explicit pool_load(size_t size)
+          : m_connections(new lib::atomic<size_t>[size])
+          , m_size(size)
+        {
+            for (size_t i = 0; i < m_size; ++i) {
+                m_connections[i].store(0);
+            }
+        }
+
+        ~pool_load() {
+            delete[] m_connections;
+        }
+
+        size_t count(size_t index) const {
+            return m_connections[index].load(lib::memory_order_relaxed);
+        }
+
+        void acquire(size_t index) {
+            m_connections[index].fetch_add(1, lib::memory_order_relaxed);
+        }
+
+        /// Pick the io_service with the fewest connections and count one more
+        /**
+         * Concurrent callers may see the same counts and pick the same
+         * io_service.
+         */
+        size_t acquire_least_loaded() {
+            size_t index = 0;
+            size_t least = count(0);
+            for (size_t i = 1; i < m_size; ++i) {
+                size_t c = count(i);
+                if (c < least) {
+                    index = i;
+                    least = c;
+                }
+            }
+
+            acquire(index);
+            return index;
+        }
+
+        void release(size_t index) {
+            m_connections[index].fetch_sub(1, lib::memory_order_relaxed);
+        }
+    private:
+        // Non-copyable
+        pool_load(pool_load const &);
+        pool_load & operator=(pool_load const &);
+
+        lib::atomic<size_t> * m_connections;
+        size_t m_size;
+    };
+
+    /// A connection's registration with a pooled io_service
+    class pool_lease {
+    public:
+        pool_lease(lib::shared_ptr<pool_load> load, size_t index)
+          : m_load(load)
+          , m_index(index) {}
+
+        ~pool_lease() {
+            m_load->release(m_index);
+        }
+    private:
+        lib::shared_ptr<pool_load> m_load;
+        size_t m_index;
+    };
+
+    /// Pick the pooled io_service that a new connection will belong to
+    /**
+     * The returned io_service has already counted the new connection.
+     */
+    size_t select_pool_index() {
+#ifndef _WEBSOCKETPP_NO_THREADING_
+        if (m_reuse_port) {
+            // Connections created on a pool thread stay on it. This keeps
+            // each accept loop on the thread that owns its acceptor.
+            size_t index;
+            if (get_pool_thread_index(index)) {
+                m_pool_load->acquire(index);
+                return index;
+            }
+        }
+#endif
+
+        if (m_pool_placement == placement::least_connections) {
+            return m_pool_load->acquire_least_loaded();
+        }
+
+        size_t index = m_pool_next.fetch_add(1, lib::memory_order_relaxed) %
+            m_pool.size();
+        m_pool_load->acquire(index);
+        return index;
+    }
+
+#ifndef _WEBSOCKETPP_NO_THREADING_
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_
+    /// The pooled io_service run by a thread
+    struct pool_thread {
+        /// The endpoint whose pool the thread runs, NULL if none
+        endpoint const * owner;
+        size_t index;
+    };
+
+    /// Get the record of the pooled io_service run by the calling thread
+    static pool_thread & current_pool_thread() {
+        static _WEBSOCKETPP_THREAD_LOCAL_ pool_thread t;
+        return t;
+    }
+#endif
+
+    /// Get the index of the pooled io_service run by the calling thread
+    /**
+     * @param index Set to the index if the calling thread runs one of this
+     * endpoint's pooled io_services
+     * @return Whether the calling thread runs one of them
+     */
+    bool get_pool_thread_index(size_t & index) {
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_
+        pool_thread const & t = current_pool_thread();
+        if (t.owner != this) {
+            return false;
+        }
+        index = t.index;
+        return true;
+#else
+        scoped_lock_type guard(m_pool_lock);
+
+        lib::thread::id current = lib::this_thread::get_id();
+        for (size_t i = 0; i < m_pool_thread_ids.size(); ++i) {
+            if (m_pool_thread_ids[i] == current) {
+                index = i;
+                return true;
+            }
+        }
+        return false;
+#endif
+    }
+
+    /// Pin the calling thread to a single CPU
+    /**
+     * @param cpu The index of the CPU, wrapped to the number of hardware
+     * threads
+     * @return Whether or not the thread was pinned
+     */
+    static bool pin_current_thread(size_t cpu) {
+#if defined(__linux__)
+        size_t cpus = lib::thread::hardware_concurrency();
+        if (cpus == 0) {
+            return false;
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu % cpus, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    /// Run every pooled io_service on its own thread
+    /**
+     * The calling thread runs the first io_service. Each thread records the
+     * index of its io_service before it starts running handlers.
+     *
+     * The other io_services are kept running until the first one runs out of
+     * work, as it hosts the acceptor that hands them new connections. After
+     * that they finish their remaining work and exit.
+     */
+    std::size_t run_pool() {
+        std::vector<thread_ptr> threads;
+        std::vector<std::size_t> counts(m_pool.size(),0);
+        std::vector<work_ptr> keep_running;
+
+        for (size_t i = 1; i < m_pool.size(); ++i) {
+            io_service_ptr service = m_pool[i];
+            keep_running.push_back(
+                lib::make_shared<lib::asio::io_service::work>(
+                    lib::ref(*service)));
+        }
+
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_
+        // The calling thread may already run another endpoint's pool
+        pool_thread saved = current_pool_thread();
+        current_pool_thread().owner = this;
+        current_pool_thread().index = 0;
+
+        for (size_t i = 1; i < m_pool.size(); ++i) {
+            threads.push_back(lib::make_shared<lib::thread>(lib::bind(
+                &type::run_pool_thread,
+                this,
+                i,
+                &counts[i]
+            )));
+        }
+#else
+        {
+            scoped_lock_type guard(m_pool_lock);
+
+            m_pool_thread_ids.assign(m_pool.size(),lib::thread::id());
+            m_pool_thread_ids[0] = lib::this_thread::get_id();
+
+            for (size_t i = 1; i < m_pool.size(); ++i) {
+                threads.push_back(lib::make_shared<lib::thread>(lib::bind(
+                    &type::run_pool_thread,
+                    this,
+                    i,
+                    &counts[i]
+                )));
+                m_pool_thread_ids[i] = threads.back()->get_id();
+            }
+        }
+#endif
+
+#if defined(__linux__)
+        cpu_set_t saved_affinity;
+        bool restore_affinity = m_pool_cpu_affinity && pthread_getaffinity_np(
+            pthread_self(), sizeof(saved_affinity), &saved_affinity) == 0;
+#endif
+        if (m_pool_cpu_affinity && !pin_current_thread(0)) {
+            m_elog->write(log::elevel::info,
+                "asio::run could not pin pool thread 0 to a CPU");
+        }
+
+        counts[0] = m_io_service->run();
+        keep_running.clear();
+
+#if defined(__linux__)
+        if (restore_affinity) {
+            pthread_setaffinity_np(pthread_self(), sizeof(saved_affinity),
+                &saved_affinity);
+        }
+#endif
+
+        std::size_t total = 0;
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i]->join();
+        }
+        for (size_t i = 0; i < counts.size(); ++i) {
+            total += counts[i];
+        }
+
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_
+        current_pool_thread() = saved;
+#else
+        scoped_lock_type guard(m_pool_lock);
+        m_pool_thread_ids.clear();
+#endif
+
+        return total;
+    }
+
+    /// Thread body for pooled io_services other than the first
+    void run_pool_thread(size_t index, std::size_t * count) {
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_
+        current_pool_thread().owner = this;
+        current_pool_thread().index = index;
+#else
+        {
+            // Wait for run_pool to finish recording thread ids
+            scoped_lock_type guard(m_pool_lock);
+        }
+#endif
+
+        if (m_pool_cpu_affinity && !pin_current_thread(index)) {
+            m_elog->write(log::elevel::info,
+                "asio::run could not pin a pool thread to a CPU");
+        }
+
+        *count = m_pool[index]->run();
+    }
+
+#endif // _WEBSOCKETPP_NO_THREADING_
+
     /// Convenience method for logging the code and message for an error_code
     template <typename error_type>
     void log_err(log::level l, char const * msg, error_type const & ec) {
@@ -1126,12 +2672,45 @@ private:
     io_service_ptr      m_io_service;
     bool                m_external_io_service;
     acceptor_ptr        m_acceptor;
-    resolver_ptr        m_resolver;
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+    local_acceptor_ptr  m_local_acceptor;
+#endif
+    /// Path of the unix domain socket being listened on, if any
+    std::string         m_local_path;
     work_ptr            m_work;
 
+    // io_service pool resources. The first element of m_pool and
+    // m_pool_acceptors is m_io_service and m_acceptor respectively. The
+    // remaining acceptors are only opened in SO_REUSEPORT mode.
+    std::vector<io_service_ptr>     m_pool;
+    std::vector<acceptor_ptr>       m_pool_acceptors;
+    std::vector<work_ptr>           m_pool_work;
+#if !defined(_WEBSOCKETPP_NO_THREADING_) && !defined(_WEBSOCKETPP_THREAD_LOCAL_)
+    /// Ids of the threads running each pooled io_service, used to find the
+    /// calling thread's io_service without thread local storage
+    std::vector<lib::thread::id>    m_pool_thread_ids;
+#endif
+    mutex_type                      m_pool_lock;
+
     // Network constants
     int                 m_listen_backlog;
     bool                m_reuse_addr;
+    bool                m_reuse_port;
+    lib::atomic<size_t> m_pool_next;
+    placement::value    m_pool_placement;
+    bool                m_pool_cpu_affinity;
+    lib::shared_ptr<pool_load> m_pool_load;
+
+    // Connection timer wheels, one per pooled io_service, created on demand
+    std::vector<timer_wheel_ptr> m_timer_wheels;
+    // Wheels of an earlier resolution that still had pending timeouts
+    std::vector<timer_wheel_ptr> m_retired_timer_wheels;
+    long                m_timer_wheel_resolution;
+
+    // Shared DNS cache, empty if caching is disabled
+    dns_cache_ptr       m_dns_cache;
+    // Delay between racing connection attempts, zero to connect sequentially
+    long                m_connection_attempt_delay;
 
     elog_type* m_elog;
     alog_type* m_alog;
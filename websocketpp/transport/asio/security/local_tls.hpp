@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_SECURITY_LOCAL_TLS_HPP
+#define WEBSOCKETPP_TRANSPORT_SECURITY_LOCAL_TLS_HPP
+
+#include <websocketpp/transport/asio/security/tls.hpp>
+
+#include <websocketpp/common/asio.hpp>
+
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+/// A socket policy for the asio transport that implements a TLS encrypted
+/// unix domain socket by wrapping with an asio::ssl::stream
+/**
+ * Endpoints using this policy listen on a `local_endpoint_type` and connect
+ * to `unix:` URIs. They do not accept or open TCP connections. Otherwise the
+ * policy behaves like tls_socket, including TLS session resumption. Client
+ * sessions are cached under the URI of the socket.
+ *
+ * @since 0.8.0
+ */
+namespace local_tls_socket {
+
+/// TLS enabled unix domain socket Asio connection socket component
+typedef tls_socket::basic_connection<lib::asio::local::stream_protocol::socket>
+    connection;
+
+/// TLS enabled unix domain socket Asio endpoint socket component
+typedef tls_socket::basic_endpoint<lib::asio::local::stream_protocol::socket>
+    endpoint;
+
+/// The signature of the socket_init_handler for this socket policy
+typedef connection::socket_init_handler socket_init_handler;
+
+/// The signature of the tls_init_handler for this socket policy
+typedef tls_socket::tls_init_handler tls_init_handler;
+
+} // namespace local_tls_socket
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // _WEBSOCKETPP_LOCAL_SOCKETS_
+
+#endif // WEBSOCKETPP_TRANSPORT_SECURITY_LOCAL_TLS_HPP
@@ -0,0 +1,501 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_SECURITY_SESSION_CACHE_HPP
+#define WEBSOCKETPP_TRANSPORT_SECURITY_SESSION_CACHE_HPP
+
+#include <websocketpp/common/asio_ssl.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#ifdef _WEBSOCKETPP_NO_THREADING_
+#include <websocketpp/concurrency/none.hpp>
+#else
+#include <websocketpp/concurrency/basic.hpp>
+#endif
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+namespace tls_socket {
+
+/// TLS session resumption counters
+struct session_stats {
+    session_stats() : resumed(0), full(0) {}
+
+    /// Fraction of handshakes that resumed a session, zero if there were none
+    double hit_rate() const {
+        uint64_t total = resumed + full;
+        return total ? double(resumed) / double(total) : 0.0;
+    }
+
+    /// Number of handshakes that resumed a previous session
+    uint64_t resumed;
+    /// Number of full handshakes
+    uint64_t full;
+};
+
+/// TLS session resumption cache
+/**
+ * Holds the state that lets TLS connections skip the full handshake when they
+ * reconnect. A cache is shared by all connections of an endpoint and is
+ * attached to every TLS context returned by the endpoint's tls init handler,
+ * so sessions are reused even if the handler creates a new context for each
+ * connection.
+ *
+ * Servers keep resumable sessions by session ID and issue session tickets
+ * encrypted with keys that rotate at a fixed interval. Tickets encrypted with
+ * one of the previous keys are still accepted and are replaced with a ticket
+ * under the current key.
+ *
+ * Clients keep the most recent session for each host and port they connected
+ * to and offer it the next time they connect there.
+ *
+ * Attaching a cache to a context replaces the context's session ID context,
+ * session cache callbacks and ticket key callback. The context holds a
+ * reference to the cache, so the cache lives at least as long as any context
+ * it is attached to.
+ *
+ * @since 0.8.0
+ */
+class session_cache : public lib::enable_shared_from_this<session_cache> {
+public:
+    /// Type of a shared pointer to a session cache
+    typedef lib::shared_ptr<session_cache> ptr;
+
+#ifdef _WEBSOCKETPP_NO_THREADING_
+    typedef concurrency::none concurrency_type;
+#else
+    typedef concurrency::basic concurrency_type;
+#endif
+    /// Type of the mutex protecting the cache
+    typedef concurrency_type::mutex_type mutex_type;
+    /// Type of a lock on the cache
+    typedef concurrency_type::scoped_lock_type scoped_lock_type;
+
+    session_cache()
+      : m_max_sessions(20480)
+      , m_ticket_key_interval(3600)
+      , m_ticket_key_history(2) {}
+
+    ~session_cache() {
+        session_map::iterator it;
+        for (it = m_sessions.begin(); it != m_sessions.end(); ++it) {
+            SSL_SESSION_free(it->second.session);
+        }
+    }
+
+    /// Set the maximum number of sessions kept
+    /**
+     * The oldest session is dropped when a new one would exceed the limit.
+     * Server session IDs and client sessions count towards the same limit.
+     * The default is 20480.
+     *
+     * @param max The maximum number of sessions
+     */
+    void set_max_sessions(size_t max) {
+        scoped_lock_type guard(m_lock);
+        m_max_sessions = max;
+        evict_locked();
+    }
+
+    /// Set how often the session ticket key is replaced
+    /**
+     * New tickets are encrypted with the current key. Tickets encrypted with
+     * one of the `history` previous keys are still accepted. A ticket is
+     * therefore honored for between `history` and `history + 1` intervals.
+     * The defaults are one hour and two previous keys.
+     *
+     * @param interval The lifetime of a key in seconds
+     * @param history The number of previous keys kept for decryption
+     */
+    void set_ticket_key_rotation(long interval, size_t history) {
+        scoped_lock_type guard(m_lock);
+        m_ticket_key_interval = interval > 0 ? interval : 1;
+        m_ticket_key_history = history;
+    }
+
+    /// Replace the session ticket key now
+    /**
+     * Tickets under the previous key stay valid as described in
+     * `set_ticket_key_rotation`.
+     */
+    void rotate_ticket_keys() {
+        scoped_lock_type guard(m_lock);
+        rotate_locked(std::time(NULL));
+    }
+
+    /// Get the resumption counters
+    session_stats get_stats() const {
+        scoped_lock_type guard(m_lock);
+        return m_stats;
+    }
+
+    /// Get the number of sessions held
+    size_t size() const {
+        scoped_lock_type guard(m_lock);
+        return m_sessions.size();
+    }
+
+    /// Attach the cache to a TLS context
+    /**
+     * Called by the tls socket policy for each connection. Contexts the cache
+     * is already attached to are left untouched. The cache must be owned by a
+     * `session_cache::ptr`.
+     *
+     * @param ctx The context
+     * @param is_server Whether the context is used by servers
+     */
+    void attach(SSL_CTX * ctx, bool is_server) {
+        scoped_lock_type guard(m_lock);
+
+        ptr * held = static_cast<ptr *>(SSL_CTX_get_ex_data(ctx,ctx_index()));
+        if (held && held->get() == this) {
+            return;
+        }
+        // The reference is released by free_ctx_data when the context is
+        // freed, or here if another cache takes the context over.
+        SSL_CTX_set_ex_data(ctx,ctx_index(),new ptr(shared_from_this()));
+        delete held;
+
+        SSL_CTX_sess_set_new_cb(ctx,&type::new_session_callback);
+
+        if (is_server) {
+            static unsigned char const id_context[] = "websocketpp";
+            SSL_CTX_set_session_id_context(ctx,id_context,
+                sizeof(id_context) - 1);
+            SSL_CTX_set_session_cache_mode(ctx,SSL_SESS_CACHE_SERVER |
+                SSL_SESS_CACHE_NO_INTERNAL);
+            SSL_CTX_sess_set_get_cb(ctx,&type::get_session_callback);
+            SSL_CTX_sess_set_remove_cb(ctx,&type::remove_session_callback);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx,
+                &type::ticket_key_callback<EVP_MAC_CTX>);
+#else
+            SSL_CTX_set_tlsext_ticket_key_cb(ctx,
+                &type::ticket_key_callback<HMAC_CTX>);
+#endif
+        } else {
+            SSL_CTX_set_session_cache_mode(ctx,SSL_SESS_CACHE_CLIENT |
+                SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        }
+    }
+
+    /// Offer the stored session for a host to a client connection
+    /**
+     * New sessions the server sends on this connection replace the stored
+     * one.
+     *
+     * @param ssl The client connection, before its handshake
+     * @param key The host and port being connected to. Must stay valid for
+     * the lifetime of ssl.
+     */
+    void prepare_client(SSL * ssl, std::string const * key) {
+        SSL_set_ex_data(ssl,ssl_index(),const_cast<std::string *>(key));
+
+        scoped_lock_type guard(m_lock);
+        session_map::iterator it = m_sessions.find(client_key(*key));
+        if (it != m_sessions.end()) {
+            SSL_set_session(ssl,it->second.session);
+        }
+    }
+
+    /// Count a completed handshake
+    void record_handshake(SSL * ssl) {
+        scoped_lock_type guard(m_lock);
+        if (SSL_session_reused(ssl)) {
+            ++m_stats.resumed;
+        } else {
+            ++m_stats.full;
+        }
+    }
+private:
+    typedef session_cache type;
+
+    struct entry {
+        SSL_SESSION * session;
+        std::list<std::string>::iterator age;
+    };
+    typedef std::map<std::string,entry> session_map;
+
+    struct ticket_key {
+        unsigned char name[16];
+        unsigned char aes_key[32];
+        unsigned char hmac_key[32];
+        std::time_t created;
+    };
+
+    static int ctx_index() {
+        static int const index = SSL_CTX_get_ex_new_index(0,NULL,NULL,NULL,
+            &type::free_ctx_data);
+        return index;
+    }
+
+    /// Release the reference a context holds to its cache
+    static void free_ctx_data(void *, void * data, CRYPTO_EX_DATA *, int,
+        long, void *)
+    {
+        delete static_cast<ptr *>(data);
+    }
+
+    static int ssl_index() {
+        static int const index = SSL_get_ex_new_index(0,NULL,NULL,NULL,NULL);
+        return index;
+    }
+
+    static session_cache * from_ctx(SSL_CTX * ctx) {
+        ptr * held = static_cast<ptr *>(SSL_CTX_get_ex_data(ctx,ctx_index()));
+        return held ? held->get() : NULL;
+    }
+
+    static session_cache * from_ssl(SSL * ssl) {
+        return from_ctx(SSL_get_SSL_CTX(ssl));
+    }
+
+    // Client entries are prefixed so they can't collide with session IDs
+    static std::string client_key(std::string const & host) {
+        return "c:" + host;
+    }
+
+    static std::string server_key(unsigned char const * id, unsigned int len) {
+        return "s:" + std::string(reinterpret_cast<char const *>(id),len);
+    }
+
+    static std::string server_key(SSL_SESSION const * session) {
+        unsigned int len;
+        unsigned char const * id = SSL_SESSION_get_id(session,&len);
+        return server_key(id,len);
+    }
+
+    /// Store a session, taking over the caller's reference
+    void insert_locked(std::string const & key, SSL_SESSION * session) {
+        erase_locked(key);
+
+        m_ages.push_back(key);
+        entry e;
+        e.session = session;
+        e.age = --m_ages.end();
+        m_sessions[key] = e;
+
+        evict_locked();
+    }
+
+    void erase_locked(std::string const & key) {
+        session_map::iterator it = m_sessions.find(key);
+        if (it != m_sessions.end()) {
+            SSL_SESSION_free(it->second.session);
+            m_ages.erase(it->second.age);
+            m_sessions.erase(it);
+        }
+    }
+
+    void evict_locked() {
+        while (m_sessions.size() > m_max_sessions) {
+            erase_locked(m_ages.front());
+        }
+    }
+
+    void rotate_locked(std::time_t now) {
+        ticket_key key;
+        if (RAND_bytes(key.name,sizeof(key.name)) != 1 ||
+            RAND_bytes(key.aes_key,sizeof(key.aes_key)) != 1 ||
+            RAND_bytes(key.hmac_key,sizeof(key.hmac_key)) != 1)
+        {
+            // keep using the current key rather than an unseeded one
+            return;
+        }
+        key.created = now;
+
+        m_ticket_keys.push_front(key);
+        while (m_ticket_keys.size() > m_ticket_key_history + 1) {
+            m_ticket_keys.pop_back();
+        }
+    }
+
+    static int new_session_callback(SSL * ssl, SSL_SESSION * session) {
+        session_cache * cache = from_ssl(ssl);
+        if (!cache) {
+            return 0;
+        }
+
+        std::string const * host = static_cast<std::string const *>(
+            SSL_get_ex_data(ssl,ssl_index()));
+
+        scoped_lock_type guard(cache->m_lock);
+        if (host) {
+            cache->insert_locked(client_key(*host),session);
+        } else {
+            cache->insert_locked(server_key(session),session);
+        }
+        // the cache keeps the reference it was given
+        return 1;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    static SSL_SESSION * get_session_callback(SSL * ssl,
+        unsigned char const * id, int len, int * copy)
+#else
+    static SSL_SESSION * get_session_callback(SSL * ssl, unsigned char * id,
+        int len, int * copy)
+#endif
+    {
+        *copy = 0;
+
+        session_cache * cache = from_ssl(ssl);
+        if (!cache) {
+            return NULL;
+        }
+
+        scoped_lock_type guard(cache->m_lock);
+        session_map::iterator it = cache->m_sessions.find(server_key(id,
+            static_cast<unsigned int>(len)));
+        if (it == cache->m_sessions.end()) {
+            return NULL;
+        }
+
+        // OpenSSL takes its own reference to the returned session
+        *copy = 1;
+        return it->second.session;
+    }
+
+    static void remove_session_callback(SSL_CTX * ctx, SSL_SESSION * session) {
+        session_cache * cache = from_ctx(ctx);
+        if (!cache) {
+            return;
+        }
+
+        scoped_lock_type guard(cache->m_lock);
+        cache->erase_locked(server_key(session));
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static bool init_hmac(EVP_MAC_CTX * hctx, unsigned char * key) {
+        OSSL_PARAM params[3];
+        params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,key,
+            32);
+        params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+            const_cast<char *>("SHA256"),0);
+        params[2] = OSSL_PARAM_construct_end();
+        return EVP_MAC_CTX_set_params(hctx,params) == 1;
+    }
+#else
+    static bool init_hmac(HMAC_CTX * hctx, unsigned char * key) {
+        return HMAC_Init_ex(hctx,key,32,EVP_sha256(),NULL) == 1;
+    }
+#endif
+
+    /// Session ticket key callback
+    /**
+     * Returns 1 to use the key, 2 to accept a ticket and issue a new one
+     * under the current key, 0 to fall back to a full handshake and -1 on
+     * error.
+     */
+    template <typename hmac_context>
+    static int ticket_key_callback(SSL * ssl, unsigned char * name,
+        unsigned char * iv, EVP_CIPHER_CTX * cctx, hmac_context * hctx,
+        int enc)
+    {
+        session_cache * cache = from_ssl(ssl);
+        if (!cache) {
+            return -1;
+        }
+
+        scoped_lock_type guard(cache->m_lock);
+        std::deque<ticket_key> & keys = cache->m_ticket_keys;
+
+        if (enc) {
+            std::time_t now = std::time(NULL);
+            if (keys.empty() || now - keys.front().created >=
+                cache->m_ticket_key_interval)
+            {
+                cache->rotate_locked(now);
+            }
+            if (keys.empty()) {
+                return -1;
+            }
+
+            ticket_key & key = keys.front();
+            if (RAND_bytes(iv,EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+                return -1;
+            }
+            std::memcpy(name,key.name,sizeof(key.name));
+            if (EVP_EncryptInit_ex(cctx,EVP_aes_256_cbc(),NULL,key.aes_key,
+                iv) != 1 || !init_hmac(hctx,key.hmac_key))
+            {
+                return -1;
+            }
+            return 1;
+        }
+
+        for (size_t i = 0; i < keys.size(); ++i) {
+            ticket_key & key = keys[i];
+            if (std::memcmp(name,key.name,sizeof(key.name)) != 0) {
+                continue;
+            }
+            if (EVP_DecryptInit_ex(cctx,EVP_aes_256_cbc(),NULL,key.aes_key,
+                iv) != 1 || !init_hmac(hctx,key.hmac_key))
+            {
+                return -1;
+            }
+            return i == 0 ? 1 : 2;
+        }
+        return 0;
+    }
+
+    mutable mutex_type      m_lock;
+    session_map             m_sessions;
+    std::list<std::string>  m_ages;
+    size_t                  m_max_sessions;
+    std::deque<ticket_key>  m_ticket_keys;
+    long                    m_ticket_key_interval;
+    size_t                  m_ticket_key_history;
+    session_stats           m_stats;
+};
+
+} // namespace tls_socket
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_SECURITY_SESSION_CACHE_HPP
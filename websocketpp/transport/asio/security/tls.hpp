@@ -28,7 +28,9 @@
 #ifndef WEBSOCKETPP_TRANSPORT_SECURITY_TLS_HPP
 #define WEBSOCKETPP_TRANSPORT_SECURITY_TLS_HPP
 
+#include <websocketpp/transport/asio/base.hpp>
 #include <websocketpp/transport/asio/security/base.hpp>
+#include <websocketpp/transport/asio/security/session_cache.hpp>
 
 #include <websocketpp/uri.hpp>
 
@@ -38,6 +40,12 @@
 #include <websocketpp/common/functional.hpp>
 #include <websocketpp/common/memory.hpp>
 
+#ifdef _WEBSOCKETPP_NO_THREADING_
+#include <websocketpp/concurrency/none.hpp>
+#else
+#include <websocketpp/concurrency/basic.hpp>
+#endif
+
 #include <sstream>
 #include <string>
 
@@ -57,18 +65,30 @@ typedef lib::function<lib::shared_ptr<lib::asio::ssl::context>(connection_hdl)>
 
 /// TLS enabled Asio connection socket component
 /**
- * transport::asio::tls_socket::connection implements a secure connection socket
- * component that uses Asio's ssl::stream to wrap an ip::tcp::socket.
+ * transport::asio::tls_socket::basic_connection implements a secure
+ * connection socket component that uses Asio's ssl::stream to wrap a stream
+ * socket. tls_socket::connection wraps an ip::tcp::socket and
+ * local_tls_socket::connection a unix domain socket.
+ *
+ * @since 0.8.0 as a template on the wrapped socket type
+ *
+ * @tparam Socket The type of the Asio stream socket to wrap
  */
-class connection : public lib::enable_shared_from_this<connection> {
+template <typename Socket>
+class basic_connection
+  : public lib::enable_shared_from_this<basic_connection<Socket> >
+{
 public:
     /// Type of this connection socket component
-    typedef connection type;
+    typedef basic_connection<Socket> type;
     /// Type of a shared pointer to this connection socket component
     typedef lib::shared_ptr<type> ptr;
 
     /// Type of the ASIO socket being used
-    typedef lib::asio::ssl::stream<lib::asio::ip::tcp::socket> socket_type;
+    typedef lib::asio::ssl::stream<Socket> socket_type;
+    /// The signature of the socket_init_handler for this socket component
+    typedef lib::function<void(connection_hdl,socket_type&)>
+        socket_init_handler;
     /// Type of a shared pointer to the ASIO socket being used
     typedef lib::shared_ptr<socket_type> socket_ptr;
     /// Type of a pointer to the ASIO io_service being used
@@ -78,14 +98,22 @@ public:
     /// Type of a shared pointer to the ASIO TLS context being used
     typedef lib::shared_ptr<lib::asio::ssl::context> context_ptr;
 
-    explicit connection() {
+#ifdef _WEBSOCKETPP_NO_THREADING_
+    typedef concurrency::none concurrency_type;
+#else
+    typedef concurrency::basic concurrency_type;
+#endif
+    /// Type of the arena that holds memory for TLS handshakes and shutdowns
+    typedef handler_arena<concurrency_type> handler_arena_type;
+
+    explicit basic_connection() {
         //std::cout << "transport::asio::tls_socket::connection constructor"
         //          << std::endl;
     }
 
     /// Get a shared pointer to this component
     ptr get_shared() {
-        return shared_from_this();
+        return this->shared_from_this();
     }
 
     /// Check whether or not this connection is secure
@@ -100,7 +128,7 @@ public:
     /**
      * This is used internally. It can also be used to set socket options, etc
      */
-    socket_type::lowest_layer_type & get_raw_socket() {
+    typename socket_type::lowest_layer_type & get_raw_socket() {
         return m_socket->lowest_layer();
     }
 
@@ -108,7 +136,7 @@ public:
     /**
      * This is used internally.
      */
-    socket_type::next_layer_type & get_next_layer() {
+    typename socket_type::next_layer_type & get_next_layer() {
         return m_socket->next_layer();
     }
 
@@ -145,6 +173,20 @@ public:
         m_tls_init_handler = h;
     }
 
+    /// Set the TLS session cache
+    /**
+     * Connections with a session cache attach it to their TLS context. Client
+     * connections offer the cached session for their host and port and all
+     * connections count their handshakes in the cache's stats.
+     *
+     * @since 0.8.0
+     *
+     * @param cache The session cache, or an empty pointer for none
+     */
+    void set_session_cache(session_cache::ptr cache) {
+        m_session_cache = cache;
+    }
+
     /// Get the remote endpoint address
     /**
      * The iostream transport has no information about the ultimate remote
@@ -159,7 +201,11 @@ public:
         std::stringstream s;
 
         lib::asio::error_code aec;
-        lib::asio::ip::tcp::endpoint ep = m_socket->lowest_layer().remote_endpoint(aec);
+        typename socket_type::lowest_layer_type::endpoint_type ep =
+            m_socket->lowest_layer().remote_endpoint(aec);
+        if (!aec) {
+            write_remote_endpoint(s, ep, m_socket->lowest_layer(), aec);
+        }
 
         if (aec) {
             ec = error::make_error_code(error::pass_through);
@@ -168,7 +214,6 @@ public:
             return s.str();
         } else {
             ec = lib::error_code();
-            s << ep;
             return s.str();
         }
     }
@@ -193,6 +238,9 @@ protected:
         if (!m_context) {
             return socket::make_error_code(socket::error::invalid_tls_context);
         }
+        if (m_session_cache) {
+            m_session_cache->attach(m_context->native_handle(),is_server);
+        }
         m_socket = lib::make_shared<socket_type>(
             _WEBSOCKETPP_REF(*service),lib::ref(*m_context));
 
@@ -245,6 +293,16 @@ protected:
         }
 #endif
 
+        if (!m_is_server && m_session_cache) {
+            if (m_uri->get_socket_path().empty()) {
+                m_session_key = m_uri->get_authority();
+            } else {
+                m_session_key = m_uri->str();
+            }
+            m_session_cache->prepare_client(get_socket().native_handle(),
+                &m_session_key);
+        }
+
         if (m_socket_init_handler) {
             m_socket_init_handler(m_hdl,get_socket());
         }
@@ -267,19 +325,25 @@ protected:
         if (m_strand) {
             m_socket->async_handshake(
                 get_handshake_type(),
-                m_strand->wrap(lib::bind(
-                    &type::handle_init, get_shared(),
-                    callback,
-                    lib::placeholders::_1
+                m_strand->wrap(make_custom_alloc_handler(
+                    m_handler_arena,
+                    lib::bind(
+                        &type::handle_init, get_shared(),
+                        callback,
+                        lib::placeholders::_1
+                    )
                 ))
             );
         } else {
             m_socket->async_handshake(
                 get_handshake_type(),
-                lib::bind(
-                    &type::handle_init, get_shared(),
-                    callback,
-                    lib::placeholders::_1
+                make_custom_alloc_handler(
+                    m_handler_arena,
+                    lib::bind(
+                        &type::handle_init, get_shared(),
+                        callback,
+                        lib::placeholders::_1
+                    )
                 )
             );
         }
@@ -301,6 +365,9 @@ protected:
             m_ec = socket::make_error_code(socket::error::tls_handshake_failed);
         } else {
             m_ec = lib::error_code();
+            if (m_session_cache) {
+                m_session_cache->record_handshake(get_socket().native_handle());
+            }
         }
 
         callback(m_ec);
@@ -327,9 +394,11 @@ protected:
 
     void async_shutdown(socket::shutdown_handler callback) {
         if (m_strand) {
-            m_socket->async_shutdown(m_strand->wrap(callback));
+            m_socket->async_shutdown(m_strand->wrap(
+                make_custom_alloc_handler(m_handler_arena, callback)));
         } else {
-            m_socket->async_shutdown(callback);
+            m_socket->async_shutdown(
+                make_custom_alloc_handler(m_handler_arena, callback));
         }
     }
 
@@ -383,7 +452,7 @@ protected:
         return ec;
     }
 private:
-    socket_type::handshake_type get_handshake_type() {
+    typename socket_type::handshake_type get_handshake_type() {
         if (m_is_server) {
             return lib::asio::ssl::stream_base::server;
         } else {
@@ -391,6 +460,36 @@ private:
         }
     }
 
+    /// Write the address of the peer of a TCP socket
+    template <typename LowestLayer>
+    static void write_remote_endpoint(std::ostream & s,
+        lib::asio::ip::tcp::endpoint const & ep, LowestLayer &,
+        lib::asio::error_code &)
+    {
+        s << ep;
+    }
+
+#ifdef _WEBSOCKETPP_LOCAL_SOCKETS_
+    /// Write the address of the peer of a unix domain socket
+    /**
+     * The peer of an accepted connection is usually unnamed, so the path of
+     * the socket the connection was accepted on is written instead.
+     */
+    template <typename LowestLayer>
+    static void write_remote_endpoint(std::ostream & s,
+        lib::asio::local::stream_protocol::endpoint const & ep,
+        LowestLayer & socket, lib::asio::error_code & aec)
+    {
+        std::string path = ep.path();
+        if (path.empty()) {
+            path = socket.local_endpoint(aec).path();
+        }
+        if (!aec) {
+            s << "unix:" << path;
+        }
+    }
+#endif
+
     io_service_ptr      m_io_service;
     strand_ptr          m_strand;
     context_ptr         m_context;
@@ -398,8 +497,15 @@ private:
     uri_ptr             m_uri;
     bool                m_is_server;
 
+    session_cache::ptr  m_session_cache;
+    /// Host the cached client session belongs to. Referenced by the SSL object
+    std::string         m_session_key;
+
     lib::error_code     m_ec;
 
+    /// Memory for the handshake and shutdown operations
+    handler_arena_type  m_handler_arena;
+
     connection_hdl      m_hdl;
     socket_init_handler m_socket_init_handler;
     tls_init_handler    m_tls_init_handler;
@@ -407,21 +513,28 @@ private:
 
 /// TLS enabled Asio endpoint socket component
 /**
- * transport::asio::tls_socket::endpoint implements a secure endpoint socket
- * component that uses Asio's ssl::stream to wrap an ip::tcp::socket.
+ * transport::asio::tls_socket::basic_endpoint implements a secure endpoint
+ * socket component that uses Asio's ssl::stream to wrap a stream socket.
+ *
+ * @since 0.8.0 as a template on the wrapped socket type
+ *
+ * @tparam Socket The type of the Asio stream socket to wrap
  */
-class endpoint {
+template <typename Socket>
+class basic_endpoint {
 public:
     /// The type of this endpoint socket component
-    typedef endpoint type;
+    typedef basic_endpoint<Socket> type;
 
     /// The type of the corresponding connection socket component
-    typedef connection socket_con_type;
+    typedef basic_connection<Socket> socket_con_type;
     /// The type of a shared pointer to the corresponding connection socket
     /// component.
-    typedef socket_con_type::ptr socket_con_ptr;
+    typedef typename socket_con_type::ptr socket_con_ptr;
+    /// The signature of the socket_init_handler for this socket component
+    typedef typename socket_con_type::socket_init_handler socket_init_handler;
 
-    explicit endpoint() {}
+    explicit basic_endpoint() {}
 
     /// Checks whether the endpoint creates secure connections
     /**
@@ -455,6 +568,51 @@ public:
     void set_tls_init_handler(tls_init_handler h) {
         m_tls_init_handler = h;
     }
+
+    /// Enable or disable TLS session resumption
+    /**
+     * Session resumption lets reconnecting clients skip the full TLS
+     * handshake. When enabled, all connections created afterwards share one
+     * session_cache that is attached to the TLS contexts returned by the tls
+     * init handler. See session_cache for details. Disabled by default.
+     *
+     * Disabling resumption drops the cache and its counters.
+     *
+     * @since 0.8.0
+     *
+     * @param value Whether or not to resume TLS sessions
+     */
+    void set_tls_session_resumption(bool value) {
+        if (!value) {
+            m_session_cache.reset();
+        } else if (!m_session_cache) {
+            m_session_cache = lib::make_shared<session_cache>();
+        }
+    }
+
+    /// Get the TLS session cache
+    /**
+     * May be used to configure the cache's size and ticket key rotation.
+     *
+     * @since 0.8.0
+     *
+     * @return The cache, or an empty pointer if session resumption is
+     * disabled
+     */
+    session_cache::ptr get_tls_session_cache() const {
+        return m_session_cache;
+    }
+
+    /// Get the TLS session resumption counters
+    /**
+     * @since 0.8.0
+     *
+     * @return The number of resumed and full handshakes of connections
+     * created while session resumption was enabled
+     */
+    session_stats get_tls_session_stats() const {
+        return m_session_cache ? m_session_cache->get_stats() : session_stats();
+    }
 protected:
     /// Initialize a connection
     /**
@@ -468,14 +626,22 @@ protected:
     lib::error_code init(socket_con_ptr scon) {
         scon->set_socket_init_handler(m_socket_init_handler);
         scon->set_tls_init_handler(m_tls_init_handler);
+        scon->set_session_cache(m_session_cache);
         return lib::error_code();
     }
 
 private:
     socket_init_handler m_socket_init_handler;
     tls_init_handler m_tls_init_handler;
+    session_cache::ptr m_session_cache;
 };
 
+/// TLS enabled Asio connection socket component for TCP sockets
+typedef basic_connection<lib::asio::ip::tcp::socket> connection;
+
+/// TLS enabled Asio endpoint socket component for TCP sockets
+typedef basic_endpoint<lib::asio::ip::tcp::socket> endpoint;
+
 } // namespace tls_socket
 } // namespace asio
 } // namespace transport
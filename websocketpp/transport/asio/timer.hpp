@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_ASIO_TIMER_HPP
+#define WEBSOCKETPP_TRANSPORT_ASIO_TIMER_HPP
+
+#include <websocketpp/transport/base/connection.hpp>
+
+#include <websocketpp/common/asio.hpp>
+#include <websocketpp/common/chrono.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/system_error.hpp>
+
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+/// Handle to a pending connection timer
+/**
+ * Returned by `connection::set_timer`. Depending on how the endpoint was
+ * configured the timer is either backed by its own Asio steady_timer or by an
+ * entry in a timer_wheel shared by all connections on an io_service.
+ */
+class timer {
+public:
+    virtual ~timer() {}
+
+    /// Cancel the timer
+    /**
+     * If the timer has not fired yet its handler will be called with
+     * transport::error::operation_aborted. The handler is never called from
+     * within cancel itself.
+     */
+    virtual void cancel() = 0;
+
+    /// Test whether the timer's expiry time has passed
+    /**
+     * Handlers that race with a timeout use this to determine whether the
+     * timeout handler has been or is about to be called.
+     */
+    virtual bool expired() const = 0;
+};
+
+/// Timer handle backed by an individual Asio steady_timer
+class basic_timer : public timer {
+public:
+    basic_timer(lib::asio::io_service & service, long duration)
+      : m_timer(service, lib::asio::milliseconds(duration)) {}
+
+    void cancel() {
+        m_timer.cancel();
+    }
+
+    bool expired() const {
+        return lib::asio::is_neg(m_timer.expires_from_now());
+    }
+
+    /// Get the underlying Asio timer
+    lib::asio::steady_timer & get_timer() {
+        return m_timer;
+    }
+private:
+    lib::asio::steady_timer m_timer;
+};
+
+/// Hierarchical timing wheel for connection timeouts
+/**
+ * A timer_wheel keeps a large number of coarse timeouts on a single Asio
+ * timer. Arming and cancelling a timeout are constant time operations that
+ * only touch an intrusive list, rather than the Asio timer queue. The wheel's
+ * own Asio timer only runs while at least one timeout is pending.
+ *
+ * Timeouts are rounded up to a whole number of ticks of the configured
+ * resolution and fire at most one tick late. The first level covers 256
+ * ticks, each of the three further levels 64 times as many as the level
+ * below. Longer timeouts wait in the last slot of the highest level and are
+ * linked again each time it cascades, until they are in range.
+ *
+ * A scheduled timeout is linked into the wheel through an `entry`. Callers
+ * that arm timeouts repeatedly keep their own entries and schedule their
+ * own `timeout` objects on them, so that arming a timeout allocates nothing
+ * in the wheel. `schedule(duration, callback)` allocates both for callers
+ * that do not.
+ *
+ * Pending timeouts are owned by the wheel, and the wheel only by its
+ * creator. Neither the wheel's Asio timer nor its entries keep it alive, so
+ * releasing the wheel destroys the handlers of timeouts that never fired,
+ * as Asio does for handlers pending when an io_service is destroyed.
+ *
+ * Handlers are called from a thread running the wheel's io_service. Handlers
+ * that need to run in a strand should be wrapped by the caller.
+ *
+ * @since 0.8.0
+ */
+template <typename concurrency>
+class timer_wheel
+  : public lib::enable_shared_from_this<timer_wheel<concurrency> >
+{
+public:
+    /// Type of this timer wheel
+    typedef timer_wheel<concurrency> type;
+    /// Type of a shared pointer to this timer wheel
+    typedef lib::shared_ptr<type> ptr;
+    /// Type of a pointer to the Asio io_service the wheel runs on
+    typedef lib::asio::io_service * io_service_ptr;
+    /// Type of a handle to a scheduled timeout
+    typedef lib::shared_ptr<timer> timer_ptr;
+    /// Type of a timeout handler
+    typedef lib::function<void(lib::error_code const &)> handler;
+    /// Type of the clock timeouts are measured with
+    typedef lib::chrono::steady_clock clock_type;
+
+    /// Type of the mutex used to protect the wheel
+    typedef typename concurrency::mutex_type mutex_type;
+    /// Type of the lock used to protect the wheel
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+
+    class timeout;
+    /// Type of a pointer to a timeout
+    typedef lib::shared_ptr<timeout> timeout_ptr;
+
+    /// Link of a timeout in one slot of the wheel
+    /**
+     * An entry holds at most one pending timeout and may be reused as soon
+     * as that timeout fires or is cancelled. Its fields are only accessed
+     * with the wheel locked. An entry that may still be pending must be
+     * released before it is destroyed.
+     */
+    class entry {
+    public:
+        entry() : m_expiry(0), m_slot(0), m_prev(NULL), m_next(NULL) {}
+    private:
+        friend class timer_wheel;
+
+        // Non-copyable
+        entry(entry const &);
+        entry & operator=(entry const &);
+
+        /// The pending timeout, empty if the entry is free
+        timeout_ptr m_timeout;
+        uint64_t m_expiry;
+        size_t m_slot;
+        entry * m_prev;
+        entry * m_next;
+    };
+
+    /// A timeout scheduled on the wheel
+    /**
+     * Serves as the handle returned to the code that scheduled it, which
+     * may cancel it or test whether it expired. `call` runs once, when the
+     * timeout expires or after it is cancelled.
+     */
+    class timeout : public timer {
+    public:
+        timeout() : m_entry(NULL) {}
+
+        void cancel() {
+            ptr wheel = m_wheel.lock();
+            if (wheel) {
+                wheel->cancel(this);
+            }
+        }
+
+        bool expired() const {
+            return clock_type::now() >= m_deadline;
+        }
+
+        /// Called when the timeout expires or is cancelled
+        virtual void call(lib::error_code const & ec) = 0;
+    private:
+        friend class timer_wheel;
+
+        lib::weak_ptr<type> m_wheel;
+        clock_type::time_point m_deadline;
+        /// The entry linking this timeout, NULL once it fired or was
+        /// cancelled. Lock: the wheel's lock.
+        entry * m_entry;
+    };
+
+    /// Construct a timer wheel
+    /**
+     * @param service The io_service to run the wheel's timer on
+     * @param resolution The length of one tick in milliseconds
+     */
+    timer_wheel(io_service_ptr service, long resolution)
+      : m_io_service(service)
+      , m_timer(*service)
+      , m_resolution(resolution > 0 ? resolution : 1)
+      , m_origin(clock_type::now())
+      , m_current(0)
+      , m_size(0)
+      , m_armed(false)
+      , m_slots(slot_count, static_cast<entry *>(NULL)) {}
+
+    ~timer_wheel() {
+        // Unlink every entry before dropping any timeout. Their handlers are
+        // destroyed without being called, as Asio does for handlers pending
+        // when an io_service is destroyed, and may release the owners of
+        // entries that are still linked.
+        std::vector<timeout_ptr> pending;
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            while (m_slots[i]) {
+                pending.push_back(unlink(m_slots[i]));
+            }
+        }
+    }
+
+    /// Get the length of one tick in milliseconds
+    long get_resolution() const {
+        return m_resolution;
+    }
+
+    /// Get the number of pending timeouts
+    size_t size() const {
+        scoped_lock_type guard(m_lock);
+        return m_size;
+    }
+
+    /// Schedule a timeout
+    /**
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call when the timeout expires or is
+     * cancelled.
+     * @return A handle that can be used to cancel the timeout
+     */
+    timer_ptr schedule(long duration, handler callback) {
+        lib::shared_ptr<callback_timeout> t =
+            lib::make_shared<callback_timeout>(callback);
+        schedule(&t->m_link, 1, t, duration);
+        return t;
+    }
+
+    /// Schedule a timeout on one of the caller's entries
+    /**
+     * Links the timeout through the first of the given entries that is
+     * free. Nothing is scheduled if all of them are pending.
+     *
+     * @param entries The entries that may link the timeout
+     * @param count The number of entries
+     * @param t The timeout to schedule. Must not have been scheduled before.
+     * @param duration Length of time to wait in milliseconds
+     * @return Whether a free entry was found
+     */
+    bool schedule(entry * entries, size_t count, timeout_ptr const & t,
+        long duration)
+    {
+        t->m_wheel = this->shared_from_this();
+
+        clock_type::time_point now = clock_type::now();
+        t->m_deadline = now + lib::chrono::milliseconds(duration);
+
+        bool arm;
+        {
+            scoped_lock_type guard(m_lock);
+
+            entry * e = NULL;
+            for (size_t i = 0; i < count; ++i) {
+                if (!entries[i].m_timeout) {
+                    e = &entries[i];
+                    break;
+                }
+            }
+            if (!e) {
+                return false;
+            }
+
+            if (m_size == 0) {
+                // Nothing is pending so the current tick may be stale
+                m_current = ticks_at(now);
+            }
+
+            uint64_t expiry = ticks_at(t->m_deadline);
+            if (duration > 0 && t->m_deadline > tick_time(expiry)) {
+                ++expiry;
+            }
+            if (expiry <= m_current) {
+                expiry = m_current + 1;
+            }
+            e->m_expiry = expiry;
+
+            e->m_timeout = t;
+            t->m_entry = e;
+            link(e);
+
+            arm = !m_armed;
+            m_armed = true;
+        }
+
+        if (arm) {
+            start_tick();
+        }
+
+        return true;
+    }
+
+    /// Drop the timeout pending on an entry without calling it
+    /**
+     * Used by the owner of an entry before destroying it.
+     *
+     * @param e The entry to release
+     */
+    void release(entry & e) {
+        timeout_ptr dropped;
+        {
+            scoped_lock_type guard(m_lock);
+            if (e.m_timeout) {
+                dropped = unlink(&e);
+            }
+        }
+    }
+private:
+    /// Timeout that calls a function, linked by an entry of its own
+    class callback_timeout : public timeout {
+    public:
+        explicit callback_timeout(handler const & callback)
+          : m_callback(callback) {}
+
+        void call(lib::error_code const & ec) {
+            m_callback(ec);
+        }
+
+        handler m_callback;
+        entry m_link;
+    };
+
+    static size_t const level0_bits = 8;
+    static size_t const level_bits = 6;
+    static size_t const level0_size = size_t(1) << level0_bits;
+    static size_t const level_size = size_t(1) << level_bits;
+    static size_t const levels = 4;
+    static size_t const slot_count = level0_size + (levels - 1) * level_size;
+
+    uint64_t ticks_at(clock_type::time_point t) const {
+        if (t <= m_origin) {
+            return 0;
+        }
+        return static_cast<uint64_t>(lib::chrono::duration_cast<
+            lib::chrono::milliseconds>(t - m_origin).count() / m_resolution);
+    }
+
+    clock_type::time_point tick_time(uint64_t tick) const {
+        return m_origin + lib::chrono::milliseconds(
+            static_cast<long>(tick) * m_resolution);
+    }
+
+    /// Add an entry to the slot matching its expiry. Requires the lock.
+    void link(entry * e) {
+        uint64_t delta = e->m_expiry - m_current;
+        size_t slot;
+
+        if (delta < level0_size) {
+            slot = static_cast<size_t>(e->m_expiry & (level0_size - 1));
+        } else {
+            size_t level = 1;
+            size_t shift = level0_bits;
+            while (level < levels - 1 &&
+                delta >= (uint64_t(1) << (shift + level_bits)))
+            {
+                ++level;
+                shift += level_bits;
+            }
+
+            // Timeouts beyond the range of the highest level wait in its
+            // furthest slot and are placed again when that slot cascades.
+            uint64_t max_delta = uint64_t(1) << (shift + level_bits);
+            uint64_t place = e->m_expiry;
+            if (delta >= max_delta) {
+                place = m_current + max_delta - 1;
+            }
+
+            slot = level0_size + (level - 1) * level_size +
+                static_cast<size_t>((place >> shift) & (level_size - 1));
+        }
+
+        e->m_slot = slot;
+        e->m_prev = NULL;
+        e->m_next = m_slots[slot];
+        if (e->m_next) {
+            e->m_next->m_prev = e;
+        }
+        m_slots[slot] = e;
+        ++m_size;
+    }
+
+    /// Remove an entry from its slot and free it. Requires the lock.
+    /**
+     * The entry's timeout is returned rather than released, as it may own
+     * the entry or hold the last reference to its owner. Callers drop it
+     * after the lock is released.
+     */
+    timeout_ptr unlink(entry * e) {
+        if (e->m_prev) {
+            e->m_prev->m_next = e->m_next;
+        } else {
+            m_slots[e->m_slot] = e->m_next;
+        }
+        if (e->m_next) {
+            e->m_next->m_prev = e->m_prev;
+        }
+        e->m_prev = NULL;
+        e->m_next = NULL;
+        --m_size;
+
+        timeout_ptr t;
+        t.swap(e->m_timeout);
+        t->m_entry = NULL;
+        return t;
+    }
+
+    void cancel(timeout * t) {
+        timeout_ptr cancelled;
+        {
+            scoped_lock_type guard(m_lock);
+            if (!t->m_entry) {
+                // Already fired or cancelled
+                return;
+            }
+            cancelled = unlink(t->m_entry);
+        }
+
+        m_io_service->post(lib::bind(&timeout::call, cancelled,
+            make_error_code(transport::error::operation_aborted)));
+    }
+
+    /// Re-link every entry of a higher level slot. Requires the lock.
+    void cascade(size_t slot) {
+        entry * e = m_slots[slot];
+        m_slots[slot] = NULL;
+
+        while (e) {
+            entry * next = e->m_next;
+            --m_size;
+            link(e);
+            e = next;
+        }
+    }
+
+    void start_tick() {
+        clock_type::time_point next;
+        {
+            scoped_lock_type guard(m_lock);
+            next = tick_time(m_current + 1);
+        }
+
+        long wait = 0;
+        clock_type::time_point now = clock_type::now();
+        if (next > now) {
+            wait = static_cast<long>(lib::chrono::duration_cast<
+                lib::chrono::milliseconds>(next - now).count()) + 1;
+        }
+
+        m_timer.expires_from_now(lib::asio::milliseconds(wait));
+        m_timer.async_wait(lib::bind(
+            &type::handle_tick_weak,
+            lib::weak_ptr<type>(this->shared_from_this()),
+            lib::placeholders::_1
+        ));
+    }
+
+    /// Forward a tick to the wheel, if it still exists
+    static void handle_tick_weak(lib::weak_ptr<type> weak,
+        lib::asio::error_code const & ec)
+    {
+        ptr wheel = weak.lock();
+        if (wheel) {
+            wheel->handle_tick(ec);
+        }
+    }
+
+    void handle_tick(lib::asio::error_code const & ec) {
+        if (ec) {
+            scoped_lock_type guard(m_lock);
+            m_armed = false;
+            return;
+        }
+
+        std::vector<timeout_ptr> expired;
+        bool arm;
+        {
+            scoped_lock_type guard(m_lock);
+            uint64_t target = ticks_at(clock_type::now());
+
+            while (m_current < target && m_size > 0) {
+                ++m_current;
+
+                size_t shift = level0_bits;
+                for (size_t level = 1; level < levels; ++level) {
+                    if ((m_current & ((uint64_t(1) << shift) - 1)) != 0) {
+                        break;
+                    }
+                    cascade(level0_size + (level - 1) * level_size +
+                        static_cast<size_t>((m_current >> shift) &
+                        (level_size - 1)));
+                    shift += level_bits;
+                }
+
+                size_t slot = static_cast<size_t>(m_current &
+                    (level0_size - 1));
+                while (m_slots[slot]) {
+                    expired.push_back(unlink(m_slots[slot]));
+                }
+            }
+
+            if (m_size == 0) {
+                m_current = target;
+            }
+
+            arm = (m_size > 0);
+            m_armed = arm;
+        }
+
+        if (arm) {
+            start_tick();
+        }
+
+        for (size_t i = 0; i < expired.size(); ++i) {
+            expired[i]->call(lib::error_code());
+        }
+    }
+
+    io_service_ptr          m_io_service;
+    lib::asio::steady_timer m_timer;
+    long const              m_resolution;
+    clock_type::time_point const m_origin;
+
+    mutable mutex_type      m_lock;
+    uint64_t                m_current;
+    size_t                  m_size;
+    bool                    m_armed;
+    std::vector<entry *>    m_slots;
+};
+
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_ASIO_TIMER_HPP
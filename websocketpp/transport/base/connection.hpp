@@ -31,6 +31,7 @@
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/connection_hdl.hpp>
 #include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/inline_function.hpp>
 #include <websocketpp/common/system_error.hpp>
 
 #include <string>
@@ -107,6 +108,11 @@ namespace websocketpp {
  * the transport's event system if it uses one. Otherwise, this method should
  * simply call `handler` immediately.
  *
+ * **get_shard_index**\n
+ * `size_t get_shard_index() const`\n
+ * The index of the endpoint shard, as counted by the endpoint's
+ * `get_shard_count`, that this connection's handlers run on.
+ *
  * **async_shutdown**\n
  * `void async_shutdown(shutdown_handler handler)`\n
  * Perform any cleanup necessary (if any). Call `handler` when complete.
@@ -117,10 +123,14 @@ namespace transport {
 typedef lib::function<void(lib::error_code const &)> init_handler;
 
 /// The type and signature of the callback passed to the read method
-typedef lib::function<void(lib::error_code const &,size_t)> read_handler;
+/**
+ * Read, write and dispatch handlers are invoked for every message. They are
+ * stored inline and never allocate. See inline_function.
+ */
+typedef inline_function<void(lib::error_code const &,size_t)> read_handler;
 
 /// The type and signature of the callback passed to the write method
-typedef lib::function<void(lib::error_code const &)> write_handler;
+typedef inline_function<void(lib::error_code const &)> write_handler;
 
 /// The type and signature of the callback passed to the read method
 typedef lib::function<void(lib::error_code const &)> timer_handler;
@@ -129,10 +139,10 @@ typedef lib::function<void(lib::error_code const &)> timer_handler;
 typedef lib::function<void(lib::error_code const &)> shutdown_handler;
 
 /// The type and signature of the callback passed to the interrupt method
-typedef lib::function<void()> interrupt_handler;
+typedef inline_function<void()> interrupt_handler;
 
 /// The type and signature of the callback passed to the dispatch method
-typedef lib::function<void()> dispatch_handler;
+typedef inline_function<void()> dispatch_handler;
 
 /// A simple utility buffer class
 struct buffer {
@@ -62,6 +62,17 @@ namespace websocketpp {
  * `void init_logging(alog_type * a, elog_type * e)`\n
  * Called once after construction to provide pointers to the endpoint's access
  * and error loggers. These may be stored and used to log messages or ignored.
+ *
+ * **get_shard_count**\n
+ * `size_t get_shard_count() const`\n
+ * The number of independent event loops connections are spread over. Used to
+ * shard the endpoint's registry of open connections. Transports with a single
+ * event loop return one.
+ *
+ * **post_to_shard**\n
+ * `void post_to_shard(size_t index, dispatch_handler handler)`\n
+ * Run `handler` on the event loop of shard `index`. Transports without an
+ * event loop may call `handler` immediately.
  */
 namespace transport {
 
@@ -207,6 +207,17 @@ public:
     void fullfil_write() {
         m_write_handler(lib::error_code());
     }
+
+    /// Get the index of the endpoint shard this connection belongs to
+    /**
+     * This transport uses a single shard.
+     *
+     * @since 0.8.0
+     */
+    size_t get_shard_index() const {
+        return 0;
+    }
+
 protected:
     /// Initialize the connection transport
     /**
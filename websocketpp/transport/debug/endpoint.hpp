@@ -89,6 +89,28 @@ public:
     bool is_secure() const {
         return false;
     }
+
+    /// Get the number of shards of the endpoint
+    /**
+     * This transport has no event loop of its own and uses a single shard.
+     *
+     * @since 0.8.0
+     */
+    size_t get_shard_count() const {
+        return 1;
+    }
+
+    /// Run a handler on the thread that owns a shard
+    /**
+     * This transport has no event loop of its own. The handler is called
+     * immediately.
+     *
+     * @since 0.8.0
+     */
+    void post_to_shard(size_t, transport::dispatch_handler handler) {
+        handler();
+    }
+
 protected:
     /// Initialize logging
     /**
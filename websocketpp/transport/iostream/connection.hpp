@@ -400,6 +400,17 @@ public:
     void set_shutdown_handler(shutdown_handler h) {
         m_shutdown_handler = h;
     }
+
+    /// Get the index of the endpoint shard this connection belongs to
+    /**
+     * This transport uses a single shard.
+     *
+     * @since 0.8.0
+     */
+    size_t get_shard_index() const {
+        return 0;
+    }
+
 protected:
     /// Initialize the connection transport
     /**
@@ -167,6 +167,17 @@ public:
     timer_ptr set_timer(long duration, timer_handler handler) {
         return timer_ptr();
     }
+
+    /// Get the index of the endpoint shard this connection belongs to
+    /**
+     * This transport uses a single shard.
+     *
+     * @since 0.8.0
+     */
+    size_t get_shard_index() const {
+        return 0;
+    }
+
 protected:
     /// Initialize the connection transport
     /**
@@ -0,0 +1,599 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_CON_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_CON_HPP
+
+#include <websocketpp/transport/uring/base.hpp>
+#include <websocketpp/transport/uring/ring.hpp>
+
+#include <websocketpp/transport/base/connection.hpp>
+
+#include <websocketpp/uri.hpp>
+#include <websocketpp/logger/format.hpp>
+#include <websocketpp/logger/levels.hpp>
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/functional.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace uring {
+
+/// A socket address and its length
+struct address {
+    sockaddr_storage storage;
+    socklen_t length;
+};
+
+/// Format a socket address as `host:port` or `[host]:port`
+inline std::string format_address(sockaddr const * addr) {
+    char host[INET6_ADDRSTRLEN];
+    std::stringstream s;
+
+    if (addr->sa_family == AF_INET) {
+        sockaddr_in const * in = reinterpret_cast<sockaddr_in const *>(addr);
+        ::inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+        s << host << ":" << ntohs(in->sin_port);
+    } else if (addr->sa_family == AF_INET6) {
+        sockaddr_in6 const * in6 = reinterpret_cast<sockaddr_in6 const *>(addr);
+        ::inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+        s << "[" << host << "]:" << ntohs(in6->sin6_port);
+    } else {
+        s << "unknown address family " << addr->sa_family;
+    }
+    return s.str();
+}
+
+/// Connection transport component that uses io_uring
+/**
+ * transport::uring::connection implements a connection transport component
+ * on top of a uring::ring shared by all connections of an endpoint.
+ *
+ * Reads use the ring's provided buffers. The kernel picks a buffer when data
+ * arrives and the bytes are copied from it into the buffer the library passed
+ * to async_read_at_least. A connection only holds on to a provided buffer
+ * while it has bytes left over that did not fit, so an idle connection owns
+ * no read buffer memory. Writes are a single vectored sendmsg.
+ */
+template <typename config>
+class connection : public lib::enable_shared_from_this<connection<config> > {
+public:
+    /// Type of this connection transport component
+    typedef connection<config> type;
+    /// Type of a shared pointer to this connection transport component
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of this transport's concurrency policy
+    typedef typename config::concurrency_type concurrency_type;
+    /// Type of this transport's access logging policy
+    typedef typename config::alog_type alog_type;
+    /// Type of this transport's error logging policy
+    typedef typename config::elog_type elog_type;
+
+    /// Type of the ring this connection runs on
+    typedef uring::ring<concurrency_type> ring_type;
+    /// Type of a pointer to the ring this connection runs on
+    typedef ring_type * ring_ptr;
+    /// Type of a pointer to a timer
+    typedef typename ring_type::timer_ptr timer_ptr;
+
+    // connection is friends with its associated endpoint to allow the endpoint
+    // to call private/protected utility methods that we don't want to expose
+    // to the public api.
+    friend class endpoint<config>;
+
+    explicit connection(bool is_server, alog_type & alog, elog_type & elog)
+      : m_ring(NULL)
+      , m_fd(-1)
+      , m_is_server(is_server)
+      , m_alog(alog)
+      , m_elog(elog)
+      , m_read_buf(NULL)
+      , m_read_len(0)
+      , m_read_min(0)
+      , m_read_done(0)
+      , m_held_bid(0)
+      , m_held_offset(0)
+      , m_held_len(0)
+      , m_write_index(0)
+    {
+        m_alog.write(log::alevel::devel,"uring con transport constructor");
+        std::memset(&m_msg, 0, sizeof(m_msg));
+    }
+
+    ~connection() {
+        // A connection can outlive its ring, in which case the held buffer
+        // went away with it.
+        if (m_held_len > 0 && !m_ring_ref.expired()) {
+            m_ring->release_buffer(m_held_bid);
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    /// Get a shared pointer to this component
+    ptr get_shared() {
+        return type::shared_from_this();
+    }
+
+    /// Tests whether or not the underlying transport is secure
+    /**
+     * The uring transport does not implement TLS.
+     *
+     * @return Whether or not the underlying transport is secure
+     */
+    bool is_secure() const {
+        return false;
+    }
+
+    /// Set uri hook
+    /**
+     * Called by the endpoint as a connection is being established to provide
+     * the uri being connected to to the transport layer.
+     *
+     * This transport policy doesn't use the uri so it is ignored.
+     *
+     * @param u The uri to set
+     */
+    void set_uri(uri_ptr) {}
+
+    /// Get the socket file descriptor
+    /**
+     * @return The connection's socket, or -1 before it is accepted or
+     * connected
+     */
+    int get_socket() const {
+        return m_fd;
+    }
+
+    /// Get the remote endpoint address
+    /**
+     * @return A string identifying the address of the remote endpoint, or a
+     * description of the error if it could not be retrieved
+     */
+    std::string get_remote_endpoint() const {
+        address remote;
+        remote.length = sizeof(remote.storage);
+
+        if (::getpeername(m_fd, reinterpret_cast<sockaddr *>(&remote.storage),
+            &remote.length) != 0)
+        {
+            std::stringstream s;
+            s << "Error getting remote endpoint: " << std::strerror(errno);
+            return s.str();
+        }
+        return format_address(reinterpret_cast<sockaddr *>(&remote.storage));
+    }
+
+    /// Get the connection handle
+    connection_hdl get_handle() const {
+        return m_connection_hdl;
+    }
+
+    /// Call back a function after a period of time.
+    /**
+     * Timers are not thread safe. They will be called from the thread running
+     * the endpoint's ring.
+     *
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call back when the timer has expired
+     * @return A handle that can be used to cancel the timer if it is no longer
+     * needed.
+     */
+    timer_ptr set_timer(long duration, timer_handler callback) {
+        if (!m_ring) {
+            return timer_ptr();
+        }
+        return m_ring->set_timer(duration, callback);
+    }
+
+    /// Get the index of the endpoint shard this connection belongs to
+    /**
+     * This transport uses a single shard.
+     *
+     * @since 0.8.0
+     */
+    size_t get_shard_index() const {
+        return 0;
+    }
+
+protected:
+    /// Initialize transport for reading
+    /**
+     * The socket is already accepted or connected by the endpoint, so there is
+     * nothing left to set up.
+     *
+     * @param callback The function to call when initialization is complete
+     */
+    void init(init_handler callback) {
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel, "uring connection init");
+        callback(lib::error_code());
+    }
+
+    /// Initiate an async_read for at least num_bytes bytes into buf
+    /**
+     * Initiates an async_read request for at least num_bytes bytes. The input
+     * will be read into buf. A maximum of len bytes will be input. When the
+     * operation is complete, handler will be called with the status and number
+     * of bytes read.
+     *
+     * Bytes left over in the connection's provided buffer from the previous
+     * read are used first.
+     *
+     * @param num_bytes The minimum number of bytes to read
+     * @param buf A pointer to a buffer to read into
+     * @param len The size of buf. At maximum, this many bytes will be read.
+     * @param handler The callback to invoke when the operation is complete or
+     * ends in an error
+     */
+    void async_read_at_least(size_t num_bytes, char * buf, size_t len,
+        read_handler handler)
+    {
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "uring async_read_at_least: " << num_bytes);
+
+        if (num_bytes > len) {
+            m_elog.write(log::elevel::devel,
+                "uring async_read_at_least error::invalid_num_bytes");
+            handler(make_error_code(transport::error::invalid_num_bytes),
+                size_t(0));
+            return;
+        }
+
+        m_read_buf = buf;
+        m_read_len = len;
+        m_read_min = num_bytes;
+        m_read_done = 0;
+        m_read_handler = handler;
+
+        if (m_held_len > 0) {
+            consume_held();
+            if (m_read_done >= m_read_min) {
+                m_ring->post(lib::bind(&type::complete_read, get_shared(),
+                    lib::error_code()));
+                return;
+            }
+        }
+
+        submit_recv();
+    }
+
+    /// Initiate a potentially asyncronous write of the given buffer
+    void async_write(char const * buf, size_t len, write_handler handler) {
+        m_iov.resize(1);
+        m_iov[0].iov_base = const_cast<char *>(buf);
+        m_iov[0].iov_len = len;
+
+        start_write(handler);
+    }
+
+    /// Initiate a potentially asyncronous write of the given buffers
+    void async_write(std::vector<buffer> const & bufs, write_handler handler) {
+        m_iov.resize(bufs.size());
+        for (size_t i = 0; i < bufs.size(); ++i) {
+            m_iov[i].iov_base = const_cast<char *>(bufs[i].buf);
+            m_iov[i].iov_len = bufs[i].len;
+        }
+
+        start_write(handler);
+    }
+
+    /// Set Connection Handle
+    /**
+     * @param hdl The new handle
+     */
+    void set_handle(connection_hdl hdl) {
+        m_connection_hdl = hdl;
+    }
+
+    /// Call given handler back within the transport's event system (if present)
+    /**
+     * The handler is run by the thread running the endpoint's ring.
+     *
+     * @param handler The callback to invoke
+     * @return Whether or not the transport was able to register the handler for
+     * callback.
+     */
+    lib::error_code dispatch(dispatch_handler handler) {
+        m_ring->post(handler);
+        return lib::error_code();
+    }
+
+    /// Trigger the on_interrupt handler
+    /**
+     * This needs to be thread safe
+     */
+    lib::error_code interrupt(interrupt_handler handler) {
+        m_ring->post(handler);
+        return lib::error_code();
+    }
+
+    /// Perform cleanup on socket shutdown_handler
+    /**
+     * Shuts the socket down in both directions, which also completes any
+     * outstanding recv. The descriptor is closed when the connection is
+     * destroyed.
+     *
+     * @param callback The function to call when cleanup is complete
+     */
+    void async_shutdown(shutdown_handler callback) {
+        _WEBSOCKETPP_LOG(m_alog, log::alevel::devel,
+            "uring connection async_shutdown");
+
+        lib::error_code ec;
+        if (m_fd >= 0 && ::shutdown(m_fd, SHUT_RDWR) != 0 && errno != ENOTCONN)
+        {
+            log_err(log::elevel::info,"uring socket shutdown",errno);
+            ec = make_error_code(transport::error::pass_through);
+        }
+        callback(ec);
+    }
+private:
+    /// Copy bytes left in the held provided buffer into the read buffer
+    void consume_held() {
+        size_t n = std::min(m_held_len, m_read_len - m_read_done);
+        std::memcpy(m_read_buf + m_read_done,
+            m_ring->get_buffer(m_held_bid) + m_held_offset, n);
+
+        m_read_done += n;
+        m_held_offset += n;
+        m_held_len -= n;
+
+        if (m_held_len == 0) {
+            m_ring->release_buffer(m_held_bid);
+        }
+    }
+
+    void submit_recv() {
+        io_uring_sqe sqe;
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_RECV;
+        sqe.fd = m_fd;
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = ring_type::buffer_group;
+
+        lib::error_code ec = m_ring->submit(sqe, lib::bind(
+            &type::handle_recv,
+            get_shared(),
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+        if (ec) {
+            m_ring->post(lib::bind(&type::complete_read, get_shared(), ec));
+        }
+    }
+
+    void handle_recv(int res, uint32_t flags) {
+        if (res == -ENOBUFS) {
+            // every provided buffer is in use, try again once one is free
+            m_ring->wait_for_buffer(lib::bind(&type::submit_recv,
+                get_shared()));
+            return;
+        }
+
+        if (res < 0) {
+            if (res == -ECANCELED) {
+                complete_read(make_error_code(
+                    transport::error::operation_aborted));
+            } else {
+                log_err(log::elevel::info,"uring recv",-res);
+                complete_read(make_error_code(transport::error::pass_through));
+            }
+            return;
+        }
+
+        if (res == 0) {
+            complete_read(make_error_code(transport::error::eof));
+            return;
+        }
+
+        m_held_bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        m_held_offset = 0;
+        m_held_len = static_cast<size_t>(res);
+        consume_held();
+
+        if (m_read_done >= m_read_min) {
+            complete_read(lib::error_code());
+        } else {
+            submit_recv();
+        }
+    }
+
+    void complete_read(lib::error_code const & ec) {
+        read_handler handler;
+        handler.swap(m_read_handler);
+
+        if (handler) {
+            handler(ec, m_read_done);
+        } else {
+            // This can happen in cases where the connection is terminated while
+            // the transport is waiting on a read.
+            m_alog.write(log::alevel::devel,
+                "uring complete_read called with null read handler");
+        }
+    }
+
+    void start_write(write_handler handler) {
+        m_write_handler = handler;
+        m_write_index = 0;
+
+        // Drop empty buffers. sendmsg with nothing to send completes with 0,
+        // which is indistinguishable from a stalled write.
+        size_t n = 0;
+        for (size_t i = 0; i < m_iov.size(); ++i) {
+            if (m_iov[i].iov_len > 0) {
+                m_iov[n++] = m_iov[i];
+            }
+        }
+        m_iov.resize(n);
+
+        if (m_iov.empty()) {
+            m_ring->post(lib::bind(&type::complete_write, get_shared(),
+                lib::error_code()));
+            return;
+        }
+
+        submit_write();
+    }
+
+    void submit_write() {
+        m_msg.msg_iov = &m_iov[m_write_index];
+        m_msg.msg_iovlen = std::min(m_iov.size() - m_write_index,
+            size_t(IOV_MAX));
+
+        io_uring_sqe sqe;
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_SENDMSG;
+        sqe.fd = m_fd;
+        sqe.addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&m_msg));
+        sqe.len = 1;
+        sqe.msg_flags = MSG_NOSIGNAL;
+
+        lib::error_code ec = m_ring->submit(sqe, lib::bind(
+            &type::handle_write,
+            get_shared(),
+            lib::placeholders::_1
+        ));
+        if (ec) {
+            m_ring->post(lib::bind(&type::complete_write, get_shared(), ec));
+        }
+    }
+
+    void handle_write(int res) {
+        if (res < 0) {
+            if (res == -ECANCELED) {
+                complete_write(make_error_code(
+                    transport::error::operation_aborted));
+            } else {
+                log_err(log::elevel::info,"uring sendmsg",-res);
+                complete_write(make_error_code(transport::error::pass_through));
+            }
+            return;
+        }
+
+        if (res == 0) {
+            // Only empty buffers are skipped, so a write that sent nothing
+            // would never make progress.
+            m_elog.write(log::elevel::info,"uring sendmsg sent no bytes");
+            complete_write(make_error_code(transport::error::pass_through));
+            return;
+        }
+
+        // Skip what was sent. A short write resumes from the first byte
+        // that was not.
+        size_t sent = static_cast<size_t>(res);
+        while (m_write_index < m_iov.size()) {
+            iovec & v = m_iov[m_write_index];
+            if (sent < v.iov_len) {
+                v.iov_base = static_cast<char *>(v.iov_base) + sent;
+                v.iov_len -= sent;
+                break;
+            }
+            sent -= v.iov_len;
+            ++m_write_index;
+        }
+
+        if (m_write_index < m_iov.size()) {
+            submit_write();
+        } else {
+            complete_write(lib::error_code());
+        }
+    }
+
+    void complete_write(lib::error_code const & ec) {
+        write_handler handler;
+        handler.swap(m_write_handler);
+
+        if (handler) {
+            handler(ec);
+        } else {
+            m_alog.write(log::alevel::devel,
+                "uring complete_write called with null write handler");
+        }
+    }
+
+    /// Convenience method for logging the code and message for an errno value
+    void log_err(log::level l, char const * msg, int value) {
+        std::stringstream s;
+        s << msg << " error: " << value << " (" << std::strerror(value) << ")";
+        m_elog.write(l,s.str());
+    }
+
+    ring_ptr        m_ring;
+    lib::weak_ptr<ring_type> m_ring_ref;
+    int             m_fd;
+    bool const      m_is_server;
+    alog_type &     m_alog;
+    elog_type &     m_elog;
+
+    connection_hdl  m_connection_hdl;
+
+    // Read state
+    char *          m_read_buf;
+    size_t          m_read_len;
+    size_t          m_read_min;
+    size_t          m_read_done;
+    read_handler    m_read_handler;
+
+    // Provided buffer holding bytes received but not yet read
+    uint16_t        m_held_bid;
+    size_t          m_held_offset;
+    size_t          m_held_len;
+
+    // Write state
+    std::vector<iovec> m_iov;
+    size_t          m_write_index;
+    msghdr          m_msg;
+    write_handler   m_write_handler;
+
+    // Client connect state
+    std::vector<address> m_addresses;
+    timer_ptr       m_connect_timer;
+};
+
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_CON_HPP
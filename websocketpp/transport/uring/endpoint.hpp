@@ -0,0 +1,1005 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_HPP
+
+#include <websocketpp/transport/base/endpoint.hpp>
+#include <websocketpp/transport/uring/base.hpp>
+#include <websocketpp/transport/uring/connection.hpp>
+#include <websocketpp/transport/uring/ring.hpp>
+
+#include <websocketpp/error.hpp>
+#include <websocketpp/uri.hpp>
+#include <websocketpp/logger/format.hpp>
+#include <websocketpp/logger/levels.hpp>
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <string>
+
+namespace websocketpp {
+namespace transport {
+namespace uring {
+
+/// Endpoint transport component that uses io_uring
+/**
+ * transport::uring::endpoint implements an endpoint transport component on
+ * Linux io_uring. All connections of the endpoint share one ring, which the
+ * endpoint creates in `init_uring` and which is run by the thread that calls
+ * `run`.
+ *
+ * Listening sockets use a multishot accept, so one submission keeps accepting
+ * connections until `stop_listening`. Reads draw from a ring of provided
+ * buffers shared by all connections. Operations issued while handling
+ * completions are handed to the kernel together in the next loop iteration.
+ *
+ * TLS and proxies are not supported. Host names are resolved synchronously
+ * with getaddrinfo.
+ *
+ * @since 0.8.0
+ */
+template <typename config>
+class endpoint {
+public:
+    /// Type of this endpoint transport component
+    typedef endpoint<config> type;
+    /// Type of a pointer to this endpoint transport component
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of this endpoint's concurrency policy
+    typedef typename config::concurrency_type concurrency_type;
+    /// Type of this endpoint's error logging policy
+    typedef typename config::elog_type elog_type;
+    /// Type of this endpoint's access logging policy
+    typedef typename config::alog_type alog_type;
+
+    /// Type of the mutex used to protect the accept queues
+    typedef typename concurrency_type::mutex_type mutex_type;
+    /// Type of the lock used to protect the accept queues
+    typedef typename concurrency_type::scoped_lock_type scoped_lock_type;
+
+    /// Type of the connection transport component associated with this
+    /// endpoint transport component
+    typedef uring::connection<config> transport_con_type;
+    /// Type of a shared pointer to the connection transport component
+    /// associated with this endpoint transport component
+    typedef typename transport_con_type::ptr transport_con_ptr;
+
+    /// Type of the ring this endpoint runs on
+    typedef uring::ring<concurrency_type> ring_type;
+    /// Type of a pointer to the ring this endpoint runs on
+    typedef ring_type * ring_ptr;
+    /// Type of a pointer to a timer
+    typedef typename ring_type::timer_ptr timer_ptr;
+
+    explicit endpoint()
+      : m_ring(NULL)
+      , m_external_ring(false)
+      , m_listen_fd(-1)
+      , m_listen_backlog(SOMAXCONN)
+      , m_reuse_addr(false)
+      , m_ring_entries(256)
+      , m_buffer_count(256)
+      , m_buffer_size(16384)
+      , m_state(UNINITIALIZED) {}
+
+    ~endpoint() {
+        m_perpetual.reset();
+
+        // Accepted sockets not yet claimed by a connection
+        while (!m_accepted.empty()) {
+            ::close(m_accepted.front());
+            m_accepted.pop_front();
+        }
+        m_acceptors.clear();
+
+        if (m_listen_fd >= 0) {
+            // The pending multishot accept holds a reference to the socket
+            // until the ring is torn down. Shutting it down releases the port
+            // right away.
+            ::shutdown(m_listen_fd, SHUT_RDWR);
+            ::close(m_listen_fd);
+        }
+
+        // Explicitly destroy local objects
+        if (m_state != UNINITIALIZED && !m_external_ring) {
+            delete m_ring;
+        }
+    }
+
+    /// transport::uring objects are not copyable or assignable.
+    /// The following code sets this situation up based on whether or not we
+    /// have C++11 support or not
+#ifdef _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
+    endpoint(const endpoint & src) = delete;
+    endpoint& operator= (const endpoint & rhs) = delete;
+#else
+private:
+    endpoint(const endpoint & src);
+    endpoint & operator= (const endpoint & rhs);
+public:
+#endif // _WEBSOCKETPP_DEFAULT_DELETE_FUNCTIONS_
+
+    /// Return whether or not the endpoint produces secure connections.
+    bool is_secure() const {
+        return false;
+    }
+
+    /// Initialize the uring transport with an external ring (exception free)
+    /**
+     * Several endpoints may share one ring, for example a client and a server
+     * in the same process. The ring must outlive the endpoint.
+     *
+     * @param ptr A pointer to an initialized ring
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void init_uring(ring_ptr ptr, lib::error_code & ec) {
+        if (m_state != UNINITIALIZED) {
+            m_elog->write(log::elevel::library,
+                "uring::init_uring called from the wrong state");
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return;
+        }
+
+        m_alog->write(log::alevel::devel,"uring::init_uring");
+
+        m_ring = ptr;
+        m_external_ring = true;
+        m_state = READY;
+        ec = lib::error_code();
+    }
+
+    /// Initialize the uring transport with an external ring
+    /**
+     * @param ptr A pointer to an initialized ring
+     */
+    void init_uring(ring_ptr ptr) {
+        lib::error_code ec;
+        init_uring(ptr,ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Initialize the uring transport with an internal ring (exception free)
+    /**
+     * Creates an io_uring instance sized by `set_ring_entries` and
+     * `set_read_buffers`.
+     *
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void init_uring(lib::error_code & ec) {
+        if (m_state != UNINITIALIZED) {
+            m_elog->write(log::elevel::library,
+                "uring::init_uring called from the wrong state");
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return;
+        }
+
+        ring_ptr r = new ring_type();
+        ec = r->init(m_ring_entries, m_buffer_count, m_buffer_size);
+        if (ec) {
+            log_err(log::elevel::fatal,"uring::init_uring",ec);
+            delete r;
+            return;
+        }
+
+        init_uring(r, ec);
+        if (ec) {
+            delete r;
+            return;
+        }
+        m_external_ring = false;
+    }
+
+    /// Initialize the uring transport with an internal ring
+    void init_uring() {
+        lib::error_code ec;
+        init_uring(ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Set the size of the ring's submission queue
+    /**
+     * Must be called before `init_uring`. The default is 256 entries.
+     *
+     * @param entries The number of submission queue entries
+     */
+    void set_ring_entries(unsigned entries) {
+        m_ring_entries = entries;
+    }
+
+    /// Set the number and size of the provided read buffers
+    /**
+     * Must be called before `init_uring`. A connection only holds a provided
+     * buffer while it has received bytes the library has not read yet, so the
+     * count bounds the number of connections with unread data rather than the
+     * number of connections. Connections wait for a free buffer when they run
+     * out. The default is 256 buffers of 16KiB.
+     *
+     * @param count The number of buffers. Rounded up to a power of two, at
+     * most 32768.
+     * @param size The size of each buffer in bytes
+     */
+    void set_read_buffers(unsigned count, size_t size) {
+        m_buffer_count = count;
+        m_buffer_size = size;
+    }
+
+    /// Get a pointer to the ring in use
+    /**
+     * @return A pointer to the ring, or NULL before `init_uring`
+     */
+    ring_ptr get_ring() {
+        return m_ring;
+    }
+
+    /// Sets whether to use the SO_REUSEADDR flag when opening listening sockets
+    /**
+     * Specifies whether or not to use the SO_REUSEADDR TCP socket option. What
+     * this flag does depends on your operating system. Please consult operating
+     * system documentation for more details.
+     *
+     * New values affect future calls to listen only.
+     *
+     * The default is false.
+     *
+     * @param value Whether or not to use the SO_REUSEADDR option
+     */
+    void set_reuse_addr(bool value) {
+        m_reuse_addr = value;
+    }
+
+    /// Sets the maximum length of the queue of pending connections.
+    /**
+     * New values affect future calls to listen only.
+     *
+     * The default value is SOMAXCONN, the operating system defined maximum
+     * queue length. Your OS may restrict or silently lower this value. A value
+     * of zero may cause all connections to be rejected.
+     *
+     * @param backlog The maximum length of the queue of pending connections
+     */
+    void set_listen_backlog(int backlog) {
+        m_listen_backlog = backlog;
+    }
+
+    /// Set up endpoint for listening on a socket address (exception free)
+    /**
+     * Bind the internal acceptor using the specified settings and start a
+     * multishot accept on it. The endpoint must have been initialized by
+     * calling init_uring before listening.
+     *
+     * @param addr The address to listen on
+     * @param length The length of addr
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void listen(sockaddr const * addr, socklen_t length, lib::error_code & ec)
+    {
+        if (m_state != READY) {
+            m_elog->write(log::elevel::library,
+                "uring::listen called from the wrong state");
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return;
+        }
+
+        m_alog->write(log::alevel::devel,"uring::listen");
+
+        int fd = ::socket(addr->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            log_err(log::elevel::info,"uring listen socket",errno);
+            ec = make_error_code(error::pass_through);
+            return;
+        }
+
+        int on = 1;
+        int off = 0;
+        if (m_reuse_addr) {
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        }
+        if (addr->sa_family == AF_INET6) {
+            // accept IPv4 connections as well, as the asio transport does
+            ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        }
+
+        if (::bind(fd, addr, length) != 0) {
+            log_err(log::elevel::info,"uring listen bind",errno);
+            ::close(fd);
+            ec = make_error_code(error::pass_through);
+            return;
+        }
+        if (::listen(fd, m_listen_backlog) != 0) {
+            log_err(log::elevel::info,"uring listen",errno);
+            ::close(fd);
+            ec = make_error_code(error::pass_through);
+            return;
+        }
+
+        {
+            scoped_lock_type guard(m_accept_lock);
+            m_listen_fd = fd;
+            m_state = LISTENING;
+        }
+
+        ec = submit_accept(fd);
+        if (ec) {
+            scoped_lock_type guard(m_accept_lock);
+            ::close(m_listen_fd);
+            m_listen_fd = -1;
+            m_state = READY;
+        }
+    }
+
+    /// Set up endpoint for listening on a socket address
+    /**
+     * @param addr The address to listen on
+     * @param length The length of addr
+     */
+    void listen(sockaddr const * addr, socklen_t length) {
+        lib::error_code ec;
+        listen(addr,length,ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Set up endpoint for listening on a port (exception free)
+    /**
+     * Listens on all IPv6 and IPv4 interfaces. Falls back to IPv4 only on
+     * systems without IPv6.
+     *
+     * @param port The port to listen on.
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void listen(uint16_t port, lib::error_code & ec) {
+        sockaddr_in6 addr6;
+        std::memset(&addr6, 0, sizeof(addr6));
+        addr6.sin6_family = AF_INET6;
+        addr6.sin6_addr = in6addr_any;
+        addr6.sin6_port = htons(port);
+
+        int probe = ::socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (probe >= 0) {
+            ::close(probe);
+            listen(reinterpret_cast<sockaddr *>(&addr6), sizeof(addr6), ec);
+            return;
+        }
+
+        sockaddr_in addr4;
+        std::memset(&addr4, 0, sizeof(addr4));
+        addr4.sin_family = AF_INET;
+        addr4.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr4.sin_port = htons(port);
+        listen(reinterpret_cast<sockaddr *>(&addr4), sizeof(addr4), ec);
+    }
+
+    /// Set up endpoint for listening on a port
+    /**
+     * @param port The port to listen on.
+     */
+    void listen(uint16_t port) {
+        lib::error_code ec;
+        listen(port,ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Set up endpoint for listening on a host and service (exception free)
+    /**
+     * The first address getaddrinfo returns for the host and service is used.
+     *
+     * @param host A string identifying a location. May be a descriptive name
+     * or a numeric address string.
+     * @param service A string identifying the requested service. This may be
+     * a descriptive name or a numeric string corresponding to a port number.
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void listen(std::string const & host, std::string const & service,
+        lib::error_code & ec)
+    {
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+
+        addrinfo * result = NULL;
+        int rv = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &result);
+        if (rv != 0 || !result) {
+            m_elog->write(log::elevel::info,
+                std::string("uring listen getaddrinfo error: ")+
+                ::gai_strerror(rv));
+            ec = make_error_code(error::invalid_host_service);
+            return;
+        }
+
+        listen(result->ai_addr, result->ai_addrlen, ec);
+        ::freeaddrinfo(result);
+    }
+
+    /// Set up endpoint for listening on a host and service
+    /**
+     * @param host A string identifying a location.
+     * @param service A string identifying the requested service.
+     */
+    void listen(std::string const & host, std::string const & service) {
+        lib::error_code ec;
+        listen(host,service,ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Get the port the endpoint is listening on (exception free)
+    /**
+     * Useful after listening on port 0 to find the port the kernel chose.
+     *
+     * @param ec Set to indicate what error occurred, if any.
+     * @return The local port, or 0 on error
+     */
+    uint16_t get_local_port(lib::error_code & ec) const {
+        address local;
+        local.length = sizeof(local.storage);
+
+        if (m_listen_fd < 0 || ::getsockname(m_listen_fd,
+            reinterpret_cast<sockaddr *>(&local.storage), &local.length) != 0)
+        {
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return 0;
+        }
+
+        ec = lib::error_code();
+        if (local.storage.ss_family == AF_INET6) {
+            return ntohs(reinterpret_cast<sockaddr_in6 *>(
+                &local.storage)->sin6_port);
+        }
+        return ntohs(reinterpret_cast<sockaddr_in *>(&local.storage)->sin_port);
+    }
+
+    /// Stop listening (exception free)
+    /**
+     * Stop listening and accepting new connections. This will not end any
+     * existing connections. Pending accepts are called back with
+     * websocketpp::error::operation_canceled.
+     *
+     * @param ec A status code indicating an error, if any.
+     */
+    void stop_listening(lib::error_code & ec) {
+        std::deque<pending_accept> acceptors;
+        int fd;
+        {
+            scoped_lock_type guard(m_accept_lock);
+            if (m_state != LISTENING) {
+                m_elog->write(log::elevel::library,
+                    "uring::stop_listening called from the wrong state");
+                using websocketpp::error::make_error_code;
+                ec = make_error_code(websocketpp::error::invalid_state);
+                return;
+            }
+
+            m_state = READY;
+            fd = m_listen_fd;
+            m_listen_fd = -1;
+            acceptors.swap(m_acceptors);
+            while (!m_accepted.empty()) {
+                ::close(m_accepted.front());
+                m_accepted.pop_front();
+            }
+        }
+
+        m_alog->write(log::alevel::devel,"uring::stop_listening");
+
+        // Release the port now. The descriptor is closed once the multishot
+        // accept on it is cancelled.
+        ::shutdown(fd, SHUT_RDWR);
+        ec = m_ring->cancel_fd(fd, lib::bind(&type::close_fd, fd,
+            lib::placeholders::_1, lib::placeholders::_2));
+        if (ec) {
+            ::close(fd);
+            ec = lib::error_code();
+        }
+
+        for (size_t i = 0; i < acceptors.size(); ++i) {
+            m_ring->post(lib::bind(acceptors[i].callback,
+                websocketpp::error::make_error_code(
+                    websocketpp::error::operation_canceled)));
+        }
+    }
+
+    /// Stop listening
+    void stop_listening() {
+        lib::error_code ec;
+        stop_listening(ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Check if the endpoint is listening
+    /**
+     * @return Whether or not the endpoint is listening.
+     */
+    bool is_listening() const {
+        return (m_state == LISTENING);
+    }
+
+    /// Get the number of acceptors this endpoint listens with
+    size_t get_acceptor_count() const {
+        return 1;
+    }
+
+    /// Run a function on the thread that owns an acceptor
+    /**
+     * @param index The acceptor index, ignored as there is only one
+     * @param handler The function to run
+     */
+    void post_to_acceptor(size_t, lib::function<void()> handler) {
+        m_ring->post(handler);
+    }
+
+    /// Run the ring's event loop
+    /**
+     * Returns when the ring has no more work or `stop` is called. Only one
+     * thread may run the ring.
+     *
+     * @return The number of handlers that were run
+     */
+    std::size_t run() {
+        return m_ring->run();
+    }
+
+    /// Run the handlers that are ready without blocking
+    /**
+     * @return The number of handlers that were run
+     */
+    std::size_t poll() {
+        return m_ring->poll();
+    }
+
+    /// Stop the ring's event loop
+    void stop() {
+        m_ring->stop();
+    }
+
+    /// Check if the ring's event loop is stopped
+    bool stopped() const {
+        return m_ring->stopped();
+    }
+
+    /// Reset the ring's event loop so that it can run again after `stop`
+    void reset() {
+        m_ring->reset();
+    }
+
+    /// Marks the endpoint as perpetual, stopping it from exiting when empty
+    /**
+     * Marks the endpoint as perpetual. Perpetual endpoints will not
+     * automatically exit when they run out of connections to process. To stop
+     * a perpetual endpoint call `stop_perpetual`.
+     */
+    void start_perpetual() {
+        if (!m_perpetual) {
+            m_perpetual = lib::make_shared<perpetual_work>(m_ring);
+        }
+    }
+
+    /// Clears the endpoint's perpetual flag, allowing it to exit when empty
+    void stop_perpetual() {
+        m_perpetual.reset();
+    }
+
+    /// Call back a function after a period of time.
+    /**
+     * The handler is called from the thread running the ring.
+     *
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call back when the timer has expired
+     * @return A handle that can be used to cancel the timer if it is no longer
+     * needed.
+     */
+    timer_ptr set_timer(long duration, timer_handler callback) {
+        return m_ring->set_timer(duration, callback);
+    }
+
+    /// Accept the next connection attempt and assign it to con (exception free)
+    /**
+     * @param tcon The connection to accept into.
+     * @param callback The function to call when the operation is complete.
+     * @param ec A status code indicating an error, if any.
+     */
+    void async_accept(transport_con_ptr tcon, accept_handler callback,
+        lib::error_code & ec)
+    {
+        _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel, "uring::async_accept");
+
+        int fd = -1;
+        {
+            scoped_lock_type guard(m_accept_lock);
+            if (m_state != LISTENING) {
+                using websocketpp::error::make_error_code;
+                ec = make_error_code(websocketpp::error::async_accept_not_listening);
+                return;
+            }
+
+            if (m_accepted.empty()) {
+                m_acceptors.push_back(pending_accept(tcon, callback));
+            } else {
+                fd = m_accepted.front();
+                m_accepted.pop_front();
+            }
+        }
+
+        if (fd >= 0) {
+            tcon->m_fd = fd;
+            m_ring->post(lib::bind(callback, lib::error_code()));
+        }
+        ec = lib::error_code();
+    }
+
+    /// Accept the next connection attempt and assign it to con.
+    /**
+     * @param tcon The connection to accept into.
+     * @param callback The function to call when the operation is complete.
+     */
+    void async_accept(transport_con_ptr tcon, accept_handler callback) {
+        lib::error_code ec;
+        async_accept(tcon,callback,ec);
+        if (ec) { throw exception(ec); }
+    }
+
+    /// Get the number of shards of the endpoint
+    /**
+     * All connections of the endpoint run on its ring, which is one shard.
+     *
+     * @since 0.8.0
+     */
+    size_t get_shard_count() const {
+        return 1;
+    }
+
+    /// Run a handler on the thread that owns a shard
+    /**
+     * The handler is posted to the endpoint's ring.
+     *
+     * @since 0.8.0
+     */
+    void post_to_shard(size_t, transport::dispatch_handler handler) {
+        m_ring->post(handler);
+    }
+
+protected:
+    /// Initialize logging
+    /**
+     * The loggers are located in the main endpoint class. As such, the
+     * transport doesn't have direct access to them. This method is called
+     * by the endpoint constructor to allow shared logging from the transport
+     * component. These are raw pointers to member variables of the endpoint.
+     * In particular, they cannot be used in the transport constructor as they
+     * haven't been constructed yet, and cannot be used in the transport
+     * destructor as they will have been destroyed by then.
+     */
+    void init_logging(alog_type * a, elog_type * e) {
+        m_alog = a;
+        m_elog = e;
+    }
+
+    /// Initiate a new connection
+    /**
+     * Resolves the host with getaddrinfo and tries each address in turn until
+     * one connects or `timeout_connect` expires.
+     *
+     * @param tcon A pointer to the transport connection component of the
+     * connection to connect.
+     * @param u A URI pointer to the URI to connect to.
+     * @param cb The function to call back with the results when complete.
+     */
+    void async_connect(transport_con_ptr tcon, uri_ptr u, connect_handler cb) {
+        _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel, "starting uring connect");
+
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo * result = NULL;
+        int rv = ::getaddrinfo(u->get_host().c_str(), u->get_port_str().c_str(),
+            &hints, &result);
+        if (rv != 0 || !result) {
+            m_elog->write(log::elevel::info,
+                std::string("uring connect getaddrinfo error: ")+
+                ::gai_strerror(rv));
+            m_ring->post(lib::bind(cb,
+                make_error_code(error::invalid_host_service)));
+            return;
+        }
+
+        tcon->m_addresses.clear();
+        for (addrinfo * ai = result; ai; ai = ai->ai_next) {
+            address a;
+            std::memcpy(&a.storage, ai->ai_addr, ai->ai_addrlen);
+            a.length = ai->ai_addrlen;
+            tcon->m_addresses.push_back(a);
+        }
+        ::freeaddrinfo(result);
+
+        tcon->m_connect_timer = m_ring->set_timer(
+            config::timeout_connect,
+            lib::bind(
+                &type::handle_connect_timeout,
+                this,
+                tcon,
+                lib::placeholders::_1
+            )
+        );
+
+        start_connect(tcon, cb, 0);
+    }
+
+    /// Initialize a connection
+    /**
+     * init is called by an endpoint once for each newly created connection.
+     * It's purpose is to give the transport policy the chance to perform any
+     * transport specific initialization that couldn't be done via the default
+     * constructor.
+     *
+     * @param tcon A pointer to the transport portion of the connection.
+     *
+     * @return A status code indicating the success or failure of the operation
+     */
+    lib::error_code init(transport_con_ptr tcon) {
+        m_alog->write(log::alevel::devel, "transport::uring::init");
+
+        if (!m_ring) {
+            using websocketpp::error::make_error_code;
+            return make_error_code(websocketpp::error::invalid_state);
+        }
+
+        tcon->m_ring = m_ring;
+        tcon->m_ring_ref = m_ring->get_weak_ptr();
+        return lib::error_code();
+    }
+private:
+    /// An async_accept waiting for a connection attempt
+    struct pending_accept {
+        pending_accept() {}
+        pending_accept(transport_con_ptr t, accept_handler c)
+          : tcon(t), callback(c) {}
+
+        transport_con_ptr tcon;
+        accept_handler callback;
+    };
+
+    /// Keeps the ring running while it exists
+    class perpetual_work {
+    public:
+        explicit perpetual_work(ring_ptr r) : m_ring(r) {
+            m_ring->add_work();
+        }
+        ~perpetual_work() {
+            m_ring->remove_work();
+        }
+    private:
+        ring_ptr m_ring;
+    };
+
+    static void close_fd(int fd, int, uint32_t) {
+        ::close(fd);
+    }
+
+    lib::error_code submit_accept(int fd) {
+        io_uring_sqe sqe;
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_ACCEPT;
+        sqe.fd = fd;
+        sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe.accept_flags = SOCK_CLOEXEC;
+
+        return m_ring->submit(sqe, lib::bind(
+            &type::handle_accept,
+            this,
+            fd,
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+    }
+
+    void handle_accept(int listen_fd, int res, uint32_t flags) {
+        bool more = (flags & IORING_CQE_F_MORE) != 0;
+
+        if (res < 0 && res != -ECANCELED) {
+            log_err(log::elevel::info,"uring accept",-res);
+        }
+
+        pending_accept acceptor;
+        {
+            scoped_lock_type guard(m_accept_lock);
+            bool listening = (m_state == LISTENING &&
+                m_listen_fd == listen_fd);
+
+            if (res >= 0) {
+                if (!listening) {
+                    ::close(res);
+                } else if (m_acceptors.empty()) {
+                    m_accepted.push_back(res);
+                } else {
+                    acceptor = m_acceptors.front();
+                    m_acceptors.pop_front();
+                }
+            }
+
+            if (!more && listening && res != -ECANCELED) {
+                // The kernel ended the multishot accept, start another one
+                submit_accept(listen_fd);
+            }
+        }
+
+        if (acceptor.tcon) {
+            acceptor.tcon->m_fd = res;
+            acceptor.callback(lib::error_code());
+        }
+    }
+
+    void start_connect(transport_con_ptr tcon, connect_handler cb,
+        size_t index)
+    {
+        address & a = tcon->m_addresses[index];
+
+        if (tcon->m_fd >= 0) {
+            ::close(tcon->m_fd);
+        }
+        tcon->m_fd = ::socket(a.storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC,
+            0);
+        if (tcon->m_fd < 0) {
+            log_err(log::elevel::info,"uring connect socket",errno);
+            finish_connect(tcon, cb, make_error_code(error::pass_through));
+            return;
+        }
+
+        io_uring_sqe sqe;
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_CONNECT;
+        sqe.fd = tcon->m_fd;
+        sqe.addr = static_cast<uint64_t>(
+            reinterpret_cast<uintptr_t>(&a.storage));
+        sqe.off = a.length;
+
+        lib::error_code ec = m_ring->submit(sqe, lib::bind(
+            &type::handle_connect,
+            this,
+            tcon,
+            cb,
+            index,
+            lib::placeholders::_1
+        ));
+        if (ec) {
+            finish_connect(tcon, cb, ec);
+        }
+    }
+
+    void handle_connect_timeout(transport_con_ptr tcon,
+        lib::error_code const & ec)
+    {
+        if (ec == transport::error::operation_aborted) {
+            return;
+        }
+
+        m_alog->write(log::alevel::devel,"uring connect timed out");
+        if (tcon->m_fd >= 0) {
+            m_ring->cancel_fd(tcon->m_fd, completion_handler());
+        }
+    }
+
+    void handle_connect(transport_con_ptr tcon, connect_handler cb,
+        size_t index, int res)
+    {
+        if (tcon->m_connect_timer->expired()) {
+            finish_connect(tcon, cb,
+                make_error_code(transport::error::timeout));
+            return;
+        }
+
+        if (res < 0) {
+            log_err(log::elevel::info,"uring connect",-res);
+            if (index + 1 < tcon->m_addresses.size()) {
+                start_connect(tcon, cb, index + 1);
+            } else {
+                finish_connect(tcon, cb, make_error_code(error::pass_through));
+            }
+            return;
+        }
+
+        _WEBSOCKETPP_LOG(*m_alog, log::alevel::devel,
+            "Async connect to " << tcon->get_remote_endpoint()
+            << " successful.");
+        finish_connect(tcon, cb, lib::error_code());
+    }
+
+    void finish_connect(transport_con_ptr tcon, connect_handler cb,
+        lib::error_code const & ec)
+    {
+        tcon->m_connect_timer->cancel();
+        tcon->m_connect_timer.reset();
+        tcon->m_addresses.clear();
+        m_ring->post(lib::bind(cb, ec));
+    }
+
+    template <typename error_type>
+    void log_err(log::level l, char const * msg, error_type const & ec) {
+        std::stringstream s;
+        s << msg << " error: " << ec << " (" << ec.message() << ")";
+        m_elog->write(l,s.str());
+    }
+
+    /// Convenience method for logging the code and message for an errno value
+    void log_err(log::level l, char const * msg, int value) {
+        std::stringstream s;
+        s << msg << " error: " << value << " (" << std::strerror(value) << ")";
+        m_elog->write(l,s.str());
+    }
+
+    enum state {
+        UNINITIALIZED = 0,
+        READY = 1,
+        LISTENING = 2
+    };
+
+    // Network Resources
+    ring_ptr            m_ring;
+    bool                m_external_ring;
+    int                 m_listen_fd;
+    lib::shared_ptr<perpetual_work> m_perpetual;
+
+    // Network constants
+    int                 m_listen_backlog;
+    bool                m_reuse_addr;
+    unsigned            m_ring_entries;
+    unsigned            m_buffer_count;
+    size_t              m_buffer_size;
+
+    // Accept queues
+    mutex_type          m_accept_lock;
+    std::deque<pending_accept> m_acceptors;
+    std::deque<int>     m_accepted;
+
+    elog_type *         m_elog;
+    alog_type *         m_alog;
+
+    // Transport state
+    state               m_state;
+};
+
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_HPP
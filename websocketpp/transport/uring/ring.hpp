@@ -0,0 +1,961 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_RING_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_RING_HPP
+
+#include <websocketpp/transport/uring/base.hpp>
+#include <websocketpp/transport/base/connection.hpp>
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/system_error.hpp>
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace uring {
+
+/// Thin wrappers around the io_uring system calls
+namespace detail {
+
+inline int io_uring_setup(unsigned entries, io_uring_params * p) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+inline int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags, void const * arg, size_t size)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+        min_complete, flags, arg, size));
+}
+
+inline int io_uring_register(int fd, unsigned opcode, void const * arg,
+    unsigned nr_args)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode,
+        arg, nr_args));
+}
+
+/// Read the monotonic clock in nanoseconds
+inline int64_t now() {
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/// Build an error code from an errno value
+inline lib::error_code system_error_code(int value) {
+    return lib::error_code(value, lib::system_category());
+}
+
+} // namespace detail
+
+template <typename concurrency>
+class ring;
+
+/// A timer scheduled on a ring
+/**
+ * Returned by ring::set_timer. The handler is called once, from the thread
+ * running the ring, either with no error when the timer fires or with
+ * transport::error::operation_aborted when it is cancelled first.
+ */
+template <typename concurrency>
+class timer {
+public:
+    /// Type of the ring that owns this timer
+    typedef ring<concurrency> ring_type;
+
+    timer(ring_type * owner, timer_handler handler)
+      : m_ring(owner)
+      , m_handler(handler)
+      , m_pending(false)
+      , m_expired(false) {}
+
+    /// Cancel the timer
+    /**
+     * Has no effect if the timer already fired or was cancelled.
+     */
+    void cancel() {
+        m_ring->cancel_timer(*this);
+    }
+
+    /// Check whether the timer fired
+    /**
+     * @return Whether the timer reached its deadline without being cancelled
+     */
+    bool expired() const {
+        return m_ring->timer_expired(*this);
+    }
+private:
+    friend class ring<concurrency>;
+
+    typedef std::multimap<int64_t, lib::shared_ptr<timer> > queue_type;
+
+    ring_type *                     m_ring;
+    timer_handler                   m_handler;
+    typename queue_type::iterator   m_position;
+    bool                            m_pending;
+    bool                            m_expired;
+};
+
+/// An io_uring instance and the event loop that runs it
+/**
+ * A ring owns an io_uring submission and completion queue, an eventfd used to
+ * wake the loop, a provided buffer ring for reads and a queue of timers.
+ *
+ * Operations are queued into the submission queue by `submit` and are handed
+ * to the kernel in one `io_uring_enter` call per loop iteration, together with
+ * the wait for the next completion, so a burst of reads and writes issued by
+ * handlers costs one system call.
+ *
+ * The ring is driven by `run` or `poll`, which must only be called from one
+ * thread at a time. The other methods may be called from any thread when the
+ * concurrency policy provides real locks. A thread that submits work while
+ * the loop is waiting in the kernel wakes it through the eventfd.
+ *
+ * Requires Linux 5.19 or later.
+ *
+ * @since 0.8.0
+ */
+template <typename concurrency>
+class ring {
+public:
+    /// Type of this ring
+    typedef ring<concurrency> type;
+
+    /// Type of the mutex used to protect the ring
+    typedef typename concurrency::mutex_type mutex_type;
+    /// Type of the lock used to protect the ring
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+
+    /// Type of the timers scheduled on this ring
+    typedef uring::timer<concurrency> timer_type;
+    /// Type of a shared pointer to a timer
+    typedef lib::shared_ptr<timer_type> timer_ptr;
+
+    /// The buffer group id of the provided read buffers
+    static uint16_t const buffer_group = 0;
+
+    ring()
+      : m_fd(-1)
+      , m_wake_fd(-1)
+      , m_sq_ring(NULL)
+      , m_sq_ring_size(0)
+      , m_cq_ring(NULL)
+      , m_cq_ring_size(0)
+      , m_sqes(NULL)
+      , m_sqes_size(0)
+      , m_sq_khead(NULL)
+      , m_sq_ktail(NULL)
+      , m_sq_mask(0)
+      , m_sq_entries(0)
+      , m_sq_tail(0)
+      , m_cq_khead(NULL)
+      , m_cq_ktail(NULL)
+      , m_cq_mask(0)
+      , m_cqes(NULL)
+      , m_buf_ring(NULL)
+      , m_buf_ring_size(0)
+      , m_buf_count(0)
+      , m_buf_size(0)
+      , m_buf_tail(0)
+      , m_outstanding(0)
+      , m_work(0)
+      , m_wake_value(0)
+      , m_waiting(false)
+      , m_woken(false)
+      , m_stopped(false)
+      , m_self(this, null_deleter())
+    {
+        m_operations.prev = &m_operations;
+        m_operations.next = &m_operations;
+    }
+
+    ~ring() {
+        // Releasing the handlers of pending operations, posted handlers and
+        // timers may destroy connections, which return their read buffers
+        // to this ring. Release them while the ring is still intact.
+        typename timer_type::queue_type timers;
+        std::vector<post_handler> posted;
+        std::deque<post_handler> waiters;
+        std::vector<operation *> operations;
+        {
+            scoped_lock_type guard(m_lock);
+            timers.swap(m_timers);
+            posted.swap(m_posted);
+            waiters.swap(m_buffer_waiters);
+
+            while (m_operations.next != &m_operations) {
+                operation * op = m_operations.next;
+                unlink(op);
+                operations.push_back(op);
+            }
+            m_outstanding = 0;
+
+            for (typename timer_type::queue_type::iterator it = timers.begin();
+                 it != timers.end(); ++it)
+            {
+                it->second->m_pending = false;
+            }
+        }
+
+        for (typename timer_type::queue_type::iterator it = timers.begin();
+             it != timers.end(); ++it)
+        {
+            it->second->m_handler = timer_handler();
+        }
+        timers.clear();
+        posted.clear();
+        waiters.clear();
+
+        for (size_t i = 0; i < operations.size(); ++i) {
+            delete operations[i];
+        }
+        for (size_t i = 0; i < m_free_operations.size(); ++i) {
+            delete m_free_operations[i];
+        }
+
+        destroy();
+    }
+
+    /// Create the io_uring instance
+    /**
+     * @param entries The number of submission queue entries. The completion
+     * queue is twice as large.
+     * @param buffer_count The number of provided read buffers. Rounded up to
+     * a power of two.
+     * @param buffer_size The size of each provided read buffer
+     * @return A status code indicating the success or failure of the operation
+     */
+    lib::error_code init(unsigned entries, unsigned buffer_count,
+        size_t buffer_size)
+    {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CLAMP | IORING_SETUP_COOP_TASKRUN;
+
+        int fd = detail::io_uring_setup(entries, &p);
+        if (fd < 0 && errno == EINVAL) {
+            // COOP_TASKRUN is only an optimization and needs Linux 5.19
+            std::memset(&p, 0, sizeof(p));
+            p.flags = IORING_SETUP_CLAMP;
+            fd = detail::io_uring_setup(entries, &p);
+        }
+        if (fd < 0) {
+            return detail::system_error_code(errno);
+        }
+        m_fd = fd;
+
+        if (!(p.features & IORING_FEAT_EXT_ARG) ||
+            !(p.features & IORING_FEAT_NODROP))
+        {
+            destroy();
+            return make_error_code(error::unsupported_kernel);
+        }
+
+        lib::error_code ec = map_rings(p);
+        if (!ec) {
+            ec = init_buffers(buffer_count, buffer_size);
+        }
+        if (!ec) {
+            m_wake_fd = ::eventfd(0, EFD_CLOEXEC);
+            if (m_wake_fd < 0) {
+                ec = detail::system_error_code(errno);
+            }
+        }
+        if (ec) {
+            destroy();
+            return ec;
+        }
+
+        scoped_lock_type guard(m_lock);
+        arm_wake();
+        return lib::error_code();
+    }
+
+    /// Queue an operation
+    /**
+     * The entry is copied into the submission queue and handed to the kernel
+     * the next time the loop enters it. `user_data` is overwritten.
+     *
+     * If `handler` is empty the completion is ignored and the operation does
+     * not keep the loop running.
+     *
+     * @param sqe The submission queue entry to queue
+     * @param handler The handler to call with each completion of the entry
+     * @return A status code indicating the success or failure of the operation
+     */
+    lib::error_code submit(io_uring_sqe const & sqe,
+        completion_handler handler)
+    {
+        scoped_lock_type guard(m_lock);
+
+        io_uring_sqe * slot = next_sqe();
+        if (!slot) {
+            return make_error_code(error::submission_queue_full);
+        }
+
+        *slot = sqe;
+        if (handler) {
+            operation * op = allocate_operation();
+            op->handler.swap(handler);
+            link(op);
+            ++m_outstanding;
+            slot->user_data = static_cast<uint64_t>(
+                reinterpret_cast<uintptr_t>(op));
+        } else {
+            slot->user_data = 0;
+        }
+        commit_sqe();
+
+        wake();
+        return lib::error_code();
+    }
+
+    /// Cancel every pending operation on a file descriptor
+    /**
+     * Each cancelled operation completes with `-ECANCELED`.
+     *
+     * @param fd The file descriptor whose operations to cancel
+     * @param handler The handler to call when the cancellation completes
+     * @return A status code indicating the success or failure of the operation
+     */
+    lib::error_code cancel_fd(int fd, completion_handler handler) {
+        io_uring_sqe sqe;
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.fd = fd;
+        sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        return submit(sqe, handler);
+    }
+
+    /// Run a handler on the thread running the ring
+    void post(post_handler handler) {
+        scoped_lock_type guard(m_lock);
+        m_posted.push_back(handler);
+        wake();
+    }
+
+    /// Schedule a timer
+    /**
+     * @param duration Length of time to wait in milliseconds
+     * @param handler The handler to call when the timer fires or is cancelled
+     * @return A pointer to the new timer
+     */
+    timer_ptr set_timer(long duration, timer_handler handler) {
+        timer_ptr t = lib::make_shared<timer_type>(this, handler);
+        int64_t deadline = detail::now() + int64_t(duration) * 1000000;
+
+        scoped_lock_type guard(m_lock);
+        t->m_position = m_timers.insert(std::make_pair(deadline, t));
+        t->m_pending = true;
+        wake();
+        return t;
+    }
+
+    /// Get a provided read buffer
+    char * get_buffer(uint16_t bid) {
+        return &m_buffers[size_t(bid) * m_buf_size];
+    }
+
+    /// Get the size of each provided read buffer
+    size_t get_buffer_size() const {
+        return m_buf_size;
+    }
+
+    /// Return a provided read buffer to the kernel
+    /**
+     * A reader that got `-ENOBUFS` and is waiting for a buffer is resumed.
+     */
+    void release_buffer(uint16_t bid) {
+        scoped_lock_type guard(m_lock);
+        if (!m_buf_ring) {
+            return;
+        }
+
+        push_buffer(bid);
+        publish_buffers();
+
+        if (!m_buffer_waiters.empty()) {
+            m_posted.push_back(m_buffer_waiters.front());
+            m_buffer_waiters.pop_front();
+            wake();
+        }
+    }
+
+    /// Get a weak pointer that expires when this ring is destroyed
+    /**
+     * The ring is not owned through it. Objects that may outlive the ring,
+     * such as connections holding a provided buffer, check it before
+     * touching the ring.
+     */
+    lib::weak_ptr<type> get_weak_ptr() const {
+        return m_self;
+    }
+
+    /// Call a handler once a provided read buffer is released
+    void wait_for_buffer(post_handler handler) {
+        scoped_lock_type guard(m_lock);
+        m_buffer_waiters.push_back(handler);
+    }
+
+    /// Run the loop until it runs out of work or is stopped
+    /**
+     * @return The number of handlers run
+     */
+    size_t run() {
+        size_t count = 0;
+        while (run_once(true, count)) {}
+        return count;
+    }
+
+    /// Run ready handlers without blocking
+    /**
+     * @return The number of handlers run
+     */
+    size_t poll() {
+        size_t count = 0;
+        run_once(false, count);
+        return count;
+    }
+
+    /// Stop the loop
+    /**
+     * `run` returns as soon as the current handler returns. Pending
+     * operations remain queued until the loop is run again after `reset`.
+     */
+    void stop() {
+        scoped_lock_type guard(m_lock);
+        m_stopped = true;
+        wake();
+    }
+
+    /// Check whether the loop is stopped
+    bool stopped() const {
+        scoped_lock_type guard(m_lock);
+        return m_stopped;
+    }
+
+    /// Clear the stopped flag so that the loop can run again
+    void reset() {
+        scoped_lock_type guard(m_lock);
+        m_stopped = false;
+    }
+
+    /// Keep the loop running while it has no other work
+    void add_work() {
+        scoped_lock_type guard(m_lock);
+        ++m_work;
+    }
+
+    /// Undo a call to add_work
+    void remove_work() {
+        scoped_lock_type guard(m_lock);
+        if (m_work > 0) {
+            --m_work;
+        }
+        wake();
+    }
+private:
+    friend class uring::timer<concurrency>;
+
+    /// An operation whose completions have not all arrived
+    struct operation {
+        completion_handler handler;
+        operation * prev;
+        operation * next;
+    };
+
+    /// Deleter for m_self, which does not own the ring
+    struct null_deleter {
+        void operator()(type *) const {}
+    };
+
+    /// user_data of the eventfd read used to wake the loop
+    static uint64_t const wake_token = 1;
+
+    bool run_once(bool block, size_t & count) {
+        {
+            scoped_lock_type guard(m_lock);
+            if (m_stopped || work() == 0) {
+                return false;
+            }
+            m_ready.swap(m_posted);
+        }
+
+        for (size_t i = 0; i < m_ready.size(); ++i) {
+            m_ready[i]();
+            ++count;
+        }
+        m_ready.clear();
+
+        count += fire_timers();
+
+        unsigned to_submit;
+        unsigned wait_nr = 0;
+        __kernel_timespec ts;
+        io_uring_getevents_arg arg;
+        std::memset(&arg, 0, sizeof(arg));
+        {
+            scoped_lock_type guard(m_lock);
+            to_submit = m_sq_tail - __atomic_load_n(m_sq_khead,
+                __ATOMIC_ACQUIRE);
+
+            if (block && !m_stopped && m_posted.empty() && work() > 0) {
+                wait_nr = 1;
+                m_waiting = true;
+
+                if (!m_timers.empty()) {
+                    int64_t wait = m_timers.begin()->first - detail::now();
+                    if (wait < 0) {
+                        wait = 0;
+                    }
+                    ts.tv_sec = wait / 1000000000;
+                    ts.tv_nsec = wait % 1000000000;
+                    arg.ts = static_cast<uint64_t>(
+                        reinterpret_cast<uintptr_t>(&ts));
+                }
+            }
+        }
+
+        // Submitting, waiting and (with COOP_TASKRUN) running deferred
+        // completion work all happen in this one call. Its errors (EINTR,
+        // ETIME, EBUSY on completion queue overflow) only mean that there
+        // is nothing more to do in this iteration.
+        detail::io_uring_enter(m_fd, to_submit, wait_nr,
+            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+
+        {
+            scoped_lock_type guard(m_lock);
+            m_waiting = false;
+            m_woken = false;
+        }
+
+        count += reap();
+        return true;
+    }
+
+    size_t fire_timers() {
+        int64_t now = detail::now();
+        {
+            scoped_lock_type guard(m_lock);
+            while (!m_timers.empty() && m_timers.begin()->first <= now) {
+                timer_ptr t = m_timers.begin()->second;
+                m_timers.erase(m_timers.begin());
+                t->m_pending = false;
+                t->m_expired = true;
+                m_fired.push_back(t);
+            }
+        }
+
+        size_t count = m_fired.size();
+        for (size_t i = 0; i < count; ++i) {
+            timer_handler handler;
+            handler.swap(m_fired[i]->m_handler);
+            handler(lib::error_code());
+        }
+        m_fired.clear();
+        return count;
+    }
+
+    size_t reap() {
+        size_t count = 0;
+        unsigned head = __atomic_load_n(m_cq_khead, __ATOMIC_RELAXED);
+
+        for (;;) {
+            unsigned tail = __atomic_load_n(m_cq_ktail, __ATOMIC_ACQUIRE);
+            if (head == tail) {
+                break;
+            }
+
+            io_uring_cqe const & cqe = m_cqes[head & m_cq_mask];
+            uint64_t user_data = cqe.user_data;
+            int res = cqe.res;
+            uint32_t flags = cqe.flags;
+
+            ++head;
+            __atomic_store_n(m_cq_khead, head, __ATOMIC_RELEASE);
+
+            if (complete(user_data, res, flags)) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    bool complete(uint64_t user_data, int res, uint32_t flags) {
+        if (user_data == 0) {
+            return false;
+        }
+
+        if (user_data == wake_token) {
+            scoped_lock_type guard(m_lock);
+            arm_wake();
+            return false;
+        }
+
+        operation * op = reinterpret_cast<operation *>(
+            static_cast<uintptr_t>(user_data));
+
+        if (flags & IORING_CQE_F_MORE) {
+            // multishot operation with more completions to come
+            op->handler(res, flags);
+            return true;
+        }
+
+        completion_handler handler;
+        handler.swap(op->handler);
+        {
+            scoped_lock_type guard(m_lock);
+            unlink(op);
+            --m_outstanding;
+            m_free_operations.push_back(op);
+        }
+
+        handler(res, flags);
+        return true;
+    }
+
+    void cancel_timer(timer_type & t) {
+        scoped_lock_type guard(m_lock);
+        if (!t.m_pending) {
+            return;
+        }
+
+        t.m_pending = false;
+        m_posted.push_back(lib::bind(t.m_handler,
+            make_error_code(transport::error::operation_aborted)));
+        t.m_handler = timer_handler();
+        // may drop the last reference but the caller holds another one
+        m_timers.erase(t.m_position);
+        wake();
+    }
+
+    bool timer_expired(timer_type const & t) const {
+        scoped_lock_type guard(m_lock);
+        return t.m_expired;
+    }
+
+    /// Amount of outstanding work that keeps the loop running. Needs m_lock.
+    size_t work() const {
+        return m_outstanding + m_timers.size() + m_posted.size() +
+            m_buffer_waiters.size() + m_work;
+    }
+
+    /// Wake the loop if it is waiting in the kernel. Needs m_lock.
+    void wake() {
+        if (m_waiting && !m_woken) {
+            m_woken = true;
+            uint64_t one = 1;
+            if (::write(m_wake_fd, &one, sizeof(one)) < 0) {
+                // the counter is already non-zero, the loop will wake
+            }
+        }
+    }
+
+    /// Queue a read of the wake eventfd. Needs m_lock.
+    void arm_wake() {
+        if (m_fd < 0) {
+            return;
+        }
+
+        io_uring_sqe * slot = next_sqe();
+        if (!slot) {
+            return;
+        }
+
+        std::memset(slot, 0, sizeof(*slot));
+        slot->opcode = IORING_OP_READ;
+        slot->fd = m_wake_fd;
+        slot->addr = static_cast<uint64_t>(
+            reinterpret_cast<uintptr_t>(&m_wake_value));
+        slot->len = sizeof(m_wake_value);
+        slot->user_data = wake_token;
+        commit_sqe();
+    }
+
+    /// Get the next free submission queue entry. Needs m_lock.
+    io_uring_sqe * next_sqe() {
+        if (m_fd < 0) {
+            return NULL;
+        }
+
+        unsigned head = __atomic_load_n(m_sq_khead, __ATOMIC_ACQUIRE);
+        if (m_sq_tail - head >= m_sq_entries) {
+            // Full. Hand the queued entries to the kernel now rather than
+            // waiting for the next loop iteration.
+            detail::io_uring_enter(m_fd, m_sq_tail - head, 0, 0, NULL, 0);
+            head = __atomic_load_n(m_sq_khead, __ATOMIC_ACQUIRE);
+            if (m_sq_tail - head >= m_sq_entries) {
+                return NULL;
+            }
+        }
+        return &m_sqes[m_sq_tail & m_sq_mask];
+    }
+
+    /// Make the entry returned by next_sqe visible. Needs m_lock.
+    void commit_sqe() {
+        ++m_sq_tail;
+        __atomic_store_n(m_sq_ktail, m_sq_tail, __ATOMIC_RELEASE);
+    }
+
+    operation * allocate_operation() {
+        if (m_free_operations.empty()) {
+            return new operation();
+        }
+        operation * op = m_free_operations.back();
+        m_free_operations.pop_back();
+        return op;
+    }
+
+    void link(operation * op) {
+        op->prev = &m_operations;
+        op->next = m_operations.next;
+        m_operations.next->prev = op;
+        m_operations.next = op;
+    }
+
+    void unlink(operation * op) {
+        op->prev->next = op->next;
+        op->next->prev = op->prev;
+    }
+
+    lib::error_code map_rings(io_uring_params const & p) {
+        m_sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        m_cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            if (m_cq_ring_size > m_sq_ring_size) {
+                m_sq_ring_size = m_cq_ring_size;
+            }
+            m_cq_ring_size = 0;
+        }
+
+        m_sq_ring = map(m_sq_ring_size, IORING_OFF_SQ_RING);
+        if (!m_sq_ring) {
+            return detail::system_error_code(errno);
+        }
+
+        if (m_cq_ring_size == 0) {
+            m_cq_ring = m_sq_ring;
+        } else {
+            m_cq_ring = map(m_cq_ring_size, IORING_OFF_CQ_RING);
+            if (!m_cq_ring) {
+                return detail::system_error_code(errno);
+            }
+        }
+
+        m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe *>(map(m_sqes_size,
+            IORING_OFF_SQES));
+        if (!m_sqes) {
+            return detail::system_error_code(errno);
+        }
+
+        char * sq = static_cast<char *>(m_sq_ring);
+        m_sq_khead = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        m_sq_ktail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        m_sq_mask = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        m_sq_entries = p.sq_entries;
+        m_sq_tail = *m_sq_ktail;
+
+        // Entries are always used in order, so the indirection array is the
+        // identity mapping.
+        unsigned * array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        for (unsigned i = 0; i < p.sq_entries; ++i) {
+            array[i] = i;
+        }
+
+        char * cq = static_cast<char *>(m_cq_ring);
+        m_cq_khead = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        m_cq_ktail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        m_cq_mask = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+
+        return lib::error_code();
+    }
+
+    void * map(size_t size, off_t offset) {
+        void * ptr = ::mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return ptr == MAP_FAILED ? NULL : ptr;
+    }
+
+    lib::error_code init_buffers(unsigned count, size_t size) {
+        // The buffer ring size must be a power of two and buffer ids are
+        // 16 bits.
+        unsigned entries = 1;
+        while (entries < count && entries < 32768) {
+            entries <<= 1;
+        }
+
+        m_buf_ring_size = entries * sizeof(io_uring_buf);
+        void * ptr = ::mmap(NULL, m_buf_ring_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return detail::system_error_code(errno);
+        }
+        m_buf_ring = static_cast<io_uring_buf *>(ptr);
+        m_buf_count = entries;
+        m_buf_size = size;
+        m_buffers.resize(size_t(entries) * size);
+
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr));
+        reg.ring_entries = entries;
+        reg.bgid = buffer_group;
+
+        if (detail::io_uring_register(m_fd, IORING_REGISTER_PBUF_RING, &reg,
+            1) < 0)
+        {
+            if (errno == EINVAL) {
+                return make_error_code(error::unsupported_kernel);
+            }
+            return detail::system_error_code(errno);
+        }
+
+        for (unsigned i = 0; i < entries; ++i) {
+            push_buffer(static_cast<uint16_t>(i));
+        }
+        publish_buffers();
+
+        return lib::error_code();
+    }
+
+    /// Add a buffer to the buffer ring. Needs m_lock.
+    void push_buffer(uint16_t bid) {
+        io_uring_buf & buf = m_buf_ring[m_buf_tail & (m_buf_count - 1)];
+        buf.addr = static_cast<uint64_t>(
+            reinterpret_cast<uintptr_t>(get_buffer(bid)));
+        buf.len = static_cast<uint32_t>(m_buf_size);
+        buf.bid = bid;
+        ++m_buf_tail;
+    }
+
+    /// Make pushed buffers visible to the kernel. Needs m_lock.
+    void publish_buffers() {
+        // The ring tail shares its location with the reserved field of the
+        // first entry.
+        __atomic_store_n(&m_buf_ring[0].resv, m_buf_tail, __ATOMIC_RELEASE);
+    }
+
+    void destroy() {
+        if (m_buf_ring) {
+            ::munmap(m_buf_ring, m_buf_ring_size);
+            m_buf_ring = NULL;
+        }
+        if (m_sqes) {
+            ::munmap(m_sqes, m_sqes_size);
+            m_sqes = NULL;
+        }
+        if (m_cq_ring && m_cq_ring != m_sq_ring) {
+            ::munmap(m_cq_ring, m_cq_ring_size);
+        }
+        m_cq_ring = NULL;
+        if (m_sq_ring) {
+            ::munmap(m_sq_ring, m_sq_ring_size);
+            m_sq_ring = NULL;
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        if (m_wake_fd >= 0) {
+            ::close(m_wake_fd);
+            m_wake_fd = -1;
+        }
+    }
+
+    int                 m_fd;
+    int                 m_wake_fd;
+
+    void *              m_sq_ring;
+    size_t              m_sq_ring_size;
+    void *              m_cq_ring;
+    size_t              m_cq_ring_size;
+    io_uring_sqe *      m_sqes;
+    size_t              m_sqes_size;
+
+    unsigned *          m_sq_khead;
+    unsigned *          m_sq_ktail;
+    unsigned            m_sq_mask;
+    unsigned            m_sq_entries;
+    unsigned            m_sq_tail;
+
+    unsigned *          m_cq_khead;
+    unsigned *          m_cq_ktail;
+    unsigned            m_cq_mask;
+    io_uring_cqe *      m_cqes;
+
+    io_uring_buf *      m_buf_ring;
+    size_t              m_buf_ring_size;
+    unsigned            m_buf_count;
+    size_t              m_buf_size;
+    uint16_t            m_buf_tail;
+    std::vector<char>   m_buffers;
+
+    mutable mutex_type  m_lock;
+    operation           m_operations;
+    std::vector<operation *> m_free_operations;
+    size_t              m_outstanding;
+    size_t              m_work;
+    std::vector<post_handler> m_posted;
+    std::vector<post_handler> m_ready;
+    std::deque<post_handler> m_buffer_waiters;
+    typename timer_type::queue_type m_timers;
+    std::vector<timer_ptr> m_fired;
+
+    uint64_t            m_wake_value;
+    bool                m_waiting;
+    bool                m_woken;
+    bool                m_stopped;
+
+    // Declared last so that it expires only after the destructor has released
+    // every handler
+    lib::shared_ptr<type> m_self;
+};
+
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_RING_HPP
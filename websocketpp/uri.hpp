@@ -72,6 +72,30 @@ public:
             m_secure = true;
             m_scheme = "https";
             it += 8;
+        } else if (uri_len >= 6 && std::equal(it,it+5,"unix:")) {
+            // unix:<socket path>[:<resource>]
+            // The path is used as is and may not contain ':'. The handshake
+            // is sent to localhost.
+            it += 5;
+            temp = std::find(it,uri_string.end(),':');
+
+            m_scheme = "unix";
+            m_secure = false;
+            m_host = "localhost";
+            m_port = uri_default_port;
+            m_socket_path.assign(it,temp);
+
+            m_resource = "/";
+            if (temp != uri_string.end()) {
+                ++temp;
+                if (temp != uri_string.end() && *temp == '/') {
+                    ++temp;
+                }
+                m_resource.append(temp,uri_string.end());
+            }
+
+            m_valid = !m_socket_path.empty();
+            return;
         } else {
             return;
         }
@@ -270,9 +294,31 @@ public:
         return m_resource;
     }
 
+    /// Return the unix domain socket path
+    /**
+     * URIs of the form `unix:/run/ws.sock` or `unix:/run/ws.sock:/resource`
+     * connect to a unix domain socket rather than a TCP host and port. The
+     * host of such a URI is `localhost`.
+     *
+     * @since 0.8.0
+     *
+     * @return The socket path, or an empty string for other URIs.
+     */
+    std::string const & get_socket_path() const {
+        return m_socket_path;
+    }
+
     std::string str() const {
         std::stringstream s;
 
+        if (!m_socket_path.empty()) {
+            s << "unix:" << m_socket_path;
+            if (m_resource != "/") {
+                s << ":" << m_resource;
+            }
+            return s.str();
+        }
+
         s << m_scheme << "://" << m_host;
 
         if (m_port != (m_secure ? uri_default_secure_port : uri_default_port)) {
@@ -342,6 +388,7 @@ private:
     std::string m_scheme;
     std::string m_host;
     std::string m_resource;
+    std::string m_socket_path;
     uint16_t    m_port;
     bool        m_secure;
     bool        m_valid;